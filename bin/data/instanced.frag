@@ -0,0 +1,25 @@
+// Instanced model fragment shader
+// Matches the fixed-function path the queue uses for single draws: vertex
+// color times the material's diffuse plus its emission, modulated by the
+// mesh texture when there is one. The loader's
+// textures are rectangles; the texture pipeline's are mipmapped 2D.
+
+#extension GL_ARB_texture_rectangle : enable
+
+uniform sampler2DRect tex;
+uniform sampler2D tex2D;
+uniform float textured;  // 0 none, 1 rectangle, 2 2D
+uniform vec4 materialDiffuse;
+uniform vec4 materialEmissive;
+
+void main()
+{
+    vec4 color = gl_Color * materialDiffuse;
+    color.rgb += materialEmissive.rgb;
+    if (textured > 1.5) {
+        color *= texture2D(tex2D, gl_TexCoord[0].st);
+    } else if (textured > 0.5) {
+        color *= texture2DRect(tex, gl_TexCoord[0].st);
+    }
+    gl_FragColor = color;
+}
@@ -0,0 +1,12 @@
+// Instanced model vertex shader
+// One draw covers every copy of a mesh; each copy's model matrix arrives as a
+// per-instance attribute and is applied ahead of the shared modelview.
+
+attribute mat4 instanceMatrix;
+
+void main()
+{
+    gl_Position = gl_ModelViewProjectionMatrix * (instanceMatrix * gl_Vertex);
+    gl_TexCoord[0] = gl_TextureMatrix[0] * gl_MultiTexCoord0;
+    gl_FrontColor = gl_Color;
+}
@@ -1,42 +1,57 @@
 // Radome fragment shader
 
+#extension GL_EXT_texture_array : enable
+
+#define MAX_VIDEO_LAYERS 4
+
 uniform samplerCube EnvMap;
 varying vec3 ReflectDir;
 varying vec4 position;
 
-uniform sampler2DRect video;
-uniform vec2 videoSize;
-uniform float videoMix;
-uniform int mixMode;
-uniform int mappingMode;
+// Active 2D layers, packed bottom to top; each samples its own array slice.
+uniform sampler2DArray layers;
+uniform int layerCount;
+uniform float layerSlice[MAX_VIDEO_LAYERS];
+uniform int layerMapping[MAX_VIDEO_LAYERS];
+uniform int layerBlend[MAX_VIDEO_LAYERS];
+uniform float layerMix[MAX_VIDEO_LAYERS];
+uniform vec2 layerSize[MAX_VIDEO_LAYERS];
+
 uniform float domeHeight;
 uniform float domeDiameter;
 
-vec2 getUV() {
-    vec2 normalUV;
+// Projector color correction; identity unless set for an output pass.
+uniform sampler3D colorLUT;
+uniform float lutEnabled;
+uniform vec3 lutScale;
+uniform vec3 lutOffset;
+uniform float outputGamma;
+uniform float blackLevel;
+
+// Normalized layer coordinates for the dome position under the given mapping.
+vec2 getUV(int mappingMode, vec2 videoSize) {
     if (mappingMode == 0) {
         // Basic latitude/longitude mapping
-        normalUV = vec2(0.5 + atan(position.x, position.z)/(2.0*3.141592),
-                        4.0 * asin(position.y/domeHeight)/(2.0*3.141592));
+        return vec2(0.5 + atan(position.x, position.z)/(2.0*3.141592),
+                    4.0 * asin(position.y/domeHeight)/(2.0*3.141592));
     } else if (mappingMode == 1) {
         // Mirrored quadrants
-        normalUV = vec2(abs(position.x)/domeDiameter,
-                        4.0 * asin(position.y/domeHeight)/(2.0*3.141592));
+        return vec2(abs(position.x)/domeDiameter,
+                    4.0 * asin(position.y/domeHeight)/(2.0*3.141592));
     } else if (mappingMode == 2) {
         // Fisheye
         float radians = atan(position.x, position.z);
         float radius = 1.0 - asin(position.y/domeHeight)/(2.0*3.141592);
-        float dist = videoSize.y * 0.5 * radius * 0.2;
-        return vec2(0.5 * videoSize.x + dist * sin(radians), 0.5 * videoSize.y + dist * cos(radians));
+        float dist = 0.5 * radius * 0.2;
+        float aspect = videoSize.y / max(videoSize.x, 1.0);
+        return vec2(0.5 + dist * aspect * sin(radians), 0.5 + dist * cos(radians));
     } else {
         // Default UV
-        normalUV = gl_TexCoord[0].st;
+        return gl_TexCoord[0].st;
     }
-    
-    return vec2(normalUV.s * videoSize.x, normalUV.t * videoSize.y);
 }
 
-vec4 mixColors(vec4 envColor, vec4 videoColor, float videoMix) {
+vec4 mixColors(vec4 envColor, vec4 videoColor, float videoMix, int mixMode) {
     if (mixMode == 0) {
         // Underlay
         return mix(videoColor, envColor, envColor.a * videoMix);
@@ -51,18 +66,25 @@ vec4 mixColors(vec4 envColor, vec4 videoColor, float videoMix) {
     }
 }
 
-/*
-vec4 multiLayerMix(vec4 envColor,
-                   vec4 videoOverlayColor, float videoOverlayMix,
-                   vec4 videoUnderlayColor, float videoUnderlayMix,
-                   vec4 videoMaskColor, float videoMaskMix)
-{
-    vec4 mask = mix(envColor, videoMaskColor, envColor.a * videoMaskMix);
-    vec4 under = mix(videoUnderlayColor, mask, envColor.a * videoUnderlayMix);
-    vec4 over = mix(under, videoOverlayColor, videoOverlayColor.a * videoOverlayMix);
-    return over;
+// One fetch per active layer, each blended over the result so far.
+vec4 compositeLayers(vec4 color) {
+    for (int ii = 0; ii < MAX_VIDEO_LAYERS; ii++) {
+        if (ii >= layerCount) break;
+        vec2 uv = getUV(layerMapping[ii], layerSize[ii]);
+        vec4 videoColor = texture2DArray(layers, vec3(uv, layerSlice[ii]));
+        color = mixColors(color, videoColor, layerMix[ii], layerBlend[ii]);
+    }
+    return color;
+}
+
+// One 3D texture fetch for the LUT; gamma and black level are arithmetic.
+vec3 correctColor(vec3 color) {
+    if (lutEnabled > 0.5) {
+        color = texture3D(colorLUT, clamp(color, 0.0, 1.0) * lutScale + lutOffset).rgb;
+    }
+    color = pow(max(color, 0.0), vec3(outputGamma));
+    return blackLevel + (1.0 - blackLevel) * color;
 }
-*/
 
 void main()
 {
@@ -75,7 +97,7 @@ void main()
         if (distSquared < pow(domeDiameter/2.0, 2.0) ) { // unless it's under the dome
             discard;
         } else {
-            gl_FragColor = vec4(0.15, 0.75, 0.3, 1.0);
+            gl_FragColor = vec4(correctColor(vec3(0.15, 0.75, 0.3)), 1.0);
         }
     } else {
         
@@ -85,18 +107,12 @@ void main()
         // Look up texture pixel in cube map
         vec4 color = textureCube(EnvMap, lookupVec);
 
-        if (videoMix >= 0.0) {
-            // Get 2D video overlay color from the mapping mode and the input video texture
-            vec2 uv = getUV();
-            vec4 videoColor = texture2DRect(video, uv);
-
-            // Blend according to the mix mode and mix level
-            color = mixColors(color, videoColor, videoMix);
-        }
+        // Blend the 2D layers according to their mapping and mix modes
+        color = compositeLayers(color);
         
         // Blend any remaining alpha against black
         gl_FragColor = mix(vec4(0.0,0.0,0.0,1.0), color, color.a);
-        gl_FragColor.a = 1.0;
+        gl_FragColor = vec4(correctColor(gl_FragColor.rgb), 1.0);
     }
 }
 
@@ -0,0 +1,38 @@
+// Skinned, instanced model vertex shader
+// The mesh stays in its bind pose; each vertex blends up to four bone
+// matrices read from the bone palette texture, then the copy's instance
+// matrix and the shared modelview apply as in instanced.vert.
+
+attribute mat4 instanceMatrix;
+attribute vec4 boneIndices;
+attribute vec4 boneWeights;
+
+uniform sampler2D bones;
+uniform vec2 paletteSize;
+uniform float boneBase;
+
+// A bone is four consecutive texels, one per matrix column.
+mat4 boneMatrix(float bone)
+{
+    float texel = (boneBase + bone) * 4.0;
+    float row = floor(texel / paletteSize.x);
+    vec2 uv = (vec2(texel - row * paletteSize.x, row) + 0.5) / paletteSize;
+    vec2 step = vec2(1.0 / paletteSize.x, 0.0);
+    return mat4(texture2DLod(bones, uv, 0.0),
+                texture2DLod(bones, uv + step, 0.0),
+                texture2DLod(bones, uv + step * 2.0, 0.0),
+                texture2DLod(bones, uv + step * 3.0, 0.0));
+}
+
+void main()
+{
+    mat4 skin = boneMatrix(boneIndices.x) * boneWeights.x
+              + boneMatrix(boneIndices.y) * boneWeights.y
+              + boneMatrix(boneIndices.z) * boneWeights.z
+              + boneMatrix(boneIndices.w) * boneWeights.w;
+
+    vec4 position = instanceMatrix * (skin * gl_Vertex);
+    gl_Position = gl_ModelViewProjectionMatrix * position;
+    gl_TexCoord[0] = gl_TextureMatrix[0] * gl_MultiTexCoord0;
+    gl_FrontColor = gl_Color;
+}
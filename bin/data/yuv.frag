@@ -0,0 +1,28 @@
+// Video file fragment shader
+// Converts a frame of planar Y'CbCr, as Y4M files hold it, to RGB while it
+// is drawn into its video layer. Each plane is a luminance texture of its
+// own size, so subsampled chroma is filtered up to the luma's.
+
+uniform sampler2D yPlane;
+uniform sampler2D cbPlane;
+uniform sampler2D crPlane;
+uniform float chroma;         // 0 for monochrome files
+uniform float fullRange;      // 0 for studio swing, 16-235 and 16-240
+uniform vec4 coefficients;    // Cr to R, Cb to G, Cr to G, Cb to B
+
+void main()
+{
+    vec2 uv = gl_TexCoord[0].st;
+    float y = texture2D(yPlane, uv).r;
+    float cb = chroma * (texture2D(cbPlane, uv).r - 0.5);
+    float cr = chroma * (texture2D(crPlane, uv).r - 0.5);
+    if (fullRange < 0.5) {
+        y = (y - 16.0 / 255.0) * (255.0 / 219.0);
+        cb *= 255.0 / 224.0;
+        cr *= 255.0 / 224.0;
+    }
+    vec3 rgb = vec3(y + coefficients.x * cr,
+                    y - coefficients.y * cb - coefficients.z * cr,
+                    y + coefficients.w * cb);
+    gl_FragColor = vec4(clamp(rgb, 0.0, 1.0), 1.0) * gl_Color;
+}
@@ -260,6 +260,13 @@ namespace icosohedron
     // levels should be 0 or greater
     // there will be 4^(levels+1) faces in there sphere
     vector<Triangle> createsphere(int levels)
+    {
+        vector<Triangle> triangles = createicosahedron();
+        for (int ctr = 0; ctr < levels; ctr++) subdivide(triangles);
+        return triangles;
+    }
+
+    vector<Triangle> createicosahedron()
     {
         
         vector<Triangle> triangles;
@@ -304,8 +311,6 @@ namespace icosohedron
         triangles.push_back(Triangle(v6, v1, v3));
         triangles.push_back(Triangle(v11, v7, v5)); // x
         
-        for (int ctr = 0; ctr < levels; ctr++) subdivide(triangles);
-        
         return triangles;
     }
 }
\ No newline at end of file
@@ -42,6 +42,10 @@ namespace icosohedron
     };
     
     std::vector<Triangle> createsphere(int levels);
+    // The 20 faces createsphere() starts from; each face subdivides
+    // independently of the others.
+    std::vector<Triangle> createicosahedron();
+    void subdivide(std::vector<Triangle>& triangles);
         
 }
 
@@ -9,83 +9,192 @@
 #define DOME_DIAMETER 300
 #define DOME_HEIGHT 110
 #define NUM_PROJECTORS 3
+#define OUTPUT_FRAME_RATE 45
+#define PREVIEW_RATE_DIVISOR 2
+#define PREVIEW_RESOLUTION_SCALE 0.5
+#define PROJECTOR_MIN_RENDER_SCALE 0.5
+#define PROJECTOR_MAX_RENDER_SCALE 1.0
+#define PROJECTOR_BUDGET_FRACTION 0.6
+#define CUBE_MAP_SIZE 1024
+#define GPU_MEMORY_BUDGET_MB 256
+#define GEOMETRY_STREAM_KB 1024
+#define DOME_SUBDIVISIONS 4
+#define MODEL_UPDATE_GRAIN 16
+#define SCALING_SWEEP_FRAMES 120
+#define FRAMES_IN_FLIGHT 2
+//spin increments are per step, so stepping at the old frame rate keeps their speed
+#define SIMULATION_RATE OUTPUT_FRAME_RATE
+#define OSC_PORT 9000
+#define OSC_LOOPBACK_PINGS 10000
+#define OSC_LOOPBACK_TIMEOUT_MS 2000
+//layer n reads frames from the shared memory ring SHARED_VIDEO_NAME + n
+#define SHARED_VIDEO_NAME "/radome-layer"
 
 #define PROJECTOR_INITIAL_HEIGHT 147.5
 #define PROJECTOR_INITIAL_DISTANCE DOME_DIAMETER*1.5
 
-radomeApp::radomeApp() {
+radomeApp::radomeApp()
+: _oscListener(&_controls)
+{
   _pUI = NULL;
   _projectorWindow = NULL;
 }
 
 radomeApp::~radomeApp() {
+  _oscListener.stop();
   if (_pUI)
     delete (_pUI);
     
-  if (_projectorWindow) {
-    _projectorWindow->destroy();
-    ofxFensterManager::get()->deleteFenster(_projectorWindow);
-  }
-    
-  deletePointerCollection(_projectorList);
-  deletePointerCollection(_modelList);
+  closeProjectorWindows();
+
+  if (_renderThread.isRendering())
+    _renderThread.stop();
+  else
+    teardownRenderer();
 }
 
 void radomeApp::setup() {
+  //CPU-heavy work below and in update() is spread over one worker per core
+  _jobSystem.setup();
+
   //configure window manager
   ofxFensterManager::get()->setWindowTitle("radome");
   
-  ofSetFrameRate(45);
+  ofSetFrameRate(OUTPUT_FRAME_RATE);
   ofEnableSmoothing();
 
   //set the display mode (see enum in header)
   _displayMode = DisplayScene;
-  //seems to be related to the shader?
-  _mixMode = 0;
-  //shader variable
-  _mappingMode = 0;
+  _previewMode = DisplayScene;
+  //2D layer that the mixer controls edit
+  _selectedLayer = 0;
+  for (int ii = 0; ii < MAX_VIDEO_LAYERS; ii++) {
+    LayerControls controls = { _layerStack.getBlendMode(ii), _layerStack.getMappingMode(ii), _layerStack.getFader(ii) };
+    _layerControls.push_back(controls);
+  }
+  _fullscreen = false;
+  _framesInFlight = FRAMES_IN_FLIGHT;
+  
+  //setup turntable cam
+  _cam.setTarget(ofVec3f(0.0, DOME_HEIGHT*0.25, 0.0));
+  _cam.setRotation(0.66, 0.5);
+  _cam.setupPerspective(false);
+
+  //initialize the GUI!
+  initGUI();
+
+  //show control can drive the same parameters as the GUI over OSC
+  bindControls();
+  _loopbackParameter = -1;
+  _oscListener.start(OSC_PORT);
+
+  //the scene and the outputs live on the render thread from here on; without
+  //a render context of its own, it all runs in update() instead
+  if (!_renderThread.start(this, OUTPUT_FRAME_RATE, SIMULATION_RATE))
+    setupRenderer();
+}
+
+// Render thread, render context current.
+void radomeApp::setupRenderer() {
   //animation timer for the modelList
   _animationTime = 0.0;
-  _lastSystemTime = ofGetSystemTime();
-  _fullscreen = false;
+  _videoClock = 0.0;
+  _videoTime = 0.0;
+  _frameInputTime = ofGetElapsedTimeMicros();
+  _modelUpdatePending = false;
+  //no thread scaling measurement until 'j'
+  _scalingThreads = 0;
+
+  //GL state is per context, and this one starts from the defaults
+  ofEnableSmoothing();
   
   _shader.load("radome");
+  _instancedShader.load("instanced");
+  _renderQueue.setInstancingShader(_instancedShader.isLoaded() ? &_instancedShader : NULL);
+
+  //the CPU simulates the next frame while the GPU renders this one, up to
+  //FRAMES_IN_FLIGHT frames ahead
+  _framePipeline.setup(FRAMES_IN_FLIGHT);
+
+  //animated meshes write their skinned vertices into a per-frame upload ring
+  _geometryStream.allocate(GEOMETRY_STREAM_KB * 1024);
+  _modelCache.setStreamBuffer(&_geometryStream);
+
+  //skinned meshes are posed by the shader from a per-frame bone palette;
+  //without one they fall back to the stream above
+  _skinnedShader.load("skinned.vert", "instanced.frag");
+  if (_skinnedShader.isLoaded() && _bonePalette.allocate() &&
+      _renderQueue.setSkinningShader(&_skinnedShader, &_bonePalette))
+    _modelCache.setBonePalette(&_bonePalette);
+
+  //imported meshes get simplified detail levels built in the background
+  _modelCache.setLodBuilder(&_lodBuilder);
+
+  //model textures are decoded, mipmapped and compressed in the background
+  _texturePipeline.setup();
+  _modelCache.setTexturePipeline(&_texturePipeline);
+
+  //model files are parsed in the background and join the scene when uploaded
+  _modelLoader.setJobSystem(&_jobSystem);
+  _modelCache.setModelLoader(&_modelLoader);
+
+  //all GPU allocations are accounted against this budget
+  radomeGpuMemory::get().setBudget(GPU_MEMORY_BUDGET_MB * 1024 * 1024);
   
   //initialize cubemap in the FBO
-  _cubeMap.initEmptyTextures(1024);
+  _cubeMap.initEmptyTextures(CUBE_MAP_SIZE);
+  radomeGpuMemory::get().track(&_cubeMap, "cube map", GpuCubeMap,
+    radomeGpuMemory::estimateFramebufferBytes(CUBE_MAP_SIZE, CUBE_MAP_SIZE, GL_RGBA, true, 6));
   _cubeMap.setNearFar(ofVec2f(0.01, 8192.0));
   
-  //setup turntable cam
-  _cam.setTarget(ofVec3f(0.0, DOME_HEIGHT*0.25, 0.0));
-  _cam.setRotation(0.66, 0.5);
-  _cam.setupPerspective(false);
+  //the operator preview follows the UI's camera through CommandSetCamera
+  _previewCam.setupPerspective(false);
+
+  //operator preview runs at a fraction of the output rate and resolution
+  _preview.setFrameBudget(1.0/OUTPUT_FRAME_RATE);
+  _preview.setRateDivisor(PREVIEW_RATE_DIVISOR);
+  _preview.setResolutionScale(PREVIEW_RESOLUTION_SCALE);
+
+  //projector passes share a slice of the frame; resolution adapts to stay in it
+  _resolutionGovernor.setBounds(PROJECTOR_MIN_RENDER_SCALE, PROJECTOR_MAX_RENDER_SCALE);
+  _resolutionGovernor.setFrameBudget(PROJECTOR_BUDGET_FRACTION/OUTPUT_FRAME_RATE);
   
   //icosohedron class? My guess is that this creates the dome mesh.
-  _triangles = icosohedron::createsphere(4);
+  createDomeTriangles(DOME_SUBDIVISIONS);
   
   //syphon client
   //  _vidOverlay.initialize(DEFAULT_SYPHON_APP, DEFAULT_SYPHON_SERVER);
+  //  _layerStack.setSource(0, &_vidOverlay, false);
   //_vidOverlay.setFaderValue(0.75);
   
-  //setup a blank  ofImage
-  unsigned char p[3] = {0, 0, 0};
-  _blankImage.setUseTexture(true);
-  //set it to a 1x1 black pixel?
-  _blankImage.setFromPixels(p, 1, 1, OF_IMAGE_COLOR);
-  
   //create list of projectors and their positions.
   for (int ii = 0; ii < NUM_PROJECTORS; ii++) {
     _projectorList.push_back(new radomeProjector(ii*360.0/(NUM_PROJECTORS*1.0)+60.0, PROJECTOR_INITIAL_DISTANCE, PROJECTOR_INITIAL_HEIGHT));
   }    
   
-  //initialize the GUI!
-  initGUI();
+  loadColorLUTs();
   
   glEnable(GL_DEPTH_TEST);
   //some more dome geometry setup
   prepDrawList();
 }
 
+// Render thread; the render context is still current, so its framebuffers
+// go with it.
+void radomeApp::teardownRenderer() {
+  finishModelUpdate();
+  //the loader's jobs need the workers the sweep parks
+  if (_scalingThreads) {
+    _scalingThreads = 0;
+    _jobSystem.setActiveThreads(_jobSystem.getThreadCount());
+  }
+  _framePipeline.release();
+  deletePointerCollection(_projectorList);
+  _projectorList.clear();
+  deletePointerCollection(_modelList);
+  _modelList.clear();
+}
+
 void radomeApp::initGUI() {
   _pUI = new ofxUICanvas(5, 0, SIDEBAR_WIDTH, ofGetHeight());
   _pUI->setWidgetSpacing(5.0);
@@ -103,18 +212,26 @@ void radomeApp::initGUI() {
   _pCalibrationUI->addSlider("PROJECTOR 1 DISTANCE", DOME_DIAMETER/20.0, DOME_DIAMETER/5.0, PROJECTOR_INITIAL_DISTANCE/10.0, 200, 25);
   _pCalibrationUI->addSlider("PROJECTOR 1 FOV", 20.0, 90.0, 30.0, 200, 25);
   _pCalibrationUI->addSlider("PROJECTOR 1 TARGET", 0.0, DOME_HEIGHT/10.0, 2.0, 200, 25);
+  _pCalibrationUI->addSlider("PROJECTOR 1 GAMMA", 0.5, 2.5, 1.0, 200, 25);
+  _pCalibrationUI->addSlider("PROJECTOR 1 BLACK", 0.0, 0.2, 0.0, 200, 25);
   _pCalibrationUI->addSpacer(0, 12);
   _pCalibrationUI->addSlider("PROJECTOR 2 HEIGHT", 5.0, 20.0, PROJECTOR_INITIAL_HEIGHT/10.0, 200, 25);
   _pCalibrationUI->addSlider("PROJECTOR 2 HEADING", 120.0, 240.0, 180.0, 200, 25);
   _pCalibrationUI->addSlider("PROJECTOR 2 DISTANCE", DOME_DIAMETER/20.0, DOME_DIAMETER/5.0, PROJECTOR_INITIAL_DISTANCE/10.0, 200, 25);
   _pCalibrationUI->addSlider("PROJECTOR 2 FOV", 20.0, 90.0, 30.0, 200, 25);
   _pCalibrationUI->addSlider("PROJECTOR 2 TARGET", 0.0, DOME_HEIGHT/10.0, 2.0, 200, 25);
+  _pCalibrationUI->addSlider("PROJECTOR 2 GAMMA", 0.5, 2.5, 1.0, 200, 25);
+  _pCalibrationUI->addSlider("PROJECTOR 2 BLACK", 0.0, 0.2, 0.0, 200, 25);
   _pCalibrationUI->addSpacer(0, 12);
   _pCalibrationUI->addSlider("PROJECTOR 3 HEIGHT", 5.0, 20.0, PROJECTOR_INITIAL_HEIGHT/10.0, 200, 25);
   _pCalibrationUI->addSlider("PROJECTOR 3 HEADING", 240.0, 360.0, 300.0, 200, 25);
   _pCalibrationUI->addSlider("PROJECTOR 3 DISTANCE", DOME_DIAMETER/20.0, DOME_DIAMETER/5.0, PROJECTOR_INITIAL_DISTANCE/10.0, 200, 25);
   _pCalibrationUI->addSlider("PROJECTOR 3 FOV", 20.0, 90.0, 30.0, 200, 25);
   _pCalibrationUI->addSlider("PROJECTOR 3 TARGET", 0.0, DOME_HEIGHT/10.0, 2.0, 200, 25);
+  _pCalibrationUI->addSlider("PROJECTOR 3 GAMMA", 0.5, 2.5, 1.0, 200, 25);
+  _pCalibrationUI->addSlider("PROJECTOR 3 BLACK", 0.0, 0.2, 0.0, 200, 25);
+  _pCalibrationUI->addSpacer(0, 12);
+  _pCalibrationUI->addWidgetDown(new ofxUILabelButton("Reload LUTs", false, 0, 30, 0, 0, OFX_UI_FONT_SMALL));
   _pCalibrationUI->setVisible(false);
     
   //label for Radome
@@ -134,18 +251,27 @@ void radomeApp::initGUI() {
   _pUI->addWidgetDown(new ofxUILabel("PROJECTORS", OFX_UI_FONT_MEDIUM));
   _pUI->addWidgetDown(new ofxUILabelButton("Calibrate...", false, 0, 30, 0, 0, OFX_UI_FONT_SMALL));
   _pUI->addWidgetDown(new ofxUILabelButton("Show Window", false, 0, 30, 0, 0, OFX_UI_FONT_SMALL));
+  _pUI->addWidgetDown(new ofxUILabelButton("Native Outputs", false, 0, 30, 0, 0, OFX_UI_FONT_SMALL));
   _pUI->addSpacer(0, 12);
 
   //Content
   _pUI->addWidgetDown(new ofxUILabel("CONTENT", OFX_UI_FONT_MEDIUM));
   _pUI->addWidgetDown(new ofxUILabelButton("Add 3D Model...", false, 0, 30, 0, 0, OFX_UI_FONT_SMALL));
   _pUI->addWidgetDown(new ofxUILabelButton("2D Input...", false, 0, 30, 0, 0, OFX_UI_FONT_SMALL));
+  _pUI->addWidgetDown(new ofxUILabelButton("Shared Video", false, 0, 30, 0, 0, OFX_UI_FONT_SMALL));
   _pUI->addWidgetDown(new ofxUILabelButton("Plugins...", false, 0, 30, 0, 0, OFX_UI_FONT_SMALL));
   _pUI->addSpacer(0, 12);
 
   //mix slider
   _pUI->addWidgetDown(new ofxUILabel("MIXER", OFX_UI_FONT_MEDIUM));
   //  _pUI->addWidgetDown(new ofxUIBiLabelSlider(0, 0, SIDEBAR_WIDTH-10, 30, 0, 100, _vidOverlay.getFaderValue()*100.0, "XFADE", "2D", "3D", OFX_UI_FONT_MEDIUM));
+
+  //layer selection; the fader, blend and mapping controls edit the selected layer
+  for (int ii = 0; ii < MAX_VIDEO_LAYERS; ii++) {
+    _layerNames.push_back("Layer " + ofToString(ii + 1));
+  }
+  addRadioAndSetFirstItem(_pUI, "LAYER", _layerNames, OFX_UI_ORIENTATION_VERTICAL, 16, 16);
+  _pUI->addSlider("LAYER MIX", 0.0, 1.0, _layerControls[0].fader, SIDEBAR_WIDTH-10, 16);
     
   //mix modes
   _mixModeNames.push_back("Underlay");
@@ -167,6 +293,38 @@ void radomeApp::initGUI() {
 
   ofAddListener(_pUI->newGUIEvent, this, &radomeApp::guiEvent);
   ofAddListener(_pCalibrationUI->newGUIEvent, this, &radomeApp::guiEvent);
+
+  //draw both canvases from cached framebuffers, re-rendered only on change
+  _uiCache.setCanvas(_pUI);
+  _calibrationUICache.setCanvas(_pCalibrationUI);
+}
+
+struct radomeSphereJob {
+  const vector<icosohedron::Triangle>* pFaces;
+  vector<icosohedron::Triangle>* pTriangles;
+  int levels;
+};
+
+// Each face of the icosahedron subdivides on its own, into its own slice of
+// the result.
+static void subdivideFaces(void* pData, int begin, int end) {
+  radomeSphereJob* pJob = (radomeSphereJob*)pData;
+  int perFace = 1 << (2 * pJob->levels);
+  for (int ff = begin; ff < end; ff++) {
+    vector<icosohedron::Triangle> face(1, (*pJob->pFaces)[ff]);
+    for (int ll = 0; ll < pJob->levels; ll++)
+      icosohedron::subdivide(face);
+    std::copy(face.begin(), face.end(), pJob->pTriangles->begin() + ff * perFace);
+  }
+}
+
+// Same triangles as icosohedron::createsphere(), one job per face.
+void radomeApp::createDomeTriangles(int levels) {
+  vector<icosohedron::Triangle> faces = icosohedron::createicosahedron();
+  _triangles.resize(faces.size() << (2 * levels));
+  radomeSphereJob job = { &faces, &_triangles, levels };
+  _jobSystem.parallelFor(_frameJobs, subdivideFaces, &job, 0, faces.size());
+  _jobSystem.wait(_frameJobs);
 }
 
 void radomeApp::prepDrawList()
@@ -216,60 +374,734 @@ void radomeApp::loadFile() {
   ofxFensterManager::get()->deleteFenster(pDummy);
     
   if (result.bSuccess) {
-    auto model = new radomeModel();
-    model->loadModel(result.getPath());
-    _modelList.push_back(model);
+    // The model is added to the scene by renderFrame() once it has loaded.
+    radomeCommand command;
+    command.type = CommandLoadModel;
+    command.path = result.getPath();
+    post(command);
   }
 }
 
-void radomeApp::showProjectorWindow() {
+void radomeApp::closeProjectorWindows() {
+  //the render thread must not be presenting into a window while it goes away
+  for (auto iter = _outputWindows.begin(); iter != _outputWindows.end(); ++iter) {
+    _renderThread.removeOutput(*iter);
+  }
+  _outputWindows.clear();
+
   if (_projectorWindow && _projectorWindow->id != 0) {
     _projectorWindow->destroy();
     ofxFensterManager::get()->deleteFenster(_projectorWindow);
   }
+  _projectorWindow = NULL;
+
+  //any of them may have been closed by the OS already, like the window above
+  for (auto iter = _nativeProjectorWindows.begin(); iter != _nativeProjectorWindows.end(); ++iter) {
+    if (*iter && (*iter)->id != 0) {
+      (*iter)->destroy();
+      ofxFensterManager::get()->deleteFenster(*iter);
+    }
+    *iter = NULL;
+  }
+  _nativeProjectorWindows.clear();
+}
+
+// A window the OS closed is forgotten here; closeProjectorWindows() has
+// already let go of the ones it closes. Once the last native window is
+// gone the projectors go back to the governor's scale.
+void radomeApp::outputClosed(radomeOutputWindow*& pOutput) {
+  auto iter = std::find(_outputWindows.begin(), _outputWindows.end(), pOutput);
+  if (iter == _outputWindows.end())
+    return;
+  _outputWindows.erase(iter);
+  if (_outputWindows.empty() && !_nativeProjectorWindows.empty())
+    post(CommandSetNativeOutputs, 0, 0);
+}
+
+void radomeApp::loadLayerImage() {
+  ofFileDialogResult result = ofSystemLoadDialog("Load 2D Input", false);
+
+  // Workaround for ofxFenster modal mouse event bug
+  ofxFenster* pWin = ofxFensterManager::get()->getActiveWindow();
+  ofxFenster* pDummy = ofxFensterManager::get()->createFenster(0,0,1,1);
+  ofxFensterManager::get()->setActiveWindow(pDummy);
+  ofxFensterManager::get()->setActiveWindow(pWin);
+  ofxFensterManager::get()->deleteFenster(pDummy);
+
+  if (result.bSuccess) {
+    radomeCommand command;
+    command.type = CommandLoadLayerImage;
+    command.index = _selectedLayer;
+    command.path = result.getPath();
+    post(command);
+  }
+}
+
+void radomeApp::syncLayerControls() {
+  const LayerControls& controls = _layerControls[_selectedLayer];
+  auto pBlend = dynamic_cast<ofxUIRadio*>(_pUI->getWidget("BLEND MODE"));
+  if (pBlend)
+    pBlend->activateToggle(_mixModeNames[controls.blendMode]);
+  auto pMapping = dynamic_cast<ofxUIRadio*>(_pUI->getWidget("MAPPING MODE"));
+  if (pMapping)
+    pMapping->activateToggle(_mappingModeNames[controls.mappingMode]);
+  auto pFader = dynamic_cast<ofxUISlider*>(_pUI->getWidget("LAYER MIX"));
+  if (pFader)
+    pFader->setValue(controls.fader);
+}
+
+// Preview window with every projector's framebuffer scaled side by side.
+void radomeApp::showProjectorWindow() {
+  closeProjectorWindows();
+  post(CommandSetNativeOutputs, 0, 0);
+
+  radomeOutputWindow* pOutput = new radomeProjectorWindowListener(&_renderThread, &_projectorList);
   _projectorWindow = ofxFensterManager::get()->createFenster(400, 300, 750, 200, OF_WINDOW);
-  _projectorWindow->addListener(new radomeProjectorWindowListener(&_projectorList));
+  _projectorWindow->addListener(pOutput);
+  ofAddListener(pOutput->closed, this, &radomeApp::outputClosed);
   _projectorWindow->setWindowTitle("Projector Output");
+  _outputWindows.push_back(pOutput);
 }
 
-void radomeApp::update() {
-  //track clock time, update time, and update cube map according to 3d models
-  unsigned long long time = ofGetSystemTime();
-  _animationTime += (time - _lastSystemTime)/1000.0;
-  _lastSystemTime = time;
-    
-  if (_animationTime >= 1.0) {
-    _animationTime = 0.0;
+// One borderless window per projector at its native resolution, laid out to
+// the right of the main display where the projector outputs extend the
+// desktop. The projectors render at full size for these, so each window
+// shows its projector's framebuffer without scaling; without a render thread
+// each window draws its projector's final pass itself, with no framebuffer.
+void radomeApp::showNativeProjectorWindows() {
+  closeProjectorWindows();
+  post(CommandSetNativeOutputs, 0, 1);
+
+  int x = ofGetScreenWidth();
+  for (int ii = 0; ii < NUM_PROJECTORS; ii++) {
+    //the projector list doesn't change after setupRenderer()
+    radomeOutputWindow* pOutput = new radomeProjectorNativeListener(&_renderThread, _projectorList[ii], this);
+    ofxFenster* pWindow = ofxFensterManager::get()->createFenster(x, 0, PROJECTOR_NATIVE_WIDTH, PROJECTOR_NATIVE_HEIGHT, OF_WINDOW);
+    pWindow->setBorder(false);
+    pWindow->addListener(pOutput);
+    ofAddListener(pOutput->closed, this, &radomeApp::outputClosed);
+    pWindow->setWindowTitle("Projector " + ofToString(ii + 1));
+    _nativeProjectorWindows.push_back(pWindow);
+    _outputWindows.push_back(pOutput);
+    x += PROJECTOR_NATIVE_WIDTH;
   }
-  for (auto iter = _modelList.begin(); iter != _modelList.end(); ++iter) {
-    (*iter)->update(_animationTime);
+}
+
+void radomeApp::renderProjectorView(radomeProjector* pProjector) {
+  beginShader();
+  pProjector->beginColorCorrection(_shader);
+  drawDome();
+  pProjector->endColorCorrection();
+  endShader();
+}
+
+// Looks for data/luts/projectorN.cube for each projector; projectors without
+// one keep an identity table.
+void radomeApp::loadColorLUTs() {
+  for (int ii = 0; ii < (int)_projectorList.size(); ii++) {
+    string path = "luts/projector" + ofToString(ii + 1) + ".cube";
+    if (ofFile::doesFileExist(path)) {
+      _projectorList[ii]->loadColorLUT(path);
+    }
   }
+}
+
+void radomeApp::update() {
+  //the UI loop is running, so the output windows are presented by it
+  _renderThread.lockGraphics();
+  _renderThread.checkIn();
+  _renderThread.unlockGraphics();
+  //the last loop's windows have just been swapped, which paces the render thread
+  _renderThread.getScheduler().presented();
+
+  postCamera();
+  pollControls();
+  checkLoopback();
+  if (!_renderThread.isRendering())
+    renderFrame();
+}
+
+// Sends the operator's camera to the render thread whenever it has moved.
+void radomeApp::postCamera() {
+  _cam.setDistance(DOME_DIAMETER * (_displayMode == DisplayDome ? 1.10 : 1.6));
+  radomeCommand command;
+  command.type = CommandSetCamera;
+  command.matrix = _cam.getGlobalTransformMatrix();
+  if (command.matrix == _postedCamera)
+    return;
+  if (post(command))
+    _postedCamera = command.matrix;
+}
+
+// Render thread, between commands: the scene work update() used to do, the
+// output passes, and the operator preview when it's showing.
+void radomeApp::renderFrame() {
+  applyControls();
+  //this frame's models were updated on the workers while the GPU ran the last one
+  finishModelUpdate();
+  _renderThread.getScheduler().notePhase(PhaseGpuWait, _framePipeline.beginFrame() / 1000000.0);
+
+  radomeGpuMemory::get().beginFrame();
+  radomeGpuMemory::get().enforceBudget();
+  _texturePipeline.update();
+  _geometryStream.beginFrame();
+  _bonePalette.beginFrame();
+  publishModels();
+  _bonePalette.endFrame();
+  _geometryStream.endFrame();
+  buildRenderQueue();
+  _layerStack.update(_videoTime);
     
+  _preview.beginOutputFrame();
   updateCubeMap();
   //then update the projector
   updateProjectorOutput();
+  _preview.endOutputFrame();
+
+  if ((_previewMode == DisplayScene || _previewMode == DisplayDome) && _preview.shouldRender()) {
+    _preview.begin();
+    if (_previewMode == DisplayScene)
+      drawScenePreview();
+    else
+      drawDomePreview();
+    _preview.end();
+  }
+  _framePipeline.endFrame(_frameInputTime);
+
+  //the next frame's simulation overlaps the GPU's work on this one
+  startModelUpdate();
+}
+
+bool radomeApp::post(int type, int index, float value) {
+  radomeCommand command;
+  command.type = type;
+  command.index = index;
+  command.value = value;
+  return post(command);
+}
+
+// Without a render thread the command takes effect right away.
+bool radomeApp::post(const radomeCommand& command) {
+  if (_renderThread.isRendering())
+    return _renderThread.post(command);
+  executeCommand(command);
+  return true;
+}
+
+//OSC can send any value for a mode; out of range (or NaN) it's the nearest one
+static int toMode(float value, int count) {
+  if (!(value > 0))
+    return 0;
+  return value < count - 1 ? (int)value : count - 1;
+}
+
+void radomeApp::executeCommand(const radomeCommand& command) {
+  switch (command.type) {
+  case CommandLoadModel:
+  case CommandRemoveModel:
+  case CommandMoveModel:
+  case CommandSpinModel:
+  case CommandSetModelOrigin:
+  case CommandSetModelRotation:
+  case CommandSetModelSpin:
+    finishModelUpdate();
+    executeModelCommand(command);
+    break;
+  case CommandSetDisplayMode:
+    _previewMode = (DisplayMode)command.index;
+    _preview.invalidate();
+    break;
+  case CommandSetCamera:
+    _previewCam.setTransformMatrix(command.matrix);
+    _preview.invalidate();
+    break;
+  case CommandLoadLayerImage:
+    if (radomeVideoFileSource::canLoad(command.path)) {
+      auto pSource = new radomeVideoFileSource();
+      pSource->setJobSystem(&_jobSystem);
+      if (pSource->load(command.path)) {
+        _layerStack.setSource(command.index, pSource, true);
+      } else {
+        delete pSource;
+      }
+    } else {
+      auto pSource = new radomeImageSource();
+      if (pSource->load(command.path)) {
+        _layerStack.setSource(command.index, pSource, true);
+      } else {
+        delete pSource;
+      }
+    }
+    break;
+  case CommandConnectSharedVideo:
+    {
+      //waits for the producer if it isn't running yet
+      auto pSource = new radomeSharedVideoSource();
+      pSource->setup(command.path);
+      _layerStack.setSource(command.index, pSource, true);
+      ofLogNotice() << "layer " << command.index + 1 << " reads shared video from " << command.path;
+    }
+    break;
+  case CommandSetLayerBlend: _layerStack.setBlendMode(command.index, toMode(command.value, LAYER_BLEND_MODES)); break;
+  case CommandSetLayerMapping: _layerStack.setMappingMode(command.index, toMode(command.value, LAYER_MAPPING_MODES)); break;
+  case CommandSetLayerFader: _layerStack.setFader(command.index, command.value); break;
+  case CommandSetProjectorHeight:
+  case CommandSetProjectorHeading:
+  case CommandSetProjectorDistance:
+  case CommandSetProjectorFOV:
+  case CommandSetProjectorTarget:
+  case CommandSetProjectorGamma:
+  case CommandSetProjectorBlack:
+    executeProjectorCommand(command);
+    break;
+  case CommandReloadLUTs: loadColorLUTs(); break;
+  case CommandSetNativeOutputs:
+    {
+      //native windows show the framebuffers 1:1, so they stay at full size;
+      //without a render thread the windows draw the final pass themselves
+      bool native = command.value != 0;
+      _resolutionGovernor.setEnabled(!native);
+      for (auto iter = _projectorList.begin(); iter != _projectorList.end(); ++iter) {
+        (*iter)->setDirectOutput(native && !_renderThread.isRendering());
+        (*iter)->setRenderScale(native ? 1.0 : _resolutionGovernor.getScale());
+      }
+    }
+    break;
+  case CommandToggleLod:
+    _renderQueue.setLodEnabled(!_renderQueue.isLodEnabled());
+    ofLogNotice() << "LOD selection " << (_renderQueue.isLodEnabled() ? "on" : "off");
+    break;
+  case CommandToggleSkinning:
+    //switch skinning paths to compare their per-model CPU cost with 'q'
+    finishModelUpdate();
+    if (_renderQueue.isSkinningEnabled()) {
+      _modelCache.setBonePalette(_modelCache.getBonePalette() ? NULL : &_bonePalette);
+      ofLogNotice() << "skinning on the " << (_modelCache.getBonePalette() ? "GPU" : "CPU");
+    } else {
+      ofLogNotice() << "GPU skinning unavailable";
+    }
+    break;
+  case CommandStartScalingSweep:
+    if (!_scalingThreads)
+      startScalingSweep();
+    break;
+  case CommandSetFramesInFlight: _framePipeline.setDepth((int)command.value); break;
+  case CommandLogStats:
+    //the pose jobs write the skinning times, so let this frame's finish first
+    finishModelUpdate();
+    logStats();
+    break;
+  case CommandLogGpuMemory: ofLogNotice() << radomeGpuMemory::get().getReport(); break;
+  }
+}
+
+void radomeApp::executeModelCommand(const radomeCommand& command) {
+  if (command.type == CommandLoadModel) {
+    _modelCache.request(command.path);
+    return;
+  }
+  if (_modelList.empty())
+    return;
+
+  radomeModel* model = _modelList.back();
+  switch (command.type) {
+  case CommandRemoveModel:
+    _modelList.pop_back();
+    delete model;
+    break;
+  case CommandMoveModel:
+    model->translate(command.vector);
+    break;
+  case CommandSpinModel:
+    if (model->getRotationIncrement() == 0) {
+      model->setRotationOrigin(model->getOrigin());
+      model->setRotation(ofVec4f(0.0,
+                                 frand_bounded(),
+                                 frand_bounded(),
+                                 frand_bounded()));
+    }
+    model->setRotationIncrement(model->getRotationIncrement() + 2.0);
+    if (model->getRotationIncrement() == 10.0) {
+      model->setRotationIncrement(0.0);
+    }
+    break;
+  case CommandSetModelOrigin:
+    model->setOrigin(command.vector);
+    break;
+  case CommandSetModelRotation:
+    model->setRotationOrigin(model->getOrigin());
+    model->setRotation(ofVec4f(command.value, command.vector.x, command.vector.y, command.vector.z));
+    break;
+  case CommandSetModelSpin:
+    if (model->getRotationIncrement() == 0)
+      model->setRotationOrigin(model->getOrigin());
+    model->setRotationIncrement(command.value);
+    break;
+  }
+}
+
+// Addresses follow the GUI, with projectors and layers numbered from 1 and
+// projector lengths in scene units rather than the sliders' tens. Model
+// addresses act on the most recently added model, as the keys do.
+void radomeApp::bindControls() {
+  static const char* projectorParameters[] = { "height", "heading", "distance", "fov", "target", "gamma", "black" };
+  for (int ii = 0; ii < NUM_PROJECTORS; ii++) {
+    string prefix = "/radome/projector/" + ofToString(ii + 1) + "/";
+    for (int pp = 0; pp < 7; pp++) {
+      bindControl(prefix + projectorParameters[pp], CommandSetProjectorHeight + pp, ii);
+    }
+  }
+  for (int ii = 0; ii < MAX_VIDEO_LAYERS; ii++) {
+    string prefix = "/radome/layer/" + ofToString(ii + 1) + "/";
+    bindControl(prefix + "blend", CommandSetLayerBlend, ii);
+    bindControl(prefix + "mapping", CommandSetLayerMapping, ii);
+    bindControl(prefix + "fader", CommandSetLayerFader, ii);
+  }
+  bindControl("/radome/model/origin", CommandSetModelOrigin, 0, 3);
+  bindControl("/radome/model/rotation", CommandSetModelRotation, 0, 4);
+  bindControl("/radome/model/spin", CommandSetModelSpin, 0);
+  _controlsSeen.assign(_controls.getCount(), 0);
+  _uiControlsSeen.assign(_controls.getCount(), 0);
+}
+
+void radomeApp::bindControl(const string& address, int type, int index, int count) {
+  ControlBinding binding = { type, index, 0, count };
+  if (!_controlBindings.empty())
+    binding.parameter = _controlBindings.back().parameter + _controlBindings.back().count;
+  if (!_oscListener.bind(address, binding.parameter, count)) {
+    ofLogWarning() << "osc: no room for " << address;
+    return;
+  }
+  _controlBindings.push_back(binding);
+}
+
+// Render thread, once a frame: however many messages arrived since the last
+// one, each binding applies only its latest values, all from the same message.
+void radomeApp::applyControls() {
+  float values[4];
+  for (auto iter = _controlBindings.begin(); iter != _controlBindings.end(); ++iter) {
+    if (!_controls.read(iter->parameter, values, iter->count, _controlsSeen[iter->parameter]))
+      continue;
+
+    radomeCommand command;
+    command.type = iter->type;
+    command.index = iter->index;
+    command.value = iter->count == 3 ? 0 : values[0];
+    if (iter->count >= 3) {
+      int first = iter->count - 3;
+      command.vector.set(values[first], values[first + 1], values[first + 2]);
+    }
+    executeCommand(command);
+  }
+}
+
+//calibration sliders are "PROJECTOR n PARAMETER", in the order of the
+//projector commands; lengths are shown in tens of units
+static const char* projectorSliderParameters[] = { "HEIGHT", "HEADING", "DISTANCE", "FOV", "TARGET", "GAMMA", "BLACK" };
+static const float projectorSliderScales[] = { 10, 1, 10, 1, 10, 1, 1 };
+
+// UI thread, once a frame: values sent over OSC go into the widgets too, and
+// layer settings into the UI's copy of them, shown when they're the selected
+// layer's. The GUI has no model widgets, so model values aren't mirrored.
+void radomeApp::pollControls() {
+  bool selectedChanged = false;
+  bool calibrationChanged = false;
+  float value;
+  for (auto iter = _controlBindings.begin(); iter != _controlBindings.end(); ++iter) {
+    if (iter->type >= CommandSetProjectorHeight && iter->type <= CommandSetProjectorBlack) {
+      if (!_controls.read(iter->parameter, &value, 1, _uiControlsSeen[iter->parameter]))
+        continue;
+      int parameter = iter->type - CommandSetProjectorHeight;
+      string name = "PROJECTOR " + ofToString(iter->index + 1) + " " + projectorSliderParameters[parameter];
+      auto pSlider = dynamic_cast<ofxUISlider*>(_pCalibrationUI->getWidget(name));
+      if (pSlider) {
+        pSlider->setValue(value / projectorSliderScales[parameter]);
+        calibrationChanged = true;
+      }
+      continue;
+    }
+    if (iter->index < 0 || iter->index >= (int)_layerControls.size())
+      continue;
+    LayerControls& controls = _layerControls[iter->index];
+    switch (iter->type) {
+    case CommandSetLayerBlend:
+      if (!_controls.read(iter->parameter, &value, 1, _uiControlsSeen[iter->parameter]))
+        continue;
+      controls.blendMode = toMode(value, LAYER_BLEND_MODES);
+      break;
+    case CommandSetLayerMapping:
+      if (!_controls.read(iter->parameter, &value, 1, _uiControlsSeen[iter->parameter]))
+        continue;
+      controls.mappingMode = toMode(value, LAYER_MAPPING_MODES);
+      break;
+    case CommandSetLayerFader:
+      if (!_controls.read(iter->parameter, &value, 1, _uiControlsSeen[iter->parameter]))
+        continue;
+      controls.fader = ofClamp(value, 0.0, 1.0);
+      break;
+    default:
+      continue;
+    }
+    if (iter->index == _selectedLayer)
+      selectedChanged = true;
+  }
+  if (selectedChanged) {
+    syncLayerControls();
+    _uiCache.invalidate();
+  }
+  if (calibrationChanged)
+    _calibrationUICache.invalidate();
+}
+
+// Sends the selected layer's fader, unchanged, to its bound address; the
+// check passes once the listener has stored that same value.
+void radomeApp::startLoopback() {
+  _loopbackParameter = -1;
+  for (auto iter = _controlBindings.begin(); iter != _controlBindings.end(); ++iter) {
+    if (iter->type == CommandSetLayerFader && iter->index == _selectedLayer)
+      _loopbackParameter = iter->parameter;
+  }
+  if (_loopbackParameter < 0)
+    return;
+
+  //only a write after this one counts
+  float value;
+  _loopbackSeen = 0;
+  _controls.read(_loopbackParameter, &value, 1, _loopbackSeen);
+
+  _loopbackAddress = "/radome/layer/" + ofToString(_selectedLayer + 1) + "/fader";
+  _loopbackValue = _layerControls[_selectedLayer].fader;
+  _loopbackDeadline = ofGetElapsedTimeMillis() + OSC_LOOPBACK_TIMEOUT_MS;
+  radomeOscMessage message(_loopbackAddress);
+  message.addFloat(_loopbackValue);
+  _oscLoopback.send(message);
+}
+
+// UI thread, once a frame while a loopback check is waiting.
+void radomeApp::checkLoopback() {
+  if (_loopbackParameter < 0)
+    return;
+  float value;
+  if (_controls.read(_loopbackParameter, &value, 1, _loopbackSeen)) {
+    if (value == _loopbackValue)
+      ofLogNotice() << "osc: loopback " << _loopbackAddress << " stored " << value;
+    else
+      ofLogWarning() << "osc: loopback " << _loopbackAddress << " sent " << _loopbackValue << " but stored " << value;
+    _loopbackParameter = -1;
+  } else if (ofGetElapsedTimeMillis() > _loopbackDeadline) {
+    ofLogWarning() << "osc: loopback " << _loopbackAddress << " never reached the parameter store";
+    _loopbackParameter = -1;
+  }
+}
+
+void radomeApp::executeProjectorCommand(const radomeCommand& command) {
+  if (command.index < 0 || command.index >= (int)_projectorList.size())
+    return;
+
+  radomeProjector* pProjector = _projectorList[command.index];
+  switch (command.type) {
+  case CommandSetProjectorHeight: pProjector->setHeight(command.value); break;
+  case CommandSetProjectorHeading: pProjector->setHeading(command.value); break;
+  case CommandSetProjectorDistance: pProjector->setDistance(command.value); break;
+  case CommandSetProjectorFOV: pProjector->setFOV(command.value); break;
+  case CommandSetProjectorTarget: pProjector->setTargetHeight(command.value); break;
+  case CommandSetProjectorGamma: pProjector->setGamma(command.value); break;
+  case CommandSetProjectorBlack: pProjector->setBlackLevel(command.value); break;
+  }
+}
+
+static void poseAssets(void* pData, int begin, int end) {
+  radomeUpdateJob* pJob = (radomeUpdateJob*)pData;
+  for (int ii = begin; ii < end; ii++)
+    pJob->assets[ii]->poseAnimation(pJob->t);
+}
+
+static void updateModelRange(void* pData, int begin, int end) {
+  radomeUpdateJob* pJob = (radomeUpdateJob*)pData;
+  for (int ii = begin; ii < end; ii++)
+    pJob->models[ii]->update(pJob->t, pJob->steps, pJob->alpha);
+}
+
+static int getNodeDepth(const radomeSceneNode* pNode) {
+  int depth = 0;
+  for (pNode = pNode->getParent(); pNode; pNode = pNode->getParent())
+    depth++;
+  return depth;
+}
+
+static bool isShallower(const radomeModel* pA, const radomeModel* pB) {
+  return getNodeDepth(pA) < getNodeDepth(pB);
+}
+
+// Samples the clock for the next frame and starts updating its models:
+// animated assets are posed one job per asset (instances share their asset's
+// pose) alongside the models' own updates. Both only write the models' back
+// frames, so they can run on the workers while this frame's draws, already
+// submitted, execute on the GPU.
+void radomeApp::startModelUpdate() {
+  //the next frame is simulated in fixed steps up to when it will be on screen,
+  //and shows the animation interpolated between its last two steps
+  radomeFrameTime frameTime = _renderThread.getScheduler().planFrame();
+  _animationTime = fmod(_animationTime + frameTime.steps * frameTime.stepSeconds, 1.0);
+  float t = _animationTime - (1 - frameTime.alpha) * frameTime.stepSeconds;
+  if (t < 0) {
+    t += 1.0;
+  }
+  //video files play on the same steps, so their loops stay locked to the animation
+  _videoClock += frameTime.steps * frameTime.stepSeconds;
+  _videoTime = MAX(0.0, _videoClock - (1 - frameTime.alpha) * frameTime.stepSeconds);
+  _frameInputTime = ofGetElapsedTimeMicros();
+
+  //models that finished loading join here, so they're updated before they're drawn
+  _modelCache.update();
+  vector<radomeModelAsset*> loaded;
+  _modelCache.collectLoaded(loaded);
+  for (auto iter = loaded.begin(); iter != loaded.end(); ++iter) {
+    _modelList.push_back(new radomeModel(&_modelCache, *iter));
+  }
+
+  _modelUpdateStart = ofGetElapsedTimeMicros();
+  _modelUpdate.t = t;
+  _modelUpdate.steps = frameTime.steps;
+  _modelUpdate.alpha = frameTime.alpha;
+  _modelUpdate.assets.clear();
+  _modelUpdate.models.clear();
+  _attachedModels.clear();
+  for (auto iter = _modelList.begin(); iter != _modelList.end(); ++iter) {
+    radomeModelAsset* pAsset = (*iter)->getAsset();
+    if (pAsset->isAnimated() && std::find(_modelUpdate.assets.begin(), _modelUpdate.assets.end(), pAsset) == _modelUpdate.assets.end())
+      _modelUpdate.assets.push_back(pAsset);
+    if ((*iter)->getParent() || !(*iter)->getChildren().empty())
+      _attachedModels.push_back(*iter);
+    else
+      _modelUpdate.models.push_back(*iter);
+  }
+  _jobSystem.parallelFor(_frameJobs, poseAssets, &_modelUpdate, 0, _modelUpdate.assets.size());
+  _jobSystem.parallelFor(_frameJobs, updateModelRange, &_modelUpdate, 0, _modelUpdate.models.size(), MODEL_UPDATE_GRAIN);
+  _modelUpdatePending = true;
+
+  //a sweep measures the update by itself, not overlapped with the GPU
+  if (_scalingThreads)
+    finishModelUpdate();
+}
+
+// Anything that changes models or assets calls this first, so it never
+// races the update jobs.
+void radomeApp::finishModelUpdate() {
+  if (!_modelUpdatePending)
+    return;
+  unsigned long long waitStart = ofGetElapsedTimeMicros();
+  _jobSystem.wait(_frameJobs);
+
+  //models in a hierarchy touch each other's transforms, so they update here,
+  //parents first so children see this frame's parent transform
+  std::stable_sort(_attachedModels.begin(), _attachedModels.end(), isShallower);
+  for (auto iter = _attachedModels.begin(); iter != _attachedModels.end(); ++iter) {
+    (*iter)->update(_modelUpdate.t, _modelUpdate.steps, _modelUpdate.alpha);
+  }
+  _modelUpdatePending = false;
+  _renderThread.getScheduler().notePhase(PhaseSimulation, (ofGetElapsedTimeMicros() - waitStart) / 1000000.0);
+  updateScalingSweep(ofGetElapsedTimeMicros() - _modelUpdateStart, _modelUpdate.models.size(), _modelUpdate.assets.size());
+}
+
+// The GL side of the update, committed once everything has finished so the
+// frame's draw state changes all at once.
+void radomeApp::publishModels() {
+  for (auto iter = _modelList.begin(); iter != _modelList.end(); ++iter) {
+    (*iter)->publish();
+  }
+}
+
+// Runs the model updates for SCALING_SWEEP_FRAMES frames at every thread
+// count from 1 up to all of them, then reports the speedup of each. Models
+// still being loaded finish first: loader jobs only run on the workers, and
+// at one thread every worker is parked.
+void radomeApp::startScalingSweep() {
+  _modelLoader.drain();
+  _scalingResults.clear();
+  _scalingMicros = 0;
+  _scalingFrames = 0;
+  _scalingThreads = 1;
+  _jobSystem.setActiveThreads(_scalingThreads);
+  ofLogNotice() << "measuring model update scaling over 1 to " << _jobSystem.getThreadCount() << " threads";
+}
+
+void radomeApp::updateScalingSweep(unsigned long long micros, int models, int animatedAssets) {
+  if (!_scalingThreads)
+    return;
+  _scalingMicros += micros;
+  if (++_scalingFrames < SCALING_SWEEP_FRAMES)
+    return;
+
+  _scalingResults.push_back((double)_scalingMicros / _scalingFrames);
+  _scalingMicros = 0;
+  _scalingFrames = 0;
+  if (++_scalingThreads <= _jobSystem.getThreadCount()) {
+    _jobSystem.setActiveThreads(_scalingThreads);
+    return;
+  }
+
+  ofLogNotice() << "model update scaling, " << models << " unattached models and " << animatedAssets
+                << " animated assets, averaged over " << SCALING_SWEEP_FRAMES << " frames:";
+  for (int ii = 0; ii < (int)_scalingResults.size(); ii++) {
+    double speedup = _scalingResults[0] / MAX(1.0, _scalingResults[ii]);
+    ofLogNotice() << "  " << ii + 1 << " threads: " << ofToString(_scalingResults[ii], 0) << " us, "
+                  << ofToString(speedup, 2) << "x, " << ofToString(speedup / (ii + 1) * 100, 0) << "% efficiency";
+  }
+  _scalingThreads = 0;
+  _jobSystem.setActiveThreads(_jobSystem.getThreadCount());
+}
+
+// The scene is submitted and sorted once per frame; every cube face and the
+// operator preview replay the same sorted queue.
+void radomeApp::buildRenderQueue() {
+  _renderQueue.begin();
+  for (auto iter = _modelList.begin(); iter != _modelList.end(); ++iter) {
+    (*iter)->enqueue(_renderQueue);
+  }
+  _renderQueue.sort();
 }
 
 void radomeApp::updateCubeMap() {
+  //faces look down the axes from the cube map's origin with a 90 degree fov,
+  //which is what LOD selection needs to size models per face
+  static const ofVec3f faceDirections[6] = {
+    ofVec3f(1, 0, 0), ofVec3f(-1, 0, 0),
+    ofVec3f(0, 1, 0), ofVec3f(0, -1, 0),
+    ofVec3f(0, 0, 1), ofVec3f(0, 0, -1)
+  };
+  radomeLodView view;
+  view.eye.set(0, 0, 0);
+  view.pixelScale = CUBE_MAP_SIZE * 0.5;
+
   glEnable(GL_DEPTH_TEST);
   for(int i = 0; i < 6; i++) {
     _cubeMap.beginDrawingInto3D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i);
     ofClear(0,0,0,0);
-    drawScene();
+    view.forward = faceDirections[i];
+    drawScene(&view);
     _cubeMap.endDrawingInto3D();
   }
 }
 
 void radomeApp::updateProjectorOutput() {
   glEnable(GL_DEPTH_TEST);
+  float renderTime = 0.0;
   for (auto iter = _projectorList.begin(); iter != _projectorList.end(); ++iter) {
-    (*iter)->renderBegin();
-
-    beginShader();
-    drawDome();
-    endShader();
+    //direct outputs are drawn by their own windows
+    if ((*iter)->isDirectOutput())
+      continue;
 
+    (*iter)->renderBegin();
+    renderProjectorView(*iter);
     (*iter)->renderEnd();
+    renderTime += (*iter)->getLastRenderTime();
+  }
+
+  if (_resolutionGovernor.addFrameSample(renderTime)) {
+    for (auto iter = _projectorList.begin(); iter != _projectorList.end(); ++iter) {
+      (*iter)->setRenderScale(_resolutionGovernor.getScale());
+    }
   }
 }
 
@@ -278,56 +1110,34 @@ void radomeApp::beginShader() {
   _cubeMap.bind();
 
   _shader.setUniform1i("EnvMap", 0);
-  _shader.setUniform1i("mixMode", _mixMode);
-  _shader.setUniform1i("mappingMode", _mappingMode);
+  _layerStack.bind(_shader, VIDEO_LAYER_TEXTURE_UNIT);
   _shader.setUniform1f("domeDiameter", DOME_DIAMETER*1.0);
   _shader.setUniform1f("domeHeight", DOME_HEIGHT*1.0);
-    
-  /*  if (_vidOverlay.maybeBind()) {
-    _shader.setUniform1f("videoMix", _vidOverlay.getFaderValue());
-    _shader.setUniform2f("videoSize", _vidOverlay.getWidth(), _vidOverlay.getHeight());
-    _shader.setUniformTexture("video", _vidOverlay.getTexture(), _vidOverlay.getTextureId());
-  } else {
-    _shader.setUniform1f("videoMix", -1.0);
-    _shader.setUniform2f("videoSize", 0.0, 0.0);
-    _shader.setUniformTexture("video", _blankImage.getTextureReference(),
-			      _blankImage.getTextureReference().getTextureData().textureID);
-  }
-  */
+
+  //no color correction unless a projector pass sets its own
+  _shader.setUniform1i("colorLUT", COLOR_LUT_TEXTURE_UNIT);
+  _shader.setUniform1f("lutEnabled", 0.0);
+  _shader.setUniform1f("outputGamma", 1.0);
+  _shader.setUniform1f("blackLevel", 0.0);
 }
 
 void radomeApp::endShader() {
-  //  _vidOverlay.unbind();
+  _layerStack.unbind(VIDEO_LAYER_TEXTURE_UNIT);
   _cubeMap.unbind();
   _shader.end();
 }
 
+// Everything drawn here from the render thread's side (the preview, the cube
+// map, the projector framebuffers) is a finished frame's texture: the
+// graphics lock keeps the render thread between frames meanwhile.
 void radomeApp::draw() {
+  _renderThread.lockGraphics();
+  _renderThread.checkIn();
   switch (_displayMode) {
-  case DisplayScene: {
-    ofPushStyle();
-    ofEnableBlendMode(OF_BLENDMODE_ALPHA);
-
-    _cam.setDistance(DOME_DIAMETER*1.6);
-    _cam.begin();
-                        
-    ofPushMatrix();
-    drawScene();
-    ofPopMatrix();
-
-    ofSetColor(128,128,255,128);
-            
-    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    ofSetLineWidth(1);
-    drawDome();
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-            
-    ofSetColor(80,80,192,128);
-    drawGroundPlane();
-
-    _cam.end();
-            
-    ofPopStyle();
+  case DisplayScene:
+  case DisplayDome: {
+    glDisable(GL_DEPTH_TEST);
+    _preview.draw(0, 0, ofGetWidth(), ofGetHeight());
   }
     break;
   case DisplayCubeMap: {
@@ -344,26 +1154,6 @@ void radomeApp::draw() {
     }
   }
     break;
-  case DisplayDome: {
-
-    ofClear(20, 100, 50);
-            
-    _cam.setDistance(DOME_DIAMETER*1.10);
-    _cam.begin();
-            
-    beginShader();
-    drawDome();
-    drawGroundPlane();
-    endShader();
-            
-    for (auto iter = _projectorList.begin(); iter != _projectorList.end(); ++iter)
-      {
-	(*iter)->drawSceneRepresentation();
-      }
-            
-    _cam.end();
-  }
-    break;
   case DisplayProjectorOutput:
   case LastDisplayMode: {
     ofSetColor(200,220,255);
@@ -377,23 +1167,71 @@ void radomeApp::draw() {
       (*iter)->drawFramebuffer(x, y, w, h);
       ofRect(x-1, y-1, w + margin, h + margin);
     }
+    string status = "render scale " + ofToString(_resolutionGovernor.getScale(), 2);
+    if (!_nativeProjectorWindows.empty())
+      status = string(_renderThread.isRendering() ? "native outputs at " : "native outputs: rendering directly at ")
+        + ofToString(PROJECTOR_NATIVE_WIDTH) + "x" + ofToString(PROJECTOR_NATIVE_HEIGHT);
+    else if (_resolutionGovernor.getChangeCount())
+      status += " (" + _resolutionGovernor.getLastChangeDescription() + ")";
+    ofDrawBitmapString(status, SIDEBAR_WIDTH + margin*4, ofGetWindowHeight() - margin*4);
   }
     break;            
   }
     
   glDisable(GL_DEPTH_TEST);
-  _pUI->draw();
-  if (_pCalibrationUI->isVisible())
-    _pCalibrationUI->draw();
+  _uiCache.draw();
+  _calibrationUICache.draw();
   glEnable(GL_DEPTH_TEST);
+  _renderThread.unlockGraphics();
 }
 
-void radomeApp::drawScene() {
-  ofSetColor(180, 192, 192);
-  for (auto iter = _modelList.begin(); iter != _modelList.end(); ++iter)
+void radomeApp::drawScenePreview() {
+  ofClear(40, 20, 32, 255);
+  ofPushStyle();
+  ofEnableBlendMode(OF_BLENDMODE_ALPHA);
+
+  _previewCam.begin();
+                        
+  ofPushMatrix();
+  drawScene();
+  ofPopMatrix();
+
+  ofSetColor(128,128,255,128);
+            
+  glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+  ofSetLineWidth(1);
+  drawDome();
+  glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+            
+  ofSetColor(80,80,192,128);
+  drawGroundPlane();
+
+  _previewCam.end();
+            
+  ofPopStyle();
+}
+
+void radomeApp::drawDomePreview() {
+  ofClear(20, 100, 50);
+            
+  _previewCam.begin();
+            
+  beginShader();
+  drawDome();
+  drawGroundPlane();
+  endShader();
+            
+  for (auto iter = _projectorList.begin(); iter != _projectorList.end(); ++iter)
     {
-      (*iter)->draw();
+      (*iter)->drawSceneRepresentation();
     }
+            
+  _previewCam.end();
+}
+
+void radomeApp::drawScene(const radomeLodView* pView) {
+  ofSetColor(180, 192, 192);
+  _renderQueue.execute(pView);
 }
 
 void radomeApp::drawDome() {
@@ -424,24 +1262,123 @@ void radomeApp::drawGroundPlane() {
   }
 }
 
+// Render thread: everything 'q' reports about the scene and its workers.
+void radomeApp::logStats() {
+  const radomeRenderStats& stats = _renderQueue.getLastStats();
+  ofLogNotice() << "render queue: " << stats.items << " items, "
+                << stats.drawCalls << " draw calls (" << stats.unsortedDrawCalls << " unsorted), "
+                << stats.stateChanges << " state changes (" << stats.unsortedStateChanges << " unsorted), "
+                << stats.instances << " instances in " << stats.instancedDrawCalls << " instanced calls per pass; "
+                << _modelCache.getAssetCount() << " unique assets (" << _modelCache.getLoadingCount() << " loading)";
+  const radomeStreamStats& streamStats = _geometryStream.getStats();
+  ofLogNotice() << "geometry stream (" << _geometryStream.getModeName() << "): "
+                << streamStats.bytesLastFrame / 1024 << " of " << streamStats.regionSize / 1024 << " KB last frame, "
+                << streamStats.stalls << " stalls and " << streamStats.overflows << " overflows in "
+                << streamStats.frames << " frames";
+  radomeSkinningTimes times = _modelCache.getSkinningTimes();
+  ofLogNotice() << "skinning (" << (_modelCache.getBonePalette() ? "GPU" : "CPU") << "): "
+                << (times.cpuPoses ? times.cpuMicros / times.cpuPoses : 0) << " us per CPU pose over " << times.cpuPoses << ", "
+                << (times.gpuPoses ? times.gpuMicros / times.gpuPoses : 0) << " us per GPU pose over " << times.gpuPoses << "; "
+                << _bonePalette.getBoneCount() << " bones in the palette";
+  ofLogNotice() << "LOD " << (_renderQueue.isLodEnabled() ? "on" : "off") << ": "
+                << stats.triangles << " triangles per frame (" << stats.fullDetailTriangles << " at full detail), "
+                << _lodBuilder.getPendingCount() << " meshes still simplifying";
+  vector<radomeJobThreadStats> jobStats;
+  _jobSystem.getStats(jobStats);
+  ofLogNotice() << "job threads (0 is the render thread), since the last report:";
+  for (int ii = 0; ii < (int)jobStats.size(); ii++) {
+    ofLogNotice() << "  " << ii << ": " << ofToString(jobStats[ii].utilization * 100, 1) << "% busy, "
+                  << jobStats[ii].jobs << " jobs, " << jobStats[ii].steals << " stolen";
+  }
+  radomeTextureStats textureStats = _texturePipeline.getStats();
+  ofLogNotice() << "textures: " << textureStats.delivered << " of " << textureStats.requested << " uploaded ("
+                << textureStats.cacheHits << " from cache, " << textureStats.failed << " failed), "
+                << textureStats.uncompressedBytes / 1024 << " KB uncompressed -> "
+                << textureStats.uploadedBytes / 1024 << " KB with mipmaps";
+  radomeFrameSchedulerStats schedulerStats = _renderThread.getScheduler().getStats();
+  ofLogNotice() << "frame scheduler: " << schedulerStats.frames << " frames, "
+                << ofToString(schedulerStats.stepsPerFrame, 2) << " steps each, "
+                << ofToString(schedulerStats.renderSeconds * 1000, 1) << " ms expected per frame, presents every "
+                << ofToString(schedulerStats.presentInterval * 1000, 1) << " ms; "
+                << schedulerStats.lateFrames << " late frames, " << schedulerStats.longPresents << " long presents, "
+                << schedulerStats.catchUps << " simulation catch-ups";
+  for (int ii = 0; ii < PhaseCount; ii++) {
+    if (schedulerStats.hitchCauses[ii])
+      ofLogNotice() << "  " << schedulerStats.hitchCauses[ii] << " hitches down to " << radomeFrameScheduler::getPhaseName(ii);
+  }
+  radomeFramePipelineStats pipelineStats = _framePipeline.getStats();
+  ofLogNotice() << "frame pipeline (" << _framePipeline.getModeName() << "), " << pipelineStats.depth << " in flight: "
+                << ofToString(pipelineStats.framesPerSecond, 1) << " fps, "
+                << ofToString(pipelineStats.latencyMicros / 1000, 1) << " ms input to GPU done, "
+                << pipelineStats.stalls << " of " << pipelineStats.frames << " frames waited for the GPU, "
+                << ofToString(pipelineStats.waitMicros / 1000, 2) << " ms per frame";
+  for (int ii = 0; ii < MAX_VIDEO_LAYERS; ii++) {
+    auto pVideo = dynamic_cast<radomeVideoFileSource*>(_layerStack.getSource(ii));
+    if (!pVideo)
+      continue;
+    radomeVideoFileStats videoStats = pVideo->getStats();
+    ofLogNotice() << "layer " << ii + 1 << " video: " << videoStats.frames << " frames uploaded, "
+                  << videoStats.skipped << " skipped, " << ofToString(videoStats.copyMicros / 1000, 2) << " ms per copy";
+  }
+}
+
 void radomeApp::keyPressed(int key) {
   float accel = 3.0;
-  auto model = *(_modelList.rbegin());
+  radomeCommand move;
+  move.type = CommandMoveModel;
     
   switch (key) {
-  case 'w': if (model) model->_origin.y += accel; break;
-  case 's': if (model) model->_origin.y -= accel; break;
-  case 'a': if (model) model->_origin.x -= accel; break;
-  case 'd': if (model) model->_origin.x += accel; break;
-  case 'z': if (model) model->_origin.z += accel; break;
-  case 'x': if (model) model->_origin.z -= accel; break;
-  case 'W': if (model) model->_origin.y += accel * 4; break;
-  case 'S': if (model) model->_origin.y -= accel * 4; break;
-  case 'A': if (model) model->_origin.x -= accel * 4; break;
-  case 'D': if (model) model->_origin.x += accel * 4; break;
-  case 'Z': if (model) model->_origin.z += accel * 4; break;
-  case 'X': if (model) model->_origin.z -= accel * 4; break;
+  case 'w': move.vector.set(0, accel, 0); post(move); break;
+  case 's': move.vector.set(0, -accel, 0); post(move); break;
+  case 'a': move.vector.set(-accel, 0, 0); post(move); break;
+  case 'd': move.vector.set(accel, 0, 0); post(move); break;
+  case 'z': move.vector.set(0, 0, accel); post(move); break;
+  case 'x': move.vector.set(0, 0, -accel); post(move); break;
+  case 'W': move.vector.set(0, accel * 4, 0); post(move); break;
+  case 'S': move.vector.set(0, -accel * 4, 0); post(move); break;
+  case 'A': move.vector.set(-accel * 4, 0, 0); post(move); break;
+  case 'D': move.vector.set(accel * 4, 0, 0); post(move); break;
+  case 'Z': move.vector.set(0, 0, accel * 4); post(move); break;
+  case 'X': move.vector.set(0, 0, -accel * 4); post(move); break;
   case 'l': loadFile(); break;
+  case 'g': post(CommandLogGpuMemory); break;
+  case 'q':
+    {
+      radomeRenderThreadStats renderStats = _renderThread.getStats();
+      ofLogNotice() << "render thread: " << renderStats.frames << " frames at "
+                    << ofToString(renderStats.frameMicros / 1000, 1) << " ms since the last report, "
+                    << renderStats.takeoverFrames << " presented while the UI was blocked, "
+                    << renderStats.droppedCommands << " commands dropped";
+      radomeOscStats oscStats = _oscListener.getStats();
+      ofLogNotice() << "osc on port " << _oscListener.getPort() << ": " << oscStats.packets << " packets, "
+                    << oscStats.messages << " control messages, " << oscStats.unknownAddresses << " unknown addresses, "
+                    << oscStats.malformed << " malformed; last loopback " << oscStats.pings << " of "
+                    << oscStats.pingsExpected << " pings";
+      post(CommandLogStats);
+    }
+    break;
+  case 'o':
+    //loopback check: a burst of pings at our own listener, counted under 'q',
+    //then the selected layer's fader, checked in the parameter store
+    if (_oscLoopback.setup("127.0.0.1", OSC_PORT)) {
+      for (int ii = 0; ii < OSC_LOOPBACK_PINGS; ii++) {
+        radomeOscMessage ping(OSC_PING_ADDRESS);
+        ping.addInt(ii);
+        ping.addInt(OSC_LOOPBACK_PINGS);
+        _oscLoopback.send(ping);
+      }
+      ofLogNotice() << "osc: sent " << OSC_LOOPBACK_PINGS << " pings over loopback";
+      startLoopback();
+    }
+    break;
+  case 'j': post(CommandStartScalingSweep); break;
+  case 'i':
+    //step the pipeline depth; each change logs how the last one did
+    _framesInFlight = _framesInFlight % MAX_FRAMES_IN_FLIGHT + 1;
+    post(CommandSetFramesInFlight, 0, _framesInFlight);
+    break;
+  case 'L': post(CommandToggleLod); break;
+  case 'k': post(CommandToggleSkinning); break;
   case 'm':
     {
       DisplayMode mode = getDisplayMode();
@@ -460,72 +1397,70 @@ void radomeApp::keyPressed(int key) {
       showProjectorWindow();
     }
     break;
-  case 'c':
+  case 'P':
     {
-      if (_pCalibrationUI)
-	_pCalibrationUI->setVisible(!_pCalibrationUI->isVisible());
-    }
-    break;
-  case 'C':
-    {
-      if (_modelList.size() > 0)
-	{
-	  auto m = _modelList.back();
-	  _modelList.pop_back();
-	  if (m) delete(m);
-	}
+      showNativeProjectorWindows();
     }
     break;
-  case 'r':
+  case 'c':
     {
-      if (model) {
-	if (model->getRotationIncrement() == 0) {
-	  model->setRotationOrigin(model->getOrigin());
-	  model->setRotation(ofVec4f(0.0,
-				     frand_bounded(),
-				     frand_bounded(),
-				     frand_bounded()));
-	}
-	model->setRotationIncrement(model->getRotationIncrement() + 2.0);
-	if (model->getRotationIncrement() == 10.0) {
-	  model->setRotationIncrement(0.0);
-	}
-      }
+      if (_pCalibrationUI)
+	_pCalibrationUI->setVisible(!_pCalibrationUI->isVisible());
     }
     break;
+  case 'C': post(CommandRemoveModel); break;
+  case 'r': post(CommandSpinModel); break;
   }
 }
 
 void radomeApp::mousePressed(int x, int y, int button) {
+  _uiCache.mousePressed(x, y);
+  _calibrationUICache.mousePressed(x, y);
   if ((x > SIDEBAR_WIDTH + 5) &&
       (!_pCalibrationUI || !_pCalibrationUI->isVisible() || x > (SIDEBAR_WIDTH + CALIBRATIONUI_WIDTH + 10)))
     _cam.mousePressed(x, y, button);
 }
 
 void radomeApp::mouseReleased(int x, int y, int button) {
+  _uiCache.mouseReleased(x, y);
+  _calibrationUICache.mouseReleased(x, y);
   _cam.mouseReleased(x, y, button);
 }
 
 void radomeApp::mouseDragged(int x, int y, int button) {
+  _uiCache.mouseDragged(x, y);
+  _calibrationUICache.mouseDragged(x, y);
   _cam.mouseDragged(x, y, button);
 }
 
 void radomeApp::mouseMoved(int x, int y) {
+  _uiCache.mouseMoved(x, y);
+  _calibrationUICache.mouseMoved(x, y);
+}
+
+void radomeApp::windowResized(int w, int h) {
+  _uiCache.windowResized(w, h);
+  _calibrationUICache.windowResized(w, h);
 }
 
 void radomeApp::changeDisplayMode(DisplayMode mode) {
   _displayMode = mode;
   if (_displayMode == LastDisplayMode)
     _displayMode = DisplayScene;
+  post(CommandSetDisplayMode, _displayMode);
     
   ofxUIRadio* pRadio = dynamic_cast<ofxUIRadio*>(_pUI->getWidget("DISPLAY MODE"));
   if (pRadio) {
     pRadio->activateToggle(_displayModeNames[_displayMode]);
+    _uiCache.invalidate();
   }
 }
 
 void radomeApp::guiEvent(ofxUIEventArgs &e) {
   string name = e.widget->getName();
+
+  _uiCache.invalidate();
+  _calibrationUICache.invalidate();
     
   int radio;
   if(matchRadioButton(name, _displayModeNames, &radio)) {
@@ -533,17 +1468,49 @@ void radomeApp::guiEvent(ofxUIEventArgs &e) {
     return;
   }
     
-  if (matchRadioButton(name, _mixModeNames, &_mixMode))
+  if (matchRadioButton(name, _layerNames, &_selectedLayer)) {
+    syncLayerControls();
     return;
+  }
 
-  if (matchRadioButton(name, _mappingModeNames, &_mappingMode))
+  if (matchRadioButton(name, _mixModeNames, &radio)) {
+    _layerControls[_selectedLayer].blendMode = radio;
+    post(CommandSetLayerBlend, _selectedLayer, radio);
     return;
+  }
+
+  if (matchRadioButton(name, _mappingModeNames, &radio)) {
+    _layerControls[_selectedLayer].mappingMode = radio;
+    post(CommandSetLayerMapping, _selectedLayer, radio);
+    return;
+  }
             
   if (name == "XFADE") {
     auto slider = dynamic_cast<ofxUISlider*>(e.widget);
     if (slider) {
       //      _vidOverlay.setFaderValue(slider->getValue());
     }
+  } else if (name == "LAYER MIX") {
+    auto slider = dynamic_cast<ofxUISlider*>(e.widget);
+    if (slider) {
+      _layerControls[_selectedLayer].fader = slider->getScaledValue();
+      post(CommandSetLayerFader, _selectedLayer, slider->getScaledValue());
+    }
+  } else if (name == "2D Input...") {
+    auto pButton = dynamic_cast<ofxUIButton*>(e.widget);
+    if (pButton && !pButton->getValue())
+      {
+	loadLayerImage();
+      }
+  } else if (name == "Shared Video") {
+    auto pButton = dynamic_cast<ofxUIButton*>(e.widget);
+    if (pButton && !pButton->getValue()) {
+      radomeCommand command;
+      command.type = CommandConnectSharedVideo;
+      command.index = _selectedLayer;
+      command.path = SHARED_VIDEO_NAME + ofToString(_selectedLayer + 1);
+      post(command);
+    }
   } else if (name == "Add 3D Model...") {
     auto pButton = dynamic_cast<ofxUIButton*>(e.widget);
     if (pButton && !pButton->getValue())
@@ -556,6 +1523,12 @@ void radomeApp::guiEvent(ofxUIEventArgs &e) {
       {
 	showProjectorWindow();
       }
+  } else if (name == "Native Outputs") {
+    auto pButton = dynamic_cast<ofxUIButton*>(e.widget);
+    if (pButton && !pButton->getValue())
+      {
+	showNativeProjectorWindows();
+      }
   } else if (name == "Calibrate...") {
     auto pButton = dynamic_cast<ofxUIButton*>(e.widget);
     if (pButton && !pButton->getValue())
@@ -565,81 +1538,19 @@ void radomeApp::guiEvent(ofxUIEventArgs &e) {
 	  _pCalibrationUI->setVisible(!bVis);
 	}
       }
-  } else if (name == "PROJECTOR 1 HEIGHT") {
-    auto slider = dynamic_cast<ofxUISlider*>(e.widget);
-    if (slider && _projectorList.size() > 0 && _projectorList[0]) {
-      _projectorList[0]->setHeight(slider->getScaledValue() * 10);
-    }
-  } else if (name == "PROJECTOR 1 HEADING") {
-    auto slider = dynamic_cast<ofxUISlider*>(e.widget);
-    if (slider && _projectorList.size() > 0 && _projectorList[0]) {
-      _projectorList[0]->setHeading(slider->getScaledValue());
-    }
-  } else if (name == "PROJECTOR 1 DISTANCE") {
-    auto slider = dynamic_cast<ofxUISlider*>(e.widget);
-    if (slider && _projectorList.size() > 0 && _projectorList[0]) {
-      _projectorList[0]->setDistance(slider->getScaledValue() * 10);
-    }
-  } else if (name == "PROJECTOR 1 FOV") {
-    auto slider = dynamic_cast<ofxUISlider*>(e.widget);
-    if (slider && _projectorList.size() > 0 && _projectorList[0]) {
-      _projectorList[0]->setFOV(slider->getScaledValue());
-    }
-  } else if (name == "PROJECTOR 1 TARGET") {
-    auto slider = dynamic_cast<ofxUISlider*>(e.widget);
-    if (slider && _projectorList.size() > 0 && _projectorList[0]) {
-      _projectorList[0]->setTargetHeight(slider->getScaledValue() * 10);
-    }
-  } else if (name == "PROJECTOR 2 HEIGHT") {
-    auto slider = dynamic_cast<ofxUISlider*>(e.widget);
-    if (slider && _projectorList.size() > 1 && _projectorList[1]) {
-      _projectorList[1]->setHeight(slider->getScaledValue() * 10);
-    }
-  } else if (name == "PROJECTOR 2 HEADING") {
-    auto slider = dynamic_cast<ofxUISlider*>(e.widget);
-    if (slider && _projectorList.size() > 1 && _projectorList[1]) {
-      _projectorList[1]->setHeading(slider->getScaledValue());
-    }
-  } else if (name == "PROJECTOR 2 DISTANCE") {
-    auto slider = dynamic_cast<ofxUISlider*>(e.widget);
-    if (slider && _projectorList.size() > 1 && _projectorList[1]) {
-      _projectorList[1]->setDistance(slider->getScaledValue() * 10);
-    }
-  } else if (name == "PROJECTOR 2 FOV") {
-    auto slider = dynamic_cast<ofxUISlider*>(e.widget);
-    if (slider && _projectorList.size() > 1 && _projectorList[1]) {
-      _projectorList[1]->setFOV(slider->getScaledValue());
-    }
-  } else if (name == "PROJECTOR 2 TARGET") {
-    auto slider = dynamic_cast<ofxUISlider*>(e.widget);
-    if (slider && _projectorList.size() > 1 && _projectorList[1]) {
-      _projectorList[1]->setTargetHeight(slider->getScaledValue() * 10);
-    }
-  } else if (name == "PROJECTOR 3 HEIGHT") {
-    auto slider = dynamic_cast<ofxUISlider*>(e.widget);
-    if (slider && _projectorList.size() > 2 && _projectorList[2]) {
-      _projectorList[2]->setHeight(slider->getScaledValue() * 10);
-    }
-  } else if (name == "PROJECTOR 3 HEADING") {
-    auto slider = dynamic_cast<ofxUISlider*>(e.widget);
-    if (slider && _projectorList.size() > 2 && _projectorList[2]) {
-      _projectorList[2]->setHeading(slider->getScaledValue());
-    }
-  } else if (name == "PROJECTOR 3 DISTANCE") {
-    auto slider = dynamic_cast<ofxUISlider*>(e.widget);
-    if (slider && _projectorList.size() > 2 && _projectorList[2]) {
-      _projectorList[2]->setDistance(slider->getScaledValue() * 10);
-    }
-  } else if (name == "PROJECTOR 3 FOV") {
-    auto slider = dynamic_cast<ofxUISlider*>(e.widget);
-    if (slider && _projectorList.size() > 2 && _projectorList[2]) {
-      _projectorList[2]->setFOV(slider->getScaledValue());
-    }
-  } else if (name == "PROJECTOR 3 TARGET") {
+  } else if (name == "Reload LUTs") {
+    auto pButton = dynamic_cast<ofxUIButton*>(e.widget);
+    if (pButton && !pButton->getValue())
+      {
+	post(CommandReloadLUTs);
+      }
+  } else if (name.compare(0, 10, "PROJECTOR ") == 0) {
     auto slider = dynamic_cast<ofxUISlider*>(e.widget);
-    if (slider && _projectorList.size() > 2 && _projectorList[2]) {
-      _projectorList[2]->setTargetHeight(slider->getScaledValue() * 10);
+    int projector = ofToInt(name.substr(10, 1)) - 1;
+    string parameter = name.substr(12);
+    for (int ii = 0; slider && ii < 7; ii++) {
+      if (parameter == projectorSliderParameters[ii])
+        post(CommandSetProjectorHeight + ii, projector, slider->getScaledValue() * projectorSliderScales[ii]);
     }
   }
-    
 }
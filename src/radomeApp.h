@@ -10,13 +10,19 @@
 
 #include "turntableCam.h"
 #include "icosohedron.h"
-<<<<<<< HEAD
 //#include "radomeSyphonClient.h"
-=======
-#include "radomeSyphonClient.h"
->>>>>>> 7072e5b1eb2648c23ccb5ba0530a60c77004eed2
 #include "radomeProjector.h"
 #include "radomeModel.h"
+#include "radomeCachedCanvas.h"
+#include "radomePreviewScheduler.h"
+#include "radomeResolutionGovernor.h"
+#include "radomeLayerStack.h"
+#include "radomeImageSource.h"
+#include "radomeSharedVideoSource.h"
+#include "radomeVideoFileSource.h"
+#include "radomeRenderThread.h"
+#include "radomeFramePipeline.h"
+#include "radomeOscListener.h"
 
 using std::list;
 using std::vector;
@@ -31,8 +37,56 @@ enum DisplayMode {
     LastDisplayMode,
 };
 
+// Scene and parameter changes, posted by the UI thread and applied by the
+// render thread between frames. Model commands act on the most recently
+// added model.
+enum RenderCommand {
+    CommandLoadModel = 0,       // path
+    CommandRemoveModel,
+    CommandMoveModel,           // vector
+    CommandSpinModel,
+    CommandSetModelOrigin,      // vector
+    CommandSetModelRotation,    // value: degrees, vector: axis
+    CommandSetModelSpin,        // value: degrees per frame
+    CommandSetDisplayMode,      // index
+    CommandSetCamera,           // matrix: the preview camera's global transform
+    CommandLoadLayerImage,      // index, path: an image or a video file
+    CommandConnectSharedVideo,  // index, path: the shared memory name
+    CommandSetLayerBlend,       // index, value
+    CommandSetLayerMapping,     // index, value
+    CommandSetLayerFader,       // index, value
+    CommandSetProjectorHeight,  // index, value; the projector commands run in
+    CommandSetProjectorHeading, // the order of the calibration sliders
+    CommandSetProjectorDistance,
+    CommandSetProjectorFOV,
+    CommandSetProjectorTarget,
+    CommandSetProjectorGamma,
+    CommandSetProjectorBlack,
+    CommandReloadLUTs,
+    CommandSetNativeOutputs,    // value: 1 for native windows, 0 for the preview window
+    CommandToggleLod,
+    CommandToggleSkinning,
+    CommandStartScalingSweep,
+    CommandSetFramesInFlight,   // value
+    CommandLogStats,
+    CommandLogGpuMemory,
+};
+
+// One frame's model updates, run on the job system while the GPU works
+// through the frame before it.
+struct radomeUpdateJob {
+    vector<radomeModelAsset*> assets;
+    vector<radomeModel*> models;
+    float t;
+    int steps;
+    float alpha;
+};
+
 
-class radomeApp : public ofBaseApp {
+// The app runs on two threads. The UI thread owns the windows, the GUI and
+// the operator's camera, and changes the scene only through commands; the
+// render thread owns the scene and everything that draws the output.
+class radomeApp : public ofBaseApp, public radomeRenderClient, public radomeProjectorRenderer {
 public:
     radomeApp();
     ~radomeApp();
@@ -40,16 +94,32 @@ public:
     void setup();
     void update();
     void draw();
-    void drawScene();
+    void drawScene(const radomeLodView* pView = NULL);
+    void drawScenePreview();
+    void drawDomePreview();
     void drawDome();
     void drawGroundPlane();
     void updateCubeMap();
     void updateProjectorOutput();
+    void buildRenderQueue();
     
     void loadFile();
     void showProjectorWindow();
+    void showNativeProjectorWindows();
+    void loadColorLUTs();
+    void loadLayerImage();
+    void closeProjectorWindows();
+    void outputClosed(radomeOutputWindow*& pOutput);
+    void renderProjectorView(radomeProjector* pProjector);
+
+    // radomeRenderClient
+    void setupRenderer();
+    void executeCommand(const radomeCommand& command);
+    void renderFrame();
+    void teardownRenderer();
 
     DisplayMode getDisplayMode() const { return _displayMode; }
+    const radomeResolutionGovernor& getResolutionGovernor() const { return _resolutionGovernor; }
     void changeDisplayMode(DisplayMode mode);
     
     void keyPressed(int key);
@@ -57,50 +127,124 @@ public:
     void mouseReleased(int x, int y, int button);
     void mouseDragged(int x, int y, int button);
     void mouseMoved(int x, int y);
+    void windowResized(int w, int h);
 
 protected:
     void initGUI();
     void guiEvent(ofxUIEventArgs &e);
     void beginShader();
     void endShader();
+    void syncLayerControls();
+    bool post(int type, int index = 0, float value = 0);
+    bool post(const radomeCommand& command);
+    void postCamera();
+    void executeProjectorCommand(const radomeCommand& command);
+    void executeModelCommand(const radomeCommand& command);
+    void logStats();
+    void bindControls();
+    void bindControl(const string& address, int type, int index, int count = 1);
+    void applyControls();
+    void pollControls();
+    void startLoopback();
+    void checkLoopback();
     
     void prepDrawList();
+    void createDomeTriangles(int levels);
+    void startModelUpdate();
+    void finishModelUpdate();
+    void publishModels();
+    void startScalingSweep();
+    void updateScalingSweep(unsigned long long micros, int models, int animatedAssets);
     
     ofxUICanvas* _pUI;
     ofxUICanvas* _pCalibrationUI;
+    radomeCachedCanvas _uiCache;
+    radomeCachedCanvas _calibrationUICache;
     
     ofxCubeMap _cubeMap;
     ofShader _shader;
+    ofShader _instancedShader;
+    ofShader _skinnedShader;
     ofxTurntableCam _cam;
+    ofMatrix4x4 _postedCamera;
+    ofCamera _previewCam;   // the render thread's copy of _cam
+    radomePreviewScheduler _preview;
     unsigned int domeDrawIndex;
 
+    radomeRenderThread _renderThread;
+    radomeJobSystem _jobSystem;   // outlives everything below that runs jobs on it
+    radomeJobGroup _frameJobs;
+    radomeLodBuilder _lodBuilder;   // outlives the cache, which cancels jobs into it
+    radomeTexturePipeline _texturePipeline;   // likewise
+    radomeModelLoader _modelLoader;   // likewise
+    radomeModelCache _modelCache;
     list<radomeModel*> _modelList;
+    radomeRenderQueue _renderQueue;
+    radomeStreamBuffer _geometryStream;
+    radomeBonePalette _bonePalette;
+    radomeFramePipeline _framePipeline;
     vector<radomeProjector*> _projectorList;
+    radomeResolutionGovernor _resolutionGovernor;
     ofxFenster* _projectorWindow;
+    vector<ofxFenster*> _nativeProjectorWindows;
+    vector<radomeOutputWindow*> _outputWindows;
     
-<<<<<<< HEAD
     //    radomeSyphonClient _vidOverlay;
-=======
-    radomeSyphonClient _vidOverlay;
->>>>>>> 7072e5b1eb2648c23ccb5ba0530a60c77004eed2
-    ofImage _blankImage;
+    radomeLayerStack _layerStack;
     
     bool _fullscreen;
     
     float _animationTime;
-    unsigned long long _lastSystemTime;
+    double _videoClock;   // the same steps as _animationTime, without wrapping
+    double _videoTime;    // the frame's, interpolated like the models' t
+    radomeUpdateJob _modelUpdate;
+    vector<radomeModel*> _attachedModels;
+    bool _modelUpdatePending;
+    unsigned long long _modelUpdateStart;
+    unsigned long long _frameInputTime;   // when the frame's simulation was planned
+    int _framesInFlight;   // the UI's copy of the pipeline depth
+
+    int _scalingThreads;   // thread count being measured, 0 when not sweeping
+    int _scalingFrames;
+    unsigned long long _scalingMicros;
+    vector<double> _scalingResults;   // mean update micros per thread count
     
-    int _mixMode;
-    int _mappingMode;
+    int _selectedLayer;
+    // The UI's copy of every layer's settings; the layer stack itself
+    // belongs to the render thread.
+    struct LayerControls {
+        int blendMode;
+        int mappingMode;
+        float fader;
+    };
+    vector<LayerControls> _layerControls;
+
+    // OSC writes parameters from the network thread; once a frame, the render
+    // thread turns the ones that changed into commands.
+    struct ControlBinding {
+        int type;
+        int index;
+        int parameter;   // first of count parameters in _controls
+        int count;       // 1: value, 3: vector, 4: value then vector
+    };
+    radomeParameterStore _controls;
+    radomeOscListener _oscListener;
+    radomeOscSender _oscLoopback;
+    int _loopbackParameter;   // the check's bound parameter, -1 when none is waiting
+    string _loopbackAddress;
+    float _loopbackValue;
+    unsigned int _loopbackSeen;
+    unsigned long long _loopbackDeadline;
+    vector<ControlBinding> _controlBindings;
+    vector<unsigned int> _controlsSeen;   // render thread
+    vector<unsigned int> _uiControlsSeen;   // UI thread
     
     enum DisplayMode _displayMode;
+    enum DisplayMode _previewMode;   // the render thread's copy
     vector<string> _displayModeNames;
+    vector<string> _layerNames;
     vector<string> _mixModeNames;
     vector<string> _mappingModeNames;
 
-<<<<<<< HEAD
-    vector<icosohedron::Triangle> _triangle;
-=======
     vector<icosohedron::Triangle> _triangles;
->>>>>>> 7072e5b1eb2648c23ccb5ba0530a60c77004eed2
 };
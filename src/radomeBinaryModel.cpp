@@ -0,0 +1,641 @@
+//
+//  radomeBinaryModel.cpp
+//  radome
+//
+
+#include "radomeBinaryModel.h"
+#include "radomeModelAsset.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+
+#define MODEL_CACHE_DIRECTORY "modelcache"
+#define MODEL_FILE_VERSION 1
+// Vertex arrays start on this boundary within the file, and so in memory.
+#define ARRAY_ALIGNMENT 16
+
+#define MESH_HAS_NORMALS 1
+#define MESH_HAS_TEXCOORDS 2
+#define MESH_HAS_COLORS 4
+
+static const char modelFileMagic[4] = { 'R', 'D', 'M', 'F' };
+
+// The file is this header, the tables (meshes, texture sources, nodes,
+// animations, written field by field), then the data area holding every
+// vertex and index array.
+struct modelFileHeader {
+    char magic[4];
+    uint32_t version;
+    int64_t sourceSize;
+    int64_t sourceTime;
+    uint64_t importMicros;
+    uint64_t dataOffset;
+    uint64_t dataSize;
+    uint32_t meshCount;
+    uint32_t textureCount;
+    uint32_t nodeCount;
+    uint32_t animationCount;
+    float center[3];
+    float normalizedScale;
+    int32_t drawCallsBefore;
+    int32_t drawCallsAfter;
+    int32_t verticesBefore;
+    int32_t verticesAfter;
+    float acmrBefore;
+    float acmrAfter;
+};
+
+// Followed in the tables by its bones. Offsets are into the data area.
+struct modelFileMesh {
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t flags;
+    uint32_t boneCount;
+    int32_t blendMode;
+    uint32_t twoSided;
+    float diffuse[4];
+    float specular[4];
+    float ambient[4];
+    float emissive[4];
+    float shininess;
+    uint32_t reserved;
+    uint64_t positionOffset;
+    uint64_t normalOffset;
+    uint64_t texcoordOffset;
+    uint64_t colorOffset;
+    uint64_t indexOffset;
+};
+
+class modelFileWriter {
+public:
+    void putBytes(const void* pData, size_t bytes) {
+        const unsigned char* p = (const unsigned char*)pData;
+        tables.insert(tables.end(), p, p + bytes);
+    }
+    template <class T> void put(const T& value) { putBytes(&value, sizeof(T)); }
+    void putString(const string& s) {
+        put((uint32_t)s.size());
+        putBytes(s.data(), s.size());
+    }
+    void putMatrix(const aiMatrix4x4& m) { putBytes(&m.a1, 16 * sizeof(float)); }
+
+    // Returns where the array starts in the data area.
+    uint64_t putArray(const void* pData, size_t bytes) {
+        data.resize((data.size() + ARRAY_ALIGNMENT - 1) / ARRAY_ALIGNMENT * ARRAY_ALIGNMENT, 0);
+        uint64_t offset = data.size();
+        const unsigned char* p = (const unsigned char*)pData;
+        data.insert(data.end(), p, p + bytes);
+        return offset;
+    }
+
+    vector<unsigned char> tables;
+    vector<unsigned char> data;
+};
+
+// Reads the tables; any read past the end fails this and every later read.
+class modelFileReader {
+public:
+    modelFileReader(const unsigned char* pData, size_t size) : _pData(pData), _size(size), _position(0), _valid(true) {}
+
+    bool has(size_t bytes) {
+        _valid = _valid && bytes <= _size - _position;
+        return _valid;
+    }
+    bool getBytes(void* pData, size_t bytes) {
+        if (!has(bytes))
+            return false;
+        memcpy(pData, _pData + _position, bytes);
+        _position += bytes;
+        return true;
+    }
+    template <class T> bool get(T& value) { return getBytes(&value, sizeof(T)); }
+    bool getString(string& s) {
+        uint32_t length;
+        if (!get(length) || !has(length))
+            return false;
+        s.assign((const char*)_pData + _position, length);
+        _position += length;
+        return true;
+    }
+    bool getName(aiString& name) {
+        string s;
+        if (!getString(s) || s.size() >= sizeof(name.data))
+            return _valid = false;
+        name.Set(s);
+        return true;
+    }
+    bool getMatrix(aiMatrix4x4& m) { return getBytes(&m.a1, 16 * sizeof(float)); }
+    bool isValid() const { return _valid; }
+
+protected:
+    const unsigned char* _pData;
+    size_t _size;
+    size_t _position;
+    bool _valid;
+};
+
+static void collectNodes(const aiNode* pNode, int parent, vector<const aiNode*>& nodes, vector<int>& parents) {
+    int index = nodes.size();
+    nodes.push_back(pNode);
+    parents.push_back(parent);
+    for (unsigned int ii = 0; ii < pNode->mNumChildren; ii++)
+        collectNodes(pNode->mChildren[ii], index, nodes, parents);
+}
+
+static void writeVectorKeys(modelFileWriter& writer, const aiVectorKey* pKeys, unsigned int count) {
+    writer.put((uint32_t)count);
+    for (unsigned int ii = 0; ii < count; ii++) {
+        writer.put(pKeys[ii].mTime);
+        writer.putBytes(&pKeys[ii].mValue.x, 3 * sizeof(float));
+    }
+}
+
+static bool readVectorKeys(modelFileReader& reader, aiVectorKey*& pKeys, unsigned int& count) {
+    const size_t keyBytes = sizeof(double) + 3 * sizeof(float);
+    uint32_t stored;
+    if (!reader.get(stored) || !reader.has((size_t)stored * keyBytes))
+        return false;
+    count = stored;
+    pKeys = new aiVectorKey[count];
+    for (unsigned int ii = 0; ii < count; ii++) {
+        reader.get(pKeys[ii].mTime);
+        reader.getBytes(&pKeys[ii].mValue.x, 3 * sizeof(float));
+    }
+    return true;
+}
+
+// Preorder, each node after its parent.
+static bool readNodes(modelFileReader& reader, unsigned int nodeCount, unsigned int meshCount, aiNode*& pRoot) {
+    if (nodeCount == 0) {
+        // Static models keep no hierarchy, but the loader expects a root.
+        pRoot = new aiNode();
+        return true;
+    }
+
+    vector<aiNode*> nodes;
+    vector<int> parents;
+    bool valid = true;
+    for (unsigned int ii = 0; valid && ii < nodeCount; ii++) {
+        aiNode* pNode = new aiNode();
+        nodes.push_back(pNode);
+        int32_t parent;
+        uint32_t nodeMeshes;
+        valid = reader.getName(pNode->mName) && reader.getMatrix(pNode->mTransformation)
+             && reader.get(parent) && reader.get(nodeMeshes)
+             && (ii == 0 ? parent == -1 : parent >= 0 && parent < (int)ii)
+             && reader.has((size_t)nodeMeshes * sizeof(uint32_t));
+        parents.push_back(parent);
+        if (!valid || !nodeMeshes)
+            continue;
+        pNode->mNumMeshes = nodeMeshes;
+        pNode->mMeshes = new unsigned int[nodeMeshes];
+        for (uint32_t mm = 0; valid && mm < nodeMeshes; mm++)
+            valid = reader.get(pNode->mMeshes[mm]) && pNode->mMeshes[mm] < meshCount;
+    }
+    if (!valid) {
+        // Not linked up yet, so each goes on its own.
+        for (auto iter = nodes.begin(); iter != nodes.end(); ++iter)
+            delete *iter;
+        return false;
+    }
+
+    for (unsigned int ii = 1; ii < nodeCount; ii++)
+        nodes[parents[ii]]->mNumChildren++;
+    for (unsigned int ii = 0; ii < nodeCount; ii++) {
+        if (nodes[ii]->mNumChildren) {
+            nodes[ii]->mChildren = new aiNode*[nodes[ii]->mNumChildren];
+            nodes[ii]->mNumChildren = 0;
+        }
+    }
+    for (unsigned int ii = 1; ii < nodeCount; ii++) {
+        aiNode* pParent = nodes[parents[ii]];
+        nodes[ii]->mParent = pParent;
+        pParent->mChildren[pParent->mNumChildren++] = nodes[ii];
+    }
+    pRoot = nodes[0];
+    return true;
+}
+
+static void writeAnimation(modelFileWriter& writer, const aiAnimation* pAnimation) {
+    writer.putString(pAnimation->mName.data);
+    writer.put(pAnimation->mDuration);
+    writer.put(pAnimation->mTicksPerSecond);
+    writer.put((uint32_t)pAnimation->mNumChannels);
+    for (unsigned int cc = 0; cc < pAnimation->mNumChannels; cc++) {
+        const aiNodeAnim* pChannel = pAnimation->mChannels[cc];
+        writer.putString(pChannel->mNodeName.data);
+        writeVectorKeys(writer, pChannel->mPositionKeys, pChannel->mNumPositionKeys);
+        writer.put((uint32_t)pChannel->mNumRotationKeys);
+        for (unsigned int kk = 0; kk < pChannel->mNumRotationKeys; kk++) {
+            const aiQuatKey& key = pChannel->mRotationKeys[kk];
+            writer.put(key.mTime);
+            writer.put(key.mValue.w);
+            writer.put(key.mValue.x);
+            writer.put(key.mValue.y);
+            writer.put(key.mValue.z);
+        }
+        writeVectorKeys(writer, pChannel->mScalingKeys, pChannel->mNumScalingKeys);
+    }
+}
+
+// Channels are attached as they're read, so a failure part way through is
+// cleaned up by deleting the animation.
+static bool readAnimation(modelFileReader& reader, aiAnimation* pAnimation) {
+    uint32_t channelCount;
+    if (!reader.getName(pAnimation->mName) || !reader.get(pAnimation->mDuration)
+        || !reader.get(pAnimation->mTicksPerSecond) || !reader.get(channelCount)
+        || !reader.has((size_t)channelCount * 4 * sizeof(uint32_t)))
+        return false;
+
+    pAnimation->mNumChannels = channelCount;
+    pAnimation->mChannels = new aiNodeAnim*[channelCount]();
+    const size_t rotationKeyBytes = sizeof(double) + 4 * sizeof(float);
+    for (uint32_t cc = 0; cc < channelCount; cc++) {
+        aiNodeAnim* pChannel = new aiNodeAnim();
+        pAnimation->mChannels[cc] = pChannel;
+        uint32_t rotationCount;
+        if (!reader.getName(pChannel->mNodeName)
+            || !readVectorKeys(reader, pChannel->mPositionKeys, pChannel->mNumPositionKeys)
+            || !reader.get(rotationCount) || !reader.has((size_t)rotationCount * rotationKeyBytes))
+            return false;
+        pChannel->mNumRotationKeys = rotationCount;
+        pChannel->mRotationKeys = new aiQuatKey[rotationCount];
+        for (uint32_t kk = 0; kk < rotationCount; kk++) {
+            aiQuatKey& key = pChannel->mRotationKeys[kk];
+            reader.get(key.mTime);
+            reader.get(key.mValue.w);
+            reader.get(key.mValue.x);
+            reader.get(key.mValue.y);
+            reader.get(key.mValue.z);
+        }
+        if (!readVectorKeys(reader, pChannel->mScalingKeys, pChannel->mNumScalingKeys))
+            return false;
+    }
+    return true;
+}
+
+static void getColor(const ofFloatColor& color, float* pOut) {
+    pOut[0] = color.r;
+    pOut[1] = color.g;
+    pOut[2] = color.b;
+    pOut[3] = color.a;
+}
+
+radomeBinaryModel::radomeBinaryModel()
+: _pData(NULL)
+, _size(0)
+, _importMicros(0)
+{
+}
+
+radomeBinaryModel::~radomeBinaryModel() {
+    unmap();
+}
+
+void radomeBinaryModel::unmap() {
+    if (_pData)
+        munmap(_pData, _size);
+    _pData = NULL;
+    _size = 0;
+}
+
+// One file per source path, invalidated when the source's size or
+// modification time changes.
+string radomeBinaryModel::getCachePath(const string& sourcePath) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t ii = 0; ii < sourcePath.size(); ii++) {
+        hash ^= (unsigned char)sourcePath[ii];
+        hash *= 1099511628211ULL;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.rdm", (unsigned long long)hash);
+    return ofToDataPath(MODEL_CACHE_DIRECTORY, true) + "/" + name;
+}
+
+bool radomeBinaryModel::write(const string& path, radomeModelAsset& asset, long long sourceSize, long long sourceTime,
+                              unsigned long long importMicros) {
+    modelFileWriter writer;
+    modelFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, modelFileMagic, sizeof(header.magic));
+    header.version = MODEL_FILE_VERSION;
+    header.sourceSize = sourceSize;
+    header.sourceTime = sourceTime;
+    header.importMicros = importMicros;
+    header.center[0] = asset.scene_center.x;
+    header.center[1] = asset.scene_center.y;
+    header.center[2] = asset.scene_center.z;
+    header.normalizedScale = asset.normalizedScale;
+    header.drawCallsBefore = asset._importStats.drawCallsBefore;
+    header.drawCallsAfter = asset._importStats.drawCallsAfter;
+    header.verticesBefore = asset._importStats.verticesBefore;
+    header.verticesAfter = asset._importStats.verticesAfter;
+    header.acmrBefore = asset._importStats.acmrBefore;
+    header.acmrAfter = asset._importStats.acmrAfter;
+
+    header.meshCount = asset.modelMeshes.size();
+    for (auto iter = asset.modelMeshes.begin(); iter != asset.modelMeshes.end(); ++iter) {
+        const aiMesh* pMesh = iter->mesh;
+        size_t vectorBytes = pMesh->mNumVertices * sizeof(aiVector3D);
+        modelFileMesh stored;
+        memset(&stored, 0, sizeof(stored));
+        stored.vertexCount = pMesh->mNumVertices;
+        stored.indexCount = iter->indices.size();
+        stored.boneCount = pMesh->mNumBones;
+        stored.blendMode = iter->blendMode;
+        stored.twoSided = iter->twoSided;
+        getColor(iter->material.getDiffuseColor(), stored.diffuse);
+        getColor(iter->material.getSpecularColor(), stored.specular);
+        getColor(iter->material.getAmbientColor(), stored.ambient);
+        getColor(iter->material.getEmissiveColor(), stored.emissive);
+        stored.shininess = iter->material.getShininess();
+
+        stored.positionOffset = writer.putArray(pMesh->mVertices, vectorBytes);
+        if (pMesh->HasNormals()) {
+            stored.flags |= MESH_HAS_NORMALS;
+            stored.normalOffset = writer.putArray(pMesh->mNormals, vectorBytes);
+        }
+        if (pMesh->HasTextureCoords(0)) {
+            stored.flags |= MESH_HAS_TEXCOORDS;
+            stored.texcoordOffset = writer.putArray(pMesh->mTextureCoords[0], vectorBytes);
+        }
+        if (pMesh->HasVertexColors(0)) {
+            stored.flags |= MESH_HAS_COLORS;
+            stored.colorOffset = writer.putArray(pMesh->mColors[0], pMesh->mNumVertices * sizeof(aiColor4D));
+        }
+        vector<uint32_t> indices(iter->indices.begin(), iter->indices.end());
+        stored.indexOffset = writer.putArray(indices.empty() ? NULL : &indices[0], indices.size() * sizeof(uint32_t));
+        writer.put(stored);
+
+        for (unsigned int bb = 0; bb < pMesh->mNumBones; bb++) {
+            const aiBone* pBone = pMesh->mBones[bb];
+            writer.putString(pBone->mName.data);
+            writer.putMatrix(pBone->mOffsetMatrix);
+            writer.put((uint32_t)pBone->mNumWeights);
+            writer.putBytes(pBone->mWeights, pBone->mNumWeights * sizeof(aiVertexWeight));
+        }
+    }
+
+    // Texture paths are kept relative to the model, so a copied .rdm finds
+    // textures sitting next to it.
+    string directory = ofFilePath::getEnclosingDirectory(asset._path, false);
+    header.textureCount = asset._textureSources.size();
+    for (auto iter = asset._textureSources.begin(); iter != asset._textureSources.end(); ++iter) {
+        string relative = iter->path;
+        if (relative.compare(0, directory.size(), directory) == 0)
+            relative = relative.substr(directory.size());
+        writer.putString(relative);
+        writer.put((uint32_t)iter->meshes.size());
+        for (auto mesh = iter->meshes.begin(); mesh != iter->meshes.end(); ++mesh)
+            writer.put((uint32_t)*mesh);
+    }
+
+    // Only animation needs the hierarchy; static meshes are already placed.
+    const aiScene* pScene = asset.scene;
+    if (asset.isAnimated()) {
+        vector<const aiNode*> nodes;
+        vector<int> parents;
+        collectNodes(pScene->mRootNode, -1, nodes, parents);
+        header.nodeCount = nodes.size();
+        for (int ii = 0; ii < (int)nodes.size(); ii++) {
+            writer.putString(nodes[ii]->mName.data);
+            writer.putMatrix(nodes[ii]->mTransformation);
+            writer.put((int32_t)parents[ii]);
+            writer.put((uint32_t)nodes[ii]->mNumMeshes);
+            writer.putBytes(nodes[ii]->mMeshes, nodes[ii]->mNumMeshes * sizeof(unsigned int));
+        }
+        header.animationCount = pScene->mNumAnimations;
+        for (unsigned int ii = 0; ii < pScene->mNumAnimations; ii++)
+            writeAnimation(writer, pScene->mAnimations[ii]);
+    }
+
+    size_t tablesEnd = sizeof(header) + writer.tables.size();
+    header.dataOffset = (tablesEnd + ARRAY_ALIGNMENT - 1) / ARRAY_ALIGNMENT * ARRAY_ALIGNMENT;
+    header.dataSize = writer.data.size();
+    vector<unsigned char> padding(header.dataOffset - tablesEnd, 0);
+
+    ofDirectory::createDirectory(ofFilePath::getEnclosingDirectory(path, false), false, true);
+    // Written aside and renamed, so a reader never maps half a file.
+    string partialPath = path + ".part";
+    FILE* pFile = fopen(partialPath.c_str(), "wb");
+    if (!pFile) {
+        ofLogWarning() << "couldn't write converted model " << path;
+        return false;
+    }
+    bool written = fwrite(&header, sizeof(header), 1, pFile) == 1
+        && (writer.tables.empty() || fwrite(&writer.tables[0], writer.tables.size(), 1, pFile) == 1)
+        && (padding.empty() || fwrite(&padding[0], padding.size(), 1, pFile) == 1)
+        && (writer.data.empty() || fwrite(&writer.data[0], writer.data.size(), 1, pFile) == 1);
+    fclose(pFile);
+    if (!written || rename(partialPath.c_str(), path.c_str()) != 0) {
+        ofLogWarning() << "couldn't write converted model " << path;
+        remove(partialPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool radomeBinaryModel::read(const string& path, radomeModelAsset& asset, long long sourceSize, long long sourceTime) {
+    unmap();
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        return false;
+    struct stat info;
+    if (fstat(file, &info) != 0 || info.st_size < (off_t)sizeof(modelFileHeader)) {
+        close(file);
+        return false;
+    }
+    // Private and writable: nothing should write to the arrays, but if
+    // anything does it gets its own copy of the page instead of a fault.
+    void* pMapped = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+    close(file);
+    if (pMapped == MAP_FAILED)
+        return false;
+    _pData = (unsigned char*)pMapped;
+    _size = info.st_size;
+    // Every array is read by the upload shortly after.
+    madvise(_pData, _size, MADV_WILLNEED);
+
+    modelFileHeader header;
+    memcpy(&header, _pData, sizeof(header));
+    bool valid = memcmp(header.magic, modelFileMagic, sizeof(header.magic)) == 0
+        && header.version == MODEL_FILE_VERSION
+        && (sourceSize < 0 || header.sourceSize == sourceSize)
+        && (sourceTime < 0 || header.sourceTime == sourceTime)
+        && header.dataOffset % ARRAY_ALIGNMENT == 0
+        && header.dataOffset >= sizeof(header) && header.dataOffset <= _size
+        && header.dataSize <= _size - header.dataOffset
+        && header.meshCount <= _size / sizeof(modelFileMesh)
+        && header.textureCount <= _size && header.nodeCount <= _size && header.animationCount <= _size;
+    if (!valid) {
+        unmap();
+        return false;
+    }
+    _importMicros = header.importMicros;
+
+    const unsigned char* pArrays = _pData + header.dataOffset;
+    modelFileReader reader(_pData + sizeof(header), header.dataOffset - sizeof(header));
+    aiScene* pScene = new aiScene();
+    pScene->mNumMeshes = header.meshCount;
+    pScene->mMeshes = new aiMesh*[header.meshCount]();
+    asset.modelMeshes.clear();
+    asset.modelMeshes.resize(header.meshCount);
+
+    for (uint32_t ii = 0; valid && ii < header.meshCount; ii++) {
+        modelFileMesh stored;
+        if (!reader.get(stored)) {
+            valid = false;
+            break;
+        }
+        // Arrays that are missing or run off the end leave their pointer NULL.
+        size_t vectorBytes = (size_t)stored.vertexCount * sizeof(aiVector3D);
+        struct {
+            uint64_t offset;
+            size_t bytes;
+            bool present;
+            void* pArray;
+        } arrays[] = {
+            { stored.positionOffset, vectorBytes, true, NULL },
+            { stored.normalOffset, vectorBytes, (stored.flags & MESH_HAS_NORMALS) != 0, NULL },
+            { stored.texcoordOffset, vectorBytes, (stored.flags & MESH_HAS_TEXCOORDS) != 0, NULL },
+            { stored.colorOffset, (size_t)stored.vertexCount * sizeof(aiColor4D), (stored.flags & MESH_HAS_COLORS) != 0, NULL },
+            { stored.indexOffset, (size_t)stored.indexCount * sizeof(uint32_t), true, NULL },
+        };
+        for (int aa = 0; aa < 5; aa++) {
+            if (!arrays[aa].present)
+                continue;
+            bool inside = arrays[aa].offset % ARRAY_ALIGNMENT == 0 && arrays[aa].offset <= header.dataSize
+                       && arrays[aa].bytes <= header.dataSize - arrays[aa].offset;
+            if (inside)
+                arrays[aa].pArray = (void*)(pArrays + arrays[aa].offset);
+            else
+                valid = false;
+        }
+
+        aiMesh* pMesh = new aiMesh();
+        pScene->mMeshes[ii] = pMesh;
+        pMesh->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+        pMesh->mNumVertices = stored.vertexCount;
+        pMesh->mVertices = (aiVector3D*)arrays[0].pArray;
+        pMesh->mNormals = (aiVector3D*)arrays[1].pArray;
+        pMesh->mTextureCoords[0] = (aiVector3D*)arrays[2].pArray;
+        if (pMesh->mTextureCoords[0])
+            pMesh->mNumUVComponents[0] = 2;
+        pMesh->mColors[0] = (aiColor4D*)arrays[3].pArray;
+        valid = valid && stored.indexCount % 3 == 0;
+        if (!valid)
+            break;
+
+        ofxAssimpMeshHelper& helper = asset.modelMeshes[ii];
+        helper.mesh = pMesh;
+        const uint32_t* pIndices = (const uint32_t*)arrays[4].pArray;
+        helper.indices.assign(pIndices, pIndices + stored.indexCount);
+        for (auto iter = helper.indices.begin(); valid && iter != helper.indices.end(); ++iter)
+            valid = *iter < stored.vertexCount;
+        helper.hasChanged = false;
+        helper.validCache = false;
+        helper.animatedPos.resize(stored.vertexCount);
+        if (pMesh->HasNormals())
+            helper.animatedNorm.resize(stored.vertexCount);
+        helper.material.setDiffuseColor(ofFloatColor(stored.diffuse[0], stored.diffuse[1], stored.diffuse[2], stored.diffuse[3]));
+        helper.material.setSpecularColor(ofFloatColor(stored.specular[0], stored.specular[1], stored.specular[2], stored.specular[3]));
+        helper.material.setAmbientColor(ofFloatColor(stored.ambient[0], stored.ambient[1], stored.ambient[2], stored.ambient[3]));
+        helper.material.setEmissiveColor(ofFloatColor(stored.emissive[0], stored.emissive[1], stored.emissive[2], stored.emissive[3]));
+        helper.material.setShininess(stored.shininess);
+        helper.blendMode = (ofBlendMode)stored.blendMode;
+        helper.twoSided = stored.twoSided != 0;
+
+        if (!stored.boneCount || !valid)
+            continue;
+        if (!reader.has((size_t)stored.boneCount * (sizeof(uint32_t) + 16 * sizeof(float) + sizeof(uint32_t)))) {
+            valid = false;
+            break;
+        }
+        pMesh->mNumBones = stored.boneCount;
+        pMesh->mBones = new aiBone*[stored.boneCount]();
+        for (uint32_t bb = 0; valid && bb < stored.boneCount; bb++) {
+            aiBone* pBone = new aiBone();
+            pMesh->mBones[bb] = pBone;
+            uint32_t weightCount;
+            valid = reader.getName(pBone->mName) && reader.getMatrix(pBone->mOffsetMatrix)
+                 && reader.get(weightCount) && reader.has((size_t)weightCount * sizeof(aiVertexWeight));
+            if (!valid)
+                break;
+            pBone->mNumWeights = weightCount;
+            pBone->mWeights = new aiVertexWeight[weightCount];
+            reader.getBytes(pBone->mWeights, weightCount * sizeof(aiVertexWeight));
+        }
+    }
+
+    string directory = ofFilePath::getEnclosingDirectory(asset._path, false);
+    asset._textureSources.clear();
+    for (uint32_t ii = 0; valid && ii < header.textureCount; ii++) {
+        radomeModelAsset::TextureSource source;
+        string relative;
+        uint32_t meshCount;
+        valid = reader.getString(relative) && reader.get(meshCount) && reader.has((size_t)meshCount * sizeof(uint32_t));
+        for (uint32_t mm = 0; valid && mm < meshCount; mm++) {
+            uint32_t mesh;
+            valid = reader.get(mesh) && mesh < header.meshCount;
+            source.meshes.push_back(mesh);
+        }
+        source.path = ofFilePath::join(directory, relative);
+        source.divisor = 1;
+        source.allocation = 0;
+        source.pImage = NULL;
+        source.texture = 0;
+        asset._textureSources.push_back(source);
+    }
+
+    valid = valid && readNodes(reader, header.nodeCount, header.meshCount, pScene->mRootNode);
+    if (valid && header.animationCount) {
+        pScene->mNumAnimations = header.animationCount;
+        pScene->mAnimations = new aiAnimation*[header.animationCount]();
+        for (uint32_t ii = 0; valid && ii < header.animationCount; ii++) {
+            pScene->mAnimations[ii] = new aiAnimation();
+            valid = readAnimation(reader, pScene->mAnimations[ii]);
+        }
+    }
+
+    if (!valid) {
+        ofLogWarning() << "ignoring damaged converted model " << path;
+        asset.modelMeshes.clear();
+        asset._textureSources.clear();
+        release(pScene);
+        unmap();
+        return false;
+    }
+
+    asset.scene = pScene;
+    asset.scene_center.x = header.center[0];
+    asset.scene_center.y = header.center[1];
+    asset.scene_center.z = header.center[2];
+    asset.normalizedScale = header.normalizedScale;
+    asset._importStats.drawCallsBefore = header.drawCallsBefore;
+    asset._importStats.drawCallsAfter = header.drawCallsAfter;
+    asset._importStats.verticesBefore = header.verticesBefore;
+    asset._importStats.verticesAfter = header.verticesAfter;
+    asset._importStats.acmrBefore = header.acmrBefore;
+    asset._importStats.acmrAfter = header.acmrAfter;
+    return true;
+}
+
+// The vertex arrays belong to the mapping, not to the meshes, so they're
+// detached before the scene deletes everything else.
+void radomeBinaryModel::release(const aiScene* pScene) {
+    if (!pScene)
+        return;
+    for (unsigned int ii = 0; ii < pScene->mNumMeshes; ii++) {
+        aiMesh* pMesh = pScene->mMeshes[ii];
+        if (!pMesh)
+            continue;
+        pMesh->mVertices = NULL;
+        pMesh->mNormals = NULL;
+        pMesh->mTextureCoords[0] = NULL;
+        pMesh->mColors[0] = NULL;
+    }
+    delete pScene;
+}
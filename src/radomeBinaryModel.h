@@ -0,0 +1,54 @@
+//
+//  radomeBinaryModel.h
+//  radome
+//
+//  Radome's own model format (.rdm): a model as it stands after import,
+//  welding, merging and cache ordering, so loading it is an mmap and some
+//  pointer fix-ups instead of an Assimp parse. Vertex arrays are stored in
+//  aiMesh's layout and used in place from the mapping, both by the meshes
+//  and by the VBO upload; the small tables (bones, node tree, animation keys)
+//  are copied out into Assimp structures so animation runs unchanged.
+//
+//  Imported models are converted into the cache directory automatically; a
+//  .rdm can also be opened directly, with its textures next to it.
+//
+
+#ifndef __radome__radomeBinaryModel__
+#define __radome__radomeBinaryModel__
+
+#include "ofMain.h"
+#include "aiScene.h"
+
+class radomeModelAsset;
+
+class radomeBinaryModel {
+public:
+    radomeBinaryModel();
+    ~radomeBinaryModel();
+
+    // Where the converted copy of a source model lives.
+    static string getCachePath(const string& sourcePath);
+
+    // Converts a freshly imported asset. importMicros is kept in the file,
+    // so loads from it can be compared against the Assimp path.
+    static bool write(const string& path, radomeModelAsset& asset, long long sourceSize, long long sourceTime,
+                      unsigned long long importMicros);
+
+    // Maps path and fills the asset in. A source size or time of -1 skips
+    // the staleness check (for .rdm files opened directly). The mapping has
+    // to outlive the asset's scene, which is given back through release().
+    bool read(const string& path, radomeModelAsset& asset, long long sourceSize, long long sourceTime);
+    void release(const aiScene* pScene);
+    bool isMapped() const { return _pData != NULL; }
+
+    unsigned long long getImportMicros() const { return _importMicros; }
+
+protected:
+    void unmap();
+
+    unsigned char* _pData;
+    size_t _size;
+    unsigned long long _importMicros;
+};
+
+#endif /* defined(__radome__radomeBinaryModel__) */
@@ -0,0 +1,162 @@
+//
+//  radomeBlockCompressor.cpp
+//  radome
+//
+
+#include "radomeBlockCompressor.h"
+
+#include <stdint.h>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#define BLOCK_SIZE 4
+#define COLOR_BLOCK_BYTES 8
+#define ALPHA_BLOCK_BYTES 8
+
+static int to565(const int rgb[3]) {
+    return (((rgb[0] * 31 + 127) / 255) << 11) | (((rgb[1] * 63 + 127) / 255) << 5) | ((rgb[2] * 31 + 127) / 255);
+}
+
+// Expanded the way the hardware does, by replicating the high bits.
+static void from565(int c, int rgb[3]) {
+    int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+size_t radomeBlockCompressor::getCompressedSize(int width, int height, bool alpha) {
+    size_t blocks = (size_t)((width + BLOCK_SIZE - 1) / BLOCK_SIZE) * ((height + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    return blocks * (alpha ? COLOR_BLOCK_BYTES + ALPHA_BLOCK_BYTES : COLOR_BLOCK_BYTES);
+}
+
+void radomeBlockCompressor::compress(const unsigned char* pixels, int width, int height, bool alpha, unsigned char* out) {
+    unsigned char block[BLOCK_SIZE * BLOCK_SIZE * 4];
+    for (int by = 0; by < height; by += BLOCK_SIZE) {
+        for (int bx = 0; bx < width; bx += BLOCK_SIZE) {
+            // Edge blocks repeat the last row and column.
+            for (int yy = 0; yy < BLOCK_SIZE; yy++) {
+                int y = std::min(by + yy, height - 1);
+                for (int xx = 0; xx < BLOCK_SIZE; xx++) {
+                    int x = std::min(bx + xx, width - 1);
+                    memcpy(&block[(yy * BLOCK_SIZE + xx) * 4], &pixels[((size_t)y * width + x) * 4], 4);
+                }
+            }
+            if (alpha) {
+                encodeAlpha(block, out);
+                out += ALPHA_BLOCK_BYTES;
+            }
+            encodeColor(block, out);
+            out += COLOR_BLOCK_BYTES;
+        }
+    }
+}
+
+void radomeBlockCompressor::encodeColor(const unsigned char* block, unsigned char* out) {
+    int low[3] = { 255, 255, 255 }, high[3] = { 0, 0, 0 }, mean[3] = { 0, 0, 0 };
+    for (int ii = 0; ii < 16; ii++) {
+        for (int cc = 0; cc < 3; cc++) {
+            int v = block[ii * 4 + cc];
+            low[cc] = std::min(low[cc], v);
+            high[cc] = std::max(high[cc], v);
+            mean[cc] += v;
+        }
+    }
+
+    // Pick the box diagonal the colors actually run along: channels that
+    // fall as the widest one rises get their ends swapped.
+    int axis = 0;
+    for (int cc = 1; cc < 3; cc++) {
+        if (high[cc] - low[cc] > high[axis] - low[axis])
+            axis = cc;
+    }
+    for (int cc = 0; cc < 3; cc++) {
+        if (cc == axis)
+            continue;
+        int covariance = 0;
+        for (int ii = 0; ii < 16; ii++)
+            covariance += (block[ii * 4 + axis] * 16 - mean[axis]) * (block[ii * 4 + cc] * 16 - mean[cc]);
+        if (covariance < 0)
+            std::swap(low[cc], high[cc]);
+    }
+    // Pulling the ends in by 1/16 of the range lowers the average error.
+    for (int cc = 0; cc < 3; cc++) {
+        int inset = (high[cc] - low[cc]) / 16;
+        high[cc] -= inset;
+        low[cc] += inset;
+    }
+
+    int c0 = to565(high), c1 = to565(low);
+    if (c0 < c1)
+        std::swap(c0, c1);
+
+    uint32_t bits = 0;
+    if (c0 != c1) {
+        // c0 > c1 selects four-color mode: two ends and two thirds between.
+        int palette[4][3];
+        from565(c0, palette[0]);
+        from565(c1, palette[1]);
+        for (int cc = 0; cc < 3; cc++) {
+            palette[2][cc] = (2 * palette[0][cc] + palette[1][cc]) / 3;
+            palette[3][cc] = (palette[0][cc] + 2 * palette[1][cc]) / 3;
+        }
+        for (int ii = 0; ii < 16; ii++) {
+            int best = 0, bestDistance = 0x7fffffff;
+            for (int pp = 0; pp < 4; pp++) {
+                int distance = 0;
+                for (int cc = 0; cc < 3; cc++) {
+                    int d = block[ii * 4 + cc] - palette[pp][cc];
+                    distance += d * d;
+                }
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    best = pp;
+                }
+            }
+            bits |= (uint32_t)best << (ii * 2);
+        }
+    }
+
+    out[0] = c0 & 0xff;
+    out[1] = c0 >> 8;
+    out[2] = c1 & 0xff;
+    out[3] = c1 >> 8;
+    for (int ii = 0; ii < 4; ii++)
+        out[4 + ii] = (bits >> (ii * 8)) & 0xff;
+}
+
+void radomeBlockCompressor::encodeAlpha(const unsigned char* block, unsigned char* out) {
+    int a0 = 0, a1 = 255;
+    for (int ii = 0; ii < 16; ii++) {
+        a0 = std::max(a0, (int)block[ii * 4 + 3]);
+        a1 = std::min(a1, (int)block[ii * 4 + 3]);
+    }
+
+    uint64_t bits = 0;
+    if (a0 != a1) {
+        // a0 > a1 selects eight-value mode: the ends and six steps between.
+        int palette[8];
+        palette[0] = a0;
+        palette[1] = a1;
+        for (int ii = 1; ii < 7; ii++)
+            palette[ii + 1] = ((7 - ii) * a0 + ii * a1) / 7;
+        for (int ii = 0; ii < 16; ii++) {
+            int a = block[ii * 4 + 3];
+            int best = 0, bestDistance = 256;
+            for (int pp = 0; pp < 8; pp++) {
+                int distance = abs(a - palette[pp]);
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    best = pp;
+                }
+            }
+            bits |= (uint64_t)best << (ii * 3);
+        }
+    }
+
+    out[0] = a0;
+    out[1] = a1;
+    for (int ii = 0; ii < 6; ii++)
+        out[2 + ii] = (bits >> (ii * 8)) & 0xff;
+}
@@ -0,0 +1,29 @@
+//
+//  radomeBlockCompressor.h
+//  radome
+//
+//  S3TC (DXT1 / DXT5, the BC1 / BC3 formats) encoding of RGBA8 images, run on
+//  the texture pipeline's worker threads. Endpoints are fitted to the color
+//  bounding box, which is quick and holds up well on model textures.
+//
+
+#ifndef __radome__radomeBlockCompressor__
+#define __radome__radomeBlockCompressor__
+
+#include <cstddef>
+
+class radomeBlockCompressor {
+public:
+    // Partial blocks at the right and bottom edges count as whole ones.
+    static size_t getCompressedSize(int width, int height, bool alpha);
+
+    // pixels is tightly packed RGBA8; out must hold getCompressedSize() bytes.
+    // Without alpha the result is DXT1 and the alpha channel is ignored.
+    static void compress(const unsigned char* pixels, int width, int height, bool alpha, unsigned char* out);
+
+protected:
+    static void encodeColor(const unsigned char* block, unsigned char* out);
+    static void encodeAlpha(const unsigned char* block, unsigned char* out);
+};
+
+#endif /* defined(__radome__radomeBlockCompressor__) */
@@ -0,0 +1,141 @@
+//
+//  radomeCachedCanvas.cpp
+//  radome
+//
+
+#include "radomeCachedCanvas.h"
+#include "ofxUI.h"
+
+radomeCachedCanvas::radomeCachedCanvas()
+: _pCanvas(NULL)
+, _fboAllocation(0)
+, _dirty(true)
+, _pHovered(NULL)
+, _pressed(false)
+, _wasVisible(false)
+, _renderCount(0)
+{
+}
+
+void radomeCachedCanvas::setCanvas(ofxUICanvas* pCanvas) {
+    _pCanvas = pCanvas;
+    allocate();
+}
+
+bool radomeCachedCanvas::isInside(int x, int y) const {
+    return _pCanvas && _pCanvas->isVisible() && _bounds.inside(x, y);
+}
+
+ofxUIWidget* radomeCachedCanvas::getWidgetAt(int x, int y) const {
+    if (!isInside(x, y))
+        return NULL;
+    vector<ofxUIWidget*> widgets = _pCanvas->getWidgets();
+    for (auto iter = widgets.begin(); iter != widgets.end(); ++iter) {
+        if ((*iter)->isVisible() && (*iter)->isHit(x, y))
+            return *iter;
+    }
+    return NULL;
+}
+
+void radomeCachedCanvas::allocate() {
+    if (!_pCanvas)
+        return;
+
+    ofxUIRectangle* pRect = _pCanvas->getRect();
+    _bounds.set(pRect->x, pRect->y, pRect->width, pRect->height);
+
+    int w = MAX(1, (int)ceil(_bounds.width));
+    int h = MAX(1, (int)ceil(_bounds.height));
+    if (!_fbo.isAllocated() || _fbo.getWidth() != w || _fbo.getHeight() != h) {
+        _fbo.allocate(w, h, GL_RGBA);
+
+        size_t bytes = radomeGpuMemory::estimateFramebufferBytes(w, h, GL_RGBA, false);
+        if (_fboAllocation)
+            radomeGpuMemory::get().resize(_fboAllocation, bytes);
+        else
+            _fboAllocation = radomeGpuMemory::get().track(this, "GUI", GpuFramebuffer, bytes);
+    }
+    _dirty = true;
+}
+
+void radomeCachedCanvas::windowResized(int w, int h) {
+    allocate();
+}
+
+// Widgets highlight under the cursor, so the canvas looks different only when
+// the cursor moves onto another widget, or off the one it was on; movement
+// within a widget or between them leaves the cache intact.
+void radomeCachedCanvas::mouseMoved(int x, int y) {
+    ofxUIWidget* pWidget = getWidgetAt(x, y);
+    if (pWidget != _pHovered)
+        _dirty = true;
+    _pHovered = pWidget;
+}
+
+void radomeCachedCanvas::mousePressed(int x, int y) {
+    _pressed = isInside(x, y);
+    if (_pressed)
+        _dirty = true;
+}
+
+// A drag that started on the canvas moves a slider or the like wherever the
+// cursor goes.
+void radomeCachedCanvas::mouseDragged(int x, int y) {
+    if (_pressed)
+        _dirty = true;
+    else
+        mouseMoved(x, y);
+}
+
+void radomeCachedCanvas::mouseReleased(int x, int y) {
+    // A release can end a drag that started inside and left the canvas.
+    if (_pressed || isInside(x, y))
+        _dirty = true;
+    _pressed = false;
+    _pHovered = getWidgetAt(x, y);
+}
+
+void radomeCachedCanvas::render() {
+    _fbo.begin();
+    ofClear(0, 0, 0, 0);
+    ofPushMatrix();
+    ofTranslate(-_bounds.x, -_bounds.y);
+    _pCanvas->draw();
+    ofPopMatrix();
+    _fbo.end();
+
+    _dirty = false;
+    _renderCount++;
+}
+
+void radomeCachedCanvas::draw() {
+    if (!_pCanvas)
+        return;
+
+    bool visible = _pCanvas->isVisible();
+    if (visible != _wasVisible) {
+        _wasVisible = visible;
+        _dirty = true;
+    }
+    if (!visible)
+        return;
+
+    ofxUIRectangle* pRect = _pCanvas->getRect();
+    if (pRect->x != _bounds.x || pRect->y != _bounds.y ||
+        pRect->width != _bounds.width || pRect->height != _bounds.height) {
+        allocate();
+    }
+
+    if (_dirty)
+        render();
+
+    // The canvas was blended over transparent black, so the FBO's colors are
+    // already multiplied by their alpha; blending them by it again would
+    // darken every translucent widget.
+    ofPushStyle();
+    ofEnableBlendMode(OF_BLENDMODE_ALPHA);
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    ofSetColor(255, 255, 255, 255);
+    _fbo.draw(_bounds.x, _bounds.y, _bounds.width, _bounds.height);
+    ofPopStyle();
+}
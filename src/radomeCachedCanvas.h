@@ -0,0 +1,57 @@
+//
+//  radomeCachedCanvas.h
+//  radome
+//
+//  Renders an ofxUICanvas into an FBO once and composites the cached result
+//  every frame; the FBO is only re-rendered after the canvas is invalidated.
+//
+
+#ifndef __radome__radomeCachedCanvas__
+#define __radome__radomeCachedCanvas__
+
+#include "ofMain.h"
+#include "radomeGpuMemory.h"
+
+class ofxUICanvas;
+class ofxUIWidget;
+
+class radomeCachedCanvas {
+public:
+    radomeCachedCanvas();
+
+    void setCanvas(ofxUICanvas* pCanvas);
+    ofxUICanvas* getCanvas() const { return _pCanvas; }
+
+    void invalidate() { _dirty = true; }
+    bool isDirty() const { return _dirty; }
+
+    // Input hooks; each one invalidates only if the canvas can have changed.
+    void windowResized(int w, int h);
+    void mouseMoved(int x, int y);
+    void mousePressed(int x, int y);
+    void mouseDragged(int x, int y);
+    void mouseReleased(int x, int y);
+
+    void draw();
+
+    unsigned int getRenderCount() const { return _renderCount; }
+
+protected:
+    bool isInside(int x, int y) const;
+    ofxUIWidget* getWidgetAt(int x, int y) const;
+    void allocate();
+    void render();
+
+    ofxUICanvas* _pCanvas;
+    ofFbo _fbo;
+    radomeGpuMemory::Handle _fboAllocation;
+    ofRectangle _bounds;
+
+    bool _dirty;
+    ofxUIWidget* _pHovered;
+    bool _pressed;          // a press that started on the canvas is still down
+    bool _wasVisible;
+    unsigned int _renderCount;
+};
+
+#endif /* defined(__radome__radomeCachedCanvas__) */
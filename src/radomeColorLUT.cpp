@@ -0,0 +1,181 @@
+//
+//  radomeColorLUT.cpp
+//  radome
+//
+
+#include "radomeColorLUT.h"
+
+#include <cctype>
+#include <fstream>
+#include <sstream>
+
+#define MAX_LUT_SIZE 256
+
+radomeColorLUT::radomeColorLUT()
+: _texture(0)
+, _size(0)
+, _domainMin(0, 0, 0)
+, _domainMax(1, 1, 1)
+, _allocation(0)
+{
+}
+
+radomeColorLUT::~radomeColorLUT() {
+    clear();
+}
+
+void radomeColorLUT::clear() {
+    if (_texture) {
+        glDeleteTextures(1, &_texture);
+        _texture = 0;
+    }
+    if (_allocation) {
+        radomeGpuMemory::get().release(_allocation);
+        _allocation = 0;
+    }
+    _size = 0;
+    _path.clear();
+}
+
+bool radomeColorLUT::parse(const string& path, vector<float>& values) {
+    std::ifstream file(ofToDataPath(path).c_str());
+    if (!file) {
+        ofLogError() << "couldn't open color LUT " << path;
+        return false;
+    }
+
+    int size = 0;
+    _domainMin.set(0, 0, 0);
+    _domainMax.set(1, 1, 1);
+    values.clear();
+
+    string line;
+    while (std::getline(file, line)) {
+        // Comments may be indented, or follow a value on the same line.
+        size_t comment = line.find('#');
+        if (comment != string::npos)
+            line.erase(comment);
+
+        std::istringstream stream(line);
+        string keyword;
+        stream >> keyword;
+        if (keyword.empty())
+            continue;
+
+        if (keyword == "TITLE") {
+            continue;
+        } else if (keyword == "LUT_3D_SIZE") {
+            stream >> size;
+            if (size < 2 || size > MAX_LUT_SIZE) {
+                ofLogError() << "color LUT " << path << " has unsupported size " << size;
+                return false;
+            }
+            values.reserve(size * size * size * 3);
+        } else if (keyword == "LUT_1D_SIZE") {
+            ofLogError() << "color LUT " << path << " is a 1D table; only 3D tables are supported";
+            return false;
+        } else if (keyword == "DOMAIN_MIN") {
+            stream >> _domainMin.x >> _domainMin.y >> _domainMin.z;
+        } else if (keyword == "DOMAIN_MAX") {
+            stream >> _domainMax.x >> _domainMax.y >> _domainMax.z;
+        } else if (keyword == "LUT_3D_INPUT_RANGE") {
+            // Resolve's form of the domain: one range for all three channels.
+            float low = 0, high = 1;
+            stream >> low >> high;
+            _domainMin.set(low, low, low);
+            _domainMax.set(high, high, high);
+        } else if (!isdigit((unsigned char)keyword[0]) && keyword[0] != '-' && keyword[0] != '+' && keyword[0] != '.') {
+            // Keywords this table doesn't use, e.g. LUT_1D_INPUT_RANGE.
+            continue;
+        } else {
+            // Data line: the keyword we read is the red component.
+            float r = atof(keyword.c_str());
+            float g = 0, b = 0;
+            if (!(stream >> g >> b)) {
+                ofLogError() << "color LUT " << path << " has a malformed line: " << line;
+                return false;
+            }
+            values.push_back(r);
+            values.push_back(g);
+            values.push_back(b);
+        }
+    }
+
+    if (!size || (int)values.size() != size * size * size * 3) {
+        ofLogError() << "color LUT " << path << " expected " << size * size * size
+                     << " entries, found " << values.size() / 3;
+        return false;
+    }
+    _size = size;
+    return true;
+}
+
+bool radomeColorLUT::load(const string& path) {
+    vector<float> values;
+    int previousSize = _size;
+    ofVec3f previousMin = _domainMin, previousMax = _domainMax;
+    if (!parse(path, values)) {
+        _size = previousSize;
+        _domainMin = previousMin;
+        _domainMax = previousMax;
+        return false;
+    }
+
+    if (!_texture)
+        glGenTextures(1, &_texture);
+
+    // .cube data runs red fastest, then green, then blue: exactly the order of
+    // a 3D texture's width, height and depth.
+    GLint internalFormat = GLEW_ARB_texture_float ? GL_RGB16F_ARB : GL_RGB8;
+    glBindTexture(GL_TEXTURE_3D, _texture);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage3D(GL_TEXTURE_3D, 0, internalFormat, _size, _size, _size, 0, GL_RGB, GL_FLOAT, &values[0]);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_3D, 0);
+
+    size_t bytes = _size * _size * _size * (GLEW_ARB_texture_float ? 6 : 3);
+    if (_allocation)
+        radomeGpuMemory::get().resize(_allocation, bytes);
+    else
+        _allocation = radomeGpuMemory::get().track(this, "color LUT", GpuOther, bytes);
+
+    _path = path;
+    ofLogNotice() << "loaded " << _size << "^3 color LUT " << path;
+    return true;
+}
+
+// Maps an input color in the table's domain to texel centers, so the first
+// and last entries are sampled exactly: coord = color * lutScale + lutOffset.
+void radomeColorLUT::bind(ofShader& shader, int textureUnit) {
+    shader.setUniform1i("colorLUT", textureUnit);
+    if (!_texture) {
+        shader.setUniform1f("lutEnabled", 0.0);
+        return;
+    }
+
+    ofVec3f range = _domainMax - _domainMin;
+    float texels = (_size - 1.0) / _size;
+    ofVec3f scale(texels / MAX(range.x, 1e-6), texels / MAX(range.y, 1e-6), texels / MAX(range.z, 1e-6));
+    ofVec3f offset = ofVec3f(0.5 / _size, 0.5 / _size, 0.5 / _size) - _domainMin * scale;
+
+    glActiveTexture(GL_TEXTURE0 + textureUnit);
+    glBindTexture(GL_TEXTURE_3D, _texture);
+    glActiveTexture(GL_TEXTURE0);
+
+    shader.setUniform1f("lutEnabled", 1.0);
+    shader.setUniform3f("lutScale", scale.x, scale.y, scale.z);
+    shader.setUniform3f("lutOffset", offset.x, offset.y, offset.z);
+}
+
+void radomeColorLUT::unbind(int textureUnit) {
+    if (!_texture)
+        return;
+    glActiveTexture(GL_TEXTURE0 + textureUnit);
+    glBindTexture(GL_TEXTURE_3D, 0);
+    glActiveTexture(GL_TEXTURE0);
+}
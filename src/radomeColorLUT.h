@@ -0,0 +1,45 @@
+//
+//  radomeColorLUT.h
+//  radome
+//
+//  3D color lookup table loaded from a .cube file and kept in a 3D texture,
+//  for matching projector color in the output pass.
+//
+
+#ifndef __radome__radomeColorLUT__
+#define __radome__radomeColorLUT__
+
+#include "ofMain.h"
+#include "radomeGpuMemory.h"
+
+class radomeColorLUT {
+public:
+    radomeColorLUT();
+    ~radomeColorLUT();
+
+    // Reads an Adobe/Resolve style .cube file (LUT_3D_SIZE, optional
+    // DOMAIN_MIN/DOMAIN_MAX). On failure any previously loaded table is kept.
+    bool load(const string& path);
+    void clear();
+
+    bool isLoaded() const { return _texture != 0; }
+    const string& getPath() const { return _path; }
+    int getSize() const { return _size; }
+
+    // Binds the table to the given texture unit and sets the uniforms
+    // radome.frag expects: colorLUT, lutEnabled, lutScale and lutOffset.
+    void bind(ofShader& shader, int textureUnit);
+    void unbind(int textureUnit);
+
+protected:
+    bool parse(const string& path, vector<float>& values);
+
+    GLuint _texture;
+    int _size;
+    string _path;
+    ofVec3f _domainMin;
+    ofVec3f _domainMax;
+    radomeGpuMemory::Handle _allocation;
+};
+
+#endif /* defined(__radome__radomeColorLUT__) */
@@ -0,0 +1,45 @@
+//
+//  radomeCommandQueue.cpp
+//  radome
+//
+
+#include "radomeCommandQueue.h"
+
+radomeCommandQueue::radomeCommandQueue(int capacity)
+: _head(0)
+, _tail(0)
+{
+    unsigned int size = 1;
+    while (size < (unsigned int)MAX(1, capacity))
+        size <<= 1;
+    _slots = new radomeCommand[size];
+    _mask = size - 1;
+}
+
+radomeCommandQueue::~radomeCommandQueue() {
+    delete [] _slots;
+}
+
+// The first barrier keeps the slot write after the read of _tail, so the
+// consumer is done with the slot; the second publishes the slot before _head.
+bool radomeCommandQueue::push(const radomeCommand& command) {
+    unsigned int head = _head;
+    if (head - _tail > _mask)
+        return false;
+    __sync_synchronize();
+    _slots[head & _mask] = command;
+    __sync_synchronize();
+    _head = head + 1;
+    return true;
+}
+
+bool radomeCommandQueue::pop(radomeCommand& command) {
+    unsigned int tail = _tail;
+    if (tail == _head)
+        return false;
+    __sync_synchronize();
+    command = _slots[tail & _mask];
+    __sync_synchronize();
+    _tail = tail + 1;
+    return true;
+}
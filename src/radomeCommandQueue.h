@@ -0,0 +1,47 @@
+//
+//  radomeCommandQueue.h
+//  radome
+//
+//  Fixed-size ring of commands from exactly one producer thread to exactly
+//  one consumer thread, without locks: each side only ever stores its own
+//  index, and a memory barrier orders the slot contents against the index
+//  that publishes them. Neither side waits for the other; a full queue
+//  refuses the command instead.
+//
+
+#ifndef __radome__radomeCommandQueue__
+#define __radome__radomeCommandQueue__
+
+#include "ofMain.h"
+
+// What a command means is up to whoever posts and executes it; the fields
+// cover everything the app sends.
+struct radomeCommand {
+    int type;
+    int index;      // projector, layer or mode the command applies to
+    float value;
+    ofVec3f vector;
+    ofMatrix4x4 matrix;
+    string path;
+};
+
+class radomeCommandQueue {
+public:
+    // Capacity is rounded up to a power of two.
+    radomeCommandQueue(int capacity = 1024);
+    ~radomeCommandQueue();
+
+    // Producer thread only. False when the queue is full.
+    bool push(const radomeCommand& command);
+    // Consumer thread only. False when the queue is empty.
+    bool pop(radomeCommand& command);
+
+protected:
+    radomeCommand* _slots;
+    unsigned int _mask;
+    // Free-running counts: the producer stores _head, the consumer _tail.
+    volatile unsigned int _head;
+    volatile unsigned int _tail;
+};
+
+#endif /* defined(__radome__radomeCommandQueue__) */
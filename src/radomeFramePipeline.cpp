@@ -0,0 +1,185 @@
+//
+//  radomeFramePipeline.cpp
+//  radome
+//
+
+#include "radomeFramePipeline.h"
+
+#define FENCE_TIMEOUT_NS 1000000000ULL
+
+radomeFramePipeline::radomeFramePipeline()
+: _mode(FenceNone)
+, _depth(1)
+, _next(0)
+{
+    for (int ii = 0; ii < MAX_FRAMES_IN_FLIGHT; ii++) {
+        _frames[ii].sync = 0;
+        _frames[ii].fence = 0;
+        _frames[ii].pending = false;
+        _frames[ii].inputMicros = 0;
+    }
+    resetStats();
+}
+
+radomeFramePipeline::~radomeFramePipeline() {
+    release();
+}
+
+const char* radomeFramePipeline::getModeName() const {
+    switch (_mode) {
+        case FenceSync: return "ARB_sync";
+        case FenceApple: return "APPLE_fence";
+        default: return "no fences";
+    }
+}
+
+void radomeFramePipeline::setup(int depth) {
+    release();
+    if (GLEW_ARB_sync)
+        _mode = FenceSync;
+    else if (GLEW_APPLE_fence)
+        _mode = FenceApple;
+    else
+        _mode = FenceNone;
+
+    if (_mode == FenceApple) {
+        for (int ii = 0; ii < MAX_FRAMES_IN_FLIGHT; ii++)
+            glGenFencesAPPLE(1, &_frames[ii].fence);
+    }
+    _depth = MAX(1, MIN(depth, MAX_FRAMES_IN_FLIGHT));
+    _next = 0;
+    resetStats();
+
+    if (_mode == FenceNone)
+        ofLogWarning() << "frame pipeline: no fences, frames in flight are up to the driver";
+    else
+        ofLogNotice() << "frame pipeline: up to " << _depth << " frames in flight, " << getModeName();
+}
+
+void radomeFramePipeline::release() {
+    for (int ii = 0; ii < MAX_FRAMES_IN_FLIGHT; ii++) {
+        if (_frames[ii].sync) {
+            glDeleteSync(_frames[ii].sync);
+            _frames[ii].sync = 0;
+        }
+        if (_frames[ii].fence) {
+            glDeleteFencesAPPLE(1, &_frames[ii].fence);
+            _frames[ii].fence = 0;
+        }
+        _frames[ii].pending = false;
+    }
+    _mode = FenceNone;
+}
+
+void radomeFramePipeline::setDepth(int depth) {
+    depth = MAX(1, MIN(depth, MAX_FRAMES_IN_FLIGHT));
+    if (depth == _depth)
+        return;
+    radomeFramePipelineStats stats = getStats();
+    if (stats.frames) {
+        ofLogNotice() << "frame pipeline, " << stats.depth << " in flight: "
+                      << ofToString(stats.framesPerSecond, 1) << " fps, "
+                      << ofToString(stats.latencyMicros / 1000, 1) << " ms input to GPU done, "
+                      << stats.stalls << " of " << stats.frames << " frames waited for the GPU, "
+                      << ofToString(stats.waitMicros / 1000, 2) << " ms per frame";
+    }
+    _depth = depth;
+    ofLogNotice() << "frame pipeline: up to " << _depth << " frames in flight";
+}
+
+// A frame is only known to be finished once its fence is seen, so latency
+// is measured to whichever of the next frame's checks first notices it.
+bool radomeFramePipeline::isFinished(Frame& frame, bool wait) {
+    if (_mode == FenceSync) {
+        GLenum result = glClientWaitSync(frame.sync, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? FENCE_TIMEOUT_NS : 0);
+        return wait || result != GL_TIMEOUT_EXPIRED;
+    }
+    if (wait) {
+        glFinishFenceAPPLE(frame.fence);
+        return true;
+    }
+    return glTestFenceAPPLE(frame.fence);
+}
+
+void radomeFramePipeline::retire(Frame& frame, unsigned long long now) {
+    if (frame.sync) {
+        glDeleteSync(frame.sync);
+        frame.sync = 0;
+    }
+    frame.pending = false;
+    _latencyMicros += now - frame.inputMicros;
+    _retired++;
+}
+
+unsigned long long radomeFramePipeline::beginFrame() {
+    if (_mode == FenceNone)
+        return 0;
+
+    // Oldest first: _next is the slot the oldest frame in the ring used.
+    unsigned long long now = ofGetElapsedTimeMicros();
+    int pending = 0;
+    for (int ii = 0; ii < MAX_FRAMES_IN_FLIGHT; ii++) {
+        Frame& frame = _frames[(_next + ii) % MAX_FRAMES_IN_FLIGHT];
+        if (frame.pending && isFinished(frame, false))
+            retire(frame, now);
+        if (frame.pending)
+            pending++;
+    }
+    if (pending < _depth)
+        return 0;
+
+    for (int ii = 0; ii < MAX_FRAMES_IN_FLIGHT && pending >= _depth; ii++) {
+        Frame& frame = _frames[(_next + ii) % MAX_FRAMES_IN_FLIGHT];
+        if (!frame.pending)
+            continue;
+        isFinished(frame, true);
+        retire(frame, ofGetElapsedTimeMicros());
+        pending--;
+    }
+    unsigned long long waited = ofGetElapsedTimeMicros() - now;
+    _stalls++;
+    _waitMicros += waited;
+    return waited;
+}
+
+void radomeFramePipeline::endFrame(unsigned long long inputMicros) {
+    _statsFrames++;
+    if (_mode == FenceNone)
+        return;
+
+    // beginFrame() leaves this slot free unless a fence was missed.
+    Frame& frame = _frames[_next];
+    if (frame.pending) {
+        isFinished(frame, true);
+        retire(frame, ofGetElapsedTimeMicros());
+    }
+    if (_mode == FenceSync)
+        frame.sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    else
+        glSetFenceAPPLE(frame.fence);
+    frame.pending = true;
+    frame.inputMicros = inputMicros;
+    _next = (_next + 1) % MAX_FRAMES_IN_FLIGHT;
+}
+
+radomeFramePipelineStats radomeFramePipeline::getStats() {
+    radomeFramePipelineStats stats;
+    double seconds = (ofGetElapsedTimeMicros() - _statsStart) / 1000000.0;
+    stats.depth = _depth;
+    stats.frames = _statsFrames;
+    stats.stalls = _stalls;
+    stats.waitMicros = _statsFrames ? (float)_waitMicros / _statsFrames : 0;
+    stats.latencyMicros = _retired ? (float)_latencyMicros / _retired : 0;
+    stats.framesPerSecond = seconds > 0 ? _statsFrames / seconds : 0;
+    resetStats();
+    return stats;
+}
+
+void radomeFramePipeline::resetStats() {
+    _statsFrames = 0;
+    _stalls = 0;
+    _waitMicros = 0;
+    _retired = 0;
+    _latencyMicros = 0;
+    _statsStart = ofGetElapsedTimeMicros();
+}
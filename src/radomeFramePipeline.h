@@ -0,0 +1,85 @@
+//
+//  radomeFramePipeline.h
+//  radome
+//
+//  Lets the CPU run ahead of the GPU by a bounded number of frames. Every
+//  frame ends with a fence; before the next one is submitted, the oldest
+//  fences are waited on until fewer than the pipeline's depth are still
+//  unfinished. A deeper pipeline keeps the GPU busier at the cost of showing
+//  older input, and the stats measure both sides of that trade.
+//
+
+#ifndef __radome__radomeFramePipeline__
+#define __radome__radomeFramePipeline__
+
+#include "ofMain.h"
+
+#define MAX_FRAMES_IN_FLIGHT 3
+
+enum radomeFenceMode {
+    FenceSync = 0,    // ARB_sync
+    FenceApple,       // APPLE_fence, for legacy contexts without ARB_sync
+    FenceNone,        // neither: frames in flight are up to the driver
+};
+
+struct radomeFramePipelineStats {
+    int depth;
+    unsigned int frames;
+    unsigned int stalls;      // frames that waited for the GPU before submitting
+    float waitMicros;         // mean time spent in those waits, over all frames
+    float latencyMicros;      // mean time from a frame's input to the GPU finishing it
+    float framesPerSecond;
+};
+
+class radomeFramePipeline {
+public:
+    radomeFramePipeline();
+    ~radomeFramePipeline();
+
+    // With the context the frames are submitted on current.
+    void setup(int depth);
+    void release();
+
+    // Takes effect from the next frame; the stats so far are logged first,
+    // so stepping through depths measures each one.
+    void setDepth(int depth);
+    int getDepth() const { return _depth; }
+    radomeFenceMode getMode() const { return _mode; }
+    const char* getModeName() const;
+
+    // Before the frame's first GL command: waits until fewer than depth
+    // frames are unfinished. Returns the microseconds waited.
+    unsigned long long beginFrame();
+    // After the frame's last GL command. inputMicros is when the state the
+    // frame shows was sampled (ofGetElapsedTimeMicros()).
+    void endFrame(unsigned long long inputMicros);
+
+    // Since the last call or depth change.
+    radomeFramePipelineStats getStats();
+
+protected:
+    struct Frame {
+        GLsync sync;
+        GLuint fence;
+        bool pending;
+        unsigned long long inputMicros;
+    };
+
+    bool isFinished(Frame& frame, bool wait);
+    void retire(Frame& frame, unsigned long long now);
+    void resetStats();
+
+    radomeFenceMode _mode;
+    int _depth;
+    Frame _frames[MAX_FRAMES_IN_FLIGHT];
+    int _next;
+
+    unsigned int _statsFrames;
+    unsigned int _stalls;
+    unsigned long long _waitMicros;
+    unsigned int _retired;
+    unsigned long long _latencyMicros;
+    unsigned long long _statsStart;
+};
+
+#endif /* defined(__radome__radomeFramePipeline__) */
@@ -0,0 +1,255 @@
+//
+//  radomeFrameScheduler.cpp
+//  radome
+//
+
+#include "radomeFrameScheduler.h"
+
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#ifdef __APPLE__
+#include <mach/mach_time.h>
+#endif
+
+// Frames aim to be done this long before their present.
+#define PRESENT_MARGIN_SECONDS 0.002
+// Presents further apart than this many usual intervals don't count towards
+// the cadence, and once none has come for PRESENT_STALE_INTERVALS, frames
+// are paced by the frame rate alone.
+#define LONG_PRESENT_FACTOR 1.5
+#define PRESENT_STALE_INTERVALS 4
+// A frame owing more steps than this skips the rest of the time instead of
+// simulating it all at once.
+#define MAX_STEPS_PER_FRAME 8
+// The last stretch of a wait is spent yielding, since sleeps overshoot.
+#define SPIN_SECONDS 0.0005
+#define HITCH_LOG_INTERVAL 1.0
+
+static const char* phaseNames[PhaseCount] = { "waking up", "simulation", "GPU wait", "rendering" };
+
+radomeFrameScheduler::radomeFrameScheduler()
+: _origin(getNanos())
+, _frameInterval(1.0 / 60)
+, _stepSeconds(1.0 / 60)
+, _lastPresent(0)
+, _presentInterval(0)
+, _planned(false)
+, _plannedStart(0)
+, _plannedSkip(0)
+, _currentSkip(0)
+, _simulationTime(0)
+, _frameStart(0)
+, _renderSeconds(0)
+, _lastHitchLog(0)
+, _unloggedHitches(0)
+, _statsSteps(0)
+{
+    memset(&_plan, 0, sizeof(_plan));
+    memset(&_current, 0, sizeof(_current));
+    memset(_phases, 0, sizeof(_phases));
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+// mach_absolute_time() ticks are only nanoseconds on some machines; the
+// split conversion avoids overflowing on the others.
+unsigned long long radomeFrameScheduler::getNanos() {
+#ifdef __APPLE__
+    static mach_timebase_info_data_t timebase;
+    if (!timebase.denom)
+        mach_timebase_info(&timebase);
+    unsigned long long ticks = mach_absolute_time();
+    return ticks / timebase.denom * timebase.numer + ticks % timebase.denom * timebase.numer / timebase.denom;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec;
+#endif
+}
+
+void radomeFrameScheduler::setup(float frameRate, float stepRate) {
+    _origin = getNanos();
+    _frameInterval = 1.0 / MAX(1.0f, frameRate);
+    _stepSeconds = 1.0 / MAX(1.0f, stepRate);
+    _renderSeconds = _frameInterval * 0.5;
+    _simulationTime = 0;
+    _plannedStart = 0;
+    _planned = false;
+    _presentMutex.lock();
+    _lastPresent = 0;
+    _presentInterval = 0;
+    _presentMutex.unlock();
+}
+
+double radomeFrameScheduler::getTime() const {
+    return (getNanos() - _origin) / 1000000000.0;
+}
+
+void radomeFrameScheduler::presented() {
+    double now = getTime();
+    bool longPresent = false;
+    double interval = 0;
+    double usual = 0;
+    _presentMutex.lock();
+    if (_lastPresent > 0) {
+        interval = now - _lastPresent;
+        usual = _presentInterval;
+        if (usual > 0 && interval > usual * LONG_PRESENT_FACTOR)
+            longPresent = true;
+        else
+            _presentInterval = usual > 0 ? usual * 0.9 + interval * 0.1 : interval;
+    }
+    _lastPresent = now;
+    _presentMutex.unlock();
+
+    if (longPresent) {
+        _statsMutex.lock();
+        _stats.longPresents++;
+        _statsMutex.unlock();
+        reportHitch(ofToString(interval * 1000, 1) + " ms between presents, usually " +
+                    ofToString(usual * 1000, 1) + " ms", "the presenting thread stalled");
+    }
+}
+
+// The next frame starts no sooner than a frame interval after this one did,
+// then waits for the latest start that still makes the present after it.
+radomeFrameTime radomeFrameScheduler::planFrame() {
+    double now = getTime();
+    double earliest = MAX(now, _plannedStart + _frameInterval);
+    double done = earliest + _renderSeconds + PRESENT_MARGIN_SECONDS;
+
+    _presentMutex.lock();
+    double lastPresent = _lastPresent;
+    double presentInterval = _presentInterval;
+    _presentMutex.unlock();
+
+    double start = earliest;
+    double present = earliest + _frameInterval;
+    if (presentInterval > 0 && now - lastPresent < presentInterval * PRESENT_STALE_INTERVALS) {
+        present = lastPresent + ceil((done - lastPresent) / presentInterval) * presentInterval;
+        start = MAX(earliest, present - _renderSeconds - PRESENT_MARGIN_SECONDS);
+    }
+
+    radomeFrameTime time;
+    time.presentTime = present;
+    time.stepSeconds = _stepSeconds;
+    time.steps = 0;
+    while (_simulationTime + _stepSeconds <= present && time.steps < MAX_STEPS_PER_FRAME) {
+        _simulationTime += _stepSeconds;
+        time.steps++;
+    }
+    double skipped = 0;
+    if (_simulationTime + _stepSeconds <= present) {
+        skipped = present - _simulationTime - fmod(present - _simulationTime, _stepSeconds);
+        _simulationTime += skipped;
+    }
+    time.alpha = ofClamp((present - _simulationTime) / _stepSeconds, 0, 1);
+
+    _plan = time;
+    _plannedStart = start;
+    _plannedSkip = skipped;
+    _planned = true;
+    return time;
+}
+
+void radomeFrameScheduler::waitForFrame() {
+    if (!_planned)
+        planFrame();
+    _planned = false;
+
+    double wait = _plannedStart - getTime();
+    if (wait > SPIN_SECONDS)
+        usleep((wait - SPIN_SECONDS) * 1000000);
+    while (getTime() < _plannedStart)
+        sched_yield();
+
+    _frameStart = getTime();
+    _current = _plan;
+    _currentSkip = _plannedSkip;
+    memset(_phases, 0, sizeof(_phases));
+    _phases[PhaseWake] = _frameStart - _plannedStart;
+}
+
+void radomeFrameScheduler::notePhase(radomeFramePhase phase, double seconds) {
+    _phases[phase] += seconds;
+}
+
+void radomeFrameScheduler::endFrame() {
+    double now = getTime();
+    double duration = now - _frameStart;
+    _phases[PhaseRender] = MAX(0.0, duration - _phases[PhaseSimulation] - _phases[PhaseGpuWait]);
+    // Leans towards the slow frames, which are the ones that miss.
+    if (duration > _renderSeconds)
+        _renderSeconds = _renderSeconds * 0.5 + duration * 0.5;
+    else
+        _renderSeconds = _renderSeconds * 0.95 + duration * 0.05;
+
+    bool late = now > _current.presentTime;
+    _statsMutex.lock();
+    _stats.frames++;
+    _statsSteps += _current.steps;
+    if (_currentSkip > 0)
+        _stats.catchUps++;
+    _statsMutex.unlock();
+
+    // Skipped simulation time isn't a phase of this frame: the frames before
+    // it ran long, or none started for a while.
+    if (_currentSkip > 0) {
+        reportHitch("simulation skipped " + ofToString(_currentSkip * 1000, 1) + " ms",
+                    "more than " + ofToString(MAX_STEPS_PER_FRAME) + " steps were due");
+    }
+    if (!late)
+        return;
+
+    int cause = 0;
+    for (int ii = 1; ii < PhaseCount; ii++) {
+        if (_phases[ii] > _phases[cause])
+            cause = ii;
+    }
+    _statsMutex.lock();
+    _stats.lateFrames++;
+    _stats.hitchCauses[cause]++;
+    _statsMutex.unlock();
+
+    reportHitch("frame done " + ofToString((now - _current.presentTime) * 1000, 1) + " ms past its present",
+                string(getPhaseName(cause)) + " took " + ofToString(_phases[cause] * 1000, 1) + " ms");
+}
+
+// Throttled, since one stall tends to make several in a row.
+void radomeFrameScheduler::reportHitch(const string& what, const string& because) {
+    double now = getTime();
+    _statsMutex.lock();
+    if (now - _lastHitchLog < HITCH_LOG_INTERVAL) {
+        _unloggedHitches++;
+        _statsMutex.unlock();
+        return;
+    }
+    unsigned int unlogged = _unloggedHitches;
+    _unloggedHitches = 0;
+    _lastHitchLog = now;
+    _statsMutex.unlock();
+
+    ofLogWarning() << "hitch: " << what << "; " << because
+                   << (unlogged ? " (" + ofToString(unlogged) + " more since the last report)" : string());
+}
+
+const char* radomeFrameScheduler::getPhaseName(int phase) {
+    return phase >= 0 && phase < PhaseCount ? phaseNames[phase] : "";
+}
+
+radomeFrameSchedulerStats radomeFrameScheduler::getStats() {
+    _presentMutex.lock();
+    float presentInterval = _presentInterval;
+    _presentMutex.unlock();
+
+    _statsMutex.lock();
+    radomeFrameSchedulerStats stats = _stats;
+    stats.stepsPerFrame = _stats.frames ? (float)_statsSteps / _stats.frames : 0;
+    memset(&_stats, 0, sizeof(_stats));
+    _statsSteps = 0;
+    _statsMutex.unlock();
+
+    stats.presentInterval = presentInterval;
+    stats.renderSeconds = _renderSeconds;
+    return stats;
+}
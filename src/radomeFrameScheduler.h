@@ -0,0 +1,113 @@
+//
+//  radomeFrameScheduler.h
+//  radome
+//
+//  Decides when the render thread starts each frame and what time the frame
+//  shows. Time comes from a monotonic nanosecond clock, and a frame is
+//  simulated for the moment it is expected on screen: the first present,
+//  going by the cadence the windows are actually presented at, after the
+//  frame is likely to be done. Its start is pushed back to just before that
+//  deadline, so the picture is as fresh as it can be when it goes out.
+//
+//  Simulation advances in fixed steps towards that moment; the fraction of a
+//  step left over is returned for interpolation, so motion doesn't depend on
+//  how frame starts happen to fall.
+//
+//  A frame that finishes past its present, or a gap between presents well
+//  over the usual one, is a hitch; each is logged with the phase that took
+//  longest, which is most likely what caused it. A frame that had to skip
+//  simulation time is counted and logged on its own.
+//
+
+#ifndef __radome__radomeFrameScheduler__
+#define __radome__radomeFrameScheduler__
+
+#include "ofMain.h"
+
+// Parts of a frame that can make it late, besides the frame as a whole.
+enum radomeFramePhase {
+    PhaseWake = 0,      // how late the thread woke for the frame's start
+    PhaseSimulation,    // waiting for the frame's simulation to finish
+    PhaseGpuWait,       // waiting for the GPU before submitting
+    PhaseRender,        // everything else the frame did
+    PhaseCount,
+};
+
+// What one frame should show.
+struct radomeFrameTime {
+    double presentTime;     // seconds on the scheduler clock
+    int steps;              // fixed steps to advance the simulation by
+    float alpha;            // 0..1: how far from the step before the last towards the last
+    double stepSeconds;
+};
+
+struct radomeFrameSchedulerStats {
+    unsigned int frames;
+    unsigned int lateFrames;
+    unsigned int longPresents;      // present gaps over 1.5 of the usual
+    unsigned int catchUps;          // frames that skipped simulation time, too many steps being due
+    unsigned int hitchCauses[PhaseCount];
+    float presentInterval;          // seconds, as measured
+    float renderSeconds;            // expected length of a frame
+    float stepsPerFrame;
+};
+
+class radomeFrameScheduler {
+public:
+    radomeFrameScheduler();
+
+    // Monotonic, in nanoseconds from an arbitrary origin.
+    static unsigned long long getNanos();
+
+    // frameRate caps how often frames start; stepRate is the simulation's.
+    void setup(float frameRate, float stepRate);
+    // Seconds since setup().
+    double getTime() const;
+
+    // Whichever thread presented the output windows, right after it did.
+    void presented();
+
+    // Render thread. Plans the next frame: when it starts and the simulation
+    // it shows. Called while simulating ahead; waitForFrame() plans one
+    // itself when nobody has.
+    radomeFrameTime planFrame();
+    // Sleeps until the planned frame's start.
+    void waitForFrame();
+    // Time spent in a phase of the current frame, for hitch reports.
+    void notePhase(radomeFramePhase phase, double seconds);
+    void endFrame();
+
+    // Any thread; resets the counts.
+    radomeFrameSchedulerStats getStats();
+    static const char* getPhaseName(int phase);
+
+protected:
+    void reportHitch(const string& what, const string& because);
+
+    unsigned long long _origin;
+    double _frameInterval;
+    double _stepSeconds;
+
+    ofMutex _presentMutex;
+    double _lastPresent;          // guarded by _presentMutex, like the present stats
+    double _presentInterval;
+
+    bool _planned;
+    double _plannedStart;
+    double _plannedSkip;          // simulation time the planned frame skips
+    radomeFrameTime _plan;        // the frame planned next
+    radomeFrameTime _current;     // the frame being rendered
+    double _currentSkip;
+    double _simulationTime;       // time of the last step
+    double _frameStart;
+    double _renderSeconds;        // running estimate of a frame's length
+    double _phases[PhaseCount];
+    double _lastHitchLog;
+    unsigned int _unloggedHitches;
+
+    ofMutex _statsMutex;
+    radomeFrameSchedulerStats _stats;
+    unsigned int _statsSteps;
+};
+
+#endif /* defined(__radome__radomeFrameScheduler__) */
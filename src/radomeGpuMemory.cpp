@@ -0,0 +1,243 @@
+//
+//  radomeGpuMemory.cpp
+//  radome
+//
+
+#include "radomeGpuMemory.h"
+
+#define DEFAULT_BUDGET_MB 512
+#define DEFAULT_IDLE_FRAMES 90
+#define MB (1024.0*1024.0)
+
+radomeGpuMemory& radomeGpuMemory::get() {
+    static radomeGpuMemory instance;
+    return instance;
+}
+
+radomeGpuMemory::radomeGpuMemory()
+: _nextHandle(1)
+, _budget(DEFAULT_BUDGET_MB * 1024 * 1024)
+, _usage(0)
+, _idleFrames(DEFAULT_IDLE_FRAMES)
+, _frame(0)
+, _overBudgetWarned(false)
+{
+    for (int ii = 0; ii < GpuKindCount; ii++)
+        _usageByKind[ii] = 0;
+}
+
+radomeGpuMemory::Handle radomeGpuMemory::track(const void* owner, const string& ownerName, radomeGpuAllocationKind kind, size_t bytes) {
+    Allocation a;
+    a.owner = owner;
+    a.ownerName = ownerName;
+    a.kind = kind;
+    a.bytes = bytes;
+
+    ofScopedLock lock(_mutex);
+    Handle h = _nextHandle++;
+    _allocations[h] = a;
+    _usage += bytes;
+    _usageByKind[kind] += bytes;
+
+    if (_usage > _budget && !_overBudgetWarned) {
+        ofLogWarning() << "GPU memory over budget after " << getKindName(kind) << " allocation for "
+                       << ownerName << ": " << ofToString(_usage / MB, 1) << "MB of "
+                       << ofToString(_budget / MB, 1) << "MB";
+        _overBudgetWarned = true;
+    }
+    return h;
+}
+
+void radomeGpuMemory::resize(Handle handle, size_t bytes) {
+    ofScopedLock lock(_mutex);
+    auto iter = _allocations.find(handle);
+    if (iter == _allocations.end())
+        return;
+    Allocation& a = iter->second;
+    _usage = _usage - a.bytes + bytes;
+    _usageByKind[a.kind] = _usageByKind[a.kind] - a.bytes + bytes;
+    a.bytes = bytes;
+}
+
+void radomeGpuMemory::release(Handle handle) {
+    ofScopedLock lock(_mutex);
+    auto iter = _allocations.find(handle);
+    if (iter == _allocations.end())
+        return;
+    _usage -= iter->second.bytes;
+    _usageByKind[iter->second.kind] -= iter->second.bytes;
+    _allocations.erase(iter);
+}
+
+void radomeGpuMemory::releaseOwner(const void* owner) {
+    ofScopedLock lock(_mutex);
+    auto iter = _allocations.begin();
+    while (iter != _allocations.end()) {
+        if (iter->second.owner == owner) {
+            _usage -= iter->second.bytes;
+            _usageByKind[iter->second.kind] -= iter->second.bytes;
+            _allocations.erase(iter++);
+        } else {
+            ++iter;
+        }
+    }
+}
+
+size_t radomeGpuMemory::getUsage() const {
+    ofScopedLock lock(_mutex);
+    return _usage;
+}
+
+size_t radomeGpuMemory::getUsage(radomeGpuAllocationKind kind) const {
+    ofScopedLock lock(_mutex);
+    return _usageByKind[kind];
+}
+
+size_t radomeGpuMemory::getUsage(const void* owner) const {
+    ofScopedLock lock(_mutex);
+    size_t total = 0;
+    for (auto iter = _allocations.begin(); iter != _allocations.end(); ++iter) {
+        if (iter->second.owner == owner)
+            total += iter->second.bytes;
+    }
+    return total;
+}
+
+size_t radomeGpuMemory::getSize(Handle handle) const {
+    ofScopedLock lock(_mutex);
+    auto iter = _allocations.find(handle);
+    return iter == _allocations.end() ? 0 : iter->second.bytes;
+}
+
+bool radomeGpuMemory::canAllocate(size_t bytes) const {
+    ofScopedLock lock(_mutex);
+    return _usage + bytes <= _budget;
+}
+
+size_t radomeGpuMemory::getOverage() const {
+    ofScopedLock lock(_mutex);
+    return _usage > _budget ? _usage - _budget : 0;
+}
+
+void radomeGpuMemory::registerClient(radomeGpuMemoryClient* pClient) {
+    ofScopedLock lock(_mutex);
+    if (std::find(_clients.begin(), _clients.end(), pClient) == _clients.end())
+        _clients.push_back(pClient);
+}
+
+void radomeGpuMemory::unregisterClient(radomeGpuMemoryClient* pClient) {
+    ofScopedLock lock(_mutex);
+    auto iter = std::find(_clients.begin(), _clients.end(), pClient);
+    if (iter != _clients.end())
+        _clients.erase(iter);
+}
+
+static bool compareLastUsed(radomeGpuMemoryClient* a, radomeGpuMemoryClient* b) {
+    return a->getLastUsedFrame() < b->getLastUsedFrame();
+}
+
+// Clients evict by resizing and releasing allocations, so the lock is only
+// held to copy the client list; clients come and go on this thread only.
+void radomeGpuMemory::enforceBudget() {
+    _mutex.lock();
+    bool over = _usage > _budget;
+    if (!over)
+        _overBudgetWarned = false;
+    vector<radomeGpuMemoryClient*> clients;
+    if (over)
+        clients = _clients;
+    _mutex.unlock();
+    if (!over)
+        return;
+
+    unsigned long long frame = _frame;
+    std::sort(clients.begin(), clients.end(), compareLastUsed);
+    size_t idleReleased = 0;
+    size_t usedReleased = 0;
+    for (auto iter = clients.begin(); iter != clients.end(); ++iter) {
+        size_t overage = getOverage();
+        if (!overage)
+            break;
+        size_t released = (*iter)->evictGpuMemory(overage);
+        if ((*iter)->getLastUsedFrame() + _idleFrames < frame)
+            idleReleased += released;
+        else
+            usedReleased += released;
+    }
+    if (idleReleased)
+        ofLogNotice() << "evicted " << ofToString(idleReleased / MB, 1) << "MB of idle GPU memory";
+    if (usedReleased)
+        ofLogNotice() << "evicted " << ofToString(usedReleased / MB, 1) << "MB of GPU memory still in use";
+
+    ofScopedLock lock(_mutex);
+    if (_usage > _budget && !_overBudgetWarned) {
+        ofLogWarning() << "GPU memory still over budget with nothing left to evict: "
+                       << ofToString(_usage / MB, 1) << "MB of " << ofToString(_budget / MB, 1) << "MB";
+        _overBudgetWarned = true;
+    }
+}
+
+string radomeGpuMemory::getReport() const {
+    ofScopedLock lock(_mutex);
+    std::ostringstream out;
+    out << "GPU memory " << ofToString(_usage / MB, 1) << "MB / " << ofToString(_budget / MB, 1) << "MB budget\n";
+    for (int ii = 0; ii < GpuKindCount; ii++) {
+        if (_usageByKind[ii])
+            out << "  " << getKindName((radomeGpuAllocationKind)ii) << ": " << ofToString(_usageByKind[ii] / MB, 2) << "MB\n";
+    }
+
+    map<string, size_t> byOwner;
+    for (auto iter = _allocations.begin(); iter != _allocations.end(); ++iter) {
+        byOwner[iter->second.ownerName] += iter->second.bytes;
+    }
+    for (auto iter = byOwner.begin(); iter != byOwner.end(); ++iter) {
+        out << "  " << iter->first << ": " << ofToString(iter->second / MB, 2) << "MB\n";
+    }
+    return out.str();
+}
+
+const char* radomeGpuMemory::getKindName(radomeGpuAllocationKind kind) {
+    switch (kind) {
+        case GpuCubeMap: return "cube map";
+        case GpuFramebuffer: return "framebuffer";
+        case GpuModelTexture: return "model texture";
+        case GpuModelGeometry: return "model geometry";
+        case GpuVideoTexture: return "video texture";
+        default: return "other";
+    }
+}
+
+// Drivers pad 3-channel formats to 4 bytes per texel, so RGB counts as RGBA.
+size_t radomeGpuMemory::estimateTextureBytes(int w, int h, int glInternalFormat, bool mipmapped) {
+    size_t bpp;
+    switch (glInternalFormat) {
+        case GL_LUMINANCE:
+        case GL_LUMINANCE8:
+        case GL_ALPHA:
+            bpp = 1;
+            break;
+        case GL_LUMINANCE_ALPHA:
+            bpp = 2;
+            break;
+        case GL_RGBA16F_ARB:
+        case GL_RGB16F_ARB:
+            bpp = 8;
+            break;
+        case GL_RGBA32F_ARB:
+        case GL_RGB32F_ARB:
+            bpp = 16;
+            break;
+        default:
+            bpp = 4;
+            break;
+    }
+    size_t bytes = (size_t)w * h * bpp;
+    return mipmapped ? bytes * 4 / 3 : bytes;
+}
+
+size_t radomeGpuMemory::estimateFramebufferBytes(int w, int h, int glInternalFormat, bool depth, int faces) {
+    size_t bytes = estimateTextureBytes(w, h, glInternalFormat) * faces;
+    if (depth)
+        bytes += (size_t)w * h * 4;
+    return bytes;
+}
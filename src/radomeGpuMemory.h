@@ -0,0 +1,113 @@
+//
+//  radomeGpuMemory.h
+//  radome
+//
+//  Central accounting of GPU allocations. Every texture, framebuffer and buffer
+//  radome creates is recorded here by owner and kind, usage is checked against a
+//  configurable budget, and owners that haven't been used recently are asked to
+//  give memory back when the budget is exceeded.
+//
+//  Allocations may be tracked from any thread. Clients are asked to evict,
+//  and must register and unregister, on the render thread.
+//
+
+#ifndef __radome__radomeGpuMemory__
+#define __radome__radomeGpuMemory__
+
+#include "ofMain.h"
+
+#include <map>
+using std::map;
+
+enum radomeGpuAllocationKind {
+    GpuCubeMap = 0,
+    GpuFramebuffer,
+    GpuModelTexture,
+    GpuModelGeometry,
+    GpuVideoTexture,
+    GpuOther,
+    GpuKindCount,
+};
+
+// Implemented by owners that can release or shrink their allocations on request.
+class radomeGpuMemoryClient {
+public:
+    virtual ~radomeGpuMemoryClient() {}
+
+    // Free up to bytesWanted (more is fine); returns the number of bytes released.
+    virtual size_t evictGpuMemory(size_t bytesWanted) = 0;
+    // The last frame the client's memory was needed at full quality; drawing
+    // something too small to show its detail doesn't count.
+    virtual unsigned long long getLastUsedFrame() const = 0;
+};
+
+class radomeGpuMemory {
+public:
+    static radomeGpuMemory& get();
+
+    typedef unsigned int Handle;
+
+    Handle track(const void* owner, const string& ownerName, radomeGpuAllocationKind kind, size_t bytes);
+    void resize(Handle handle, size_t bytes);
+    void release(Handle handle);
+    void releaseOwner(const void* owner);
+
+    void registerClient(radomeGpuMemoryClient* pClient);
+    void unregisterClient(radomeGpuMemoryClient* pClient);
+
+    void setBudget(size_t bytes) { _budget = bytes; }
+    size_t getBudget() const { return _budget; }
+
+    // Frames a client has to go unused before it is asked to evict.
+    void setIdleFrames(unsigned int frames) { _idleFrames = frames; }
+
+    // The render thread's frame count, which clients stamp their use with.
+    // ofGetFrameNum() counts the UI loop, which runs on while the render
+    // thread stalls and stops while it doesn't. Render thread only.
+    void beginFrame() { _frame++; }
+    unsigned long long getFrame() const { return _frame; }
+
+    size_t getUsage() const;
+    size_t getUsage(radomeGpuAllocationKind kind) const;
+    size_t getUsage(const void* owner) const;
+    size_t getSize(Handle handle) const;
+    bool canAllocate(size_t bytes) const;
+
+    // Evicts, least recently used first, until usage is back under budget:
+    // idle clients go first, and clients still in use only when that isn't
+    // enough. Call once per frame on the render thread, after beginFrame().
+    void enforceBudget();
+
+    string getReport() const;
+
+    static const char* getKindName(radomeGpuAllocationKind kind);
+    static size_t estimateTextureBytes(int w, int h, int glInternalFormat, bool mipmapped = false);
+    static size_t estimateFramebufferBytes(int w, int h, int glInternalFormat, bool depth, int faces = 1);
+
+protected:
+    radomeGpuMemory();
+
+    struct Allocation {
+        const void* owner;
+        string ownerName;
+        radomeGpuAllocationKind kind;
+        size_t bytes;
+    };
+
+    size_t getOverage() const;
+
+    // Guards everything below; never held while a client evicts.
+    mutable ofMutex _mutex;
+    map<Handle, Allocation> _allocations;
+    vector<radomeGpuMemoryClient*> _clients;
+    Handle _nextHandle;
+
+    size_t _budget;
+    size_t _usage;
+    size_t _usageByKind[GpuKindCount];
+    unsigned int _idleFrames;
+    unsigned long long _frame;
+    bool _overBudgetWarned;
+};
+
+#endif /* defined(__radome__radomeGpuMemory__) */
@@ -0,0 +1,30 @@
+//
+//  radomeImageSource.cpp
+//  radome
+//
+
+#include "radomeImageSource.h"
+
+radomeImageSource::radomeImageSource()
+: _newFrame(false)
+{
+}
+
+bool radomeImageSource::load(const string& path) {
+    if (!_image.loadImage(path)) {
+        ofLogError() << "couldn't load image " << path;
+        return false;
+    }
+    _newFrame = true;
+    return true;
+}
+
+bool radomeImageSource::update() {
+    bool result = _newFrame;
+    _newFrame = false;
+    return result;
+}
+
+void radomeImageSource::drawFrame(float x, float y, float w, float h) {
+    _image.draw(x, y, w, h);
+}
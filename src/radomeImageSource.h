@@ -0,0 +1,30 @@
+//
+//  radomeImageSource.h
+//  radome
+//
+//  Still image as a video source; it produces a single frame.
+//
+
+#ifndef __radome__radomeImageSource__
+#define __radome__radomeImageSource__
+
+#include "radomeVideoSource.h"
+
+class radomeImageSource : public radomeVideoSource {
+public:
+    radomeImageSource();
+
+    bool load(const string& path);
+
+    bool update();
+    bool isReady() { return _image.isAllocated(); }
+    float getWidth() { return _image.getWidth(); }
+    float getHeight() { return _image.getHeight(); }
+    void drawFrame(float x, float y, float w, float h);
+
+protected:
+    ofImage _image;
+    bool _newFrame;
+};
+
+#endif /* defined(__radome__radomeImageSource__) */
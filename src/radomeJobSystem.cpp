@@ -0,0 +1,323 @@
+//
+//  radomeJobSystem.cpp
+//  radome
+//
+
+#include "radomeJobSystem.h"
+
+#include <unistd.h>
+
+// Workers go back to sleep after this long without work; submissions wake
+// one up sooner.
+#define IDLE_WAIT_MS 5
+
+struct radomeJob {
+    radomeJobFunction function;
+    void* pData;
+    int begin;
+    int end;
+    radomeJobGroup* pGroup;
+    int blockers;   // unfinished dependencies, plus one until submitted
+    bool finished;
+    vector<radomeJob*> dependents;
+};
+
+class radomeJobWorker : public ofThread {
+public:
+    radomeJobWorker(radomeJobSystem* pSystem, int queue) : _pSystem(pSystem), _queue(queue) {}
+
+protected:
+    void threadedFunction() {
+        while (isThreadRunning()) {
+            // Parked workers stay off the wake event so they can't swallow
+            // a wake-up meant for an active one.
+            if (!_pSystem->isActive(_queue))
+                ofSleepMillis(IDLE_WAIT_MS);
+            else if (!_pSystem->runOne(_queue, true))
+                _pSystem->_wake.tryWait(IDLE_WAIT_MS);
+        }
+    }
+
+    radomeJobSystem* _pSystem;
+    int _queue;
+};
+
+radomeJobGroup::radomeJobGroup(bool background)
+: _background(background)
+, _unfinished(0)
+{
+}
+
+radomeJobGroup::~radomeJobGroup() {
+    for (auto iter = _jobs.begin(); iter != _jobs.end(); ++iter)
+        delete *iter;
+}
+
+radomeJobSystem::radomeJobSystem()
+: _wake(true)
+, _activeThreads(1)
+, _statsStart(0)
+{
+}
+
+radomeJobSystem::~radomeJobSystem() {
+    for (auto iter = _workers.begin(); iter != _workers.end(); ++iter)
+        (*iter)->stopThread();
+    for (auto iter = _workers.begin(); iter != _workers.end(); ++iter) {
+        _wake.set();
+        (*iter)->waitForThread(true);
+        delete *iter;
+    }
+    for (auto iter = _queues.begin(); iter != _queues.end(); ++iter)
+        delete *iter;
+}
+
+void radomeJobSystem::setup(int workerCount) {
+    if (!_queues.empty())
+        return;
+    if (workerCount <= 0)
+        workerCount = MAX(1, (int)sysconf(_SC_NPROCESSORS_ONLN) - 1);
+
+    for (int ii = 0; ii <= workerCount; ii++) {
+        Queue* pQueue = new Queue();
+        pQueue->jobsRun = 0;
+        pQueue->steals = 0;
+        pQueue->busyMicros = 0;
+        _queues.push_back(pQueue);
+    }
+    // All queues exist before any worker starts stealing from them.
+    for (int ii = 1; ii <= workerCount; ii++) {
+        radomeJobWorker* pWorker = new radomeJobWorker(this, ii);
+        pWorker->startThread(true, false);
+        _workers.push_back(pWorker);
+    }
+    _activeThreads = _queues.size();
+    _statsStart = ofGetElapsedTimeMicros();
+    ofLogNotice() << "job system: " << workerCount << " workers";
+}
+
+void radomeJobSystem::setActiveThreads(int count) {
+    _mutex.lock();
+    _activeThreads = MAX(1, MIN(count, (int)_queues.size()));
+    _mutex.unlock();
+    _wake.set();
+}
+
+int radomeJobSystem::getActiveThreads() {
+    _mutex.lock();
+    int count = _activeThreads;
+    _mutex.unlock();
+    return count;
+}
+
+bool radomeJobSystem::isActive(int queue) {
+    return queue < getActiveThreads();
+}
+
+radomeJob* radomeJobSystem::create(radomeJobGroup& group, radomeJobFunction function, void* pData, int begin, int end) {
+    radomeJob* pJob = new radomeJob();
+    pJob->function = function;
+    pJob->pData = pData;
+    pJob->begin = begin;
+    pJob->end = end;
+    pJob->pGroup = &group;
+    pJob->blockers = 1;
+    pJob->finished = false;
+
+    _mutex.lock();
+    group._unfinished++;
+    group._jobs.push_back(pJob);
+    _mutex.unlock();
+    return pJob;
+}
+
+void radomeJobSystem::depend(radomeJob* pJob, radomeJob* pBefore) {
+    _mutex.lock();
+    if (!pBefore->finished) {
+        pJob->blockers++;
+        pBefore->dependents.push_back(pJob);
+    }
+    _mutex.unlock();
+}
+
+void radomeJobSystem::submit(radomeJob* pJob) {
+    _mutex.lock();
+    bool ready = --pJob->blockers == 0;
+    _mutex.unlock();
+    if (ready)
+        push(pJob, getCurrentQueue());
+}
+
+radomeJob* radomeJobSystem::run(radomeJobGroup& group, radomeJobFunction function, void* pData, int begin, int end) {
+    radomeJob* pJob = create(group, function, pData, begin, end);
+    submit(pJob);
+    return pJob;
+}
+
+void radomeJobSystem::parallelFor(radomeJobGroup& group, radomeJobFunction function, void* pData,
+                                  int begin, int end, int grain) {
+    grain = MAX(1, grain);
+    for (int first = begin; first < end; first += grain)
+        run(group, function, pData, first, MIN(end, first + grain));
+}
+
+// Without a job system (or before setup) everything runs on the caller.
+void radomeJobSystem::push(radomeJob* pJob, int queue) {
+    if (_queues.empty()) {
+        execute(pJob, -1);
+        return;
+    }
+    if (pJob->pGroup->isBackground()) {
+        _mutex.lock();
+        _background.push_back(pJob);
+        _mutex.unlock();
+    } else {
+        Queue& target = *_queues[queue];
+        target.mutex.lock();
+        target.jobs.push_back(pJob);
+        target.mutex.unlock();
+    }
+    _wake.set();
+}
+
+// Workers are matched by thread; anything else (the GL thread, a loader
+// thread) shares queue 0.
+int radomeJobSystem::getCurrentQueue() {
+    Poco::Thread* pThread = Poco::Thread::current();
+    if (!pThread)
+        return 0;
+    for (int ii = 0; ii < (int)_workers.size(); ii++) {
+        if (_workers[ii]->getThreadId() == pThread->id())
+            return ii + 1;
+    }
+    return 0;
+}
+
+radomeJob* radomeJobSystem::take(int queue, bool background) {
+    radomeJob* pJob = NULL;
+    bool more = false;
+
+    Queue& own = *_queues[queue];
+    own.mutex.lock();
+    if (!own.jobs.empty()) {
+        pJob = own.jobs.back();
+        own.jobs.pop_back();
+        more = !own.jobs.empty();
+    }
+    own.mutex.unlock();
+
+    for (int ii = 1; !pJob && ii < (int)_queues.size(); ii++) {
+        Queue& victim = *_queues[(queue + ii) % _queues.size()];
+        victim.mutex.lock();
+        if (!victim.jobs.empty()) {
+            pJob = victim.jobs.front();
+            victim.jobs.pop_front();
+            more = !victim.jobs.empty();
+        }
+        victim.mutex.unlock();
+        if (pJob) {
+            own.mutex.lock();
+            own.steals++;
+            own.mutex.unlock();
+        }
+    }
+
+    if (!pJob && background) {
+        _mutex.lock();
+        if (!_background.empty()) {
+            pJob = _background.front();
+            _background.pop_front();
+            more = !_background.empty();
+        }
+        _mutex.unlock();
+    }
+
+    // One wake-up per submission: pass it on while work is left over.
+    if (more)
+        _wake.set();
+    return pJob;
+}
+
+bool radomeJobSystem::runOne(int queue, bool background) {
+    radomeJob* pJob = take(queue, background);
+    if (!pJob)
+        return false;
+    execute(pJob, queue);
+    return true;
+}
+
+void radomeJobSystem::execute(radomeJob* pJob, int queue) {
+    unsigned long long start = ofGetElapsedTimeMicros();
+    pJob->function(pJob->pData, pJob->begin, pJob->end);
+    if (queue >= 0) {
+        Queue& own = *_queues[queue];
+        own.mutex.lock();
+        own.jobsRun++;
+        own.busyMicros += ofGetElapsedTimeMicros() - start;
+        own.mutex.unlock();
+    }
+
+    vector<radomeJob*> ready;
+    _mutex.lock();
+    pJob->finished = true;
+    pJob->pGroup->_unfinished--;
+    for (auto iter = pJob->dependents.begin(); iter != pJob->dependents.end(); ++iter) {
+        if (--(*iter)->blockers == 0)
+            ready.push_back(*iter);
+    }
+    _mutex.unlock();
+    // Released work stays on this thread unless someone steals it.
+    for (auto iter = ready.begin(); iter != ready.end(); ++iter)
+        push(*iter, MAX(queue, 0));
+}
+
+bool radomeJobSystem::isFinished(radomeJobGroup& group) {
+    _mutex.lock();
+    bool finished = group._unfinished == 0;
+    _mutex.unlock();
+    return finished;
+}
+
+void radomeJobSystem::freeJobs(radomeJobGroup& group) {
+    _mutex.lock();
+    for (auto iter = group._jobs.begin(); iter != group._jobs.end(); ++iter)
+        delete *iter;
+    group._jobs.clear();
+    _mutex.unlock();
+}
+
+void radomeJobSystem::wait(radomeJobGroup& group) {
+    int queue = getCurrentQueue();
+    while (!isFinished(group)) {
+        // Workers may run background jobs while they wait; nobody else does.
+        if (_queues.empty() || !runOne(queue, queue > 0))
+            Poco::Thread::yield();
+    }
+    freeJobs(group);
+}
+
+bool radomeJobSystem::poll(radomeJobGroup& group) {
+    if (!isFinished(group))
+        return false;
+    freeJobs(group);
+    return true;
+}
+
+void radomeJobSystem::getStats(vector<radomeJobThreadStats>& stats) {
+    unsigned long long now = ofGetElapsedTimeMicros();
+    double interval = MAX(1.0, (double)(now - _statsStart));
+    _statsStart = now;
+
+    stats.resize(_queues.size());
+    for (int ii = 0; ii < (int)_queues.size(); ii++) {
+        Queue& queue = *_queues[ii];
+        queue.mutex.lock();
+        stats[ii].jobs = queue.jobsRun;
+        stats[ii].steals = queue.steals;
+        stats[ii].utilization = queue.busyMicros / interval;
+        queue.jobsRun = 0;
+        queue.steals = 0;
+        queue.busyMicros = 0;
+        queue.mutex.unlock();
+    }
+}
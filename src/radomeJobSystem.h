@@ -0,0 +1,121 @@
+//
+//  radomeJobSystem.h
+//  radome
+//
+//  A work-stealing scheduler for the CPU-heavy parts of a frame and for
+//  background work. Every thread has its own deque: it pushes and pops at
+//  the back, newest first while the data is still in cache, and idle threads
+//  steal from the front of the others', oldest first. Jobs can wait for
+//  other jobs, and every job belongs to a group that is waited on as a
+//  whole. A thread waiting on a group runs jobs meanwhile, so a frame's
+//  group finishes on the workers and the GL thread together.
+//
+
+#ifndef __radome__radomeJobSystem__
+#define __radome__radomeJobSystem__
+
+#include "ofMain.h"
+#include "Poco/Event.h"
+
+#include <deque>
+using std::deque;
+
+// Runs items [begin, end) of whatever pData describes.
+typedef void (*radomeJobFunction)(void* pData, int begin, int end);
+
+struct radomeJob;
+class radomeJobWorker;
+
+// Per thread, since the last getStats(); index 0 is the thread that waits
+// on frame groups.
+struct radomeJobThreadStats {
+    unsigned int jobs;
+    unsigned int steals;
+    float utilization;   // fraction of the interval spent running jobs
+};
+
+class radomeJobGroup {
+public:
+    // Background jobs only run on workers, never on a thread waiting for a
+    // frame group: they're for long work (model imports) that mustn't hold
+    // up the frame.
+    radomeJobGroup(bool background = false);
+    // Waited on or finished by now; deletes the jobs.
+    ~radomeJobGroup();
+
+    bool isBackground() const { return _background; }
+
+protected:
+    friend class radomeJobSystem;
+
+    bool _background;
+    int _unfinished;
+    vector<radomeJob*> _jobs;
+};
+
+class radomeJobSystem {
+public:
+    radomeJobSystem();
+    ~radomeJobSystem();
+
+    // Starts the workers: one per core besides the calling thread when
+    // workerCount is 0.
+    void setup(int workerCount = 0);
+    // Workers plus the thread that waits.
+    int getThreadCount() const { return _queues.size(); }
+    // Parks the workers past the first count - 1, to measure how work scales
+    // with the number of cores. Background jobs wait while only the calling
+    // thread is active.
+    void setActiveThreads(int count);
+    int getActiveThreads();
+
+    // A job is held back until submit(), so dependencies can be added first;
+    // an unsubmitted job keeps its group from finishing. Job pointers stay
+    // valid until the group is waited on.
+    radomeJob* create(radomeJobGroup& group, radomeJobFunction function, void* pData, int begin = 0, int end = 1);
+    // pJob, not yet submitted, won't start before pBefore has finished.
+    void depend(radomeJob* pJob, radomeJob* pBefore);
+    void submit(radomeJob* pJob);
+    radomeJob* run(radomeJobGroup& group, radomeJobFunction function, void* pData, int begin = 0, int end = 1);
+    // Splits [begin, end) into jobs of at most grain items.
+    void parallelFor(radomeJobGroup& group, radomeJobFunction function, void* pData, int begin, int end, int grain = 1);
+
+    // Runs jobs on the calling thread until the group has finished, then
+    // frees its jobs so the group can be reused.
+    void wait(radomeJobGroup& group);
+    // The same without blocking: false while jobs are still unfinished.
+    bool poll(radomeJobGroup& group);
+
+    void getStats(vector<radomeJobThreadStats>& stats);
+
+protected:
+    friend class radomeJobWorker;
+
+    struct Queue {
+        ofMutex mutex;
+        deque<radomeJob*> jobs;
+        unsigned int jobsRun;
+        unsigned int steals;
+        unsigned long long busyMicros;
+    };
+
+    int getCurrentQueue();
+    bool isActive(int queue);
+    radomeJob* take(int queue, bool background);
+    bool runOne(int queue, bool background);
+    void execute(radomeJob* pJob, int queue);
+    void push(radomeJob* pJob, int queue);
+    bool isFinished(radomeJobGroup& group);
+    void freeJobs(radomeJobGroup& group);
+
+    vector<Queue*> _queues;
+    vector<radomeJobWorker*> _workers;
+    // Dependencies, group counts and the background queue.
+    ofMutex _mutex;
+    deque<radomeJob*> _background;
+    Poco::Event _wake;
+    int _activeThreads;
+    unsigned long long _statsStart;
+};
+
+#endif /* defined(__radome__radomeJobSystem__) */
@@ -0,0 +1,202 @@
+//
+//  radomeLayerStack.cpp
+//  radome
+//
+
+#include "radomeLayerStack.h"
+
+#define DEFAULT_SLICE_WIDTH 1024
+#define DEFAULT_SLICE_HEIGHT 1024
+
+radomeLayerStack::radomeLayerStack()
+: _texture(0)
+, _fbo(0)
+, _width(DEFAULT_SLICE_WIDTH)
+, _height(DEFAULT_SLICE_HEIGHT)
+, _allocation(0)
+, _activeCount(0)
+, _copyCount(0)
+{
+    for (int ii = 0; ii < MAX_VIDEO_LAYERS; ii++) {
+        radomeVideoLayer& layer = _layers[ii];
+        layer.pSource = NULL;
+        layer.ownsSource = false;
+        layer.enabled = true;
+        layer.hasFrame = false;
+        layer.mappingMode = 0;
+        layer.blendMode = 0;
+        layer.fader = 0.75;
+    }
+}
+
+radomeLayerStack::~radomeLayerStack() {
+    for (int ii = 0; ii < MAX_VIDEO_LAYERS; ii++)
+        setSource(ii, NULL, false);
+    if (_fbo)
+        glDeleteFramebuffersEXT(1, &_fbo);
+    if (_texture)
+        glDeleteTextures(1, &_texture);
+    if (_allocation)
+        radomeGpuMemory::get().release(_allocation);
+}
+
+void radomeLayerStack::setSliceSize(int w, int h) {
+    if (w == _width && h == _height)
+        return;
+    _width = MAX(1, w);
+    _height = MAX(1, h);
+    if (_texture) {
+        glDeleteTextures(1, &_texture);
+        _texture = 0;
+        for (int ii = 0; ii < MAX_VIDEO_LAYERS; ii++)
+            _layers[ii].hasFrame = false;
+    }
+}
+
+void radomeLayerStack::setSource(int layer, radomeVideoSource* pSource, bool takeOwnership) {
+    if (!isValid(layer))
+        return;
+    radomeVideoLayer& l = _layers[layer];
+    if (l.pSource && l.ownsSource && l.pSource != pSource)
+        delete l.pSource;
+    l.pSource = pSource;
+    l.ownsSource = takeOwnership;
+    l.hasFrame = false;
+}
+
+radomeVideoSource* radomeLayerStack::getSource(int layer) const {
+    return isValid(layer) ? _layers[layer].pSource : NULL;
+}
+
+void radomeLayerStack::setEnabled(int layer, bool enabled) { if (isValid(layer)) _layers[layer].enabled = enabled; }
+bool radomeLayerStack::isEnabled(int layer) const { return isValid(layer) && _layers[layer].enabled; }
+void radomeLayerStack::setMappingMode(int layer, int mode) { if (isValid(layer)) _layers[layer].mappingMode = MAX(0, MIN(mode, LAYER_MAPPING_MODES - 1)); }
+int radomeLayerStack::getMappingMode(int layer) const { return isValid(layer) ? _layers[layer].mappingMode : 0; }
+void radomeLayerStack::setBlendMode(int layer, int mode) { if (isValid(layer)) _layers[layer].blendMode = MAX(0, MIN(mode, LAYER_BLEND_MODES - 1)); }
+int radomeLayerStack::getBlendMode(int layer) const { return isValid(layer) ? _layers[layer].blendMode : 0; }
+void radomeLayerStack::setFader(int layer, float fader) { if (isValid(layer)) _layers[layer].fader = ofClamp(fader, 0.0, 1.0); }
+float radomeLayerStack::getFader(int layer) const { return isValid(layer) ? _layers[layer].fader : 0.0; }
+
+bool radomeLayerStack::allocate() {
+    if (_texture)
+        return true;
+    if (!GLEW_EXT_texture_array) {
+        ofLogError() << "video layers need EXT_texture_array, which this driver lacks";
+        return false;
+    }
+
+    glGenTextures(1, &_texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY_EXT, _texture);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // Longitude wraps around the dome; latitude doesn't.
+    glTexParameteri(GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY_EXT, 0, GL_RGBA8, _width, _height, MAX_VIDEO_LAYERS, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D_ARRAY_EXT, 0);
+
+    if (!_fbo)
+        glGenFramebuffersEXT(1, &_fbo);
+
+    size_t bytes = radomeGpuMemory::estimateTextureBytes(_width, _height, GL_RGBA) * MAX_VIDEO_LAYERS;
+    if (_allocation)
+        radomeGpuMemory::get().resize(_allocation, bytes);
+    else
+        _allocation = radomeGpuMemory::get().track(this, "video layers", GpuVideoTexture, bytes);
+    return true;
+}
+
+// Draws the source's frame into its slice through a framebuffer attached to
+// that layer of the array.
+void radomeLayerStack::copyToSlice(int layer) {
+    GLint previousFbo = 0;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING_EXT, &previousFbo);
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, _fbo);
+    glFramebufferTextureLayerEXT(GL_FRAMEBUFFER_EXT, GL_COLOR_ATTACHMENT0_EXT, _texture, 0, layer);
+
+    glPushAttrib(GL_VIEWPORT_BIT | GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT);
+    glViewport(0, 0, _width, _height);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0, _width, 0, _height, -1, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    ofPushStyle();
+    ofSetColor(255, 255, 255, 255);
+    _layers[layer].pSource->drawFrame(0, 0, _width, _height);
+    ofPopStyle();
+
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+    glPopAttrib();
+
+    glBindFramebufferEXT(GL_FRAMEBUFFER_EXT, previousFbo);
+    _layers[layer].hasFrame = true;
+    _copyCount++;
+}
+
+void radomeLayerStack::update(double time) {
+    _activeCount = 0;
+    for (int ii = 0; ii < MAX_VIDEO_LAYERS; ii++) {
+        radomeVideoLayer& layer = _layers[ii];
+        if (!layer.pSource || !layer.enabled)
+            continue;
+        // Updated first: some sources only become ready with their first frame.
+        layer.pSource->setTime(time);
+        bool newFrame = layer.pSource->update();
+        if (!layer.pSource->isReady())
+            continue;
+        if (newFrame || !layer.hasFrame) {
+            if (!allocate())
+                return;
+            if (layer.pSource->uploadToSlice(_texture, ii, _width, _height))
+                layer.hasFrame = true;
+            else
+                copyToSlice(ii);
+        }
+
+        int n = _activeCount++;
+        _activeSlice[n] = ii;
+        _activeMapping[n] = layer.mappingMode;
+        _activeBlend[n] = layer.blendMode;
+        _activeMix[n] = layer.fader;
+        _activeSize[n * 2] = layer.pSource->getWidth();
+        _activeSize[n * 2 + 1] = layer.pSource->getHeight();
+    }
+}
+
+void radomeLayerStack::bind(ofShader& shader, int textureUnit) {
+    shader.setUniform1i("layers", textureUnit);
+    shader.setUniform1i("layerCount", _activeCount);
+    if (!_activeCount)
+        return;
+
+    glActiveTexture(GL_TEXTURE0 + textureUnit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY_EXT, _texture);
+    glActiveTexture(GL_TEXTURE0);
+
+    shader.setUniform1fv("layerSlice", _activeSlice, _activeCount);
+    shader.setUniform1iv("layerMapping", _activeMapping, _activeCount);
+    shader.setUniform1iv("layerBlend", _activeBlend, _activeCount);
+    shader.setUniform1fv("layerMix", _activeMix, _activeCount);
+    shader.setUniform2fv("layerSize", _activeSize, _activeCount);
+}
+
+void radomeLayerStack::unbind(int textureUnit) {
+    if (!_activeCount)
+        return;
+    glActiveTexture(GL_TEXTURE0 + textureUnit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY_EXT, 0);
+    glActiveTexture(GL_TEXTURE0);
+}
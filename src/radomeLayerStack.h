@@ -0,0 +1,90 @@
+//
+//  radomeLayerStack.h
+//  radome
+//
+//  2D video layers composited over the cube map in the dome shader. Each
+//  layer's latest frame is copied into one slice of a texture array, and the
+//  shader blends the active layers in a single pass; only active layers are
+//  handed to the shader, so cost follows the number of layers in use.
+//
+
+#ifndef __radome__radomeLayerStack__
+#define __radome__radomeLayerStack__
+
+#include "ofMain.h"
+#include "radomeVideoSource.h"
+#include "radomeGpuMemory.h"
+
+#define MAX_VIDEO_LAYERS 4
+#define VIDEO_LAYER_TEXTURE_UNIT 1
+// Modes as the dome shader numbers them.
+#define LAYER_BLEND_MODES 3
+#define LAYER_MAPPING_MODES 5
+
+struct radomeVideoLayer {
+    radomeVideoSource* pSource;
+    bool ownsSource;
+    bool enabled;
+    bool hasFrame;
+    int mappingMode;
+    int blendMode;
+    float fader;
+};
+
+class radomeLayerStack {
+public:
+    radomeLayerStack();
+    ~radomeLayerStack();
+
+    // Size of every slice; sources are scaled to it when copied.
+    void setSliceSize(int w, int h);
+
+    // The stack deletes sources it owns when they are replaced or on destruction.
+    void setSource(int layer, radomeVideoSource* pSource, bool takeOwnership);
+    radomeVideoSource* getSource(int layer) const;
+
+    void setEnabled(int layer, bool enabled);
+    bool isEnabled(int layer) const;
+    void setMappingMode(int layer, int mode);
+    int getMappingMode(int layer) const;
+    void setBlendMode(int layer, int mode);
+    int getBlendMode(int layer) const;
+    void setFader(int layer, float fader);
+    float getFader(int layer) const;
+
+    // Copies new frames into their slices and rebuilds the active layer list;
+    // call once per frame, outside any framebuffer. time is the animation
+    // clock's, in seconds, which clips are played in step with.
+    void update(double time);
+
+    int getActiveLayerCount() const { return _activeCount; }
+    unsigned int getCopyCount() const { return _copyCount; }
+
+    // Binds the array to the texture unit and sets the layer uniforms that
+    // radome.frag expects.
+    void bind(ofShader& shader, int textureUnit);
+    void unbind(int textureUnit);
+
+protected:
+    bool isValid(int layer) const { return layer >= 0 && layer < MAX_VIDEO_LAYERS; }
+    bool allocate();
+    void copyToSlice(int layer);
+
+    radomeVideoLayer _layers[MAX_VIDEO_LAYERS];
+
+    GLuint _texture;
+    GLuint _fbo;
+    int _width;
+    int _height;
+    radomeGpuMemory::Handle _allocation;
+
+    int _activeCount;
+    float _activeSlice[MAX_VIDEO_LAYERS];
+    int _activeMapping[MAX_VIDEO_LAYERS];
+    int _activeBlend[MAX_VIDEO_LAYERS];
+    float _activeMix[MAX_VIDEO_LAYERS];
+    float _activeSize[MAX_VIDEO_LAYERS * 2];
+    unsigned int _copyCount;
+};
+
+#endif /* defined(__radome__radomeLayerStack__) */
@@ -0,0 +1,119 @@
+//
+//  radomeLodBuilder.cpp
+//  radome
+//
+
+#include "radomeLodBuilder.h"
+
+// Below this a mesh is cheap enough to draw at full detail everywhere.
+#define MIN_LOD_TRIANGLES 64
+// A level that saves less than this over the previous one isn't kept.
+#define MIN_LOD_REDUCTION 0.8
+#define IDLE_SLEEP_MS 10
+
+radomeLodBuilder::radomeLodBuilder()
+: _pRunning(NULL)
+, _runningCanceled(false)
+{
+}
+
+radomeLodBuilder::~radomeLodBuilder() {
+    if (isThreadRunning())
+        waitForThread(true);
+    for (auto iter = _pending.begin(); iter != _pending.end(); ++iter)
+        delete *iter;
+    for (auto iter = _finished.begin(); iter != _finished.end(); ++iter)
+        delete *iter;
+}
+
+void radomeLodBuilder::submit(radomeLodJob* pJob) {
+    lock();
+    _pending.push_back(pJob);
+    unlock();
+    if (!isThreadRunning())
+        startThread(true, false);
+}
+
+void radomeLodBuilder::collect(vector<radomeLodJob*>& finished) {
+    lock();
+    finished.insert(finished.end(), _finished.begin(), _finished.end());
+    _finished.clear();
+    unlock();
+}
+
+void radomeLodBuilder::cancel(const void* pOwner) {
+    lock();
+    for (auto iter = _pending.begin(); iter != _pending.end(); ) {
+        if ((*iter)->pOwner == pOwner) {
+            delete *iter;
+            iter = _pending.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+    for (auto iter = _finished.begin(); iter != _finished.end(); ) {
+        if ((*iter)->pOwner == pOwner) {
+            delete *iter;
+            iter = _finished.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+    if (_pRunning && _pRunning->pOwner == pOwner)
+        _runningCanceled = true;
+    unlock();
+}
+
+int radomeLodBuilder::getPendingCount() {
+    lock();
+    int count = _pending.size() + (_pRunning ? 1 : 0);
+    unlock();
+    return count;
+}
+
+void radomeLodBuilder::threadedFunction() {
+    while (isThreadRunning()) {
+        lock();
+        radomeLodJob* pJob = NULL;
+        if (!_pending.empty()) {
+            pJob = _pending.front();
+            _pending.pop_front();
+            _pRunning = pJob;
+            _runningCanceled = false;
+        }
+        unlock();
+
+        if (!pJob) {
+            sleep(IDLE_SLEEP_MS);
+            continue;
+        }
+
+        buildLevels(*pJob);
+
+        lock();
+        if (_runningCanceled)
+            delete pJob;
+        else
+            _finished.push_back(pJob);
+        _pRunning = NULL;
+        unlock();
+    }
+}
+
+// Each level aims for half the triangles of the one before it, simplifying
+// from that level rather than from full detail.
+void radomeLodBuilder::buildLevels(radomeLodJob& job) {
+    const vector<ofIndexType>* pPrevious = &job.indices;
+    int previousCount = job.indices.size() / 3;
+    for (int level = 1; level < MAX_LOD_LEVELS; level++) {
+        if (previousCount < MIN_LOD_TRIANGLES)
+            break;
+        vector<ofIndexType> simplified;
+        int count = _simplifier.simplify(job.positions, job.texcoords, *pPrevious, previousCount / 2, simplified);
+        if (count == 0 || count > previousCount * MIN_LOD_REDUCTION)
+            break;
+        job.levels.push_back(simplified);
+        pPrevious = &job.levels.back();
+        previousCount = count;
+    }
+}
@@ -0,0 +1,55 @@
+//
+//  radomeLodBuilder.h
+//  radome
+//
+//  Worker thread that builds LOD chains for imported meshes, so simplifying a
+//  large model never holds up the frame. Jobs carry copies of the geometry;
+//  results are collected and uploaded on the main (GL) thread.
+//
+
+#ifndef __radome__radomeLodBuilder__
+#define __radome__radomeLodBuilder__
+
+#include "ofMain.h"
+#include "radomeMeshSimplifier.h"
+
+#include <deque>
+using std::deque;
+
+struct radomeLodJob {
+    const void* pOwner;
+    int meshIndex;
+    vector<ofVec3f> positions;
+    vector<ofVec2f> texcoords;
+    vector<ofIndexType> indices;
+    // Filled in by the worker: levels below full detail, coarsest last.
+    vector< vector<ofIndexType> > levels;
+};
+
+class radomeLodBuilder : public ofThread {
+public:
+    radomeLodBuilder();
+    ~radomeLodBuilder();
+
+    // Takes ownership of the job; the thread starts on first use.
+    void submit(radomeLodJob* pJob);
+    // Hands over every finished job; the caller deletes them.
+    void collect(vector<radomeLodJob*>& finished);
+    // Drops queued and finished jobs for owner; one already running is
+    // discarded when it completes.
+    void cancel(const void* pOwner);
+
+    int getPendingCount();
+
+protected:
+    void threadedFunction();
+    void buildLevels(radomeLodJob& job);
+
+    deque<radomeLodJob*> _pending;
+    vector<radomeLodJob*> _finished;
+    radomeLodJob* _pRunning;
+    bool _runningCanceled;
+    radomeMeshSimplifier _simplifier;
+};
+
+#endif /* defined(__radome__radomeLodBuilder__) */
@@ -0,0 +1,417 @@
+//
+//  radomeMeshOptimizer.cpp
+//  radome
+//
+
+#include "radomeMeshOptimizer.h"
+
+#include <map>
+
+// Vertex cache ordering after Tom Forsyth, "Linear-Speed Vertex Cache
+// Optimisation": a simulated LRU cache scores vertices by cache position and
+// by how many of their triangles are still to be drawn.
+#define FORSYTH_CACHE_SIZE 32
+#define CACHE_DECAY_POWER 1.5f
+#define LAST_TRIANGLE_SCORE 0.75f
+#define VALENCE_BOOST_SCALE 2.0f
+#define VALENCE_BOOST_POWER 0.5f
+
+// What ACMR is measured against: a FIFO of common post-transform cache size.
+#define ACMR_CACHE_SIZE 16
+
+// Overdraw clusters are cut where the ordered triangles jump (a triangle
+// misses on all three vertices), but never shorter than this.
+#define MIN_CLUSTER_TRIANGLES 64
+
+// Position, normal, raw UV and color; vertices equal in all of them are welded.
+struct radomeVertexKey {
+    float v[12];
+    bool operator<(const radomeVertexKey& other) const { return memcmp(v, other.v, sizeof(v)) < 0; }
+};
+
+float radomeMeshOptimizer::computeACMR(const vector<ofIndexType>& indices, int vertexCount) {
+    int triangles = indices.size() / 3;
+    if (!triangles)
+        return 0;
+
+    vector<int> inserted(vertexCount, -1);
+    int time = 0;
+    int misses = 0;
+    for (auto iter = indices.begin(); iter != indices.end(); ++iter) {
+        int& when = inserted[*iter];
+        if (when < 0 || time - when >= ACMR_CACHE_SIZE) {
+            when = time++;
+            misses++;
+        }
+    }
+    return (float)misses / triangles;
+}
+
+static float vertexScore(int cachePosition, int remaining) {
+    if (remaining == 0)
+        return -1;
+
+    float score = 0;
+    if (cachePosition >= 0) {
+        // The last triangle's vertices get a fixed score so the next triangle
+        // doesn't simply reuse the same edge.
+        if (cachePosition < 3)
+            score = LAST_TRIANGLE_SCORE;
+        else
+            score = powf(1.0f - (cachePosition - 3) / (float)(FORSYTH_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+    }
+    return score + VALENCE_BOOST_SCALE * powf((float)remaining, -VALENCE_BOOST_POWER);
+}
+
+void radomeMeshOptimizer::orderForVertexCache(vector<ofIndexType>& indices, int vertexCount) {
+    int triangleCount = indices.size() / 3;
+    if (triangleCount < 2)
+        return;
+
+    // Triangles around each vertex, compacted as they are drawn.
+    vector<int> remaining(vertexCount, 0);
+    for (auto iter = indices.begin(); iter != indices.end(); ++iter)
+        remaining[*iter]++;
+    vector<int> offsets(vertexCount + 1, 0);
+    for (int vv = 0; vv < vertexCount; vv++)
+        offsets[vv + 1] = offsets[vv] + remaining[vv];
+    vector<int> adjacency(offsets[vertexCount]);
+    vector<int> fill(vertexCount, 0);
+    for (int tt = 0; tt < triangleCount; tt++) {
+        for (int cc = 0; cc < 3; cc++) {
+            int v = indices[tt * 3 + cc];
+            adjacency[offsets[v] + fill[v]++] = tt;
+        }
+    }
+
+    vector<int> cachePosition(vertexCount, -1);
+    vector<float> score(vertexCount);
+    for (int vv = 0; vv < vertexCount; vv++)
+        score[vv] = vertexScore(-1, remaining[vv]);
+
+    vector<float> triangleScore(triangleCount);
+    vector<bool> added(triangleCount, false);
+    int best = 0;
+    for (int tt = 0; tt < triangleCount; tt++) {
+        triangleScore[tt] = score[indices[tt * 3]] + score[indices[tt * 3 + 1]] + score[indices[tt * 3 + 2]];
+        if (triangleScore[tt] > triangleScore[best])
+            best = tt;
+    }
+
+    vector<ofIndexType> ordered;
+    ordered.reserve(indices.size());
+    vector<int> cache, nextCache;
+    int scan = 0;
+    for (int drawn = 0; drawn < triangleCount; drawn++) {
+        if (best < 0) {
+            // Nothing in the cache has triangles left: start a new region.
+            while (added[scan])
+                scan++;
+            best = scan;
+        }
+        added[best] = true;
+
+        nextCache.clear();
+        for (int cc = 0; cc < 3; cc++) {
+            int v = indices[best * 3 + cc];
+            ordered.push_back(v);
+            nextCache.push_back(v);
+
+            int* pBegin = &adjacency[offsets[v]];
+            int* pEnd = pBegin + remaining[v];
+            int* pFound = std::find(pBegin, pEnd, best);
+            if (pFound != pEnd) {
+                *pFound = *(pEnd - 1);
+                remaining[v]--;
+            }
+        }
+        for (auto iter = cache.begin(); iter != cache.end(); ++iter) {
+            if (*iter != nextCache[0] && *iter != nextCache[1] && *iter != nextCache[2])
+                nextCache.push_back(*iter);
+        }
+
+        for (int ii = 0; ii < (int)nextCache.size(); ii++) {
+            int v = nextCache[ii];
+            cachePosition[v] = ii < FORSYTH_CACHE_SIZE ? ii : -1;
+            score[v] = vertexScore(cachePosition[v], remaining[v]);
+        }
+
+        // Rescore triangles around every vertex whose score moved, including
+        // the ones just pushed out, and take the best for the next step.
+        best = -1;
+        float bestScore = -1;
+        for (auto iter = nextCache.begin(); iter != nextCache.end(); ++iter) {
+            int v = *iter;
+            for (int ii = 0; ii < remaining[v]; ii++) {
+                int tt = adjacency[offsets[v] + ii];
+                triangleScore[tt] = score[indices[tt * 3]] + score[indices[tt * 3 + 1]] + score[indices[tt * 3 + 2]];
+                if (triangleScore[tt] > bestScore) {
+                    bestScore = triangleScore[tt];
+                    best = tt;
+                }
+            }
+        }
+
+        if ((int)nextCache.size() > FORSYTH_CACHE_SIZE)
+            nextCache.resize(FORSYTH_CACHE_SIZE);
+        cache.swap(nextCache);
+    }
+    indices.swap(ordered);
+}
+
+// Cuts the cache-ordered triangles into clusters and draws the ones facing
+// away from the mesh centre first; those tend to occlude the rest.
+void radomeMeshOptimizer::orderForOverdraw(const vector<ofVec3f>& positions, vector<ofIndexType>& indices) {
+    int triangleCount = indices.size() / 3;
+    if (triangleCount < MIN_CLUSTER_TRIANGLES * 2)
+        return;
+
+    vector<int> starts;
+    vector<int> inserted(positions.size(), -1);
+    int time = 0;
+    for (int tt = 0; tt < triangleCount; tt++) {
+        int misses = 0;
+        for (int cc = 0; cc < 3; cc++) {
+            int& when = inserted[indices[tt * 3 + cc]];
+            if (when < 0 || time - when >= ACMR_CACHE_SIZE) {
+                when = time++;
+                misses++;
+            }
+        }
+        if (starts.empty() || (misses == 3 && tt - starts.back() >= MIN_CLUSTER_TRIANGLES))
+            starts.push_back(tt);
+    }
+    if (starts.size() < 2)
+        return;
+    starts.push_back(triangleCount);
+
+    ofVec3f meshCenter;
+    float meshArea = 0;
+    vector<ofVec3f> clusterCenters(starts.size() - 1), clusterNormals(starts.size() - 1);
+    vector<float> clusterAreas(starts.size() - 1, 0);
+    for (int cl = 0; cl + 1 < (int)starts.size(); cl++) {
+        for (int tt = starts[cl]; tt < starts[cl + 1]; tt++) {
+            const ofVec3f& a = positions[indices[tt * 3]];
+            const ofVec3f& b = positions[indices[tt * 3 + 1]];
+            const ofVec3f& c = positions[indices[tt * 3 + 2]];
+            ofVec3f normal = (b - a).getCrossed(c - a);
+            float area = normal.length();
+            clusterCenters[cl] += (a + b + c) * (area / 3);
+            clusterNormals[cl] += normal;
+            clusterAreas[cl] += area;
+        }
+        meshCenter += clusterCenters[cl];
+        meshArea += clusterAreas[cl];
+    }
+    if (meshArea <= 0)
+        return;
+    meshCenter /= meshArea;
+
+    vector< std::pair<float, int> > order;
+    for (int cl = 0; cl + 1 < (int)starts.size(); cl++) {
+        ofVec3f center = clusterAreas[cl] > 0 ? clusterCenters[cl] / clusterAreas[cl] : meshCenter;
+        float facing = (center - meshCenter).dot(clusterNormals[cl].getNormalized());
+        order.push_back(std::make_pair(-facing, cl));
+    }
+    std::stable_sort(order.begin(), order.end());
+
+    vector<ofIndexType> ordered;
+    ordered.reserve(indices.size());
+    for (auto iter = order.begin(); iter != order.end(); ++iter) {
+        int cl = iter->second;
+        ordered.insert(ordered.end(), indices.begin() + starts[cl] * 3, indices.begin() + starts[cl + 1] * 3);
+    }
+    indices.swap(ordered);
+}
+
+// Concatenates the group's vertices, welding identical ones, into a new
+// aiMesh and a helper that draws it with the group's material and texture.
+void radomeMeshOptimizer::mergeGroup(vector<ofxAssimpMeshHelper>& meshes, const vector<int>& group,
+                                     ofxAssimpMeshHelper& merged, aiMesh*& pMerged) {
+    const ofxAssimpMeshHelper& first = meshes[group[0]];
+    const aiMesh* pFirst = first.mesh;
+    bool hasNormals = pFirst->HasNormals();
+    bool hasTexcoords = pFirst->HasTextureCoords(0);
+    bool hasColors = pFirst->HasVertexColors(0);
+
+    std::map<radomeVertexKey, int> welded;
+    vector<int> remap;
+    vector<int> sources;        // (mesh, vertex) pairs of every welded vertex
+    vector<ofIndexType> indices;
+    for (auto iter = group.begin(); iter != group.end(); ++iter) {
+        const ofxAssimpMeshHelper& helper = meshes[*iter];
+        const aiMesh* pMesh = helper.mesh;
+        remap.resize(pMesh->mNumVertices);
+        for (unsigned int vv = 0; vv < pMesh->mNumVertices; vv++) {
+            radomeVertexKey key;
+            memset(&key, 0, sizeof(key));
+            key.v[0] = pMesh->mVertices[vv].x; key.v[1] = pMesh->mVertices[vv].y; key.v[2] = pMesh->mVertices[vv].z;
+            if (hasNormals) {
+                key.v[3] = pMesh->mNormals[vv].x; key.v[4] = pMesh->mNormals[vv].y; key.v[5] = pMesh->mNormals[vv].z;
+            }
+            if (hasTexcoords) {
+                key.v[6] = pMesh->mTextureCoords[0][vv].x; key.v[7] = pMesh->mTextureCoords[0][vv].y;
+            }
+            if (hasColors) {
+                const aiColor4D& color = pMesh->mColors[0][vv];
+                key.v[8] = color.r; key.v[9] = color.g; key.v[10] = color.b; key.v[11] = color.a;
+            }
+            auto found = welded.find(key);
+            if (found == welded.end()) {
+                int id = sources.size() / 2;
+                welded[key] = id;
+                sources.push_back(*iter);
+                sources.push_back(vv);
+                remap[vv] = id;
+            } else {
+                remap[vv] = found->second;
+            }
+        }
+        for (auto index = helper.indices.begin(); index != helper.indices.end(); ++index)
+            indices.push_back(remap[*index]);
+    }
+
+    int vertexCount = sources.size() / 2;
+    pMerged = new aiMesh();
+    pMerged->mName = pFirst->mName;
+    pMerged->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+    pMerged->mMaterialIndex = pFirst->mMaterialIndex;
+    pMerged->mNumVertices = vertexCount;
+    pMerged->mVertices = new aiVector3D[vertexCount];
+    if (hasNormals)
+        pMerged->mNormals = new aiVector3D[vertexCount];
+    if (hasTexcoords) {
+        pMerged->mTextureCoords[0] = new aiVector3D[vertexCount];
+        pMerged->mNumUVComponents[0] = 2;
+    }
+    if (hasColors)
+        pMerged->mColors[0] = new aiColor4D[vertexCount];
+
+    merged.mesh = pMerged;
+    merged.material = first.material;
+    merged.texture = first.texture;
+    merged.blendMode = first.blendMode;
+    merged.twoSided = first.twoSided;
+    merged.hasChanged = false;
+    merged.cachedMesh.clear();
+
+    for (int ii = 0; ii < vertexCount; ii++) {
+        const aiMesh* pMesh = meshes[sources[ii * 2]].mesh;
+        int vv = sources[ii * 2 + 1];
+        pMerged->mVertices[ii] = pMesh->mVertices[vv];
+        merged.cachedMesh.addVertex(ofVec3f(pMesh->mVertices[vv].x, pMesh->mVertices[vv].y, pMesh->mVertices[vv].z));
+        if (hasNormals) {
+            pMerged->mNormals[ii] = pMesh->mNormals[vv];
+            merged.cachedMesh.addNormal(ofVec3f(pMesh->mNormals[vv].x, pMesh->mNormals[vv].y, pMesh->mNormals[vv].z));
+        }
+        if (hasTexcoords) {
+            pMerged->mTextureCoords[0][ii] = pMesh->mTextureCoords[0][vv];
+            merged.cachedMesh.addTexCoord(ofVec2f(pMesh->mTextureCoords[0][vv].x, pMesh->mTextureCoords[0][vv].y));
+        }
+        if (hasColors) {
+            const aiColor4D& color = pMesh->mColors[0][vv];
+            pMerged->mColors[0][ii] = color;
+            merged.cachedMesh.addColor(ofFloatColor(color.r, color.g, color.b, color.a));
+        }
+    }
+    merged.validCache = true;
+
+    pMerged->mNumFaces = indices.size() / 3;
+    pMerged->mFaces = new aiFace[pMerged->mNumFaces];
+    for (unsigned int ff = 0; ff < pMerged->mNumFaces; ff++) {
+        pMerged->mFaces[ff].mNumIndices = 3;
+        pMerged->mFaces[ff].mIndices = new unsigned int[3];
+        for (int cc = 0; cc < 3; cc++)
+            pMerged->mFaces[ff].mIndices[cc] = indices[ff * 3 + cc];
+    }
+    merged.indices.swap(indices);
+}
+
+// Groups meshes that drawFaces() would draw with identical state; meshes
+// with bones or non-triangle primitives are left as they are.
+void radomeMeshOptimizer::mergeByMaterial(vector<ofxAssimpMeshHelper>& meshes, vector<aiMesh*>& created) {
+    vector< vector<int> > groups;
+    vector<bool> mergeable;
+    for (int ii = 0; ii < (int)meshes.size(); ii++) {
+        const ofxAssimpMeshHelper& helper = meshes[ii];
+        const aiMesh* pMesh = helper.mesh;
+        bool canMerge = pMesh && !pMesh->HasBones() && pMesh->mNumVertices > 0 &&
+                        pMesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE && helper.indices.size() % 3 == 0;
+        int found = -1;
+        for (int gg = 0; canMerge && gg < (int)groups.size() && found < 0; gg++) {
+            const ofxAssimpMeshHelper& other = meshes[groups[gg][0]];
+            const aiMesh* pOther = other.mesh;
+            if (mergeable[gg] &&
+                pOther->mMaterialIndex == pMesh->mMaterialIndex &&
+                pOther->HasNormals() == pMesh->HasNormals() &&
+                pOther->HasTextureCoords(0) == pMesh->HasTextureCoords(0) &&
+                pOther->HasVertexColors(0) == pMesh->HasVertexColors(0) &&
+                other.twoSided == helper.twoSided && other.blendMode == helper.blendMode)
+                found = gg;
+        }
+        if (found >= 0) {
+            groups[found].push_back(ii);
+        } else {
+            groups.push_back(vector<int>(1, ii));
+            mergeable.push_back(canMerge);
+        }
+    }
+
+    vector<ofxAssimpMeshHelper> result;
+    result.reserve(groups.size());
+    for (int gg = 0; gg < (int)groups.size(); gg++) {
+        if (!mergeable[gg]) {
+            result.push_back(meshes[groups[gg][0]]);
+            continue;
+        }
+        ofxAssimpMeshHelper merged;
+        aiMesh* pMerged = NULL;
+        mergeGroup(meshes, groups[gg], merged, pMerged);
+        created.push_back(pMerged);
+        result.push_back(merged);
+    }
+    meshes.swap(result);
+}
+
+radomeMeshOptimizerStats radomeMeshOptimizer::optimize(vector<ofxAssimpMeshHelper>& meshes, bool allowMerge,
+                                                       vector<aiMesh*>& created) {
+    radomeMeshOptimizerStats stats;
+    memset(&stats, 0, sizeof(stats));
+
+    float misses = 0;
+    int triangles = 0;
+    for (auto iter = meshes.begin(); iter != meshes.end(); ++iter) {
+        if (!iter->mesh)
+            continue;
+        misses += computeACMR(iter->indices, iter->mesh->mNumVertices) * (iter->indices.size() / 3);
+        triangles += iter->indices.size() / 3;
+        stats.verticesBefore += iter->mesh->mNumVertices;
+    }
+    stats.drawCallsBefore = meshes.size();
+    stats.acmrBefore = triangles ? misses / triangles : 0;
+
+    if (allowMerge)
+        mergeByMaterial(meshes, created);
+
+    misses = 0;
+    for (auto iter = meshes.begin(); iter != meshes.end(); ++iter) {
+        if (!iter->mesh)
+            continue;
+        int vertexCount = iter->mesh->mNumVertices;
+        stats.verticesAfter += vertexCount;
+        if (iter->indices.size() < 3 || iter->indices.size() % 3 != 0) {
+            misses += computeACMR(iter->indices, vertexCount) * (iter->indices.size() / 3);
+            continue;
+        }
+        orderForVertexCache(iter->indices, vertexCount);
+        vector<ofVec3f> positions(vertexCount);
+        for (int vv = 0; vv < vertexCount; vv++)
+            positions[vv].set(iter->mesh->mVertices[vv].x, iter->mesh->mVertices[vv].y, iter->mesh->mVertices[vv].z);
+        orderForOverdraw(positions, iter->indices);
+
+        misses += computeACMR(iter->indices, vertexCount) * (iter->indices.size() / 3);
+    }
+    stats.drawCallsAfter = meshes.size();
+    stats.acmrAfter = triangles ? misses / triangles : 0;
+    return stats;
+}
@@ -0,0 +1,47 @@
+//
+//  radomeMeshOptimizer.h
+//  radome
+//
+//  Import-time cleanup of loaded models: static meshes that share a material
+//  are merged into one (with duplicate vertices welded), and every mesh's
+//  triangles are reordered for the post-transform vertex cache, then in
+//  clusters so outward-facing parts draw first and cut overdraw. Nothing here
+//  touches GL: it runs on the model loader's thread, before the meshes'
+//  buffers are created.
+//
+
+#ifndef __radome__radomeMeshOptimizer__
+#define __radome__radomeMeshOptimizer__
+
+#include "ofxAssimpModelLoader.h"
+
+struct radomeMeshOptimizerStats {
+    int drawCallsBefore;
+    int drawCallsAfter;
+    int verticesBefore;
+    int verticesAfter;
+    // Average cache miss ratio: vertices transformed per triangle.
+    float acmrBefore;
+    float acmrAfter;
+};
+
+class radomeMeshOptimizer {
+public:
+    // Merging changes vertex numbering, so skinned models only get their
+    // triangles reordered. Merged meshes are new aiMeshes owned by the
+    // caller; they are appended to created.
+    radomeMeshOptimizerStats optimize(vector<ofxAssimpMeshHelper>& meshes, bool allowMerge,
+                                      vector<aiMesh*>& created);
+
+    // Simulated FIFO post-transform cache of typical hardware size.
+    static float computeACMR(const vector<ofIndexType>& indices, int vertexCount);
+
+protected:
+    void mergeByMaterial(vector<ofxAssimpMeshHelper>& meshes, vector<aiMesh*>& created);
+    void mergeGroup(vector<ofxAssimpMeshHelper>& meshes, const vector<int>& group,
+                    ofxAssimpMeshHelper& merged, aiMesh*& pMerged);
+    void orderForVertexCache(vector<ofIndexType>& indices, int vertexCount);
+    void orderForOverdraw(const vector<ofVec3f>& positions, vector<ofIndexType>& indices);
+};
+
+#endif /* defined(__radome__radomeMeshOptimizer__) */
@@ -0,0 +1,264 @@
+//
+//  radomeMeshSimplifier.cpp
+//  radome
+//
+
+#include "radomeMeshSimplifier.h"
+
+#include <map>
+#include <stdint.h>
+
+// Open edges are held in place by a plane perpendicular to their face,
+// weighted well above the surface planes so silhouettes don't shrink.
+#define BOUNDARY_WEIGHT 100.0
+// A collapse is rejected if it turns any remaining face more than ~78 degrees.
+#define MIN_NORMAL_DOT 0.2
+
+struct positionLess {
+    bool operator()(const ofVec3f& a, const ofVec3f& b) const {
+        if (a.x != b.x) return a.x < b.x;
+        if (a.y != b.y) return a.y < b.y;
+        return a.z < b.z;
+    }
+};
+
+static uint64_t edgeKey(int a, int b) {
+    return a < b ? ((uint64_t)a << 32) | (uint32_t)b : ((uint64_t)b << 32) | (uint32_t)a;
+}
+
+// Vertices split only for normals or UVs share a position; collapses work
+// on positions so those seams can't tear open.
+void radomeMeshSimplifier::weld(const vector<ofVec3f>& positions) {
+    std::map<ofVec3f, int, positionLess> ids;
+    _positionOf.resize(positions.size());
+    for (int ii = 0; ii < (int)positions.size(); ii++) {
+        auto iter = ids.find(positions[ii]);
+        int id;
+        if (iter == ids.end()) {
+            id = _positions.size();
+            ids[positions[ii]] = id;
+            _positions.push_back(positions[ii]);
+            _positionVertices.push_back(vector<int>());
+        } else {
+            id = iter->second;
+        }
+        _positionOf[ii] = id;
+        _positionVertices[id].push_back(ii);
+    }
+}
+
+void radomeMeshSimplifier::addPlane(Quadric& q, const ofVec3f& normal, float d, double weight) {
+    double a = normal.x, b = normal.y, c = normal.z;
+    q.m[0] += weight * a * a; q.m[1] += weight * a * b; q.m[2] += weight * a * c; q.m[3] += weight * a * d;
+    q.m[4] += weight * b * b; q.m[5] += weight * b * c; q.m[6] += weight * b * d;
+    q.m[7] += weight * c * c; q.m[8] += weight * c * d;
+    q.m[9] += weight * d * d;
+}
+
+double radomeMeshSimplifier::evaluate(const Quadric& q, const ofVec3f& v) const {
+    double x = v.x, y = v.y, z = v.z;
+    return q.m[0] * x * x + 2 * q.m[1] * x * y + 2 * q.m[2] * x * z + 2 * q.m[3] * x
+         + q.m[4] * y * y + 2 * q.m[5] * y * z + 2 * q.m[6] * y
+         + q.m[7] * z * z + 2 * q.m[8] * z
+         + q.m[9];
+}
+
+void radomeMeshSimplifier::buildQuadrics() {
+    Quadric zero;
+    memset(&zero, 0, sizeof(zero));
+    _quadrics.assign(_positions.size(), zero);
+
+    std::map<uint64_t, int> edgeUse;
+    for (int tt = 0; tt < (int)_triangles.size(); tt++) {
+        const Triangle& tri = _triangles[tt];
+        const ofVec3f& p0 = _positions[tri.v[0]];
+        ofVec3f normal = (_positions[tri.v[1]] - p0).getCrossed(_positions[tri.v[2]] - p0);
+        float length = normal.length();
+        if (length > 0) {
+            normal /= length;
+            for (int cc = 0; cc < 3; cc++)
+                addPlane(_quadrics[tri.v[cc]], normal, -normal.dot(p0), length * 0.5);
+        }
+        for (int cc = 0; cc < 3; cc++)
+            edgeUse[edgeKey(tri.v[cc], tri.v[(cc + 1) % 3])]++;
+    }
+
+    for (int tt = 0; tt < (int)_triangles.size(); tt++) {
+        const Triangle& tri = _triangles[tt];
+        const ofVec3f& p0 = _positions[tri.v[0]];
+        ofVec3f faceNormal = (_positions[tri.v[1]] - p0).getCrossed(_positions[tri.v[2]] - p0).getNormalized();
+        for (int cc = 0; cc < 3; cc++) {
+            int a = tri.v[cc], b = tri.v[(cc + 1) % 3];
+            if (edgeUse[edgeKey(a, b)] != 1)
+                continue;
+            ofVec3f edge = _positions[b] - _positions[a];
+            ofVec3f normal = edge.getCrossed(faceNormal).getNormalized();
+            double weight = BOUNDARY_WEIGHT * edge.lengthSquared();
+            float d = -normal.dot(_positions[a]);
+            addPlane(_quadrics[a], normal, d, weight);
+            addPlane(_quadrics[b], normal, d, weight);
+        }
+    }
+}
+
+// Queues the cheaper direction of collapsing the edge a-b.
+void radomeMeshSimplifier::pushCollapse(int a, int b) {
+    Quadric q;
+    for (int ii = 0; ii < 10; ii++)
+        q.m[ii] = _quadrics[a].m[ii] + _quadrics[b].m[ii];
+
+    double toB = evaluate(q, _positions[b]);
+    double toA = evaluate(q, _positions[a]);
+    Collapse c;
+    c.from = toB <= toA ? a : b;
+    c.to = toB <= toA ? b : a;
+    c.cost = MIN(toA, toB);
+    c.fromStamp = _stamps[c.from];
+    c.toStamp = _stamps[c.to];
+    _heap.push(c);
+}
+
+bool radomeMeshSimplifier::flipsFace(int from, int to) {
+    const vector<int>& triangles = _positionTriangles[from];
+    for (auto iter = triangles.begin(); iter != triangles.end(); ++iter) {
+        const Triangle& tri = _triangles[*iter];
+        if (tri.removed || tri.v[0] == to || tri.v[1] == to || tri.v[2] == to)
+            continue;
+
+        ofVec3f before[3], after[3];
+        for (int cc = 0; cc < 3; cc++) {
+            before[cc] = _positions[tri.v[cc]];
+            after[cc] = tri.v[cc] == from ? _positions[to] : before[cc];
+        }
+        ofVec3f n0 = (before[1] - before[0]).getCrossed(before[2] - before[0]);
+        ofVec3f n1 = (after[1] - after[0]).getCrossed(after[2] - after[0]);
+        float l0 = n0.length(), l1 = n1.length();
+        if (l1 == 0 || n0.dot(n1) < MIN_NORMAL_DOT * l0 * l1)
+            return true;
+    }
+    return false;
+}
+
+// Of the vertices at position, the one whose UV is closest to vertex's.
+int radomeMeshSimplifier::cornerFor(int vertex, int position) {
+    const vector<int>& candidates = _positionVertices[position];
+    if (candidates.size() == 1 || _pTexcoords->size() <= (size_t)vertex)
+        return candidates[0];
+
+    const ofVec2f& uv = (*_pTexcoords)[vertex];
+    int best = candidates[0];
+    float bestDistance = uv.squareDistance((*_pTexcoords)[best]);
+    for (int ii = 1; ii < (int)candidates.size(); ii++) {
+        float distance = uv.squareDistance((*_pTexcoords)[candidates[ii]]);
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            best = candidates[ii];
+        }
+    }
+    return best;
+}
+
+void radomeMeshSimplifier::collapse(int from, int to) {
+    vector<int>& triangles = _positionTriangles[from];
+    for (auto iter = triangles.begin(); iter != triangles.end(); ++iter) {
+        Triangle& tri = _triangles[*iter];
+        if (tri.removed)
+            continue;
+        if (tri.v[0] == to || tri.v[1] == to || tri.v[2] == to) {
+            tri.removed = true;
+            _triangleCount--;
+            continue;
+        }
+        for (int cc = 0; cc < 3; cc++) {
+            if (tri.v[cc] == from) {
+                tri.v[cc] = to;
+                tri.corner[cc] = cornerFor(tri.corner[cc], to);
+            }
+        }
+        _positionTriangles[to].push_back(*iter);
+    }
+    triangles.clear();
+
+    for (int ii = 0; ii < 10; ii++)
+        _quadrics[to].m[ii] += _quadrics[from].m[ii];
+    _removed[from] = true;
+    _stamps[to]++;
+
+    // Re-queue every edge around the merged vertex with its new quadric.
+    vector<int> neighbours;
+    const vector<int>& around = _positionTriangles[to];
+    for (auto iter = around.begin(); iter != around.end(); ++iter) {
+        const Triangle& tri = _triangles[*iter];
+        if (tri.removed)
+            continue;
+        for (int cc = 0; cc < 3; cc++) {
+            if (tri.v[cc] != to && std::find(neighbours.begin(), neighbours.end(), tri.v[cc]) == neighbours.end())
+                neighbours.push_back(tri.v[cc]);
+        }
+    }
+    for (auto iter = neighbours.begin(); iter != neighbours.end(); ++iter)
+        pushCollapse(to, *iter);
+}
+
+int radomeMeshSimplifier::simplify(const vector<ofVec3f>& positions, const vector<ofVec2f>& texcoords,
+                                   const vector<ofIndexType>& indices, int targetTriangles,
+                                   vector<ofIndexType>& result) {
+    _pTexcoords = &texcoords;
+    _positionOf.clear();
+    _positions.clear();
+    _positionVertices.clear();
+    _triangles.clear();
+    _heap = std::priority_queue<Collapse>();
+
+    weld(positions);
+    _positionTriangles.assign(_positions.size(), vector<int>());
+    for (int ii = 0; ii + 2 < (int)indices.size(); ii += 3) {
+        Triangle tri;
+        for (int cc = 0; cc < 3; cc++) {
+            tri.corner[cc] = indices[ii + cc];
+            tri.v[cc] = _positionOf[tri.corner[cc]];
+        }
+        if (tri.v[0] == tri.v[1] || tri.v[1] == tri.v[2] || tri.v[2] == tri.v[0])
+            continue;
+        tri.removed = false;
+        for (int cc = 0; cc < 3; cc++)
+            _positionTriangles[tri.v[cc]].push_back(_triangles.size());
+        _triangles.push_back(tri);
+    }
+    _triangleCount = _triangles.size();
+    _stamps.assign(_positions.size(), 0);
+    _removed.assign(_positions.size(), false);
+    buildQuadrics();
+
+    std::map<uint64_t, bool> queued;
+    for (auto iter = _triangles.begin(); iter != _triangles.end(); ++iter) {
+        for (int cc = 0; cc < 3; cc++) {
+            int a = iter->v[cc], b = iter->v[(cc + 1) % 3];
+            if (!queued[edgeKey(a, b)]) {
+                queued[edgeKey(a, b)] = true;
+                pushCollapse(a, b);
+            }
+        }
+    }
+
+    while (_triangleCount > targetTriangles && !_heap.empty()) {
+        Collapse c = _heap.top();
+        _heap.pop();
+        if (_removed[c.from] || _removed[c.to] ||
+            c.fromStamp != _stamps[c.from] || c.toStamp != _stamps[c.to])
+            continue;
+        if (flipsFace(c.from, c.to))
+            continue;
+        collapse(c.from, c.to);
+    }
+
+    result.clear();
+    result.reserve(_triangleCount * 3);
+    for (auto iter = _triangles.begin(); iter != _triangles.end(); ++iter) {
+        if (iter->removed)
+            continue;
+        for (int cc = 0; cc < 3; cc++)
+            result.push_back(iter->corner[cc]);
+    }
+    return _triangleCount;
+}
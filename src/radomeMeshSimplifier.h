@@ -0,0 +1,80 @@
+//
+//  radomeMeshSimplifier.h
+//  radome
+//
+//  Quadric error metric edge collapse. Every collapse moves one vertex onto a
+//  neighbour, so simplified index lists still refer to the original vertices
+//  and each LOD is just another index range in the mesh's own VBO.
+//
+
+#ifndef __radome__radomeMeshSimplifier__
+#define __radome__radomeMeshSimplifier__
+
+#include "ofMain.h"
+
+#include <queue>
+
+#define MAX_LOD_LEVELS 4
+
+// Index ranges of a mesh's detail levels, finest first, plus its bounds in
+// mesh space for picking a level from projected size.
+struct radomeMeshLod {
+    ofVec3f center;
+    float radius;
+    int levelCount;
+    int indexOffset[MAX_LOD_LEVELS];
+    int indexCount[MAX_LOD_LEVELS];
+};
+
+class radomeMeshSimplifier {
+public:
+    // Collapses edges until at most targetTriangles remain or no collapse is
+    // left that wouldn't flip a face. texcoords may be empty; when present they
+    // pick which of the vertices sharing a position a corner moves to, so UV
+    // seams survive. Returns the triangle count of result.
+    int simplify(const vector<ofVec3f>& positions, const vector<ofVec2f>& texcoords,
+                 const vector<ofIndexType>& indices, int targetTriangles,
+                 vector<ofIndexType>& result);
+
+protected:
+    // Symmetric 4x4 matrix, upper triangle.
+    struct Quadric {
+        double m[10];
+    };
+    struct Triangle {
+        int v[3];        // welded position ids
+        int corner[3];   // original vertex ids
+        bool removed;
+    };
+    struct Collapse {
+        double cost;
+        int from;
+        int to;
+        unsigned int fromStamp;
+        unsigned int toStamp;
+        bool operator<(const Collapse& other) const { return cost > other.cost; }
+    };
+
+    void weld(const vector<ofVec3f>& positions);
+    void buildQuadrics();
+    void addPlane(Quadric& q, const ofVec3f& normal, float d, double weight);
+    double evaluate(const Quadric& q, const ofVec3f& v) const;
+    void pushCollapse(int a, int b);
+    bool flipsFace(int from, int to);
+    void collapse(int from, int to);
+    int cornerFor(int vertex, int position);
+
+    const vector<ofVec2f>* _pTexcoords;
+    vector<int> _positionOf;              // original vertex -> welded position
+    vector<ofVec3f> _positions;
+    vector< vector<int> > _positionVertices;
+    vector< vector<int> > _positionTriangles;
+    vector<Quadric> _quadrics;
+    vector<unsigned int> _stamps;
+    vector<bool> _removed;
+    vector<Triangle> _triangles;
+    std::priority_queue<Collapse> _heap;
+    int _triangleCount;
+};
+
+#endif /* defined(__radome__radomeMeshSimplifier__) */
@@ -8,19 +8,74 @@
 
 #include "radomeModel.h"
 
-void radomeModel::update(float t) {
-    setNormalizedTime(t);
-    if (_rotationIncrement) {
-        _rotation[0] += _rotationIncrement;
+radomeModel::radomeModel(radomeModelCache* pCache, radomeModelAsset* pAsset)
+: _pCache(pCache)
+, _pAsset(pAsset)
+, _rotationIncrement(0)
+, _transformVersion(0)
+, _front(0)
+{
+    _frames[0].world = getWorldMatrix();
+    _frames[0].transform = getTransform();
+    _frames[0].animationTime = 0;
+    _frames[1] = _frames[0];
+}
+
+radomeModel::~radomeModel() {
+    if (_pCache)
+        _pCache->release(_pAsset);
+}
+
+// Rotating invalidates the node's children, and the transform reads its
+// parent's, which is why only unrelated models may update side by side.
+void radomeModel::update(float t, int steps, float alpha) {
+    for (int ii = 0; _rotationIncrement && ii < steps; ii++) {
+        rotate(_rotationIncrement);
+    }
+    radomeModelFrame& back = _frames[1 - _front];
+    back.animationTime = t;
+
+    // Children are updated from this node's live transform, so a parent is
+    // drawn at its last step too.
+    if (!_rotationIncrement || alpha >= 1 || !getChildren().empty()) {
+        back.world = getWorldMatrix();
+        back.transform = getTransform();
+        return;
+    }
+    ofVec4f rotation = getRotation();
+    setRotation(ofVec4f(rotation.x - _rotationIncrement * (1 - alpha), rotation.y, rotation.z, rotation.w));
+    back.world = getWorldMatrix();
+    back.transform = getTransform();
+    setRotation(rotation);
+}
+
+// Animated assets are posed on their shared meshes, so every instance shows the
+// pose of the last time set; all instances follow the app's clock, so the pose
+// is evaluated once per frame rather than once per copy.
+void radomeModel::publish() {
+    _front = 1 - _front;
+    if (_pAsset->isAnimated())
+        _pAsset->setAnimationTime(_frames[_front].animationTime);
+    _pAsset->restoreTexturesIfNeeded();
+}
+
+const ofMatrix4x4& radomeModel::getTransform() const {
+    unsigned int version = getWorldVersion();
+    if (version != _transformVersion) {
+        _transform = _pAsset->getLoaderTransform() * getWorldMatrix();
+        _transformVersion = version;
     }
+    return _transform;
+}
+
+void radomeModel::enqueue(radomeRenderQueue& queue) {
+    _pAsset->enqueue(queue, queue.allocTransform(_frames[_front].transform));
 }
 
 void radomeModel::draw() {
+    _pAsset->markUsed();
     ofPushMatrix();
-    ofTranslate(_origin);
-    ofTranslate(-_rotationOrigin);
-    ofRotate(_rotation[0], _rotation[1], _rotation[2], _rotation[3]);
-    ofTranslate(_rotationOrigin);
-    drawFaces();
+    ofMultMatrix(_frames[_front].world);
+    _pAsset->drawFaces();
     ofPopMatrix();
-}
\ No newline at end of file
+}
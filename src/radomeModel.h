@@ -9,31 +9,59 @@
 #ifndef __radome__radomeModel__
 #define __radome__radomeModel__
 
-#include "ofxAssimpModelLoader.h"
+#include "radomeModelAsset.h"
+#include "radomeRenderQueue.h"
+#include "radomeSceneNode.h"
 
-class radomeModel : public ofxAssimpModelLoader {
+// What drawing reads of a model. update() fills in the back copy while the
+// front one stays as it was, and publish() swaps them once every model has
+// been updated, so a draw never sees a model half-way through its update.
+struct radomeModelFrame {
+    ofMatrix4x4 world;
+    ofMatrix4x4 transform;
+    float animationTime;
+};
+
+// One placement of a shared radomeModelAsset: a transform and animation state.
+class radomeModel : public radomeSceneNode {
 public:
-    void update(float t);
-    void draw();
+    radomeModel(radomeModelCache* pCache, radomeModelAsset* pAsset);
+    ~radomeModel();
 
-    ofVec3f getOrigin() const { return _origin; }
-    void setOrigin(ofVec3f o) { _origin = o; }
+    radomeModelAsset* getAsset() const { return _pAsset; }
 
-    ofVec4f getRotation() const { return _rotation; }
-    void setRotation(ofVec4f r) { _rotation = r; }
+    // CPU only, and safe to run concurrently for models that aren't
+    // attached to one another. Spins by the rotation increment once per
+    // simulation step, and draws alpha of the way from the step before the
+    // last to the last one.
+    void update(float t, int steps, float alpha);
+    // Makes the state update() produced current. GL thread.
+    void publish();
+    void draw();
 
-    ofVec3f getRotationOrigin() const { return _rotationOrigin; }
-    void setRotationOrigin(ofVec3f o) { _rotationOrigin = o; }
+    // Submits every mesh of the asset to the queue under this instance's transform.
+    void enqueue(radomeRenderQueue& queue);
+    // Asset placement followed by the node's world transform; rebuilt only
+    // when the world matrix has changed. This is the live transform; drawing
+    // uses the one last published.
+    const ofMatrix4x4& getTransform() const;
 
     float getRotationIncrement() const { return _rotationIncrement; }
     void setRotationIncrement(float f) { _rotationIncrement = f; }
-    
-    ofVec3f _origin;
+
+    float getAnimationTime() const { return _frames[_front].animationTime; }
 
 protected:
-    ofVec4f _rotation;
-    ofVec3f _rotationOrigin;
+    radomeModelCache* _pCache;
+    radomeModelAsset* _pAsset;
+
     float _rotationIncrement;
+
+    mutable ofMatrix4x4 _transform;
+    mutable unsigned int _transformVersion;
+
+    radomeModelFrame _frames[2];
+    int _front;
 };
 
 #endif /* defined(__radome__radomeModel__) */
@@ -0,0 +1,801 @@
+//
+//  radomeModelAsset.cpp
+//  radome
+//
+
+#include "radomeModelAsset.h"
+#include "aiConfig.h"
+#include "aiPostProcess.h"
+
+#include <climits>
+#include <sys/stat.h>
+
+#define MAX_TEXTURE_DIVISOR 4
+// GL thread time spent creating buffers for models still loading, per frame.
+#define MODEL_UPLOAD_MICROS_PER_FRAME 4000
+
+radomeModelAsset::radomeModelAsset(const string& path)
+: _path(path)
+, _refCount(0)
+, _ready(false)
+, _uploadedMeshes(0)
+, _animationTime(0)
+, _animationValid(false)
+, _posedTime(0)
+, _posed(false)
+, _posedOnGpu(false)
+, _pStream(NULL)
+, _streamedFrame(0)
+, _pPalette(NULL)
+, _skinnedFrame(0)
+, _bindPoseDirty(false)
+, _pLodBuilder(NULL)
+, _geometryBytes(0)
+, _pTexturePipeline(NULL)
+, _geometryAllocation(0)
+, _lastDrawnFrame(0)
+{
+    memset(&_skinningTimes, 0, sizeof(_skinningTimes));
+    memset(&_importStats, 0, sizeof(_importStats));
+}
+
+radomeModelAsset::~radomeModelAsset() {
+    if (_binary.isMapped()) {
+        // Our own scene, pointing into the mapping: not Assimp's to release.
+        _binary.release(scene);
+        scene = NULL;
+    }
+    if (_pLodBuilder)
+        _pLodBuilder->cancel(this);
+    if (_pTexturePipeline)
+        _pTexturePipeline->cancel(this);
+    for (auto iter = _textureSources.begin(); iter != _textureSources.end(); ++iter) {
+        if (iter->texture)
+            glDeleteTextures(1, &iter->texture);
+        delete iter->pImage;
+    }
+    radomeGpuMemory::get().unregisterClient(this);
+    radomeGpuMemory::get().releaseOwner(this);
+    for (auto iter = _mergedMeshes.begin(); iter != _mergedMeshes.end(); ++iter)
+        delete *iter;
+}
+
+bool radomeModelAsset::load() {
+    return prepare() && upload(ULLONG_MAX);
+}
+
+// No GL in here: this runs on the model loader's thread.
+bool radomeModelAsset::prepare() {
+    unsigned long long start = ofGetElapsedTimeMicros();
+    string fullPath = ofToDataPath(_path, true);
+    if (ofToLower(ofFilePath::getFileExt(_path)) == "rdm")
+        return prepareConverted(fullPath, -1, -1, start);
+
+    struct stat info;
+    bool hasInfo = stat(fullPath.c_str(), &info) == 0;
+    string cachePath = radomeBinaryModel::getCachePath(fullPath);
+    if (hasInfo && prepareConverted(cachePath, info.st_size, info.st_mtime, start))
+        return true;
+
+    if (!importScene())
+        return false;
+    calculateDimensions();
+    buildMeshes();
+    optimizeMeshes();
+    if (isAnimated())
+        _skeleton.setup(scene);
+    computeBounds();
+    findTextureSources();
+
+    unsigned long long importMicros = ofGetElapsedTimeMicros() - start;
+    ofLogNotice() << ofFilePath::getFileName(_path) << ": imported through Assimp in "
+                  << ofToString(importMicros / 1000.0, 1) << " ms";
+    if (hasInfo)
+        radomeBinaryModel::write(cachePath, *this, info.st_size, info.st_mtime, importMicros);
+    return true;
+}
+
+// Everything the import, optimizer and texture search produced comes out of
+// the file; only the per-load tables are rebuilt.
+bool radomeModelAsset::prepareConverted(const string& path, long long sourceSize, long long sourceTime,
+                                        unsigned long long startMicros) {
+    if (!_binary.read(path, *this, sourceSize, sourceTime))
+        return false;
+    if (isAnimated())
+        _skeleton.setup(scene);
+    computeBounds();
+
+    unsigned long long micros = ofGetElapsedTimeMicros() - startMicros;
+    ofLogNotice() << ofFilePath::getFileName(_path) << ": loaded converted model in "
+                  << ofToString(micros / 1000.0, 1) << " ms (Assimp import took "
+                  << ofToString(_binary.getImportMicros() / 1000.0, 1) << " ms)";
+    return true;
+}
+
+bool radomeModelAsset::importScene() {
+    // Same import settings as ofxAssimpModelLoader::loadModel().
+    aiSetImportPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_LINE | aiPrimitiveType_POINT);
+    unsigned int flags = aiProcessPreset_TargetRealtime_MaxQuality | aiProcess_Triangulate | aiProcess_FlipUVs;
+    scene = aiImportFile(ofToDataPath(_path).c_str(), flags);
+    if (!scene)
+        ofLogError() << "couldn't import " << _path << ": " << aiGetErrorString();
+    return scene != NULL;
+}
+
+// What ofxAssimpModelLoader::loadGLResources() sets up, minus anything GL:
+// buffers are created by upload(), and textures come from the texture
+// pipeline, so texcoords stay Assimp's 0-1 ones rather than being scaled to
+// a rectangle texture's pixels.
+void radomeModelAsset::buildMeshes() {
+    modelMeshes.clear();
+    modelMeshes.resize(scene->mNumMeshes);
+    for (unsigned int ii = 0; ii < scene->mNumMeshes; ii++) {
+        aiMesh* pMesh = scene->mMeshes[ii];
+        ofxAssimpMeshHelper& helper = modelMeshes[ii];
+        helper.mesh = pMesh;
+        helper.hasChanged = false;
+        helper.animatedPos.resize(pMesh->mNumVertices);
+        if (pMesh->HasNormals())
+            helper.animatedNorm.resize(pMesh->mNumVertices);
+
+        ofMesh& mesh = helper.cachedMesh;
+        mesh.setMode(OF_PRIMITIVE_TRIANGLES);
+        for (unsigned int vv = 0; vv < pMesh->mNumVertices; vv++) {
+            mesh.addVertex(ofVec3f(pMesh->mVertices[vv].x, pMesh->mVertices[vv].y, pMesh->mVertices[vv].z));
+            if (pMesh->HasNormals())
+                mesh.addNormal(ofVec3f(pMesh->mNormals[vv].x, pMesh->mNormals[vv].y, pMesh->mNormals[vv].z));
+            if (pMesh->HasTextureCoords(0))
+                mesh.addTexCoord(ofVec2f(pMesh->mTextureCoords[0][vv].x, pMesh->mTextureCoords[0][vv].y));
+            if (pMesh->HasVertexColors(0)) {
+                const aiColor4D& color = pMesh->mColors[0][vv];
+                mesh.addColor(ofFloatColor(color.r, color.g, color.b, color.a));
+            }
+        }
+        helper.validCache = true;
+
+        helper.indices.reserve(pMesh->mNumFaces * 3);
+        for (unsigned int ff = 0; ff < pMesh->mNumFaces; ff++) {
+            const aiFace& face = pMesh->mFaces[ff];
+            for (unsigned int cc = 0; cc < face.mNumIndices; cc++)
+                helper.indices.push_back(face.mIndices[cc]);
+        }
+
+        const aiMaterial* pMaterial = scene->mMaterials[pMesh->mMaterialIndex];
+        aiColor4D color;
+        if (aiGetMaterialColor(pMaterial, AI_MATKEY_COLOR_DIFFUSE, &color) == aiReturn_SUCCESS)
+            helper.material.setDiffuseColor(ofFloatColor(color.r, color.g, color.b, color.a));
+        if (aiGetMaterialColor(pMaterial, AI_MATKEY_COLOR_SPECULAR, &color) == aiReturn_SUCCESS)
+            helper.material.setSpecularColor(ofFloatColor(color.r, color.g, color.b, color.a));
+        if (aiGetMaterialColor(pMaterial, AI_MATKEY_COLOR_AMBIENT, &color) == aiReturn_SUCCESS)
+            helper.material.setAmbientColor(ofFloatColor(color.r, color.g, color.b, color.a));
+        if (aiGetMaterialColor(pMaterial, AI_MATKEY_COLOR_EMISSIVE, &color) == aiReturn_SUCCESS)
+            helper.material.setEmissiveColor(ofFloatColor(color.r, color.g, color.b, color.a));
+        float shininess;
+        if (aiGetMaterialFloat(pMaterial, AI_MATKEY_SHININESS, &shininess) == aiReturn_SUCCESS)
+            helper.material.setShininess(shininess);
+        int blendMode;
+        if (aiGetMaterialInteger(pMaterial, AI_MATKEY_BLEND_FUNC, &blendMode) == aiReturn_SUCCESS)
+            helper.blendMode = blendMode == aiBlendMode_Default ? OF_BLENDMODE_ALPHA : OF_BLENDMODE_ADD;
+        int twoSided;
+        unsigned int count = 1;
+        helper.twoSided = aiGetMaterialIntegerArray(pMaterial, AI_MATKEY_TWOSIDED, &twoSided, &count) == aiReturn_SUCCESS
+                          && twoSided;
+    }
+}
+
+// GL thread. Every call makes progress on at least one mesh.
+bool radomeModelAsset::upload(unsigned long long deadlineMicros) {
+    while (_uploadedMeshes < (int)modelMeshes.size()) {
+        uploadMesh(modelMeshes[_uploadedMeshes++]);
+        if (_uploadedMeshes < (int)modelMeshes.size() && ofGetElapsedTimeMicros() >= deadlineMicros)
+            return false;
+    }
+    _skeleton.upload();
+    trackGpuMemory();
+    _ready = true;
+    _lastDrawnFrame = radomeGpuMemory::get().getFrame();
+    // Only now: until the loader's thread is done with prepare(), the meshes
+    // and texture sources are still being built and there's nothing to evict.
+    radomeGpuMemory::get().registerClient(this);
+    return true;
+}
+
+// Straight from the aiMesh arrays, which for a converted model are the
+// mapped file itself. Texcoords keep aiMesh's three-float stride.
+void radomeModelAsset::uploadMesh(ofxAssimpMeshHelper& helper) {
+    const aiMesh* pMesh = helper.mesh;
+    if (!pMesh || !pMesh->mNumVertices)
+        return;
+    int vertexCount = pMesh->mNumVertices;
+
+    // Animated positions and normals are rewritten every pose on the CPU path.
+    int usage = isAnimated() ? GL_STREAM_DRAW : GL_STATIC_DRAW;
+    helper.vbo.setVertexData(&pMesh->mVertices[0].x, 3, vertexCount, usage, sizeof(aiVector3D));
+    if (pMesh->HasNormals())
+        helper.vbo.setNormalData(&pMesh->mNormals[0].x, vertexCount, usage, sizeof(aiVector3D));
+    if (pMesh->HasVertexColors(0))
+        helper.vbo.setColorData(&pMesh->mColors[0][0].r, vertexCount, GL_STATIC_DRAW, sizeof(aiColor4D));
+    if (pMesh->HasTextureCoords(0))
+        helper.vbo.setTexCoordData(&pMesh->mTextureCoords[0][0].x, vertexCount, GL_STATIC_DRAW, sizeof(aiVector3D));
+    if (!helper.indices.empty())
+        helper.vbo.setIndexData(&helper.indices[0], helper.indices.size(), GL_STATIC_DRAW);
+}
+
+// Runs before anything else looks at modelMeshes: merging replaces meshes
+// and renumbers their vertices.
+void radomeModelAsset::optimizeMeshes() {
+    radomeMeshOptimizer optimizer;
+    _importStats = optimizer.optimize(modelMeshes, !isAnimated(), _mergedMeshes);
+    ofLogNotice() << ofFilePath::getFileName(_path) << ": "
+                  << _importStats.drawCallsBefore << " -> " << _importStats.drawCallsAfter << " draw calls, "
+                  << _importStats.verticesBefore << " -> " << _importStats.verticesAfter << " vertices, ACMR "
+                  << ofToString(_importStats.acmrBefore, 2) << " -> " << ofToString(_importStats.acmrAfter, 2);
+}
+
+bool radomeModelAsset::isAnimated() {
+    return scene && scene->mNumAnimations > 0;
+}
+
+bool radomeModelAsset::isGpuSkinned() const {
+    return _pPalette && _pPalette->isAllocated() && _skeleton.isValid();
+}
+
+void radomeModelAsset::setAnimationTime(float t) {
+    bool gpuSkinned = isGpuSkinned();
+    bool streaming = !gpuSkinned && _pStream && _pStream->isAllocated();
+    if (_animationValid && t == _animationTime) {
+        // Same pose, but last frame's palette or stream region is about to be reused.
+        if (gpuSkinned && _skinnedFrame != _pPalette->getFrameCount())
+            poseOnGpu();
+        else if (streaming && _streamedFrame != _pStream->getStats().frames)
+            streamAnimatedMeshes();
+        return;
+    }
+    _animationTime = t;
+    _animationValid = true;
+
+    // Free if a job has posed this time already.
+    poseAnimation(t);
+    if (gpuSkinned) {
+        poseOnGpu();
+        return;
+    }
+
+    _skinnedFrame = 0;
+    _bindPoseDirty = true;
+    if (!streaming) {
+        _vertexStreams.clear();
+        uploadAnimatedMeshes();
+    } else {
+        streamAnimatedMeshes();
+    }
+}
+
+// setNormalizedTime() minus its VBO upload: on the GPU path only the node
+// hierarchy is evaluated, on the CPU path every skinned vertex too.
+void radomeModelAsset::poseAnimation(float t) {
+    ofScopedLock lock(_poseMutex);
+    bool gpuSkinned = isGpuSkinned();
+    if (_posed && t == _posedTime && gpuSkinned == _posedOnGpu)
+        return;
+    _posed = true;
+    _posedTime = t;
+    _posedOnGpu = gpuSkinned;
+
+    unsigned long long start = ofGetElapsedTimeMicros();
+    const aiAnimation* pAnimation = scene->mAnimations[currentAnimation];
+    double ticks = ofMap(t, 0.0, 1.0, 0.0, pAnimation->mDuration, false);
+    if (gpuSkinned) {
+        _skeleton.pose(currentAnimation, ticks);
+        _skinningTimes.gpuPoses++;
+        _skinningTimes.gpuMicros += ofGetElapsedTimeMicros() - start;
+    } else {
+        updateAnimation(currentAnimation, ticks);
+        _skinningTimes.cpuPoses++;
+        _skinningTimes.cpuMicros += ofGetElapsedTimeMicros() - start;
+    }
+}
+
+// The hierarchy is posed already: only bone matrices go into the palette,
+// and vertices stay untouched in the VBOs.
+void radomeModelAsset::poseOnGpu() {
+    _vertexStreams.clear();
+    if (_bindPoseDirty)
+        restoreBindPose();
+    _skeleton.writeBones(*_pPalette);
+    _skinnedFrame = _pPalette->getFrameCount();
+}
+
+// The upload setNormalizedTime() does after posing: skinned vertices
+// straight into each mesh's VBO.
+void radomeModelAsset::uploadAnimatedMeshes() {
+    for (auto iter = modelMeshes.begin(); iter != modelMeshes.end(); ++iter) {
+        const aiMesh* pMesh = iter->mesh;
+        if (!pMesh || !pMesh->HasBones() || iter->animatedPos.size() < pMesh->mNumVertices)
+            continue;
+        iter->vbo.updateVertexData(&iter->animatedPos[0].x, pMesh->mNumVertices);
+        if (pMesh->HasNormals() && iter->animatedNorm.size() >= pMesh->mNumVertices)
+            iter->vbo.updateNormalData(&iter->animatedNorm[0].x, pMesh->mNumVertices);
+    }
+}
+
+// The CPU path may have left posed vertices in the VBOs; the skinning shader
+// needs the bind pose back.
+void radomeModelAsset::restoreBindPose() {
+    for (auto iter = modelMeshes.begin(); iter != modelMeshes.end(); ++iter) {
+        const aiMesh* pMesh = iter->mesh;
+        if (!pMesh || !pMesh->HasBones())
+            continue;
+        iter->vbo.updateVertexData(&pMesh->mVertices[0].x, pMesh->mNumVertices);
+        if (pMesh->HasNormals())
+            iter->vbo.updateNormalData(&pMesh->mNormals[0].x, pMesh->mNumVertices);
+    }
+    _bindPoseDirty = false;
+}
+
+void radomeModelAsset::streamAnimatedMeshes() {
+    _streamedFrame = _pStream->getStats().frames;
+    _vertexStreams.resize(modelMeshes.size());
+    for (int ii = 0; ii < (int)modelMeshes.size(); ii++) {
+        ofxAssimpMeshHelper& helper = modelMeshes[ii];
+        radomeVertexStream& stream = _vertexStreams[ii];
+        stream.buffer = 0;
+
+        const aiMesh* pMesh = helper.mesh;
+        if (!pMesh || !pMesh->HasBones() || helper.animatedPos.size() < pMesh->mNumVertices)
+            continue;
+
+        size_t bytes = pMesh->mNumVertices * 3 * sizeof(float);
+        bool hasNormals = pMesh->HasNormals() && helper.animatedNorm.size() >= pMesh->mNumVertices;
+        void* pPositions = _pStream->reserve(bytes, stream.positionOffset);
+        void* pNormals = (pPositions && hasNormals) ? _pStream->reserve(bytes, stream.normalOffset) : NULL;
+
+        if (!pPositions || (hasNormals && !pNormals)) {
+            // Ring is full this frame (it grows next frame): take the stalling path.
+            helper.vbo.updateVertexData(&helper.animatedPos[0].x, pMesh->mNumVertices);
+            if (hasNormals)
+                helper.vbo.updateNormalData(&helper.animatedNorm[0].x, pMesh->mNumVertices);
+            continue;
+        }
+
+        memcpy(pPositions, &helper.animatedPos[0].x, bytes);
+        if (hasNormals)
+            memcpy(pNormals, &helper.animatedNorm[0].x, bytes);
+        stream.buffer = _pStream->getBufferId();
+        stream.hasNormals = hasNormals;
+    }
+}
+
+void radomeModelAsset::enqueue(radomeRenderQueue& queue, const ofMatrix4x4* pTransform) {
+    bool streamed = _vertexStreams.size() == modelMeshes.size();
+    bool skinned = _skinnedFrame && isGpuSkinned();
+    for (int ii = 0; ii < (int)modelMeshes.size(); ii++) {
+        ofxAssimpMeshHelper& helper = modelMeshes[ii];
+        queue.submit(NULL,
+                     bUsingTextures ? &helper.texture : NULL,
+                     bUsingMaterials ? &helper.material : NULL,
+                     &helper.vbo, helper.indices.size(), 0, pTransform,
+                     streamed ? &_vertexStreams[ii] : NULL,
+                     skinned ? _skeleton.getSkin(ii) : NULL,
+                     ii < (int)_lods.size() ? &_lods[ii] : NULL, &_lastDrawnFrame);
+    }
+}
+
+// Every mesh starts with just its full-detail range, bounded by the sphere
+// around its bind pose.
+void radomeModelAsset::computeBounds() {
+    _lods.resize(modelMeshes.size());
+    for (int ii = 0; ii < (int)modelMeshes.size(); ii++) {
+        radomeMeshLod& lod = _lods[ii];
+        const aiMesh* pMesh = modelMeshes[ii].mesh;
+        lod.levelCount = 1;
+        lod.indexOffset[0] = 0;
+        lod.indexCount[0] = modelMeshes[ii].indices.size();
+        lod.center.set(0, 0, 0);
+        lod.radius = 0;
+        if (!pMesh || !pMesh->mNumVertices)
+            continue;
+
+        ofVec3f low(pMesh->mVertices[0].x, pMesh->mVertices[0].y, pMesh->mVertices[0].z);
+        ofVec3f high = low;
+        for (unsigned int vv = 1; vv < pMesh->mNumVertices; vv++) {
+            const aiVector3D& v = pMesh->mVertices[vv];
+            low.set(MIN(low.x, v.x), MIN(low.y, v.y), MIN(low.z, v.z));
+            high.set(MAX(high.x, v.x), MAX(high.y, v.y), MAX(high.z, v.z));
+        }
+        lod.center = (low + high) * 0.5;
+        lod.radius = (high - low).length() * 0.5;
+    }
+}
+
+void radomeModelAsset::requestLods(radomeLodBuilder* pBuilder) {
+    _pLodBuilder = pBuilder;
+    for (int ii = 0; ii < (int)modelMeshes.size(); ii++) {
+        const aiMesh* pMesh = modelMeshes[ii].mesh;
+        if (!pMesh || modelMeshes[ii].indices.empty())
+            continue;
+
+        radomeLodJob* pJob = new radomeLodJob();
+        pJob->pOwner = this;
+        pJob->meshIndex = ii;
+        pJob->indices = modelMeshes[ii].indices;
+        pJob->positions.resize(pMesh->mNumVertices);
+        for (unsigned int vv = 0; vv < pMesh->mNumVertices; vv++)
+            pJob->positions[vv].set(pMesh->mVertices[vv].x, pMesh->mVertices[vv].y, pMesh->mVertices[vv].z);
+        if (pMesh->HasTextureCoords(0)) {
+            pJob->texcoords.resize(pMesh->mNumVertices);
+            for (unsigned int vv = 0; vv < pMesh->mNumVertices; vv++)
+                pJob->texcoords[vv].set(pMesh->mTextureCoords[0][vv].x, pMesh->mTextureCoords[0][vv].y);
+        }
+        pBuilder->submit(pJob);
+    }
+}
+
+// Levels are appended after the full-detail indices in the mesh's own index
+// buffer; helper.indices is left alone, so drawFaces() still draws level 0.
+void radomeModelAsset::applyLods(radomeLodJob& job) {
+    if (job.meshIndex >= (int)modelMeshes.size() || job.levels.empty())
+        return;
+
+    ofxAssimpMeshHelper& helper = modelMeshes[job.meshIndex];
+    radomeMeshLod& lod = _lods[job.meshIndex];
+    vector<ofIndexType> combined(helper.indices);
+    lod.levelCount = 1;
+    for (auto iter = job.levels.begin(); iter != job.levels.end() && lod.levelCount < MAX_LOD_LEVELS; ++iter) {
+        lod.indexOffset[lod.levelCount] = combined.size();
+        lod.indexCount[lod.levelCount] = iter->size();
+        combined.insert(combined.end(), iter->begin(), iter->end());
+        lod.levelCount++;
+    }
+    helper.vbo.setIndexData(&combined[0], combined.size(), GL_STATIC_DRAW);
+
+    _geometryBytes += (combined.size() - helper.indices.size()) * sizeof(ofIndexType);
+    radomeGpuMemory::get().resize(_geometryAllocation, _geometryBytes);
+}
+
+// Same transform ofxAssimpModelLoader::drawFaces() builds on the matrix stack.
+ofMatrix4x4 radomeModelAsset::getLoaderTransform() const {
+    ofMatrix4x4 m;
+    m.glTranslate(pos);
+    m.glRotate(180, 0, 0, 1);
+    m.glTranslate(-scene_center);
+    if (normalizeScale)
+        m.glScale(normalizedScale, normalizedScale, normalizedScale);
+    for (int ii = 0; ii < (int)rotAngle.size(); ii++)
+        m.glRotate(rotAngle[ii], rotAxis[ii].x, rotAxis[ii].y, rotAxis[ii].z);
+    m.glScale(scale.x, scale.y, scale.z);
+    return m;
+}
+
+// Meshes can share a texture file; group them so each file is accounted once.
+void radomeModelAsset::findTextureSources() {
+    _textureSources.clear();
+    if (!scene)
+        return;
+
+    string directory = ofFilePath::getEnclosingDirectory(_path, false);
+    for (int ii = 0; ii < (int)modelMeshes.size(); ii++) {
+        const aiMesh* pMesh = modelMeshes[ii].mesh;
+        if (!pMesh || !pMesh->HasTextureCoords(0))
+            continue;
+
+        aiString texPath;
+        const aiMaterial* pMaterial = scene->mMaterials[pMesh->mMaterialIndex];
+        if (pMaterial->GetTexture(aiTextureType_DIFFUSE, 0, &texPath) != aiReturn_SUCCESS)
+            continue;
+
+        string fullPath = ofFilePath::join(directory, texPath.data);
+        TextureSource* pSource = NULL;
+        for (auto iter = _textureSources.begin(); iter != _textureSources.end(); ++iter) {
+            if (iter->path == fullPath)
+                pSource = &(*iter);
+        }
+        if (!pSource) {
+            TextureSource source;
+            source.path = fullPath;
+            source.divisor = 1;
+            source.allocation = 0;
+            source.pImage = NULL;
+            source.texture = 0;
+            _textureSources.push_back(source);
+            pSource = &_textureSources.back();
+        }
+        pSource->meshes.push_back(ii);
+    }
+}
+
+void radomeModelAsset::trackGpuMemory() {
+    radomeGpuMemory& tracker = radomeGpuMemory::get();
+    tracker.releaseOwner(this);
+
+    string name = ofFilePath::getFileName(_path);
+    size_t geometryBytes = 0;
+    for (auto iter = modelMeshes.begin(); iter != modelMeshes.end(); ++iter) {
+        if (iter->mesh) {
+            // positions, normals and texcoords, plus indices
+            geometryBytes += iter->mesh->mNumVertices * (3 + 3 + 2) * sizeof(float);
+        }
+        geometryBytes += iter->indices.size() * sizeof(ofIndexType);
+    }
+    if (_skeleton.isValid())
+        geometryBytes += _skeleton.getWeightBytes();
+    _geometryBytes = geometryBytes;
+    _geometryAllocation = tracker.track(this, name, GpuModelGeometry, geometryBytes);
+
+    // Textures take up nothing until the pipeline delivers them.
+    for (auto iter = _textureSources.begin(); iter != _textureSources.end(); ++iter)
+        iter->allocation = tracker.track(this, name, GpuModelTexture, 0);
+}
+
+bool radomeModelAsset::reloadTexture(TextureSource& source, int divisor) {
+    radomeGpuMemory& tracker = radomeGpuMemory::get();
+
+    if (divisor == 0) {
+        for (auto iter = source.meshes.begin(); iter != source.meshes.end(); ++iter)
+            modelMeshes[*iter].texture.clear();
+        if (source.texture) {
+            glDeleteTextures(1, &source.texture);
+            source.texture = 0;
+        }
+        tracker.resize(source.allocation, 0);
+        source.divisor = 0;
+        return true;
+    }
+
+    // Nothing to resize until the pipeline has delivered; after that a
+    // smaller size is just the mip chain from a later level, no decode.
+    if (!source.pImage)
+        return false;
+    int firstLevel = 0;
+    while ((1 << firstLevel) < divisor && firstLevel + 1 < (int)source.pImage->levels.size())
+        firstLevel++;
+    useTexture(source, _pTexturePipeline->upload(*source.pImage, firstLevel), firstLevel);
+    source.divisor = divisor;
+    return true;
+}
+
+void radomeModelAsset::requestTextures(radomeTexturePipeline* pPipeline) {
+    _pTexturePipeline = pPipeline;
+    for (int ii = 0; ii < (int)_textureSources.size(); ii++)
+        pPipeline->request(this, ii, _textureSources[ii].path);
+}
+
+void radomeModelAsset::applyTexture(const radomeTextureResult& result) {
+    GLuint texture = result.texture;
+    if (result.slot >= (int)_textureSources.size()) {
+        glDeleteTextures(1, &texture);
+        delete result.pImage;
+        return;
+    }
+
+    TextureSource& source = _textureSources[result.slot];
+    delete source.pImage;
+    source.pImage = result.pImage;
+    if (source.divisor == 1) {
+        useTexture(source, texture, 0);
+        return;
+    }
+    // Evicted while it was loading: keep the chain, at the size asked for.
+    glDeleteTextures(1, &texture);
+    if (source.divisor > 1)
+        reloadTexture(source, source.divisor);
+}
+
+void radomeModelAsset::useTexture(TextureSource& source, GLuint texture, int firstLevel) {
+    if (source.texture)
+        glDeleteTextures(1, &source.texture);
+    source.texture = texture;
+
+    ofTexture wrapper;
+    radomeTexturePipeline::wrap(texture, *source.pImage, firstLevel, wrapper);
+    for (auto iter = source.meshes.begin(); iter != source.meshes.end(); ++iter)
+        modelMeshes[*iter].texture = wrapper;
+    radomeGpuMemory::get().resize(source.allocation, source.pImage->getBytes(firstLevel));
+}
+
+size_t radomeModelAsset::evictGpuMemory(size_t bytesWanted) {
+    if (!_ready)
+        return 0;
+    radomeGpuMemory& tracker = radomeGpuMemory::get();
+    size_t before = tracker.getUsage(this);
+
+    // Downsample everything one step first; drop textures only once they are
+    // already at the smallest size and more memory is still needed.
+    for (auto iter = _textureSources.begin(); iter != _textureSources.end(); ++iter) {
+        if (iter->divisor > 0 && iter->divisor < MAX_TEXTURE_DIVISOR)
+            reloadTexture(*iter, iter->divisor * 2);
+    }
+    if (before - tracker.getUsage(this) < bytesWanted) {
+        for (auto iter = _textureSources.begin(); iter != _textureSources.end(); ++iter) {
+            if (iter->divisor == MAX_TEXTURE_DIVISOR)
+                reloadTexture(*iter, 0);
+        }
+    }
+    return before - tracker.getUsage(this);
+}
+
+void radomeModelAsset::restoreTextures() {
+    radomeGpuMemory& tracker = radomeGpuMemory::get();
+    for (auto iter = _textureSources.begin(); iter != _textureSources.end(); ++iter) {
+        if (iter->divisor == 1 || !iter->pImage)
+            continue;
+        size_t full = iter->pImage->getBytes();
+        size_t current = tracker.getSize(iter->allocation);
+        if (tracker.canAllocate(full - current))
+            reloadTexture(*iter, 1);
+    }
+}
+
+// Drawn again after having textures evicted: bring them back if there's room.
+void radomeModelAsset::restoreTexturesIfNeeded() {
+    if (_lastDrawnFrame + 1 < radomeGpuMemory::get().getFrame())
+        return;
+    for (auto iter = _textureSources.begin(); iter != _textureSources.end(); ++iter) {
+        if (iter->divisor != 1) {
+            restoreTextures();
+            return;
+        }
+    }
+}
+
+radomeModelCache::radomeModelCache()
+: _pStream(NULL)
+, _pPalette(NULL)
+, _pLodBuilder(NULL)
+, _pTexturePipeline(NULL)
+, _pModelLoader(NULL)
+{
+}
+
+void radomeModelCache::setStreamBuffer(radomeStreamBuffer* pStream) {
+    _pStream = pStream;
+    for (auto iter = _assets.begin(); iter != _assets.end(); ++iter)
+        iter->second->setStreamBuffer(pStream);
+}
+
+void radomeModelCache::setBonePalette(radomeBonePalette* pPalette) {
+    _pPalette = pPalette;
+    for (auto iter = _assets.begin(); iter != _assets.end(); ++iter)
+        iter->second->setBonePalette(pPalette);
+}
+
+radomeSkinningTimes radomeModelCache::getSkinningTimes() const {
+    radomeSkinningTimes total;
+    memset(&total, 0, sizeof(total));
+    for (auto iter = _assets.begin(); iter != _assets.end(); ++iter) {
+        const radomeSkinningTimes& times = iter->second->getSkinningTimes();
+        total.cpuPoses += times.cpuPoses;
+        total.gpuPoses += times.gpuPoses;
+        total.cpuMicros += times.cpuMicros;
+        total.gpuMicros += times.gpuMicros;
+    }
+    return total;
+}
+
+// Work for released assets was canceled, so every owner is still cached.
+radomeModelAsset* radomeModelCache::findAsset(const void* pOwner) {
+    for (auto iter = _assets.begin(); iter != _assets.end(); ++iter) {
+        if (iter->second == pOwner)
+            return iter->second;
+    }
+    return NULL;
+}
+
+void radomeModelCache::update() {
+    uploadLoading();
+
+    if (_pLodBuilder) {
+        vector<radomeLodJob*> finished;
+        _pLodBuilder->collect(finished);
+        for (auto iter = finished.begin(); iter != finished.end(); ++iter) {
+            radomeModelAsset* pAsset = findAsset((*iter)->pOwner);
+            if (pAsset)
+                pAsset->applyLods(**iter);
+            delete *iter;
+        }
+    }
+
+    if (_pTexturePipeline) {
+        vector<radomeTextureResult> delivered;
+        _pTexturePipeline->collect(delivered);
+        for (auto iter = delivered.begin(); iter != delivered.end(); ++iter) {
+            radomeModelAsset* pAsset = findAsset(iter->pOwner);
+            if (pAsset) {
+                pAsset->applyTexture(*iter);
+            } else {
+                glDeleteTextures(1, &iter->texture);
+                delete iter->pImage;
+            }
+        }
+    }
+}
+
+// Prepared models share one slice of the frame for their uploads, oldest
+// request first.
+void radomeModelCache::uploadLoading() {
+    if (_pModelLoader) {
+        vector<radomeModelAsset*> prepared, failed;
+        _pModelLoader->collect(prepared, failed);
+        _uploading.insert(_uploading.end(), prepared.begin(), prepared.end());
+        for (auto iter = failed.begin(); iter != failed.end(); ++iter)
+            failLoading(*iter);
+    }
+
+    unsigned long long deadline = ofGetElapsedTimeMicros() + MODEL_UPLOAD_MICROS_PER_FRAME;
+    while (!_uploading.empty() && ofGetElapsedTimeMicros() < deadline) {
+        radomeModelAsset* pAsset = _uploading.front();
+        if (!pAsset->upload(deadline))
+            break;
+        _uploading.pop_front();
+        finishLoading(pAsset);
+    }
+}
+
+void radomeModelCache::finishLoading(radomeModelAsset* pAsset) {
+    pAsset->setStreamBuffer(_pStream);
+    pAsset->setBonePalette(_pPalette);
+    if (_pLodBuilder)
+        pAsset->requestLods(_pLodBuilder);
+    if (_pTexturePipeline)
+        pAsset->requestTextures(_pTexturePipeline);
+    // Every request made while it loaded gets its instance now.
+    for (int ii = 0; ii < pAsset->_refCount; ii++)
+        _loaded.push_back(pAsset);
+}
+
+void radomeModelCache::failLoading(radomeModelAsset* pAsset) {
+    ofLogError() << "couldn't load model " << pAsset->getPath();
+    _assets.erase(pAsset->getPath());
+    delete pAsset;
+}
+
+radomeModelCache::~radomeModelCache() {
+    for (auto iter = _assets.begin(); iter != _assets.end(); ++iter) {
+        if (_pModelLoader && !iter->second->isReady())
+            _pModelLoader->cancel(iter->second);
+        delete iter->second;
+    }
+}
+
+void radomeModelCache::request(const string& path) {
+    auto iter = _assets.find(path);
+    if (iter != _assets.end()) {
+        // Loading a file that's already in the scene adds another instance of
+        // the cached asset instead of a second copy of its meshes and textures.
+        iter->second->_refCount++;
+        if (iter->second->isReady())
+            _loaded.push_back(iter->second);
+        return;
+    }
+
+    radomeModelAsset* pAsset = new radomeModelAsset(path);
+    pAsset->_refCount = 1;
+    _assets[path] = pAsset;
+    if (_pModelLoader)
+        _pModelLoader->submit(pAsset);
+    else if (pAsset->load())
+        finishLoading(pAsset);
+    else
+        failLoading(pAsset);
+}
+
+void radomeModelCache::collectLoaded(vector<radomeModelAsset*>& loaded) {
+    loaded.insert(loaded.end(), _loaded.begin(), _loaded.end());
+    _loaded.clear();
+}
+
+int radomeModelCache::getLoadingCount() const {
+    int count = 0;
+    for (auto iter = _assets.begin(); iter != _assets.end(); ++iter) {
+        if (!iter->second->isReady())
+            count++;
+    }
+    return count;
+}
+
+void radomeModelCache::release(radomeModelAsset* pAsset) {
+    if (!pAsset || --pAsset->_refCount > 0)
+        return;
+    _assets.erase(pAsset->getPath());
+    delete pAsset;
+}
@@ -0,0 +1,214 @@
+//
+//  radomeModelAsset.h
+//  radome
+//
+//  A model file loaded once and shared by every radomeModel placed from it.
+//  The asset owns meshes, textures and their GPU memory; instances only carry
+//  a transform and animation state.
+//
+
+#ifndef __radome__radomeModelAsset__
+#define __radome__radomeModelAsset__
+
+#include "ofxAssimpModelLoader.h"
+#include "radomeGpuMemory.h"
+#include "radomeRenderQueue.h"
+#include "radomeStreamBuffer.h"
+#include "radomeSkinning.h"
+#include "radomeLodBuilder.h"
+#include "radomeMeshOptimizer.h"
+#include "radomeTexturePipeline.h"
+#include "radomeModelLoader.h"
+#include "radomeBinaryModel.h"
+
+#include <map>
+#include <deque>
+using std::map;
+using std::deque;
+
+class radomeModelCache;
+
+class radomeModelAsset : public ofxAssimpModelLoader, public radomeGpuMemoryClient {
+public:
+    radomeModelAsset(const string& path);
+    ~radomeModelAsset();
+
+    // Loading is split so the slow part can run off the GL thread: prepare()
+    // parses the file and builds every mesh on the CPU, then upload() creates
+    // GL buffers one mesh at a time until the deadline passes, returning true
+    // once the asset can be drawn. load() does both in one go. prepare()
+    // reads the converted .rdm copy instead when there's an up-to-date one,
+    // and writes it after an Assimp import otherwise.
+    bool load();
+    bool prepare();
+    bool upload(unsigned long long deadlineMicros);
+    bool isReady() const { return _ready; }
+    const string& getPath() const { return _path; }
+    // Draw calls and cache efficiency before and after import optimization.
+    const radomeMeshOptimizerStats& getImportStats() const { return _importStats; }
+
+    // Animation is evaluated on the shared meshes, so it only runs when the
+    // requested time differs from the last one evaluated.
+    bool isAnimated();
+    void setAnimationTime(float t);
+    // The CPU half of setAnimationTime(), which touches nothing outside this
+    // asset: run it for several assets on job threads first, and
+    // setAnimationTime() is left with the GL thread's half. The CPU path goes
+    // through ofxAssimpModelLoader::updateAnimation(), which rewrites this
+    // asset's own aiScene nodes and mesh helpers and isn't safe to run twice
+    // at once; poses of one asset are serialized, and callers give each
+    // asset a single job.
+    void poseAnimation(float t);
+
+    // Skinned vertices go to the stream buffer instead of being re-uploaded
+    // into each mesh's VBO. Without one, the loader's own upload is used.
+    void setStreamBuffer(radomeStreamBuffer* pStream) { _pStream = pStream; }
+
+    // With a palette, skinned meshes are posed on the GPU: only bone matrices
+    // are evaluated here and the VBOs keep the bind pose. NULL goes back to
+    // CPU skinning.
+    void setBonePalette(radomeBonePalette* pPalette) { _pPalette = pPalette; }
+    bool isGpuSkinned() const;
+    const radomeSkinningTimes& getSkinningTimes() const { return _skinningTimes; }
+
+    // Queues simplified levels of every mesh on the builder's thread; until
+    // they arrive (and for meshes too small to simplify) only full detail
+    // is drawn.
+    void requestLods(radomeLodBuilder* pBuilder);
+    void applyLods(radomeLodJob& job);
+
+    // Textures are mipmapped and block-compressed on the pipeline's threads;
+    // meshes draw untextured until theirs arrive.
+    void requestTextures(radomeTexturePipeline* pPipeline);
+    void applyTexture(const radomeTextureResult& result);
+
+    // Submits every mesh under the given (arena-owned) transform.
+    void enqueue(radomeRenderQueue& queue, const ofMatrix4x4* pTransform);
+
+    // Same transform ofxAssimpModelLoader::drawFaces() builds on the matrix stack.
+    ofMatrix4x4 getLoaderTransform() const;
+
+    // radomeGpuMemoryClient: idle assets first halve their textures, then drop
+    // them; they are re-uploaded from the kept mip chain once the asset is
+    // drawn at full detail again. Drawn only at coarser levels, an asset
+    // counts as idle: it's too small on the dome to show its textures.
+    size_t evictGpuMemory(size_t bytesWanted);
+    // The render queue stamps the frame without a lock, behind a barrier; a
+    // 64-bit load or store is atomic on its own.
+    unsigned long long getLastUsedFrame() const { __sync_synchronize(); return _lastDrawnFrame; }
+    void markUsed() { _lastDrawnFrame = radomeGpuMemory::get().getFrame(); __sync_synchronize(); }
+    void restoreTexturesIfNeeded();
+
+protected:
+    friend class radomeModelCache;
+    friend class radomeBinaryModel;
+
+    struct TextureSource {
+        string path;
+        vector<int> meshes;
+        int divisor;  // 1 = full size, 2 = half, ...; 0 = evicted
+        radomeGpuMemory::Handle allocation;
+        // From the texture pipeline; NULL / 0 until it delivers.
+        radomeTextureImage* pImage;
+        GLuint texture;
+    };
+
+    void trackGpuMemory();
+    void findTextureSources();
+    bool reloadTexture(TextureSource& source, int divisor);
+    void useTexture(TextureSource& source, GLuint texture, int firstLevel);
+    void restoreTextures();
+    void streamAnimatedMeshes();
+    void poseOnGpu();
+    void uploadAnimatedMeshes();
+    void restoreBindPose();
+    void computeBounds();
+    void optimizeMeshes();
+    bool importScene();
+    bool prepareConverted(const string& path, long long sourceSize, long long sourceTime,
+                          unsigned long long startMicros);
+    void buildMeshes();
+    void uploadMesh(ofxAssimpMeshHelper& helper);
+
+    string _path;
+    int _refCount;
+    radomeBinaryModel _binary;
+    bool _ready;
+    int _uploadedMeshes;
+    radomeMeshOptimizerStats _importStats;
+    vector<aiMesh*> _mergedMeshes;
+    float _animationTime;
+    bool _animationValid;
+    float _posedTime;
+    bool _posed;
+    bool _posedOnGpu;
+    ofMutex _poseMutex;
+    radomeStreamBuffer* _pStream;
+    vector<radomeVertexStream> _vertexStreams;
+    unsigned int _streamedFrame;
+    radomeBonePalette* _pPalette;
+    radomeSkeleton _skeleton;
+    unsigned int _skinnedFrame;
+    bool _bindPoseDirty;
+    radomeSkinningTimes _skinningTimes;
+    vector<radomeMeshLod> _lods;
+    radomeLodBuilder* _pLodBuilder;
+    size_t _geometryBytes;
+    radomeTexturePipeline* _pTexturePipeline;
+
+    vector<TextureSource> _textureSources;
+    radomeGpuMemory::Handle _geometryAllocation;
+    volatile unsigned long long _lastDrawnFrame;  // at full detail, set by the render queue
+};
+
+// Assets by path, reference counted by the instances using them.
+class radomeModelCache {
+public:
+    radomeModelCache();
+    ~radomeModelCache();
+
+    // Asks for one instance of the model at path. A file not in the cache
+    // is prepared on the loader's thread and uploaded by update() in slices;
+    // each request then comes back once from collectLoaded(), holding its
+    // own reference. Without a loader the file loads right here.
+    void request(const string& path);
+    void collectLoaded(vector<radomeModelAsset*>& loaded);
+    void release(radomeModelAsset* pAsset);
+
+    int getAssetCount() const { return _assets.size(); }
+    int getLoadingCount() const;
+
+    void setModelLoader(radomeModelLoader* pLoader) { _pModelLoader = pLoader; }
+
+    // Shared by every animated asset, current and future.
+    void setStreamBuffer(radomeStreamBuffer* pStream);
+    void setBonePalette(radomeBonePalette* pPalette);
+    radomeBonePalette* getBonePalette() const { return _pPalette; }
+
+    // Summed over every asset.
+    radomeSkinningTimes getSkinningTimes() const;
+
+    // New assets get their LODs built here; finished levels are handed to
+    // their assets by update(), once per frame on the GL thread.
+    void setLodBuilder(radomeLodBuilder* pBuilder) { _pLodBuilder = pBuilder; }
+    // Likewise for textures; update() hands over the ones fully uploaded.
+    void setTexturePipeline(radomeTexturePipeline* pPipeline) { _pTexturePipeline = pPipeline; }
+    void update();
+
+protected:
+    radomeModelAsset* findAsset(const void* pOwner);
+    void uploadLoading();
+    void finishLoading(radomeModelAsset* pAsset);
+    void failLoading(radomeModelAsset* pAsset);
+
+    map<string, radomeModelAsset*> _assets;
+    radomeStreamBuffer* _pStream;
+    radomeBonePalette* _pPalette;
+    radomeLodBuilder* _pLodBuilder;
+    radomeTexturePipeline* _pTexturePipeline;
+    radomeModelLoader* _pModelLoader;
+    deque<radomeModelAsset*> _uploading;
+    vector<radomeModelAsset*> _loaded;
+};
+
+#endif /* defined(__radome__radomeModelAsset__) */
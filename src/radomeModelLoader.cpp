@@ -0,0 +1,110 @@
+//
+//  radomeModelLoader.cpp
+//  radome
+//
+
+#include "radomeModelLoader.h"
+#include "radomeModelAsset.h"
+
+#include <algorithm>
+
+#define CANCEL_POLL_MS 1
+
+radomeModelLoader::radomeModelLoader()
+: _pJobs(NULL)
+, _jobs(true)
+, _pLastJob(NULL)
+, _pRunning(NULL)
+{
+}
+
+radomeModelLoader::~radomeModelLoader() {
+    // Jobs still queued find nothing left to prepare.
+    _mutex.lock();
+    _pending.clear();
+    _mutex.unlock();
+    if (_pJobs)
+        _pJobs->wait(_jobs);
+}
+
+// One job per asset, each after the previous one: Assimp's import
+// properties are global, so parses can't overlap. Uploads of earlier models
+// carry on meanwhile. Jobs take whatever is next in _pending, so cancel()
+// only has to take the asset out of the list.
+void radomeModelLoader::submit(radomeModelAsset* pAsset) {
+    _mutex.lock();
+    _pending.push_back(pAsset);
+    _mutex.unlock();
+    if (!_pJobs) {
+        prepareNext(this, 0, 1);
+        return;
+    }
+
+    if (_pJobs->poll(_jobs))
+        _pLastJob = NULL;
+    radomeJob* pJob = _pJobs->create(_jobs, &radomeModelLoader::prepareNext, this);
+    if (_pLastJob)
+        _pJobs->depend(pJob, _pLastJob);
+    _pJobs->submit(pJob);
+    _pLastJob = pJob;
+}
+
+void radomeModelLoader::collect(vector<radomeModelAsset*>& prepared, vector<radomeModelAsset*>& failed) {
+    _mutex.lock();
+    prepared.insert(prepared.end(), _prepared.begin(), _prepared.end());
+    failed.insert(failed.end(), _failed.begin(), _failed.end());
+    _prepared.clear();
+    _failed.clear();
+    _mutex.unlock();
+}
+
+void radomeModelLoader::cancel(radomeModelAsset* pAsset) {
+    _mutex.lock();
+    while (_pRunning == pAsset) {
+        _mutex.unlock();
+        ofSleepMillis(CANCEL_POLL_MS);
+        _mutex.lock();
+    }
+    _pending.erase(std::remove(_pending.begin(), _pending.end(), pAsset), _pending.end());
+    _prepared.erase(std::remove(_prepared.begin(), _prepared.end(), pAsset), _prepared.end());
+    _failed.erase(std::remove(_failed.begin(), _failed.end(), pAsset), _failed.end());
+    _mutex.unlock();
+}
+
+void radomeModelLoader::drain() {
+    if (!_pJobs)
+        return;
+    _pJobs->wait(_jobs);
+    _pLastJob = NULL;
+}
+
+int radomeModelLoader::getPendingCount() {
+    _mutex.lock();
+    int count = _pending.size() + (_pRunning ? 1 : 0);
+    _mutex.unlock();
+    return count;
+}
+
+void radomeModelLoader::prepareNext(void* pData, int begin, int end) {
+    radomeModelLoader* pLoader = (radomeModelLoader*)pData;
+    pLoader->_mutex.lock();
+    radomeModelAsset* pAsset = NULL;
+    if (!pLoader->_pending.empty()) {
+        pAsset = pLoader->_pending.front();
+        pLoader->_pending.pop_front();
+        pLoader->_pRunning = pAsset;
+    }
+    pLoader->_mutex.unlock();
+    if (!pAsset)
+        return;
+
+    bool prepared = pAsset->prepare();
+
+    pLoader->_mutex.lock();
+    if (prepared)
+        pLoader->_prepared.push_back(pAsset);
+    else
+        pLoader->_failed.push_back(pAsset);
+    pLoader->_pRunning = NULL;
+    pLoader->_mutex.unlock();
+}
@@ -0,0 +1,57 @@
+//
+//  radomeModelLoader.h
+//  radome
+//
+//  Does the CPU half of loading a model as background jobs: Assimp parsing,
+//  mesh building and import optimization, or mapping the converted .rdm.
+//  Prepared assets are collected on the GL thread, which uploads them in
+//  time-boxed slices.
+//
+
+#ifndef __radome__radomeModelLoader__
+#define __radome__radomeModelLoader__
+
+#include "ofMain.h"
+#include "radomeJobSystem.h"
+
+#include <deque>
+using std::deque;
+
+class radomeModelAsset;
+
+class radomeModelLoader {
+public:
+    radomeModelLoader();
+    // Waits for the job still running, if any.
+    ~radomeModelLoader();
+
+    // Without a job system, submit() prepares the asset right away.
+    void setJobSystem(radomeJobSystem* pJobs) { _pJobs = pJobs; }
+
+    // The asset stays owned by the caller.
+    void submit(radomeModelAsset* pAsset);
+    // Hands over every asset whose preparation finished since the last call.
+    void collect(vector<radomeModelAsset*>& prepared, vector<radomeModelAsset*>& failed);
+    // Forgets the asset; if it is being prepared right now, waits for that
+    // to finish so the caller can delete it.
+    void cancel(radomeModelAsset* pAsset);
+    // Waits until everything submitted so far has been prepared. The jobs
+    // run on the workers only, so this must happen before they are parked.
+    void drain();
+
+    int getPendingCount();
+
+protected:
+    static void prepareNext(void* pData, int begin, int end);
+
+    radomeJobSystem* _pJobs;
+    radomeJobGroup _jobs;
+    radomeJob* _pLastJob;
+    ofMutex _mutex;
+    deque<radomeModelAsset*> _pending;
+    vector<radomeModelAsset*> _prepared;
+    vector<radomeModelAsset*> _failed;
+    radomeModelAsset* _pRunning;
+};
+
+#endif /* defined(__radome__radomeModelLoader__) */
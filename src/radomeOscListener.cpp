@@ -0,0 +1,298 @@
+//
+//  radomeOscListener.cpp
+//  radome
+//
+
+#include "radomeOscListener.h"
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#define OSC_MAX_PACKET 65536
+#define OSC_MAX_ARGUMENTS 16
+// Bursts arrive faster than one thread parses them; the kernel queues them
+// meanwhile, as long as this much fits.
+#define OSC_RECEIVE_BUFFER (1024 * 1024)
+// How often the thread looks up from the socket to see if it should stop.
+#define OSC_POLL_MS 100
+
+static int readInt(const char* p) {
+    unsigned int value;
+    memcpy(&value, p, 4);
+    return (int)ntohl(value);
+}
+
+static float readFloat(const char* p) {
+    int bits = readInt(p);
+    float value;
+    memcpy(&value, &bits, 4);
+    return value;
+}
+
+static void writeInt(vector<char>& data, int value) {
+    unsigned int bits = htonl((unsigned int)value);
+    const char* p = (const char*)&bits;
+    data.insert(data.end(), p, p + 4);
+}
+
+// OSC strings are null-terminated and padded to a multiple of four bytes.
+static void writeString(vector<char>& data, const string& value) {
+    data.insert(data.end(), value.begin(), value.end());
+    data.resize(data.size() + 4 - value.size() % 4, 0);
+}
+
+// Returns the offset past the padded string, or -1 if it isn't terminated.
+static int readString(const char* pData, int size, int offset, string& value) {
+    if (offset >= size)
+        return -1;
+    const char* pEnd = (const char*)memchr(pData + offset, 0, size - offset);
+    if (!pEnd)
+        return -1;
+    value.assign(pData + offset, pEnd);
+    return offset + (value.size() / 4 + 1) * 4;
+}
+
+radomeOscListener::radomeOscListener(radomeParameterStore* pStore)
+: _pStore(pStore)
+, _socket(-1)
+, _port(0)
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+radomeOscListener::~radomeOscListener() {
+    stop();
+}
+
+bool radomeOscListener::bind(const string& address, int parameter, int count) {
+    if (isThreadRunning() || parameter < 0 || count < 1 || parameter + count > _pStore->getCount())
+        return false;
+    Binding binding = { parameter, count };
+    _bindings[address] = binding;
+    return true;
+}
+
+bool radomeOscListener::start(int port) {
+    if (_socket >= 0)
+        return true;
+
+    _socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (_socket < 0) {
+        ofLogError() << "osc: couldn't create a socket";
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    int receiveBuffer = OSC_RECEIVE_BUFFER;
+    setsockopt(_socket, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, sizeof(receiveBuffer));
+    struct timeval timeout = { 0, OSC_POLL_MS * 1000 };
+    setsockopt(_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (::bind(_socket, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        ofLogError() << "osc: couldn't listen on port " << port;
+        close(_socket);
+        _socket = -1;
+        return false;
+    }
+
+    _port = port;
+    _buffer.resize(OSC_MAX_PACKET);
+    startThread(true, false);
+    ofLogNotice() << "osc: listening on port " << port << " for " << _bindings.size() << " addresses";
+    return true;
+}
+
+void radomeOscListener::stop() {
+    if (_socket < 0)
+        return;
+    stopThread();
+    waitForThread(false);
+    close(_socket);
+    _socket = -1;
+}
+
+radomeOscStats radomeOscListener::getStats() {
+    _statsMutex.lock();
+    radomeOscStats stats = _stats;
+    _statsMutex.unlock();
+    return stats;
+}
+
+void radomeOscListener::threadedFunction() {
+    while (isThreadRunning()) {
+        ssize_t size = recv(_socket, &_buffer[0], _buffer.size(), 0);
+        if (size <= 0)
+            continue;
+        _statsMutex.lock();
+        _stats.packets++;
+        _statsMutex.unlock();
+        parsePacket(&_buffer[0], size);
+    }
+}
+
+// A bundle is "#bundle", an 8-byte time tag, then size-prefixed elements that
+// are messages or bundles themselves.
+void radomeOscListener::parsePacket(const char* pData, int size) {
+    if (size >= 16 && memcmp(pData, "#bundle", 8) == 0) {
+        int offset = 16;
+        while (offset + 4 <= size) {
+            int elementSize = readInt(pData + offset);
+            offset += 4;
+            if (elementSize <= 0 || elementSize % 4 || elementSize > size - offset)
+                break;
+            parsePacket(pData + offset, elementSize);
+            offset += elementSize;
+        }
+        if (offset == size)
+            return;
+    } else if (parseMessage(pData, size)) {
+        return;
+    }
+    _statsMutex.lock();
+    _stats.malformed++;
+    _statsMutex.unlock();
+}
+
+// Only the numeric arguments are kept, in order; strings and blobs are
+// skipped so they don't misalign the rest.
+bool radomeOscListener::parseMessage(const char* pData, int size) {
+    string address, types;
+    int offset = readString(pData, size, 0, address);
+    if (offset < 0 || address.empty() || address[0] != '/')
+        return false;
+    offset = readString(pData, size, offset, types);
+    if (offset < 0 || types.empty() || types[0] != ',')
+        return false;
+
+    float arguments[OSC_MAX_ARGUMENTS];
+    int count = 0;
+    for (int ii = 1; ii < (int)types.size(); ii++) {
+        float value = 0;
+        switch (types[ii]) {
+        case 'i':
+        case 'f':
+            if (offset + 4 > size)
+                return false;
+            value = types[ii] == 'i' ? readInt(pData + offset) : readFloat(pData + offset);
+            offset += 4;
+            break;
+        case 'T': value = 1; break;
+        case 'F': value = 0; break;
+        case 's':
+            {
+                string skipped;
+                offset = readString(pData, size, offset, skipped);
+                if (offset < 0)
+                    return false;
+            }
+            continue;
+        case 'b':
+            if (offset + 4 > size)
+                return false;
+            {
+                int blobSize = readInt(pData + offset);
+                if (blobSize < 0 || blobSize > size - offset - 4)
+                    return false;
+                offset += 4 + (blobSize + 3) / 4 * 4;
+            }
+            continue;
+        default:
+            return false;
+        }
+        if (count < OSC_MAX_ARGUMENTS)
+            arguments[count++] = value;
+    }
+
+    _statsMutex.lock();
+    if (address == OSC_PING_ADDRESS && count >= 2) {
+        // A new burst starts from sequence number 0.
+        if (arguments[0] == 0)
+            _stats.pings = 0;
+        _stats.pings++;
+        _stats.pingsExpected = arguments[1];
+        _statsMutex.unlock();
+        return true;
+    }
+    auto binding = _bindings.find(address);
+    if (binding == _bindings.end()) {
+        _stats.unknownAddresses++;
+        _statsMutex.unlock();
+        return true;
+    }
+    _stats.messages++;
+    _statsMutex.unlock();
+
+    if (count > 0)
+        _pStore->set(binding->second.parameter, arguments, MIN(count, binding->second.count));
+    return true;
+}
+
+radomeOscMessage::radomeOscMessage(const string& address)
+: _address(address)
+, _types(",")
+{
+}
+
+void radomeOscMessage::addInt(int value) {
+    _types += 'i';
+    writeInt(_arguments, value);
+}
+
+void radomeOscMessage::addFloat(float value) {
+    int bits;
+    memcpy(&bits, &value, 4);
+    _types += 'f';
+    writeInt(_arguments, bits);
+}
+
+void radomeOscMessage::serialize(vector<char>& data) const {
+    data.clear();
+    writeString(data, _address);
+    writeString(data, _types);
+    data.insert(data.end(), _arguments.begin(), _arguments.end());
+}
+
+radomeOscSender::radomeOscSender()
+: _socket(-1)
+{
+}
+
+radomeOscSender::~radomeOscSender() {
+    if (_socket >= 0)
+        close(_socket);
+}
+
+bool radomeOscSender::setup(const string& host, int port) {
+    if (_socket >= 0)
+        close(_socket);
+    _socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (_socket < 0)
+        return false;
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = inet_addr(host.c_str());
+    address.sin_port = htons(port);
+    if (connect(_socket, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        close(_socket);
+        _socket = -1;
+        return false;
+    }
+    return true;
+}
+
+bool radomeOscSender::send(const radomeOscMessage& message) {
+    if (_socket < 0)
+        return false;
+    message.serialize(_data);
+    return ::send(_socket, &_data[0], _data.size(), 0) == (ssize_t)_data.size();
+}
@@ -0,0 +1,99 @@
+//
+//  radomeOscListener.h
+//  radome
+//
+//  Receives OSC over UDP on its own thread and writes the arguments of
+//  bound addresses straight into a parameter store, so show control can
+//  send at any rate without the render loop ever waiting on the network.
+//  Messages and bundles of int, float and bool arguments are understood;
+//  bundle time tags are ignored and everything applies on arrival.
+//
+//  The sender is the other end, for checking the listener over loopback.
+//
+
+#ifndef __radome__radomeOscListener__
+#define __radome__radomeOscListener__
+
+#include "ofMain.h"
+#include "radomeParameterStore.h"
+
+// Sent as "/radome/ping ii" with a sequence number and the burst size; the
+// listener counts them instead of storing anything.
+#define OSC_PING_ADDRESS "/radome/ping"
+
+struct radomeOscStats {
+    unsigned int packets;
+    unsigned int messages;          // that matched a bound address
+    unsigned int unknownAddresses;
+    unsigned int malformed;         // packets, or bundle elements, that didn't parse
+    unsigned int pings;             // of the last burst
+    unsigned int pingsExpected;
+};
+
+class radomeOscListener : public ofThread {
+public:
+    radomeOscListener(radomeParameterStore* pStore);
+    ~radomeOscListener();
+
+    // Before start(): the address's first count arguments go to parameters
+    // parameter to parameter + count - 1, written as one group. False if they
+    // don't fit the store.
+    bool bind(const string& address, int parameter, int count = 1);
+
+    // False if the port can't be bound.
+    bool start(int port);
+    void stop();
+    int getPort() const { return _port; }
+
+    radomeOscStats getStats();
+
+protected:
+    struct Binding {
+        int parameter;
+        int count;
+    };
+
+    void threadedFunction();
+    void parsePacket(const char* pData, int size);
+    bool parseMessage(const char* pData, int size);
+
+    radomeParameterStore* _pStore;
+    map<string, Binding> _bindings;   // read-only once started
+    int _socket;
+    int _port;
+    vector<char> _buffer;
+
+    ofMutex _statsMutex;
+    radomeOscStats _stats;
+};
+
+// Builds one OSC message.
+class radomeOscMessage {
+public:
+    radomeOscMessage(const string& address);
+
+    void addInt(int value);
+    void addFloat(float value);
+
+    void serialize(vector<char>& data) const;
+
+protected:
+    string _address;
+    string _types;
+    vector<char> _arguments;
+};
+
+class radomeOscSender {
+public:
+    radomeOscSender();
+    ~radomeOscSender();
+
+    bool setup(const string& host, int port);
+    bool send(const radomeOscMessage& message);
+
+protected:
+    int _socket;
+    vector<char> _data;
+};
+
+#endif /* defined(__radome__radomeOscListener__) */
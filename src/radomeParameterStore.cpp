@@ -0,0 +1,62 @@
+//
+//  radomeParameterStore.cpp
+//  radome
+//
+
+#include "radomeParameterStore.h"
+
+radomeParameterStore::radomeParameterStore(int count)
+: _count(MAX(1, count))
+{
+    _slots = new Slot[_count];
+    for (int ii = 0; ii < _count; ii++) {
+        _slots[ii].value = 0;
+        _slots[ii].generation = 0;
+    }
+}
+
+radomeParameterStore::~radomeParameterStore() {
+    delete [] _slots;
+}
+
+// The barriers keep the values between the two generations that bracket them.
+void radomeParameterStore::set(int parameter, const float* pValues, int count) {
+    if (parameter < 0 || count < 1 || parameter + count > _count)
+        return;
+    Slot& group = _slots[parameter];
+    group.generation = group.generation + 1;
+    __sync_synchronize();
+    for (int ii = 0; ii < count; ii++)
+        _slots[parameter + ii].value = pValues[ii];
+    __sync_synchronize();
+    group.generation = group.generation + 1;
+}
+
+// Writes are a few stores each, so a reader that catches one under way, or
+// finishing as it copied, just tries again.
+bool radomeParameterStore::read(int parameter, float* pValues, int count, unsigned int& seen) const {
+    if (parameter < 0 || count < 1 || parameter + count > _count)
+        return false;
+    const Slot& group = _slots[parameter];
+    for (;;) {
+        unsigned int generation = group.generation;
+        if (generation == seen)
+            return false;
+        if (generation & 1)
+            continue;
+        __sync_synchronize();
+        for (int ii = 0; ii < count; ii++)
+            pValues[ii] = _slots[parameter + ii].value;
+        __sync_synchronize();
+        if (group.generation == generation) {
+            seen = generation;
+            return true;
+        }
+    }
+}
+
+float radomeParameterStore::get(int parameter) const {
+    if (parameter < 0 || parameter >= _count)
+        return 0;
+    return _slots[parameter].value;
+}
@@ -0,0 +1,51 @@
+//
+//  radomeParameterStore.h
+//  radome
+//
+//  Fixed set of float parameters written by one thread and read by any
+//  number of others, without locks. Each slot holds only its latest value,
+//  so a writer going faster than the readers just overwrites: readers poll
+//  once a frame and see what changed since they last looked.
+//
+//  Consecutive parameters that belong together (a position, a rotation) are
+//  written and read as a group, and a reader never sees half of one write
+//  and half of another.
+//
+
+#ifndef __radome__radomeParameterStore__
+#define __radome__radomeParameterStore__
+
+#include "ofMain.h"
+
+class radomeParameterStore {
+public:
+    radomeParameterStore(int count = 256);
+    ~radomeParameterStore();
+
+    int getCount() const { return _count; }
+
+    // Writer thread only. Sets the count parameters from parameter on; a
+    // group is always written from its first parameter, with up to as many
+    // values as it has.
+    void set(int parameter, const float* pValues, int count);
+    void set(int parameter, float value) { set(parameter, &value, 1); }
+
+    // Each reader keeps its own seen counter per group, starting at 0; true,
+    // with the group's count values copied out and the counter updated, if
+    // it was set since.
+    bool read(int parameter, float* pValues, int count, unsigned int& seen) const;
+    float get(int parameter) const;
+
+protected:
+    // The generation of a group's first slot is a sequence lock for the
+    // group: odd while a write is under way, bumped again once it's done.
+    struct Slot {
+        volatile float value;
+        volatile unsigned int generation;
+    };
+
+    Slot* _slots;
+    int _count;
+};
+
+#endif /* defined(__radome__radomeParameterStore__) */
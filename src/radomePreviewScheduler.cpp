@@ -0,0 +1,206 @@
+//
+//  radomePreviewScheduler.cpp
+//  radome
+//
+
+#include "radomePreviewScheduler.h"
+
+#define MAX_BACKOFF_LEVEL 4
+#define MAX_EFFECTIVE_DIVISOR 32
+#define MIN_EFFECTIVE_SCALE 0.125
+#define COST_SMOOTHING 0.1
+#define AT_RISK_FRACTION 0.85
+#define LATE_FRAME_FRACTION 1.05
+#define RECOVER_FRACTION 0.5
+#define RECOVER_FRAMES 90
+// The preview's cost is only measured when it renders, so a skipped frame
+// lets the estimate drift down; and after this many skips in a row it
+// renders anyway, to measure again.
+#define SKIPPED_COST_DECAY 0.95
+#define MAX_CONSECUTIVE_SKIPS 120
+
+radomePreviewScheduler::radomePreviewScheduler()
+: _fboAllocation(0)
+, _rateDivisor(2)
+, _resolutionScale(0.5)
+, _frameBudget(1.0/45.0)
+, _backoffLevel(0)
+, _framesSinceRender(0)
+, _framesUnderBudget(0)
+, _consecutiveSkips(0)
+, _invalidated(true)
+, _hasFrame(false)
+, _outputStart(0)
+, _lastOutputStart(0)
+, _previewStart(0)
+, _outputCost(0)
+, _previewCost(0)
+, _frameInterval(0)
+, _skippedFrames(0)
+, _timerQuery(0)
+, _timing(false)
+, _timerPending(false)
+, _pendingCpuCost(0)
+{
+}
+
+radomePreviewScheduler::~radomePreviewScheduler() {
+    if (_timerQuery)
+        glDeleteQueries(1, &_timerQuery);
+}
+
+void radomePreviewScheduler::setRateDivisor(int divisor) {
+    _rateDivisor = MAX(1, divisor);
+}
+
+void radomePreviewScheduler::setResolutionScale(float scale) {
+    _resolutionScale = ofClamp(scale, MIN_EFFECTIVE_SCALE, 1.0);
+}
+
+int radomePreviewScheduler::getEffectiveDivisor() const {
+    return MIN(_rateDivisor << _backoffLevel, MAX_EFFECTIVE_DIVISOR);
+}
+
+float radomePreviewScheduler::getEffectiveScale() const {
+    return MAX(_resolutionScale * pow(0.75, _backoffLevel), MIN_EFFECTIVE_SCALE);
+}
+
+void radomePreviewScheduler::beginOutputFrame() {
+    _outputStart = ofGetElapsedTimeMicros();
+    if (_lastOutputStart) {
+        _frameInterval = (_outputStart - _lastOutputStart) / 1000000.0;
+    }
+    _lastOutputStart = _outputStart;
+}
+
+void radomePreviewScheduler::endOutputFrame() {
+    float cost = (ofGetElapsedTimeMicros() - _outputStart) / 1000000.0;
+    _outputCost += (cost - _outputCost) * COST_SMOOTHING;
+    _framesSinceRender++;
+    adjustBackoff();
+}
+
+// Output frames are measured on the CPU side, so a late frame interval is the
+// most reliable sign that the projectors (GPU included) are missing vsync.
+void radomePreviewScheduler::adjustBackoff() {
+    bool late = _frameInterval > _frameBudget * LATE_FRAME_FRACTION;
+    float amortizedPreview = _previewCost / getEffectiveDivisor();
+    float load = _outputCost + amortizedPreview;
+
+    if (late || load > _frameBudget * AT_RISK_FRACTION) {
+        if (_backoffLevel < MAX_BACKOFF_LEVEL) {
+            _backoffLevel++;
+            ofLogVerbose() << "preview backing off to level " << _backoffLevel
+                           << (late ? " (late output frame)" : " (output near budget)");
+        }
+        _framesUnderBudget = 0;
+    } else if (load < _frameBudget * RECOVER_FRACTION) {
+        if (++_framesUnderBudget >= RECOVER_FRAMES && _backoffLevel > 0) {
+            _backoffLevel--;
+            _framesUnderBudget = 0;
+        }
+    } else {
+        _framesUnderBudget = 0;
+    }
+}
+
+bool radomePreviewScheduler::shouldRender() {
+    collectTimer();
+    if (!_hasFrame)
+        return true;
+
+    // Never add preview work to a frame the outputs can't afford.
+    bool late = _frameInterval > _frameBudget * LATE_FRAME_FRACTION;
+    if ((late || _outputCost + _previewCost > _frameBudget) && _consecutiveSkips < MAX_CONSECUTIVE_SKIPS) {
+        _skippedFrames++;
+        _consecutiveSkips++;
+        _previewCost *= SKIPPED_COST_DECAY;
+        return false;
+    }
+    if (_consecutiveSkips >= MAX_CONSECUTIVE_SKIPS)
+        return true;
+
+    if (_framesSinceRender >= getEffectiveDivisor())
+        return true;
+
+    return _invalidated && _outputCost + _previewCost < _frameBudget * AT_RISK_FRACTION;
+}
+
+void radomePreviewScheduler::allocate() {
+    int w = MAX(1, (int)(ofGetWidth() * getEffectiveScale()));
+    int h = MAX(1, (int)(ofGetHeight() * getEffectiveScale()));
+    if (_fbo.isAllocated() && _fbo.getWidth() == w && _fbo.getHeight() == h)
+        return;
+
+    ofFbo::Settings settings;
+    settings.width = w;
+    settings.height = h;
+    settings.internalformat = GL_RGB;
+    settings.useDepth = true;
+    _fbo.allocate(settings);
+
+    size_t bytes = radomeGpuMemory::estimateFramebufferBytes(w, h, GL_RGB, true);
+    if (_fboAllocation)
+        radomeGpuMemory::get().resize(_fboAllocation, bytes);
+    else
+        _fboAllocation = radomeGpuMemory::get().track(this, "operator preview", GpuFramebuffer, bytes);
+}
+
+// A preview the GPU takes longer over than the CPU costs the outputs its GPU
+// time, so that's what it's measured by wherever timer queries are supported.
+// The result is polled every frame rather than waited for; a render that
+// starts while the last one's is still out is measured on the CPU only.
+void radomePreviewScheduler::collectTimer() {
+    if (!_timerPending)
+        return;
+    GLint available = 0;
+    glGetQueryObjectiv(_timerQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return;
+    GLuint64EXT elapsed = 0;
+    glGetQueryObjectui64vEXT(_timerQuery, GL_QUERY_RESULT, &elapsed);
+    _timerPending = false;
+    float cost = MAX(_pendingCpuCost, elapsed / 1000000000.0);
+    _previewCost += (cost - _previewCost) * COST_SMOOTHING;
+}
+
+void radomePreviewScheduler::begin() {
+    if (!_timerQuery && (GLEW_EXT_timer_query || GLEW_ARB_timer_query))
+        glGenQueries(1, &_timerQuery);
+    collectTimer();
+    _previewStart = ofGetElapsedTimeMicros();
+    allocate();
+    _timing = _timerQuery && !_timerPending;
+    if (_timing)
+        glBeginQuery(GL_TIME_ELAPSED_EXT, _timerQuery);
+    _fbo.begin();
+}
+
+void radomePreviewScheduler::end() {
+    _fbo.end();
+
+    float cost = (ofGetElapsedTimeMicros() - _previewStart) / 1000000.0;
+    if (_timing) {
+        glEndQuery(GL_TIME_ELAPSED_EXT);
+        _timing = false;
+        _timerPending = true;
+        _pendingCpuCost = cost;
+    } else {
+        _previewCost += (cost - _previewCost) * COST_SMOOTHING;
+    }
+    _framesSinceRender = 0;
+    _consecutiveSkips = 0;
+    _invalidated = false;
+    _hasFrame = true;
+}
+
+void radomePreviewScheduler::draw(float x, float y, float w, float h) {
+    if (!_hasFrame)
+        return;
+    ofPushStyle();
+    ofSetColor(255, 255, 255);
+    // The framebuffer itself belongs to the render thread's context; only its
+    // texture is shared with the window drawing it.
+    _fbo.getTextureReference().draw(x, y, w, h);
+    ofPopStyle();
+}
@@ -0,0 +1,88 @@
+//
+//  radomePreviewScheduler.h
+//  radome
+//
+//  Renders the operator preview (3D scene / dome preview) into an offscreen
+//  buffer at a fraction of the output frame rate and window resolution, and
+//  backs off further whenever the projector outputs are close to their budget.
+//
+
+#ifndef __radome__radomePreviewScheduler__
+#define __radome__radomePreviewScheduler__
+
+#include "ofMain.h"
+#include "radomeGpuMemory.h"
+
+class radomePreviewScheduler {
+public:
+    radomePreviewScheduler();
+    ~radomePreviewScheduler();
+
+    // Configured preview rate (1 = every output frame, 2 = every other frame, ...)
+    // and resolution relative to the window. The scheduler never goes faster or
+    // sharper than this, only slower and softer under load.
+    void setRateDivisor(int divisor);
+    int getRateDivisor() const { return _rateDivisor; }
+    void setResolutionScale(float scale);
+    float getResolutionScale() const { return _resolutionScale; }
+
+    // Target output frame time in seconds, e.g. 1/45.
+    void setFrameBudget(float seconds) { _frameBudget = seconds; }
+    float getFrameBudget() const { return _frameBudget; }
+
+    // Bracket the projector output work so its cost can be measured.
+    void beginOutputFrame();
+    void endOutputFrame();
+
+    // Request a preview render as soon as the budget allows (e.g. camera moved).
+    void invalidate() { _invalidated = true; }
+
+    // Returns true if the preview should be re-rendered this frame.
+    bool shouldRender();
+    void begin();
+    void end();
+    void draw(float x, float y, float w, float h);
+
+    int getBackoffLevel() const { return _backoffLevel; }
+    int getEffectiveDivisor() const;
+    float getEffectiveScale() const;
+    float getOutputCost() const { return _outputCost; }
+    float getPreviewCost() const { return _previewCost; }
+    float getFrameInterval() const { return _frameInterval; }
+    unsigned int getSkippedFrames() const { return _skippedFrames; }
+
+protected:
+    void allocate();
+    void adjustBackoff();
+    void collectTimer();
+
+    ofFbo _fbo;
+    radomeGpuMemory::Handle _fboAllocation;
+
+    int _rateDivisor;
+    float _resolutionScale;
+    float _frameBudget;
+
+    int _backoffLevel;
+    int _framesSinceRender;
+    int _framesUnderBudget;
+    int _consecutiveSkips;
+    bool _invalidated;
+    bool _hasFrame;
+
+    unsigned long long _outputStart;
+    unsigned long long _lastOutputStart;
+    unsigned long long _previewStart;
+    float _outputCost;
+    float _previewCost;     // CPU or GPU time of a render, whichever is longer
+    float _frameInterval;
+    unsigned int _skippedFrames;
+
+    // Read back once the GPU is done, like the projectors' render timers.
+    GLuint _timerQuery;
+    bool _timing;           // the query brackets the render under way
+    bool _timerPending;
+    float _pendingCpuCost;
+};
+
+#endif /* defined(__radome__radomePreviewScheduler__) */
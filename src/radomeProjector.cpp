@@ -9,7 +9,14 @@
 #include "radomeProjector.h"
 
 radomeProjector::radomeProjector(float heading, float distance, float height, float fov, float targetHeight)
-: _heading(heading)
+: _directOutput(false)
+, _gamma(1.0)
+, _blackLevel(0.0)
+, _renderScale(1.0)
+, _lastRenderTime(0)
+, _timerIndex(0)
+, _cpuRenderStart(0)
+, _heading(heading)
 , _distance(distance)
 , _height(height)
 , _fov(fov)
@@ -17,10 +24,95 @@ radomeProjector::radomeProjector(float heading, float distance, float height, fl
 {
     updateCamera();
     
-    _fbo.allocate(1280, 1024, GL_RGB);
+    _fboAllocation = radomeGpuMemory::get().track(this, "projector", GpuFramebuffer, 0);
+    allocateFramebuffer();
+
+    _timerQueries[0] = _timerQueries[1] = 0;
+    _timerPending[0] = _timerPending[1] = false;
+    if (GLEW_EXT_timer_query || GLEW_ARB_timer_query) {
+        glGenQueries(2, _timerQueries);
+    }
+}
+
+radomeProjector::~radomeProjector() {
+    radomeGpuMemory::get().release(_fboAllocation);
+    if (_timerQueries[0]) {
+        glDeleteQueries(2, _timerQueries);
+    }
+}
+
+void radomeProjector::allocateFramebuffer() {
+    if (_fbo.isAllocated())
+        return;
+    _fbo.allocate(PROJECTOR_NATIVE_WIDTH, PROJECTOR_NATIVE_HEIGHT, GL_RGB);
     _fbo.begin();
 	ofClear(0,0,0);
     _fbo.end();
+    radomeGpuMemory::get().resize(_fboAllocation,
+        radomeGpuMemory::estimateFramebufferBytes(PROJECTOR_NATIVE_WIDTH, PROJECTOR_NATIVE_HEIGHT, GL_RGB, true));
+}
+
+void radomeProjector::setDirectOutput(bool direct) {
+    if (direct == _directOutput)
+        return;
+    _directOutput = direct;
+    if (direct) {
+        _fbo = ofFbo();
+        radomeGpuMemory::get().resize(_fboAllocation, 0);
+    } else {
+        allocateFramebuffer();
+    }
+}
+
+void radomeProjector::setRenderScale(float s) {
+    _renderScale = ofClamp(s, 0.1, 1.0);
+}
+
+int radomeProjector::getRenderWidth() const {
+    return MAX(1, (int)(PROJECTOR_NATIVE_WIDTH * _renderScale));
+}
+
+int radomeProjector::getRenderHeight() const {
+    return MAX(1, (int)(PROJECTOR_NATIVE_HEIGHT * _renderScale));
+}
+
+// Timer queries are double buffered and read a frame late so that fetching the
+// result never stalls the pipeline. Without timer query support the CPU time of
+// the pass is used instead, which undercounts but still tracks the trend.
+void radomeProjector::beginTimer() {
+    if (!_timerQueries[0]) {
+        _cpuRenderStart = ofGetElapsedTimeMicros();
+        return;
+    }
+
+    int previous = 1 - _timerIndex;
+    if (_timerPending[previous]) {
+        GLint available = 0;
+        glGetQueryObjectiv(_timerQueries[previous], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64EXT elapsed = 0;
+            glGetQueryObjectui64vEXT(_timerQueries[previous], GL_QUERY_RESULT, &elapsed);
+            _lastRenderTime = elapsed / 1000000000.0;
+            _timerPending[previous] = false;
+        }
+    }
+
+    if (!_timerPending[_timerIndex]) {
+        glBeginQuery(GL_TIME_ELAPSED_EXT, _timerQueries[_timerIndex]);
+    }
+}
+
+void radomeProjector::endTimer() {
+    if (!_timerQueries[0]) {
+        _lastRenderTime = (ofGetElapsedTimeMicros() - _cpuRenderStart) / 1000000.0;
+        return;
+    }
+
+    if (!_timerPending[_timerIndex]) {
+        glEndQuery(GL_TIME_ELAPSED_EXT);
+        _timerPending[_timerIndex] = true;
+    }
+    _timerIndex = 1 - _timerIndex;
 }
 
 void radomeProjector::updateCamera() {
@@ -31,19 +123,50 @@ void radomeProjector::updateCamera() {
 
 void radomeProjector::renderBegin()
 {
+    allocateFramebuffer();
+    beginTimer();
     _fbo.begin();
 	ofClear(0,0,0);
-    _camera.begin();
+    _camera.begin(ofRectangle(0, 0, getRenderWidth(), getRenderHeight()));
 }
 
 void radomeProjector::renderEnd()
 {
     _camera.end();
     _fbo.end();
+    endTimer();
+}
+
+void radomeProjector::renderDirectBegin(int w, int h)
+{
+    beginTimer();
+    ofViewport(0, 0, w, h);
+    ofClear(0,0,0);
+    _camera.begin(ofRectangle(0, 0, w, h));
+}
+
+void radomeProjector::renderDirectEnd()
+{
+    _camera.end();
+    endTimer();
+}
+
+void radomeProjector::beginColorCorrection(ofShader& shader) {
+    _colorLUT.bind(shader, COLOR_LUT_TEXTURE_UNIT);
+    shader.setUniform1f("outputGamma", _gamma);
+    shader.setUniform1f("blackLevel", _blackLevel);
+}
+
+void radomeProjector::endColorCorrection() {
+    _colorLUT.unbind(COLOR_LUT_TEXTURE_UNIT);
 }
 
+// Only the scaled region of the framebuffer holds the current frame; drawing
+// that subsection at the requested size is the upscale to native resolution.
 void radomeProjector::drawFramebuffer(int x, int y, int w, int h) {
-    _fbo.draw(x, y, w, h);
+    if (!_fbo.isAllocated())
+        return;
+    _fbo.getTextureReference().drawSubsection(x, y, w, h, 0, 0, getRenderWidth(), getRenderHeight());
 }
 
 void radomeProjector::drawSceneRepresentation() {
@@ -74,22 +197,43 @@ void radomeProjector::drawSceneRepresentation() {
 }
 
 
-radomeProjectorWindowListener::radomeProjectorWindowListener(vector<radomeProjector*>* pProjectors) {
-    _pProjectors = pProjectors;
-}
-
-void radomeProjectorWindowListener::setup() {
-    
+radomeProjectorWindowListener::radomeProjectorWindowListener(radomeRenderThread* pRenderer, vector<radomeProjector*>* pProjectors)
+: radomeOutputWindow(pRenderer)
+, _pProjectors(pProjectors)
+{
 }
 
-void radomeProjectorWindowListener::draw() {
+void radomeProjectorWindowListener::drawOutput(int w, int h) {
     if (_pProjectors) {
-        int w = ofGetWidth() / _pProjectors->size();
-        int h = ofGetHeight();
         int x = 0;
+        w /= _pProjectors->size();
         for (auto iter = _pProjectors->begin(); iter != _pProjectors->end(); ++iter) {
             (*iter)->drawFramebuffer(x, 0, w, h);
             x += w;
         }
     }
-}
\ No newline at end of file
+}
+
+radomeProjectorNativeListener::radomeProjectorNativeListener(radomeRenderThread* pRenderer, radomeProjector* pProjector,
+                                                             radomeProjectorRenderer* pView)
+: radomeOutputWindow(pRenderer)
+, _pProjector(pProjector)
+, _pView(pView)
+{
+}
+
+// Direct output is only ever on without a render thread, so this never runs
+// as part of a takeover.
+void radomeProjectorNativeListener::drawOutput(int w, int h) {
+    if (!_pProjector)
+        return;
+    if (!_pProjector->isDirectOutput() || !_pView) {
+        _pProjector->drawFramebuffer(0, 0, w, h);
+        return;
+    }
+
+    glEnable(GL_DEPTH_TEST);
+    _pProjector->renderDirectBegin(w, h);
+    _pView->renderProjectorView(_pProjector);
+    _pProjector->renderDirectEnd();
+}
@@ -11,19 +11,45 @@
 
 #include "ofMain.h"
 #include "ofxFenster.h"
+#include "radomeGpuMemory.h"
+#include "radomeColorLUT.h"
+#include "radomeRenderThread.h"
 
 #include <list>
 using std::list;
 
+#define PROJECTOR_NATIVE_WIDTH 1280
+#define PROJECTOR_NATIVE_HEIGHT 1024
+#define COLOR_LUT_TEXTURE_UNIT 2
+
+class radomeProjector;
+
+// Draws the projected content for one projector's camera; used by windows that
+// render a projector straight into their back buffer.
+class radomeProjectorRenderer {
+public:
+    virtual ~radomeProjectorRenderer() {}
+    virtual void renderProjectorView(radomeProjector* pProjector) = 0;
+};
+
 class radomeProjector {
 public:
     radomeProjector(float heading, float distance, float height, float fov = 30, float targetHeight = 20);
+    ~radomeProjector();
     void drawSceneRepresentation();
     void drawFramebuffer(int x, int y, int w, int h);
     
     void renderBegin();
     void renderEnd();
-    
+
+    // Direct output renders into the current window's back buffer at its full
+    // size, with no intermediate framebuffer. While it is on, the framebuffer
+    // is released and drawFramebuffer() draws nothing.
+    void setDirectOutput(bool direct);
+    bool isDirectOutput() const { return _directOutput; }
+    void renderDirectBegin(int w, int h);
+    void renderDirectEnd();
+
     void setHeading(float h) { _heading = h; updateCamera(); }
     float getHeading() const { return _heading; }
     void setDistance(float d) { _distance = d; updateCamera(); }
@@ -35,12 +61,49 @@ public:
     void setTargetHeight(float h) { _targetHeight = h; updateCamera(); }
     float getTargetHeight() const { return _targetHeight; }
     
+    // Fraction of the native resolution the next render pass uses; the result is
+    // scaled back up to the native size when the framebuffer is drawn.
+    void setRenderScale(float s);
+    float getRenderScale() const { return _renderScale; }
+    int getRenderWidth() const;
+    int getRenderHeight() const;
+
+    // Per-projector color correction, applied by radome.frag in the pass that
+    // writes the projector output: the 3D LUT first, then the gamma exponent
+    // and black level lift.
+    bool loadColorLUT(const string& path) { return _colorLUT.load(path); }
+    const radomeColorLUT& getColorLUT() const { return _colorLUT; }
+    void setGamma(float g) { _gamma = g; }
+    float getGamma() const { return _gamma; }
+    void setBlackLevel(float b) { _blackLevel = b; }
+    float getBlackLevel() const { return _blackLevel; }
+    void beginColorCorrection(ofShader& shader);
+    void endColorCorrection();
+
+    // GPU time of the most recently completed render pass, in seconds.
+    float getLastRenderTime() const { return _lastRenderTime; }
+
 protected:
     void updateCamera();
+    void allocateFramebuffer();
+    void beginTimer();
+    void endTimer();
     
     ofCamera _camera;
     ofFbo _fbo;
 
+    bool _directOutput;
+    radomeColorLUT _colorLUT;
+    float _gamma;
+    float _blackLevel;
+    float _renderScale;
+    float _lastRenderTime;
+    GLuint _timerQueries[2];
+    int _timerIndex;
+    bool _timerPending[2];
+    unsigned long long _cpuRenderStart;
+    radomeGpuMemory::Handle _fboAllocation;
+
     float _heading;
     float _distance;
     float _height;
@@ -48,13 +111,28 @@ protected:
     float _targetHeight;
 };
 
-class radomeProjectorWindowListener : public ofxFensterListener {
+class radomeProjectorWindowListener : public radomeOutputWindow {
 public:
-    radomeProjectorWindowListener(vector<radomeProjector*>* pProjectors);
-    void setup();
-    void draw();
+    radomeProjectorWindowListener(radomeRenderThread* pRenderer, vector<radomeProjector*>* pProjectors);
 protected:
+    void drawOutput(int w, int h);
+
     vector<radomeProjector*>* _pProjectors;
 };
 
+// One native-resolution window per projector. With a render thread the
+// projector renders at native size, so showing it is a 1:1 copy of its
+// framebuffer; without one, a projector in direct output has its final pass
+// drawn straight into the window.
+class radomeProjectorNativeListener : public radomeOutputWindow {
+public:
+    radomeProjectorNativeListener(radomeRenderThread* pRenderer, radomeProjector* pProjector,
+                                  radomeProjectorRenderer* pView);
+protected:
+    void drawOutput(int w, int h);
+
+    radomeProjector* _pProjector;
+    radomeProjectorRenderer* _pView;
+};
+
 #endif /* defined(__radome__radomeProjector__) */
@@ -0,0 +1,574 @@
+//
+//  radomeRenderQueue.cpp
+//  radome
+//
+
+#include "radomeRenderQueue.h"
+#include "radomeGpuMemory.h"
+
+#include <new>
+
+#define ARENA_ALIGNMENT 16
+
+// Sort key layout, most significant first: shader, texture, material, mesh.
+#define SHADER_BITS 12
+#define TEXTURE_BITS 20
+#define MATERIAL_BITS 12
+#define MESH_BITS 20
+
+// Rectangle and 2D samplers may not share a unit; the one a texture doesn't
+// use is parked here.
+#define IDLE_SAMPLER_TEXTURE_UNIT 2
+
+// Meshes covering at least this many pixels draw at full detail; every
+// halving of their size drops one level.
+#define LOD_DETAIL_PIXELS 256.0
+
+radomeFrameArena::radomeFrameArena(size_t chunkSize)
+: _chunkSize(chunkSize)
+, _chunkIndex(0)
+, _offset(0)
+, _bytesUsed(0)
+{
+}
+
+radomeFrameArena::~radomeFrameArena() {
+    for (auto iter = _chunks.begin(); iter != _chunks.end(); ++iter)
+        delete[] *iter;
+}
+
+void* radomeFrameArena::allocate(size_t bytes) {
+    bytes = (bytes + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    if (bytes > _chunkSize)
+        return NULL;
+
+    if (_chunks.empty()) {
+        _chunks.push_back(new char[_chunkSize]);
+    } else if (_offset + bytes > _chunkSize) {
+        _chunkIndex++;
+        _offset = 0;
+        if (_chunkIndex == _chunks.size())
+            _chunks.push_back(new char[_chunkSize]);
+    }
+
+    void* p = _chunks[_chunkIndex] + _offset;
+    _offset += bytes;
+    _bytesUsed += bytes;
+    return p;
+}
+
+void radomeFrameArena::reset() {
+    _chunkIndex = 0;
+    _offset = 0;
+    _bytesUsed = 0;
+}
+
+radomeRenderQueue::radomeRenderQueue()
+: _pPalette(NULL)
+, _instanceBuffer(0)
+, _lodEnabled(true)
+, _passes(0)
+{
+    setupProgram(_instancing, NULL);
+    setupProgram(_skinning, NULL);
+    memset(&_stats, 0, sizeof(_stats));
+    memset(&_lastStats, 0, sizeof(_lastStats));
+}
+
+radomeRenderQueue::~radomeRenderQueue() {
+    if (_instanceBuffer)
+        glDeleteBuffers(1, &_instanceBuffer);
+}
+
+bool radomeRenderQueue::setupProgram(InstancedProgram& program, ofShader* pShader) {
+    program.pShader = NULL;
+    program.instanceAttribute = -1;
+    program.textureUniform = -1;
+    program.texturedUniform = -1;
+    program.texture2DUniform = -1;
+    program.diffuseUniform = -1;
+    program.emissiveUniform = -1;
+    program.boneIndexAttribute = -1;
+    program.boneWeightAttribute = -1;
+    program.boneBaseUniform = -1;
+    if (!pShader)
+        return false;
+
+    GLint location = pShader->getAttributeLocation("instanceMatrix");
+    if (location < 0) {
+        ofLogWarning() << "render queue: instancing shader has no instanceMatrix attribute";
+        return false;
+    }
+    program.pShader = pShader;
+    program.instanceAttribute = location;
+    program.textureUniform = pShader->getUniformLocation("tex");
+    program.texturedUniform = pShader->getUniformLocation("textured");
+    program.texture2DUniform = pShader->getUniformLocation("tex2D");
+    program.diffuseUniform = pShader->getUniformLocation("materialDiffuse");
+    program.emissiveUniform = pShader->getUniformLocation("materialEmissive");
+    program.boneIndexAttribute = pShader->getAttributeLocation("boneIndices");
+    program.boneWeightAttribute = pShader->getAttributeLocation("boneWeights");
+    program.boneBaseUniform = pShader->getUniformLocation("boneBase");
+    return true;
+}
+
+void radomeRenderQueue::setInstancingShader(ofShader* pShader) {
+    if (!pShader || !GLEW_ARB_draw_instanced || !GLEW_ARB_instanced_arrays) {
+        ofLogNotice() << "render queue: hardware instancing unavailable, drawing copies individually";
+        pShader = NULL;
+    }
+    setupProgram(_instancing, pShader);
+}
+
+bool radomeRenderQueue::setSkinningShader(ofShader* pShader, radomeBonePalette* pPalette) {
+    _pPalette = NULL;
+    if (!_instancing.pShader || !pPalette || !pPalette->isAllocated())
+        pShader = NULL;
+    if (!setupProgram(_skinning, pShader))
+        return false;
+    if (_skinning.boneIndexAttribute < 0 || _skinning.boneWeightAttribute < 0) {
+        ofLogWarning() << "render queue: skinning shader has no boneIndices/boneWeights attributes";
+        setupProgram(_skinning, NULL);
+        return false;
+    }
+    _pPalette = pPalette;
+    return true;
+}
+
+radomeRenderQueue::InstancedProgram* radomeRenderQueue::programFor(ofShader* pShader) {
+    if (!pShader)
+        return NULL;
+    if (pShader == _instancing.pShader)
+        return &_instancing;
+    if (pShader == _skinning.pShader)
+        return &_skinning;
+    return NULL;
+}
+
+static void resetIdsIfFull(map<const void*, unsigned int>& ids, unsigned int limit) {
+    if (ids.size() + 2 >= limit)
+        ids.clear();
+}
+
+void radomeRenderQueue::begin() {
+    // Between frames, so every key of a frame comes from the same tables.
+    resetIdsIfFull(_shaderIds, 1 << SHADER_BITS);
+    resetIdsIfFull(_textureIds, 1 << TEXTURE_BITS);
+    resetIdsIfFull(_materialIds, 1 << MATERIAL_BITS);
+    resetIdsIfFull(_meshIds, 1 << MESH_BITS);
+    _lastStats = _stats;
+    memset(&_stats, 0, sizeof(_stats));
+    _items.clear();
+    _arena.reset();
+    _passes = 0;
+}
+
+const ofMatrix4x4* radomeRenderQueue::allocTransform(const ofMatrix4x4& m) {
+    void* p = _arena.allocate(sizeof(ofMatrix4x4));
+    return new (p) ofMatrix4x4(m);
+}
+
+// Ids are small dense integers so they fit the key; begin() rebuilds a table
+// once a long session has churned through more objects than the key has room
+// for. Objects past the limit within one frame all share the last id, so
+// items only join a run after comparing their state itself.
+unsigned int radomeRenderQueue::idFor(map<const void*, unsigned int>& ids, const void* p, unsigned int limit) {
+    if (!p)
+        return 0;
+    auto iter = ids.find(p);
+    if (iter != ids.end())
+        return iter->second;
+    if (ids.size() + 2 >= limit)
+        return limit - 1;
+    unsigned int id = ids.size() + 1;
+    ids[p] = id;
+    return id;
+}
+
+uint64_t radomeRenderQueue::makeKey(ofShader* pShader, ofTexture* pTexture, ofMaterial* pMaterial, ofVbo* pVbo) {
+    uint64_t shader = idFor(_shaderIds, pShader, 1 << SHADER_BITS);
+    // Textures are keyed by GL name so copies of one ofTexture sort together.
+    uint64_t texture = pTexture && pTexture->isAllocated()
+        ? idFor(_textureIds, (const void*)(size_t)pTexture->getTextureData().textureID, 1 << TEXTURE_BITS) : 0;
+    uint64_t material = idFor(_materialIds, pMaterial, 1 << MATERIAL_BITS);
+    uint64_t mesh = idFor(_meshIds, pVbo, 1 << MESH_BITS);
+
+    return (shader << (TEXTURE_BITS + MATERIAL_BITS + MESH_BITS))
+         | (texture << (MATERIAL_BITS + MESH_BITS))
+         | (material << MESH_BITS)
+         | mesh;
+}
+
+void radomeRenderQueue::submit(ofShader* pShader, ofTexture* pTexture, ofMaterial* pMaterial, ofVbo* pVbo,
+                               int indexCount, int indexOffset, const ofMatrix4x4* pTransform,
+                               const radomeVertexStream* pStream, const radomeSkin* pSkin,
+                               const radomeMeshLod* pLod, volatile unsigned long long* pUsedFrame) {
+    void* p = _arena.allocate(sizeof(radomeDrawItem));
+    if (!p || !pVbo || indexCount <= 0)
+        return;
+
+    // Skinned meshes hold the bind pose, so they only make sense drawn through
+    // the skinning shader; its key keeps them sorted apart from static meshes.
+    if (!_skinning.pShader)
+        pSkin = NULL;
+    if (pSkin && !pShader)
+        pShader = _skinning.pShader;
+
+    radomeDrawItem* pItem = (radomeDrawItem*)p;
+    pItem->key = makeKey(pShader, pTexture, pMaterial, pVbo);
+    pItem->pTransform = pTransform;
+    pItem->pShader = pShader;
+    pItem->pTexture = (pTexture && pTexture->isAllocated()) ? pTexture : NULL;
+    pItem->pMaterial = pMaterial;
+    pItem->pVbo = pVbo;
+    pItem->pStream = (pStream && pStream->buffer) ? pStream : NULL;
+    pItem->pSkin = pSkin;
+    pItem->pLod = (pLod && pLod->levelCount > 0) ? pLod : NULL;
+    pItem->pUsedFrame = pUsedFrame;
+    pItem->fullDetail = false;
+    pItem->indexCount = indexCount;
+    pItem->indexOffset = indexOffset;
+    if (pItem->pLod) {
+        ofVec3f scale = pTransform ? pTransform->getScale() : ofVec3f(1, 1, 1);
+        pItem->boundsCenter = pTransform ? pTransform->preMult(pLod->center) : pLod->center;
+        pItem->boundsRadius = pLod->radius * MAX(scale.x, MAX(scale.y, scale.z));
+    }
+    _items.push_back(pItem);
+}
+
+void radomeRenderQueue::countUnsorted() {
+    _stats.items = _items.size();
+    _stats.unsortedDrawCalls = _items.size();
+    _stats.unsortedStateChanges = 0;
+
+    radomeDrawItem* pPrev = NULL;
+    for (auto iter = _items.begin(); iter != _items.end(); ++iter) {
+        radomeDrawItem* pItem = *iter;
+        if (!pPrev || pItem->pShader != pPrev->pShader) _stats.unsortedStateChanges++;
+        if (!pPrev || pItem->pTexture != pPrev->pTexture) _stats.unsortedStateChanges++;
+        if (!pPrev || pItem->pMaterial != pPrev->pMaterial) _stats.unsortedStateChanges++;
+        if (!pPrev || pItem->pVbo != pPrev->pVbo) _stats.unsortedStateChanges++;
+        pPrev = pItem;
+    }
+}
+
+// The key says two items share state unless an id ran out mid-frame.
+static bool shareState(radomeDrawItem* a, radomeDrawItem* b) {
+    GLuint textureA = a->pTexture ? a->pTexture->getTextureData().textureID : 0;
+    GLuint textureB = b->pTexture ? b->pTexture->getTextureData().textureID : 0;
+    return a->key == b->key && a->pShader == b->pShader && textureA == textureB &&
+           a->pMaterial == b->pMaterial && a->pVbo == b->pVbo;
+}
+
+static bool compareDrawItems(const radomeDrawItem* a, const radomeDrawItem* b) {
+    if (a->key != b->key)
+        return a->key < b->key;
+    // Keep one model's draws adjacent so they can share a transform.
+    if (a->pTransform != b->pTransform)
+        return a->pTransform < b->pTransform;
+    return a->indexOffset < b->indexOffset;
+}
+
+// With instancing, the copies of each index range are what should be adjacent.
+// A key drawn under a single transform still ends up sorted by offset.
+static bool compareDrawItemsInstanced(const radomeDrawItem* a, const radomeDrawItem* b) {
+    if (a->key != b->key)
+        return a->key < b->key;
+    if (a->indexOffset != b->indexOffset)
+        return a->indexOffset < b->indexOffset;
+    if (a->indexCount != b->indexCount)
+        return a->indexCount < b->indexCount;
+    return a->pTransform < b->pTransform;
+}
+
+void radomeRenderQueue::sort() {
+    countUnsorted();
+    std::sort(_items.begin(), _items.end(), _instancing.pShader ? compareDrawItemsInstanced : compareDrawItems);
+    if (_instancing.pShader)
+        uploadInstanceMatrices();
+}
+
+// The level an item's size on screen calls for, however many its mesh has: 0
+// when its full detail shows, -1 when nothing of it does.
+int radomeRenderQueue::selectLevel(const radomeDrawItem* pItem, const radomeLodView& view) {
+    float depth = (pItem->boundsCenter - view.eye).dot(view.forward);
+    // Wholly behind the view it's clipped anyway; crossing the eye plane it
+    // may fill the view.
+    if (depth < -pItem->boundsRadius)
+        return -1;
+    if (depth <= pItem->boundsRadius)
+        return 0;
+
+    float pixels = 2 * pItem->boundsRadius / depth * view.pixelScale;
+    if (pixels >= LOD_DETAIL_PIXELS)
+        return 0;
+    return pixels > 0 ? (int)ceil(log2(LOD_DETAIL_PIXELS / pixels)) : -1;
+}
+
+// Points each LOD item at its level for this pass. Items were sorted with the
+// full-detail range, so copies now drawn at different levels split into
+// separate instanced runs but keep their instance matrices. Whether an item
+// shows its full detail goes by its size alone, also for meshes without
+// coarser levels; passes without a view (the operator preview) don't count.
+void radomeRenderQueue::selectLevels(const radomeLodView* pView) {
+    for (auto iter = _items.begin(); iter != _items.end(); ++iter) {
+        radomeDrawItem* pItem = *iter;
+        if (!pItem->pLod) {
+            pItem->fullDetail = pView != NULL;
+            _stats.triangles += pItem->indexCount / 3;
+            _stats.fullDetailTriangles += pItem->indexCount / 3;
+            continue;
+        }
+        int wanted = pView ? selectLevel(pItem, *pView) : 0;
+        pItem->fullDetail = pView && wanted == 0;
+        int coarsest = pItem->pLod->levelCount - 1;
+        int level = (pView && _lodEnabled) ? (wanted < 0 ? coarsest : MIN(wanted, coarsest)) : 0;
+        pItem->indexOffset = pItem->pLod->indexOffset[level];
+        pItem->indexCount = pItem->pLod->indexCount[level];
+        _stats.triangles += pItem->indexCount / 3;
+        _stats.fullDetailTriangles += pItem->pLod->indexCount[0] / 3;
+    }
+}
+
+// Stamps the owners of items just drawn at full detail. The stamps are read
+// by the GPU memory budget; execute() publishes them once the pass is done.
+void radomeRenderQueue::markUsed(int first, int count, unsigned long long frame) {
+    for (int ii = first; ii < first + count; ii++) {
+        if (_items[ii]->fullDetail && _items[ii]->pUsedFrame)
+            *_items[ii]->pUsedFrame = frame;
+    }
+}
+
+// One call per item: every mesh has a buffer of its own, so there is nothing
+// for a multi-draw to combine. The run shares the transform setup.
+void radomeRenderQueue::flush(radomeDrawItem** pBegin, int count) {
+    ofPushMatrix();
+    if (pBegin[0]->pTransform)
+        ofMultMatrix(*pBegin[0]->pTransform);
+    for (int ii = 0; ii < count; ii++) {
+        glDrawElements(GL_TRIANGLES, pBegin[ii]->indexCount, GL_UNSIGNED_INT,
+                       (const GLvoid*)(size_t)(pBegin[ii]->indexOffset * sizeof(ofIndexType)));
+        _stats.drawCalls++;
+    }
+    ofPopMatrix();
+}
+
+// Copies of one index range are drawn with a single instanced call. Their
+// model matrices sit contiguously in the frame's instance buffer, since the
+// matrices were written there in sorted order.
+void radomeRenderQueue::flushInstanced(InstancedProgram* pProgram, int first, int count) {
+    radomeDrawItem* pItem = _items[first];
+
+    glBindBuffer(GL_ARRAY_BUFFER, _instanceBuffer);
+    for (int column = 0; column < 4; column++) {
+        glVertexAttribPointer(pProgram->instanceAttribute + column, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float),
+                              (const GLvoid*)(size_t)((first * 16 + column * 4) * sizeof(float)));
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glDrawElementsInstancedARB(GL_TRIANGLES, pItem->indexCount, GL_UNSIGNED_INT,
+                               (const GLvoid*)(size_t)(pItem->indexOffset * sizeof(ofIndexType)), count);
+
+    _stats.drawCalls++;
+    _stats.instancedDrawCalls++;
+    _stats.instances += count;
+}
+
+void radomeRenderQueue::beginProgram(InstancedProgram* pProgram) {
+    for (int column = 0; column < 4; column++) {
+        GLuint location = pProgram->instanceAttribute + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisorARB(location, 1);
+    }
+    glUniform1i(pProgram->textureUniform, 0);
+    if (pProgram == &_skinning) {
+        glEnableVertexAttribArray(pProgram->boneIndexAttribute);
+        glEnableVertexAttribArray(pProgram->boneWeightAttribute);
+        _pPalette->bind(*pProgram->pShader, BONE_PALETTE_TEXTURE_UNIT);
+    }
+}
+
+void radomeRenderQueue::endProgram(InstancedProgram* pProgram) {
+    for (int column = 0; column < 4; column++) {
+        GLuint location = pProgram->instanceAttribute + column;
+        glVertexAttribDivisorARB(location, 0);
+        glDisableVertexAttribArray(location);
+    }
+    if (pProgram == &_skinning) {
+        glDisableVertexAttribArray(pProgram->boneIndexAttribute);
+        glDisableVertexAttribArray(pProgram->boneWeightAttribute);
+        _pPalette->unbind(BONE_PALETTE_TEXTURE_UNIT);
+    }
+}
+
+// Points the bone attributes at the mesh's weights and its slice of the palette.
+void radomeRenderQueue::bindSkin(InstancedProgram* pProgram, const radomeSkin* pSkin) {
+    GLsizei stride = MAX_BONE_INFLUENCES * 2 * sizeof(float);
+    glBindBuffer(GL_ARRAY_BUFFER, pSkin->weightBuffer);
+    glVertexAttribPointer(pProgram->boneIndexAttribute, MAX_BONE_INFLUENCES, GL_FLOAT, GL_FALSE, stride, (const GLvoid*)0);
+    glVertexAttribPointer(pProgram->boneWeightAttribute, MAX_BONE_INFLUENCES, GL_FLOAT, GL_FALSE, stride,
+                          (const GLvoid*)(MAX_BONE_INFLUENCES * sizeof(float)));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glUniform1f(pProgram->boneBaseUniform, pSkin->boneBase);
+}
+
+// The instancing shaders don't see the fixed-function material state, so the
+// bound material's colors go in as uniforms; no material is plain white.
+void radomeRenderQueue::bindMaterial(InstancedProgram* pProgram, ofMaterial* pMaterial) {
+    ofFloatColor diffuse = pMaterial ? pMaterial->getDiffuseColor() : ofFloatColor(1, 1, 1, 1);
+    ofFloatColor emissive = pMaterial ? pMaterial->getEmissiveColor() : ofFloatColor(0, 0, 0, 0);
+    glUniform4f(pProgram->diffuseUniform, diffuse.r, diffuse.g, diffuse.b, diffuse.a);
+    glUniform4f(pProgram->emissiveUniform, emissive.r, emissive.g, emissive.b, emissive.a);
+}
+
+// Writes every item's model matrix once per frame; all passes (cube faces and
+// the preview) read the same buffer instead of rebuilding the matrix stack.
+void radomeRenderQueue::uploadInstanceMatrices() {
+    int count = _items.size();
+    if (!count)
+        return;
+
+    _instanceMatrices.resize(count * 16);
+    for (int ii = 0; ii < count; ii++) {
+        const ofMatrix4x4* pTransform = _items[ii]->pTransform;
+        if (pTransform)
+            memcpy(&_instanceMatrices[ii * 16], pTransform->getPtr(), 16 * sizeof(float));
+        else
+            memcpy(&_instanceMatrices[ii * 16], ofMatrix4x4::newIdentityMatrix().getPtr(), 16 * sizeof(float));
+    }
+
+    if (!_instanceBuffer)
+        glGenBuffers(1, &_instanceBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, _instanceBuffer);
+    // Orphan last frame's contents so the driver doesn't wait on its draws.
+    glBufferData(GL_ARRAY_BUFFER, _instanceMatrices.size() * sizeof(float), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, _instanceMatrices.size() * sizeof(float), &_instanceMatrices[0]);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Points the vertex (and normal) arrays at this frame's streamed geometry; the
+// VBO's texcoords, colors and indices stay as bound.
+void radomeRenderQueue::bindStream(const radomeVertexStream* pStream) {
+    glBindBuffer(GL_ARRAY_BUFFER, pStream->buffer);
+    glVertexPointer(3, GL_FLOAT, 3 * sizeof(float), (const GLvoid*)pStream->positionOffset);
+    if (pStream->hasNormals)
+        glNormalPointer(GL_FLOAT, 3 * sizeof(float), (const GLvoid*)pStream->normalOffset);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void radomeRenderQueue::execute(const radomeLodView* pView) {
+    _stats.drawCalls = 0;
+    _stats.stateChanges = 0;
+    _stats.instancedDrawCalls = 0;
+    _stats.instances = 0;
+    _passes++;
+    selectLevels(pView);
+    unsigned long long frame = radomeGpuMemory::get().getFrame();
+
+    ofShader* pShader = NULL;
+    InstancedProgram* pProgram = NULL;
+    ofTexture* pTexture = NULL;
+    ofMaterial* pMaterial = NULL;
+    ofVbo* pVbo = NULL;
+
+    glPushAttrib(GL_ENABLE_BIT);
+    glEnable(GL_NORMALIZE);
+
+    int count = _items.size();
+    int ii = 0;
+    while (ii < count) {
+        radomeDrawItem* pItem = _items[ii];
+
+        // Shaderless items draw through the instancing shader when there is one.
+        ofShader* pItemShader = pItem->pShader ? pItem->pShader : _instancing.pShader;
+        bool textureChanged = pItem->pTexture != pTexture;
+        bool materialChanged = pItem->pMaterial != pMaterial;
+        if (pItemShader != pShader) {
+            if (pProgram) endProgram(pProgram);
+            if (pShader) pShader->end();
+            pShader = pItemShader;
+            pProgram = programFor(pShader);
+            if (pShader) pShader->begin();
+            if (pProgram) {
+                beginProgram(pProgram);
+                textureChanged = true;
+                materialChanged = true;
+            }
+            _stats.stateChanges++;
+        }
+        if (textureChanged) {
+            if (pItem->pTexture != pTexture) {
+                if (pTexture) pTexture->unbind();
+                pTexture = pItem->pTexture;
+                if (pTexture) pTexture->bind();
+                _stats.stateChanges++;
+            }
+            if (pProgram) {
+                // Pipeline textures are mipmapped 2D; the loader's are rectangles.
+                bool is2D = pTexture && pTexture->getTextureData().textureTarget == GL_TEXTURE_2D;
+                glUniform1f(pProgram->texturedUniform, !pTexture ? 0.0 : is2D ? 2.0 : 1.0);
+                glUniform1i(pProgram->textureUniform, is2D ? IDLE_SAMPLER_TEXTURE_UNIT : 0);
+                glUniform1i(pProgram->texture2DUniform, is2D ? 0 : IDLE_SAMPLER_TEXTURE_UNIT);
+            }
+        }
+        if (materialChanged) {
+            if (pItem->pMaterial != pMaterial) {
+                if (pMaterial) pMaterial->end();
+                pMaterial = pItem->pMaterial;
+                if (pMaterial) pMaterial->begin();
+                _stats.stateChanges++;
+            }
+            if (pProgram)
+                bindMaterial(pProgram, pMaterial);
+        }
+        if (pItem->pVbo != pVbo) {
+            if (pVbo) pVbo->unbind();
+            pVbo = pItem->pVbo;
+            pVbo->bind();
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pVbo->getIndexId());
+            // Every item of a mesh shares its stream and skin, so they're applied with the VBO.
+            if (pItem->pStream)
+                bindStream(pItem->pStream);
+            if (pItem->pSkin && pProgram == &_skinning)
+                bindSkin(pProgram, pItem->pSkin);
+            _stats.stateChanges++;
+        }
+
+        int run = 1;
+        if (pProgram) {
+            while (ii + run < count &&
+                   shareState(_items[ii + run], pItem) &&
+                   _items[ii + run]->indexOffset == pItem->indexOffset &&
+                   _items[ii + run]->indexCount == pItem->indexCount) {
+                run++;
+            }
+            // Single copies go through the same path, so no shaderless draw
+            // touches the legacy matrix stack.
+            flushInstanced(pProgram, ii, run);
+            markUsed(ii, run, frame);
+            ii += run;
+            continue;
+        }
+
+        while (ii + run < count &&
+               shareState(_items[ii + run], pItem) &&
+               _items[ii + run]->pTransform == pItem->pTransform) {
+            run++;
+        }
+        flush(&_items[ii], run);
+        markUsed(ii, run, frame);
+        ii += run;
+    }
+
+    if (pVbo) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        pVbo->unbind();
+    }
+    if (pMaterial) pMaterial->end();
+    if (pTexture) pTexture->unbind();
+    if (pProgram) endProgram(pProgram);
+    if (pShader) pShader->end();
+
+    glPopAttrib();
+    __sync_synchronize();
+}
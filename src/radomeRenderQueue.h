@@ -0,0 +1,184 @@
+//
+//  radomeRenderQueue.h
+//  radome
+//
+//  Per-frame list of scene draws. Models submit their meshes once per frame,
+//  the queue sorts them by state (shader, texture, material, mesh) and replays
+//  the sorted list for every cube map face, binding state only when it
+//  changes, and setting up the transform once for consecutive draws that
+//  share it.
+//  When an instancing shader has been set, model matrices are uploaded once per
+//  frame into an instance buffer and copies of one mesh are drawn instanced.
+//  Skinned meshes draw instanced too, through a skinning shader that reads
+//  their bones from the frame's bone palette. Meshes with LODs pick a detail
+//  level per pass from their projected size in that pass's view.
+//
+
+#ifndef __radome__radomeRenderQueue__
+#define __radome__radomeRenderQueue__
+
+#include "ofMain.h"
+#include "radomeStreamBuffer.h"
+#include "radomeSkinning.h"
+#include "radomeMeshSimplifier.h"
+
+#include <map>
+#include <stdint.h>
+using std::map;
+
+// Bump allocator reset every frame; chunks are kept for reuse so a steady
+// scene allocates nothing after the first frame.
+class radomeFrameArena {
+public:
+    radomeFrameArena(size_t chunkSize = 64 * 1024);
+    ~radomeFrameArena();
+
+    void* allocate(size_t bytes);
+    void reset();
+
+    size_t getBytesUsed() const { return _bytesUsed; }
+    size_t getCapacity() const { return _chunks.size() * _chunkSize; }
+
+protected:
+    vector<char*> _chunks;
+    size_t _chunkSize;
+    size_t _chunkIndex;
+    size_t _offset;
+    size_t _bytesUsed;
+};
+
+struct radomeDrawItem {
+    uint64_t key;
+    const ofMatrix4x4* pTransform;
+    ofShader* pShader;
+    ofTexture* pTexture;
+    ofMaterial* pMaterial;
+    ofVbo* pVbo;
+    const radomeVertexStream* pStream;  // replaces the VBO's positions/normals when set
+    const radomeSkin* pSkin;            // bone weights, when posed by the skinning shader
+    const radomeMeshLod* pLod;          // detail levels; each pass sets indexOffset/indexCount
+    volatile unsigned long long* pUsedFrame;    // set to the frame number when a pass draws it at full detail
+    bool fullDetail;                    // this pass shows its full detail
+    ofVec3f boundsCenter;               // world space, for LOD selection
+    float boundsRadius;
+    int indexCount;
+    int indexOffset;
+};
+
+// The camera of one pass, as far as LOD selection is concerned. pixelScale
+// is the on-screen size in pixels of one unit at a depth of one unit (half
+// the viewport divided by tan(fov / 2)).
+struct radomeLodView {
+    ofVec3f eye;
+    ofVec3f forward;
+    float pixelScale;
+};
+
+struct radomeRenderStats {
+    unsigned int items;
+    unsigned int drawCalls;
+    unsigned int stateChanges;
+    unsigned int instancedDrawCalls;
+    unsigned int instances;
+    // Summed over every pass of the frame, with and without LOD selection.
+    unsigned int triangles;
+    unsigned int fullDetailTriangles;
+    // What the same items would have cost drawn one by one in submission order.
+    unsigned int unsortedDrawCalls;
+    unsigned int unsortedStateChanges;
+};
+
+class radomeRenderQueue {
+public:
+    radomeRenderQueue();
+    ~radomeRenderQueue();
+
+    void begin();
+
+    // Copies the transform into the frame arena; submissions from one model
+    // share the returned pointer, which lets their draws share one transform setup.
+    const ofMatrix4x4* allocTransform(const ofMatrix4x4& m);
+
+    void submit(ofShader* pShader, ofTexture* pTexture, ofMaterial* pMaterial, ofVbo* pVbo,
+                int indexCount, int indexOffset, const ofMatrix4x4* pTransform,
+                const radomeVertexStream* pStream = NULL, const radomeSkin* pSkin = NULL,
+                const radomeMeshLod* pLod = NULL, volatile unsigned long long* pUsedFrame = NULL);
+
+    // Shader used for instanced draws; it must take the per-instance model
+    // matrix as a mat4 attribute named instanceMatrix. Ignored (and instancing
+    // disabled) when the driver lacks ARB_draw_instanced/ARB_instanced_arrays.
+    void setInstancingShader(ofShader* pShader);
+    bool isInstancingEnabled() const { return _instancing.pShader != NULL; }
+
+    // Shader for items submitted with a skin: an instancing shader that also
+    // takes boneIndices/boneWeights attributes and a boneBase uniform, and
+    // samples the palette's bones. Requires instancing; returns false (and
+    // skinned meshes must be posed on the CPU) when it can't be used.
+    bool setSkinningShader(ofShader* pShader, radomeBonePalette* pPalette);
+    bool isSkinningEnabled() const { return _skinning.pShader != NULL; }
+
+    void setLodEnabled(bool enabled) { _lodEnabled = enabled; }
+    bool isLodEnabled() const { return _lodEnabled; }
+
+    void sort();
+    // Without a view (or with LOD disabled) everything draws at full detail.
+    void execute(const radomeLodView* pView = NULL);
+
+    const radomeRenderStats& getStats() const { return _stats; }
+    const radomeRenderStats& getLastStats() const { return _lastStats; }
+    unsigned int getPassCount() const { return _passes; }
+
+protected:
+    // A shader the queue draws shaderless (or skinned) items through.
+    struct InstancedProgram {
+        ofShader* pShader;
+        GLint instanceAttribute;
+        GLint textureUniform;
+        GLint texturedUniform;
+        GLint texture2DUniform;
+        GLint diffuseUniform;
+        GLint emissiveUniform;
+        GLint boneIndexAttribute;
+        GLint boneWeightAttribute;
+        GLint boneBaseUniform;
+    };
+
+    uint64_t makeKey(ofShader* pShader, ofTexture* pTexture, ofMaterial* pMaterial, ofVbo* pVbo);
+    unsigned int idFor(map<const void*, unsigned int>& ids, const void* p, unsigned int limit);
+    void countUnsorted();
+    void selectLevels(const radomeLodView* pView);
+    int selectLevel(const radomeDrawItem* pItem, const radomeLodView& view);
+    void markUsed(int first, int count, unsigned long long frame);
+    void flush(radomeDrawItem** pBegin, int count);
+    void bindStream(const radomeVertexStream* pStream);
+    bool setupProgram(InstancedProgram& program, ofShader* pShader);
+    InstancedProgram* programFor(ofShader* pShader);
+    void beginProgram(InstancedProgram* pProgram);
+    void endProgram(InstancedProgram* pProgram);
+    void bindSkin(InstancedProgram* pProgram, const radomeSkin* pSkin);
+    void bindMaterial(InstancedProgram* pProgram, ofMaterial* pMaterial);
+    void flushInstanced(InstancedProgram* pProgram, int first, int count);
+    void uploadInstanceMatrices();
+
+    radomeFrameArena _arena;
+    vector<radomeDrawItem*> _items;
+
+    map<const void*, unsigned int> _shaderIds;
+    map<const void*, unsigned int> _textureIds;
+    map<const void*, unsigned int> _materialIds;
+    map<const void*, unsigned int> _meshIds;
+
+    InstancedProgram _instancing;
+    InstancedProgram _skinning;
+    radomeBonePalette* _pPalette;
+    GLuint _instanceBuffer;
+    vector<float> _instanceMatrices;
+
+    bool _lodEnabled;
+
+    radomeRenderStats _stats;
+    radomeRenderStats _lastStats;
+    unsigned int _passes;
+};
+
+#endif /* defined(__radome__radomeRenderQueue__) */
@@ -0,0 +1,224 @@
+//
+//  radomeRenderThread.cpp
+//  radome
+//
+
+#include "radomeRenderThread.h"
+
+#include <algorithm>
+
+// How long the UI loop can go without checking in before the render thread
+// presents the output windows itself. Longer than any ordinary UI frame, so
+// the two never present the same window at once.
+#define TAKEOVER_AFTER_MS 100
+
+radomeOutputWindow::radomeOutputWindow(radomeRenderThread* pRenderer)
+: _pRenderer(pRenderer)
+, _context(NULL)
+, _width(0)
+, _height(0)
+{
+}
+
+radomeOutputWindow::~radomeOutputWindow() {
+    if (_pRenderer)
+        _pRenderer->removeOutput(this);
+}
+
+// The window's context is locked while it draws, as it is while the render
+// thread presents into it, so the two never use it at once. Both threads take
+// the graphics lock first and the context lock inside it.
+void radomeOutputWindow::draw() {
+    if (!_pRenderer)
+        return;
+    _pRenderer->lockGraphics();
+#ifdef __APPLE__
+    CGLContextObj context = CGLGetCurrentContext();
+    CGLLockContext(context);
+#endif
+    _pRenderer->checkIn();
+    _width = ofGetWidth();
+    _height = ofGetHeight();
+    drawOutput(_width, _height);
+#ifdef __APPLE__
+    CGLUnlockContext(context);
+#endif
+    _pRenderer->unlockGraphics();
+#ifdef __APPLE__
+    if (!_context) {
+        _context = context;
+        _pRenderer->addOutput(this);
+    }
+#endif
+}
+
+// With the window's context current and locked.
+void radomeOutputWindow::present() {
+    ofViewport(0, 0, _width, _height);
+    ofSetupScreenOrtho(_width, _height);
+    ofClear(0, 0, 0);
+    drawOutput(_width, _height);
+#ifdef __APPLE__
+    CGLFlushDrawable(_context);
+#endif
+}
+
+// The context goes away with the window, so the render thread must stop
+// presenting into it now rather than when the listener is deleted.
+void radomeOutputWindow::exit() {
+    if (_pRenderer)
+        _pRenderer->removeOutput(this);
+    radomeOutputWindow* pThis = this;
+    ofNotifyEvent(closed, pThis);
+}
+
+radomeRenderThread::radomeRenderThread()
+: _pClient(NULL)
+, _context(NULL)
+, _lastCheckIn(0)
+, _busyMicros(0)
+, _droppedCommands(0)
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+radomeRenderThread::~radomeRenderThread() {
+    stop();
+}
+
+bool radomeRenderThread::start(radomeRenderClient* pClient, float frameRate, float stepRate) {
+    if (_pClient)
+        return true;
+
+    _scheduler.setup(frameRate, stepRate);
+
+#ifdef __APPLE__
+    CGLContextObj shared = CGLGetCurrentContext();
+    if (!shared || CGLCreateContext(CGLGetPixelFormat(shared), shared, &_context) != kCGLNoError) {
+        ofLogError() << "render thread: couldn't create a context sharing with the main window";
+        _context = NULL;
+        return false;
+    }
+
+    _pClient = pClient;
+    _lastCheckIn = ofGetElapsedTimeMicros();
+    startThread(true, false);
+    _ready.wait();
+    return true;
+#else
+    return false;
+#endif
+}
+
+void radomeRenderThread::stop() {
+    if (!_pClient)
+        return;
+    stopThread();
+    waitForThread(false);
+#ifdef __APPLE__
+    CGLDestroyContext(_context);
+#endif
+    _context = NULL;
+    _pClient = NULL;
+}
+
+bool radomeRenderThread::post(const radomeCommand& command) {
+    if (_commands.push(command))
+        return true;
+    if (_droppedCommands++ == 0)
+        ofLogWarning() << "render thread: command queue full, dropping commands";
+    return false;
+}
+
+void radomeRenderThread::checkIn() {
+    _lastCheckIn = ofGetElapsedTimeMicros();
+}
+
+void radomeRenderThread::addOutput(radomeOutputWindow* pOutput) {
+    _outputsMutex.lock();
+    if (std::find(_outputs.begin(), _outputs.end(), pOutput) == _outputs.end())
+        _outputs.push_back(pOutput);
+    _outputsMutex.unlock();
+}
+
+// Waits out a takeover in progress, which may be drawing into the window.
+void radomeRenderThread::removeOutput(radomeOutputWindow* pOutput) {
+    _outputsMutex.lock();
+    _outputs.erase(std::remove(_outputs.begin(), _outputs.end(), pOutput), _outputs.end());
+    _outputsMutex.unlock();
+}
+
+radomeRenderThreadStats radomeRenderThread::getStats() {
+    _statsMutex.lock();
+    radomeRenderThreadStats stats = _stats;
+    stats.frameMicros = _stats.frames ? (float)_busyMicros / _stats.frames : 0;
+    memset(&_stats, 0, sizeof(_stats));
+    _busyMicros = 0;
+    _statsMutex.unlock();
+    stats.droppedCommands = _droppedCommands;
+    return stats;
+}
+
+void radomeRenderThread::threadedFunction() {
+#ifdef __APPLE__
+    CGLSetCurrentContext(_context);
+#endif
+    lockGraphics();
+    _pClient->setupRenderer();
+    unlockGraphics();
+    _ready.set();
+
+    while (isThreadRunning()) {
+        _scheduler.waitForFrame();
+        unsigned long long start = ofGetElapsedTimeMicros();
+        lockGraphics();
+        radomeCommand command;
+        while (_commands.pop(command))
+            _pClient->executeCommand(command);
+        _pClient->renderFrame();
+        // Other contexts see the frame's textures once it has been flushed.
+        glFlush();
+        bool takeover = ofGetElapsedTimeMicros() - _lastCheckIn > TAKEOVER_AFTER_MS * 1000;
+        if (takeover) {
+            presentOutputs();
+            _scheduler.presented();
+        }
+        unlockGraphics();
+
+        unsigned long long now = ofGetElapsedTimeMicros();
+        _statsMutex.lock();
+        _stats.frames++;
+        if (takeover)
+            _stats.takeoverFrames++;
+        _busyMicros += now - start;
+        _statsMutex.unlock();
+        _scheduler.endFrame();
+    }
+
+    lockGraphics();
+    _pClient->teardownRenderer();
+    unlockGraphics();
+#ifdef __APPLE__
+    CGLSetCurrentContext(NULL);
+#endif
+}
+
+// Graphics lock held. Each window is drawn in its own context, which the UI
+// thread shouldn't be using: it hasn't run its loop for TAKEOVER_AFTER_MS.
+// Should its loop come back mid-present, the graphics lock holds its window
+// draw off until the present is done, and the context lock keeps the
+// window's own buffer swap apart from ours.
+void radomeRenderThread::presentOutputs() {
+#ifdef __APPLE__
+    _outputsMutex.lock();
+    for (auto iter = _outputs.begin(); iter != _outputs.end(); ++iter) {
+        CGLContextObj context = (*iter)->_context;
+        CGLLockContext(context);
+        CGLSetCurrentContext(context);
+        (*iter)->present();
+        CGLSetCurrentContext(_context);
+        CGLUnlockContext(context);
+    }
+    _outputsMutex.unlock();
+#endif
+}
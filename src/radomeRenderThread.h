@@ -0,0 +1,147 @@
+//
+//  radomeRenderThread.h
+//  radome
+//
+//  Renders the audience output on its own thread, so a blocked UI thread
+//  (modal file dialogs, window juggling, slow GUI events) never stops the
+//  projectors. The thread has its own GL context, sharing textures, buffers
+//  and shaders with the windows', and renders into framebuffers only; the
+//  UI thread changes the scene by posting commands, which the render thread
+//  applies between frames.
+//
+//  Output windows are presented by the UI thread as part of its own loop.
+//  Whenever that loop hasn't checked in for a while, the render thread
+//  presents them itself until it does again.
+//
+//  The render context comes from CGL, so this is macOS only; elsewhere
+//  start() fails and the app renders from update() on the UI thread.
+//
+
+#ifndef __radome__radomeRenderThread__
+#define __radome__radomeRenderThread__
+
+#include "ofMain.h"
+#include "ofxFenster.h"
+#include "radomeCommandQueue.h"
+#include "radomeFrameScheduler.h"
+#include "Poco/Event.h"
+
+#ifdef __APPLE__
+#include <OpenGL/OpenGL.h>
+typedef CGLContextObj radomeGLContext;
+#else
+typedef void* radomeGLContext;
+#endif
+
+class radomeRenderThread;
+
+// The scene side of the app. Everything here runs on the render thread with
+// its context current.
+class radomeRenderClient {
+public:
+    virtual ~radomeRenderClient() {}
+    virtual void setupRenderer() = 0;
+    virtual void executeCommand(const radomeCommand& command) = 0;
+    virtual void renderFrame() = 0;
+    virtual void teardownRenderer() = 0;
+};
+
+// A window that shows render-thread output. Subclasses draw it from
+// textures the render thread has finished with.
+class radomeOutputWindow : public ofxFensterListener {
+public:
+    radomeOutputWindow(radomeRenderThread* pRenderer);
+    virtual ~radomeOutputWindow();
+
+    // UI thread, from the window's own draw; registers the window's context
+    // with the render thread the first time.
+    void draw();
+    // Render thread, with this window's context current.
+    void present();
+    // UI thread, as the window closes, whether the app or the OS closed it;
+    // the render thread stops presenting into it.
+    void exit();
+
+    // Notified from exit().
+    ofEvent<radomeOutputWindow*> closed;
+
+protected:
+    friend class radomeRenderThread;
+
+    virtual void drawOutput(int w, int h) = 0;
+
+    radomeRenderThread* _pRenderer;
+    radomeGLContext _context;
+    int _width;
+    int _height;
+};
+
+struct radomeRenderThreadStats {
+    unsigned int frames;
+    unsigned int takeoverFrames;   // frames the render thread also presented
+    unsigned int droppedCommands;
+    float frameMicros;             // mean CPU time of a frame
+};
+
+class radomeRenderThread : public ofThread {
+public:
+    radomeRenderThread();
+    ~radomeRenderThread();
+
+    // Creates the render context, sharing with the one current on the
+    // calling thread, and starts rendering at up to frameRate, with the
+    // simulation stepped at stepRate. Returns once the client's
+    // setupRenderer() has run; false without a render context, which is
+    // always the case off macOS.
+    bool start(radomeRenderClient* pClient, float frameRate, float stepRate);
+    void stop();
+    bool isRendering() const { return _pClient != NULL; }
+
+    // UI thread only. Commands are applied in order before the next frame;
+    // false if the queue is full and the command was dropped.
+    bool post(const radomeCommand& command);
+
+    // oF's drawing state (style and view stacks, the current renderer) is
+    // shared by all threads. The render thread holds this lock for each frame
+    // and each takeover; the UI thread holds it while it draws.
+    void lockGraphics() { _graphicsMutex.lock(); }
+    void unlockGraphics() { _graphicsMutex.unlock(); }
+
+    // UI thread, with the graphics lock held: the UI loop is running and
+    // presenting its windows. Called from the start of the loop and from
+    // every window draw.
+    void checkIn();
+
+    // Output windows start being taken over once they have drawn once, and
+    // are forgotten before their window is destroyed.
+    void addOutput(radomeOutputWindow* pOutput);
+    void removeOutput(radomeOutputWindow* pOutput);
+
+    radomeRenderThreadStats getStats();
+
+    // Paces the frames. Set up by start() even when it fails, so a client
+    // rendering on its own thread can still plan frames with it.
+    radomeFrameScheduler& getScheduler() { return _scheduler; }
+
+protected:
+    void threadedFunction();
+    void presentOutputs();
+
+    radomeRenderClient* _pClient;
+    radomeGLContext _context;
+    radomeFrameScheduler _scheduler;
+    radomeCommandQueue _commands;
+    Poco::Event _ready;
+
+    ofMutex _graphicsMutex;
+    unsigned long long _lastCheckIn;   // guarded by the graphics lock
+    ofMutex _outputsMutex;
+    vector<radomeOutputWindow*> _outputs;
+
+    ofMutex _statsMutex;
+    radomeRenderThreadStats _stats;
+    unsigned long long _busyMicros;
+    unsigned int _droppedCommands;     // UI thread
+};
+
+#endif /* defined(__radome__radomeRenderThread__) */
@@ -0,0 +1,99 @@
+//
+//  radomeResolutionGovernor.cpp
+//  radome
+//
+
+#include "radomeResolutionGovernor.h"
+
+#define TIME_SMOOTHING 0.1
+#define HIGH_WATERMARK 0.95
+#define LOW_WATERMARK 0.7
+#define FRAMES_BEFORE_DECREASE 10
+#define FRAMES_BEFORE_INCREASE 90
+
+radomeResolutionGovernor::radomeResolutionGovernor()
+: _enabled(true)
+, _minScale(0.5)
+, _maxScale(1.0)
+, _frameBudget(1.0/60.0)
+, _step(0.05)
+, _cooldownFrames(45)
+, _scale(1.0)
+, _smoothedTime(0)
+, _framesOver(0)
+, _framesUnder(0)
+, _cooldown(0)
+, _lastReason(ScaleReasonNone)
+, _changeCount(0)
+{
+}
+
+void radomeResolutionGovernor::setEnabled(bool b) {
+    _enabled = b;
+    if (!_enabled && _scale != _maxScale) {
+        changeScale(_maxScale, ScaleReasonDisabled, "governor disabled");
+    }
+}
+
+void radomeResolutionGovernor::setBounds(float minScale, float maxScale) {
+    _minScale = ofClamp(MIN(minScale, maxScale), 0.1, 1.0);
+    _maxScale = ofClamp(MAX(minScale, maxScale), 0.1, 1.0);
+    float clamped = ofClamp(_scale, _minScale, _maxScale);
+    if (clamped != _scale) {
+        changeScale(clamped, ScaleReasonBoundsChanged, "clamped to new bounds");
+    }
+}
+
+void radomeResolutionGovernor::changeScale(float scale, radomeScaleChangeReason reason, const string& description) {
+    _scale = scale;
+    _lastReason = reason;
+    _lastDescription = description;
+    _changeCount++;
+    _framesOver = 0;
+    _framesUnder = 0;
+    _cooldown = _cooldownFrames;
+    ofLogNotice() << "projector render scale " << ofToString(_scale, 2) << ": " << description;
+}
+
+bool radomeResolutionGovernor::addFrameSample(float seconds) {
+    if (_smoothedTime == 0)
+        _smoothedTime = seconds;
+    else
+        _smoothedTime += (seconds - _smoothedTime) * TIME_SMOOTHING;
+
+    if (!_enabled)
+        return false;
+
+    if (_cooldown > 0) {
+        _cooldown--;
+        return false;
+    }
+
+    if (_smoothedTime > _frameBudget * HIGH_WATERMARK) {
+        _framesUnder = 0;
+        if (++_framesOver >= FRAMES_BEFORE_DECREASE && _scale > _minScale) {
+            // Cost is roughly proportional to pixel count, so take a larger
+            // step when far over budget, but never more than a few at a time.
+            float ratio = _smoothedTime / _frameBudget;
+            int steps = ofClamp((int)((ratio - 1.0) * 4.0) + 1, 1, 3);
+            float scale = MAX(_scale - _step * steps, _minScale);
+            changeScale(scale, ScaleReasonOverBudget,
+                        "frame time " + ofToString(_smoothedTime * 1000.0, 1) + "ms over " +
+                        ofToString(_frameBudget * 1000.0, 1) + "ms budget");
+            return true;
+        }
+    } else if (_smoothedTime < _frameBudget * LOW_WATERMARK) {
+        _framesOver = 0;
+        if (++_framesUnder >= FRAMES_BEFORE_INCREASE && _scale < _maxScale) {
+            float scale = MIN(_scale + _step, _maxScale);
+            changeScale(scale, ScaleReasonUnderBudget,
+                        "frame time " + ofToString(_smoothedTime * 1000.0, 1) + "ms under " +
+                        ofToString(_frameBudget * LOW_WATERMARK * 1000.0, 1) + "ms headroom target");
+            return true;
+        }
+    } else {
+        _framesOver = 0;
+        _framesUnder = 0;
+    }
+    return false;
+}
@@ -0,0 +1,71 @@
+//
+//  radomeResolutionGovernor.h
+//  radome
+//
+//  Picks the render scale for the projector passes from measured frame time.
+//  Changes are quantized, need a sustained trend and are followed by a cooldown,
+//  so the output resolution drifts slowly instead of pumping.
+//
+
+#ifndef __radome__radomeResolutionGovernor__
+#define __radome__radomeResolutionGovernor__
+
+#include "ofMain.h"
+
+enum radomeScaleChangeReason {
+    ScaleReasonNone = 0,
+    ScaleReasonOverBudget,
+    ScaleReasonUnderBudget,
+    ScaleReasonBoundsChanged,
+    ScaleReasonDisabled,
+};
+
+class radomeResolutionGovernor {
+public:
+    radomeResolutionGovernor();
+
+    void setEnabled(bool b);
+    bool isEnabled() const { return _enabled; }
+
+    void setBounds(float minScale, float maxScale);
+    float getMinScale() const { return _minScale; }
+    float getMaxScale() const { return _maxScale; }
+
+    // Time the governed passes may take per frame, in seconds.
+    void setFrameBudget(float seconds) { _frameBudget = seconds; }
+    float getFrameBudget() const { return _frameBudget; }
+
+    void setStep(float step) { _step = step; }
+    void setCooldownFrames(int frames) { _cooldownFrames = frames; }
+
+    // Feed one measurement per frame; returns true if the scale changed.
+    bool addFrameSample(float seconds);
+
+    float getScale() const { return _scale; }
+    float getSmoothedFrameTime() const { return _smoothedTime; }
+    radomeScaleChangeReason getLastChangeReason() const { return _lastReason; }
+    string getLastChangeDescription() const { return _lastDescription; }
+    unsigned int getChangeCount() const { return _changeCount; }
+
+protected:
+    void changeScale(float scale, radomeScaleChangeReason reason, const string& description);
+
+    bool _enabled;
+    float _minScale;
+    float _maxScale;
+    float _frameBudget;
+    float _step;
+    int _cooldownFrames;
+
+    float _scale;
+    float _smoothedTime;
+    int _framesOver;
+    int _framesUnder;
+    int _cooldown;
+
+    radomeScaleChangeReason _lastReason;
+    string _lastDescription;
+    unsigned int _changeCount;
+};
+
+#endif /* defined(__radome__radomeResolutionGovernor__) */
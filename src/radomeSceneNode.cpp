@@ -0,0 +1,113 @@
+//
+//  radomeSceneNode.cpp
+//  radome
+//
+
+#include "radomeSceneNode.h"
+
+radomeSceneNode::radomeSceneNode()
+: _pParent(NULL)
+, _localDirty(true)
+, _worldDirty(true)
+, _worldVersion(0)
+{
+}
+
+radomeSceneNode::~radomeSceneNode() {
+    setParent(NULL);
+    while (!_children.empty())
+        _children.back()->setParent(NULL);
+}
+
+void radomeSceneNode::setOrigin(ofVec3f o) {
+    if (o == _origin)
+        return;
+    _origin = o;
+    invalidateLocal();
+}
+
+void radomeSceneNode::translate(ofVec3f delta) {
+    setOrigin(_origin + delta);
+}
+
+void radomeSceneNode::setRotation(ofVec4f r) {
+    if (r == _rotation)
+        return;
+    _rotation = r;
+    invalidateLocal();
+}
+
+void radomeSceneNode::rotate(float degrees) {
+    if (degrees == 0)
+        return;
+    _rotation[0] += degrees;
+    invalidateLocal();
+}
+
+void radomeSceneNode::setRotationOrigin(ofVec3f o) {
+    if (o == _rotationOrigin)
+        return;
+    _rotationOrigin = o;
+    invalidateLocal();
+}
+
+void radomeSceneNode::setParent(radomeSceneNode* pParent) {
+    if (pParent == _pParent)
+        return;
+    for (radomeSceneNode* p = pParent; p; p = p->_pParent) {
+        if (p == this) {
+            ofLogWarning() << "scene node can't be attached beneath itself";
+            return;
+        }
+    }
+
+    if (_pParent) {
+        vector<radomeSceneNode*>& siblings = _pParent->_children;
+        siblings.erase(std::remove(siblings.begin(), siblings.end(), this), siblings.end());
+    }
+    _pParent = pParent;
+    if (_pParent)
+        _pParent->_children.push_back(this);
+    invalidateWorld();
+}
+
+void radomeSceneNode::invalidateLocal() {
+    _localDirty = true;
+    invalidateWorld();
+}
+
+// Stops at nodes that are already dirty: their subtree was invalidated with them.
+void radomeSceneNode::invalidateWorld() {
+    if (_worldDirty)
+        return;
+    _worldDirty = true;
+    for (auto iter = _children.begin(); iter != _children.end(); ++iter)
+        (*iter)->invalidateWorld();
+}
+
+// Same sequence radomeModel::draw() used to issue on the matrix stack.
+const ofMatrix4x4& radomeSceneNode::getLocalMatrix() const {
+    if (_localDirty) {
+        _localMatrix.makeIdentityMatrix();
+        _localMatrix.glTranslate(_origin);
+        _localMatrix.glTranslate(-_rotationOrigin);
+        _localMatrix.glRotate(_rotation[0], _rotation[1], _rotation[2], _rotation[3]);
+        _localMatrix.glTranslate(_rotationOrigin);
+        _localDirty = false;
+    }
+    return _localMatrix;
+}
+
+const ofMatrix4x4& radomeSceneNode::getWorldMatrix() const {
+    if (_worldDirty) {
+        _worldMatrix = _pParent ? getLocalMatrix() * _pParent->getWorldMatrix() : getLocalMatrix();
+        _worldDirty = false;
+        _worldVersion++;
+    }
+    return _worldMatrix;
+}
+
+unsigned int radomeSceneNode::getWorldVersion() const {
+    getWorldMatrix();
+    return _worldVersion;
+}
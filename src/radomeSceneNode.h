@@ -0,0 +1,62 @@
+//
+//  radomeSceneNode.h
+//  radome
+//
+//  Transform node for scene content. The local and world matrices are cached
+//  and only rebuilt after the node, or one of its ancestors, has moved.
+//
+
+#ifndef __radome__radomeSceneNode__
+#define __radome__radomeSceneNode__
+
+#include "ofMain.h"
+
+class radomeSceneNode {
+public:
+    radomeSceneNode();
+    virtual ~radomeSceneNode();
+
+    ofVec3f getOrigin() const { return _origin; }
+    void setOrigin(ofVec3f o);
+    void translate(ofVec3f delta);
+
+    // Angle in degrees followed by the rotation axis, as passed to ofRotate.
+    ofVec4f getRotation() const { return _rotation; }
+    void setRotation(ofVec4f r);
+    void rotate(float degrees);
+
+    ofVec3f getRotationOrigin() const { return _rotationOrigin; }
+    void setRotationOrigin(ofVec3f o);
+
+    // Children follow their parent's world transform. A node keeps its local
+    // transform when it is attached or detached.
+    void setParent(radomeSceneNode* pParent);
+    radomeSceneNode* getParent() const { return _pParent; }
+    const vector<radomeSceneNode*>& getChildren() const { return _children; }
+
+    const ofMatrix4x4& getLocalMatrix() const;
+    const ofMatrix4x4& getWorldMatrix() const;
+
+    // Bumped every time the world matrix is rebuilt, so anything derived from
+    // it can be cached against the version.
+    unsigned int getWorldVersion() const;
+
+protected:
+    void invalidateLocal();
+    void invalidateWorld();
+
+    ofVec3f _origin;
+    ofVec4f _rotation;
+    ofVec3f _rotationOrigin;
+
+    radomeSceneNode* _pParent;
+    vector<radomeSceneNode*> _children;
+
+    mutable ofMatrix4x4 _localMatrix;
+    mutable ofMatrix4x4 _worldMatrix;
+    mutable bool _localDirty;
+    mutable bool _worldDirty;
+    mutable unsigned int _worldVersion;
+};
+
+#endif /* defined(__radome__radomeSceneNode__) */
@@ -0,0 +1,276 @@
+//
+//  radomeSharedVideoSource.cpp
+//  radome
+//
+
+#include "radomeSharedVideoSource.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Two buffers, so the frame being filled never waits on the upload of the
+// one before it.
+#define SHARED_VIDEO_PBOS 2
+// How often the name is looked up again, to find a producer that has
+// started or restarted.
+#define SHARED_VIDEO_CHECK_MS 500
+
+radomeSharedVideoSource::radomeSharedVideoSource()
+: _fd(-1)
+, _pMapping(NULL)
+, _mappingSize(0)
+, _inode(0)
+, _session(0)
+, _slotCount(0)
+, _slotBytes(0)
+, _dataOffset(0)
+, _lastFrame(0)
+, _lastCheck(0)
+, _width(0)
+, _height(0)
+, _format(SharedVideoBGRA)
+, _usePbos(false)
+, _pbo(0)
+, _textureCurrent(false)
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+radomeSharedVideoSource::~radomeSharedVideoSource() {
+    disconnect();
+    if (!_pbos.empty())
+        glDeleteBuffers(_pbos.size(), &_pbos[0]);
+}
+
+void radomeSharedVideoSource::setup(const string& name) {
+    disconnect();
+    _name = name;
+    _usePbos = GLEW_ARB_pixel_buffer_object;
+    _lastCheck = 0;
+}
+
+// Only a complete ring is mapped: the producer sizes the object and fills
+// in the header before it writes the magic number.
+bool radomeSharedVideoSource::connect() {
+    int fd = shm_open(_name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(fd, &info) < 0 || (size_t)info.st_size < sizeof(radomeSharedVideoHeader)) {
+        close(fd);
+        return false;
+    }
+    void* pMapping = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (pMapping == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    // Each field is read once, so what's checked is what's kept.
+    const radomeSharedVideoHeader* pHeader = (const radomeSharedVideoHeader*)pMapping;
+    bool valid = pHeader->magic == SHARED_VIDEO_MAGIC;
+    __sync_synchronize();
+    uint32_t slotCount = pHeader->slotCount;
+    uint64_t slotBytes = pHeader->slotBytes;
+    uint64_t dataOffset = pHeader->dataOffset;
+    valid = valid && slotCount > 0 && slotCount <= SHARED_VIDEO_MAX_SLOTS &&
+        dataOffset >= sizeof(radomeSharedVideoHeader) && dataOffset <= (uint64_t)info.st_size &&
+        slotBytes <= ((uint64_t)info.st_size - dataOffset) / slotCount;
+    if (!valid) {
+        munmap(pMapping, info.st_size);
+        close(fd);
+        return false;
+    }
+
+    disconnect();
+    _fd = fd;
+    _pMapping = pMapping;
+    _mappingSize = info.st_size;
+    _inode = info.st_ino;
+    _session = pHeader->session;
+    _slotCount = slotCount;
+    _slotBytes = slotBytes;
+    _dataOffset = dataOffset;
+    _lastFrame = 0;
+    _stats.connects++;
+    ofLogNotice() << "shared video " << _name << ": connected, " << _slotCount << " slots of "
+                  << _slotBytes / 1024 << " KB";
+    return true;
+}
+
+void radomeSharedVideoSource::disconnect() {
+    if (_pMapping) {
+        munmap(_pMapping, _mappingSize);
+        _pMapping = NULL;
+        _mappingSize = 0;
+    }
+    if (_fd >= 0) {
+        close(_fd);
+        _fd = -1;
+    }
+}
+
+// A restarted producer unlinks the old object and creates a new one under
+// the same name, so the name stops leading to what's mapped.
+bool radomeSharedVideoSource::isStale() {
+    struct stat info;
+    int fd = shm_open(_name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+    bool stale = fstat(fd, &info) == 0 && ((unsigned long long)info.st_ino != _inode || (size_t)info.st_size != _mappingSize);
+    close(fd);
+    return stale;
+}
+
+bool radomeSharedVideoSource::update() {
+    unsigned long long now = ofGetElapsedTimeMillis();
+    if (now - _lastCheck >= SHARED_VIDEO_CHECK_MS || !_lastCheck) {
+        _lastCheck = now;
+        if (!_pMapping || isStale())
+            connect();
+    }
+    if (!_pMapping)
+        return false;
+    return readFrame();
+}
+
+void radomeSharedVideoSource::getPixelFormat(GLenum& format, GLenum& type) const {
+    if (_format == SharedVideoRGBA) {
+        format = GL_RGBA;
+        type = GL_UNSIGNED_BYTE;
+    } else {
+        format = GL_BGRA;
+        type = GL_UNSIGNED_INT_8_8_8_8_REV;
+    }
+}
+
+// The slot's sequence is read before and after the copy; if the producer
+// has started on the slot in between, the copy is torn and thrown away. Until
+// a frame checks out, the current one stays as it was, size included.
+bool radomeSharedVideoSource::readFrame() {
+    const radomeSharedVideoHeader* pHeader = (const radomeSharedVideoHeader*)_pMapping;
+    // A producer restarting in the same object sets it up again, maybe with
+    // another layout; it's connected to afresh on the next update.
+    if (pHeader->magic != SHARED_VIDEO_MAGIC || pHeader->session != _session) {
+        disconnect();
+        _lastCheck = 0;
+        return false;
+    }
+    uint64_t frames = pHeader->frames;
+    if (frames == 0 || frames == _lastFrame)
+        return false;
+    __sync_synchronize();
+
+    int index = (frames - 1) % _slotCount;
+    const radomeSharedVideoSlot& slot = pHeader->slots[index];
+    uint64_t sequence = slot.sequence;
+    __sync_synchronize();
+    if (sequence != frames * 2) {
+        _stats.dropped++;
+        _lastFrame = frames;
+        return false;
+    }
+    int width = slot.width;
+    int height = slot.height;
+    size_t stride = slot.stride;
+    int format = slot.format;
+    if (width <= 0 || height <= 0 || stride < (size_t)width * 4 || stride * height > _slotBytes) {
+        _lastFrame = frames;
+        return false;
+    }
+
+    // The one copy: rows from the ring straight into the buffer the GPU reads.
+    const unsigned char* pSource = (const unsigned char*)_pMapping + _dataOffset + index * _slotBytes;
+    int pbo = (_pbo + 1) % SHARED_VIDEO_PBOS;
+    unsigned char* pDest = NULL;
+    if (_usePbos) {
+        if (_pbos.empty()) {
+            _pbos.resize(SHARED_VIDEO_PBOS);
+            glGenBuffers(_pbos.size(), &_pbos[0]);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, _pbos[pbo]);
+        // Orphaned first, so mapping doesn't wait for an upload still reading
+        // it; sized for this frame, which also covers a change of resolution.
+        glBufferData(GL_PIXEL_UNPACK_BUFFER_ARB, width * height * 4, NULL, GL_STREAM_DRAW);
+        pDest = (unsigned char*)glMapBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY);
+    } else {
+        _scratch.resize(width * height * 4);
+        pDest = &_scratch[0];
+    }
+    if (pDest) {
+        if (stride == (size_t)width * 4) {
+            memcpy(pDest, pSource, stride * height);
+        } else {
+            for (int row = 0; row < height; row++)
+                memcpy(pDest + row * width * 4, pSource + row * stride, width * 4);
+        }
+    }
+    if (_usePbos) {
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER_ARB);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+    }
+
+    __sync_synchronize();
+    _lastFrame = frames;
+    if (!pDest || slot.sequence != sequence) {
+        _stats.dropped++;
+        return false;
+    }
+    if (!_usePbos)
+        _pixels.swap(_scratch);
+    _pbo = pbo;
+    if (width != _width || height != _height || format != _format) {
+        ofLogNotice() << "shared video " << _name << ": " << width << "x" << height;
+        _width = width;
+        _height = height;
+        _format = format;
+        _texture.clear();
+    }
+    _textureCurrent = false;
+    _stats.frames++;
+    return true;
+}
+
+// Straight from the pixel buffer into the layer's slice, when the frame is
+// exactly the slice's size; anything else is drawn in scaled instead.
+bool radomeSharedVideoSource::uploadToSlice(GLuint texture, int slice, int width, int height) {
+    if (width != _width || height != _height)
+        return false;
+
+    GLenum format, type;
+    getPixelFormat(format, type);
+    if (_usePbos)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, _pbos[_pbo]);
+    glBindTexture(GL_TEXTURE_2D_ARRAY_EXT, texture);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY_EXT, 0, 0, 0, slice, _width, _height, 1, format, type,
+                    _usePbos ? NULL : &_pixels[0]);
+    glBindTexture(GL_TEXTURE_2D_ARRAY_EXT, 0);
+    if (_usePbos)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+    return true;
+}
+
+void radomeSharedVideoSource::drawFrame(float x, float y, float w, float h) {
+    if (!_width)
+        return;
+    if (!_texture.isAllocated())
+        _texture.allocate(_width, _height, GL_RGBA);
+    if (!_textureCurrent) {
+        GLenum format, type;
+        getPixelFormat(format, type);
+        const ofTextureData& data = _texture.getTextureData();
+        if (_usePbos)
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, _pbos[_pbo]);
+        glBindTexture(data.textureTarget, data.textureID);
+        glTexSubImage2D(data.textureTarget, 0, 0, 0, _width, _height, format, type,
+                        _usePbos ? NULL : &_pixels[0]);
+        glBindTexture(data.textureTarget, 0);
+        if (_usePbos)
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+        _textureCurrent = true;
+    }
+    _texture.draw(x, y, w, h);
+}
@@ -0,0 +1,117 @@
+//
+//  radomeSharedVideoSource.h
+//  radome
+//
+//  Video source fed by another process through a POSIX shared memory ring,
+//  for machines without Syphon. The producer creates the object, fills a
+//  slot and then publishes it; this side maps the object, copies the newest
+//  finished frame straight into a pixel buffer, and lets the GPU take it
+//  from there. Nothing blocks on the producer: a frame it overwrote while
+//  being read is dropped and the next one is used instead.
+//
+//  The producer may restart, or come back at another resolution, at any
+//  time; the name is checked again periodically and remapped when it refers
+//  to a new ring.
+//
+
+#ifndef __radome__radomeSharedVideoSource__
+#define __radome__radomeSharedVideoSource__
+
+#include "radomeVideoSource.h"
+
+#include <stdint.h>
+
+// Layout of the shared object, which producers follow too. All fields are
+// native-endian; pixels start at dataOffset, slotBytes apart. The object's
+// size is fixed once the magic number is written: reading a mapping the
+// producer has shrunk with ftruncate() raises SIGBUS. Any change of size or
+// layout means shm_unlink() and a fresh object under the same name.
+#define SHARED_VIDEO_MAGIC 0x31564452   // "RDV1"
+#define SHARED_VIDEO_MAX_SLOTS 8
+
+enum radomeSharedVideoFormat {
+    SharedVideoBGRA = 0,
+    SharedVideoRGBA,
+};
+
+struct radomeSharedVideoSlot {
+    // Odd while the producer writes the slot, 2 * frames once the frame that
+    // made the count frames is complete in it.
+    volatile uint64_t sequence;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;        // bytes per row
+    uint32_t format;        // radomeSharedVideoFormat
+};
+
+struct radomeSharedVideoHeader {
+    uint32_t magic;         // written last when the producer sets the ring up
+    uint32_t slotCount;
+    uint64_t session;       // different every time a producer creates the ring
+    uint64_t slotBytes;
+    uint64_t dataOffset;
+    volatile uint64_t frames;   // published so far; the newest is in slot (frames - 1) % slotCount
+    radomeSharedVideoSlot slots[SHARED_VIDEO_MAX_SLOTS];
+};
+
+struct radomeSharedVideoStats {
+    unsigned int frames;        // uploaded
+    unsigned int dropped;       // overwritten while being read
+    unsigned int connects;      // including reconnects to a restarted producer
+};
+
+class radomeSharedVideoSource : public radomeVideoSource {
+public:
+    radomeSharedVideoSource();
+    ~radomeSharedVideoSource();
+
+    // The shared memory name, e.g. "/radome-layer1". The producer doesn't
+    // have to be running yet.
+    void setup(const string& name);
+    const string& getName() const { return _name; }
+
+    bool update();
+    bool isReady() { return _width > 0; }
+    float getWidth() { return _width; }
+    float getHeight() { return _height; }
+    void drawFrame(float x, float y, float w, float h);
+    bool uploadToSlice(GLuint texture, int slice, int width, int height);
+
+    radomeSharedVideoStats getStats() const { return _stats; }
+
+protected:
+    bool connect();
+    void disconnect();
+    bool isStale();
+    bool readFrame();
+    void getPixelFormat(GLenum& format, GLenum& type) const;
+
+    string _name;
+    int _fd;
+    void* _pMapping;
+    size_t _mappingSize;
+    unsigned long long _inode;
+    uint64_t _session;
+    // The ring's layout as it was checked against the mapping; the header is
+    // the producer's to write, so it isn't trusted again after connecting.
+    uint32_t _slotCount;
+    uint64_t _slotBytes;
+    uint64_t _dataOffset;
+    uint64_t _lastFrame;
+    unsigned long long _lastCheck;
+
+    int _width;
+    int _height;
+    int _format;
+    bool _usePbos;
+    vector<GLuint> _pbos;
+    int _pbo;               // holding the current frame
+    vector<unsigned char> _pixels;   // the current frame, without pixel buffers
+    vector<unsigned char> _scratch;  // the frame being read, until it checks out
+    ofTexture _texture;     // only for frames drawn rather than uploaded into a slice
+    bool _textureCurrent;
+
+    radomeSharedVideoStats _stats;
+};
+
+#endif /* defined(__radome__radomeSharedVideoSource__) */
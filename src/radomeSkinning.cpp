@@ -0,0 +1,342 @@
+//
+//  radomeSkinning.cpp
+//  radome
+//
+
+#include "radomeSkinning.h"
+
+// Texels per palette row; a multiple of 4 so no bone straddles two rows.
+#define BONE_PALETTE_WIDTH 1024
+#define BONES_PER_ROW (BONE_PALETTE_WIDTH / 4)
+
+radomeBonePalette::radomeBonePalette()
+: _texture(0)
+, _rows(0)
+, _boneCount(0)
+, _frames(0)
+, _allocation(0)
+{
+}
+
+radomeBonePalette::~radomeBonePalette() {
+    if (_texture)
+        glDeleteTextures(1, &_texture);
+    if (_allocation)
+        radomeGpuMemory::get().release(_allocation);
+}
+
+bool radomeBonePalette::allocate() {
+    GLint vertexTextureUnits = 0;
+    glGetIntegerv(GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS, &vertexTextureUnits);
+    if (!GLEW_ARB_texture_float || vertexTextureUnits < 1) {
+        ofLogNotice() << "bone palette: no float vertex textures, skinning on the CPU";
+        return false;
+    }
+    allocateTexture(1);
+    return true;
+}
+
+void radomeBonePalette::allocateTexture(int rows) {
+    if (!_texture)
+        glGenTextures(1, &_texture);
+    _rows = rows;
+
+    glBindTexture(GL_TEXTURE_2D, _texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F_ARB, BONE_PALETTE_WIDTH, _rows, 0, GL_RGBA, GL_FLOAT, NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    size_t bytes = BONE_PALETTE_WIDTH * _rows * 4 * sizeof(float);
+    radomeGpuMemory& tracker = radomeGpuMemory::get();
+    if (_allocation)
+        tracker.resize(_allocation, bytes);
+    else
+        _allocation = tracker.track(this, "bone palette", GpuOther, bytes);
+}
+
+void radomeBonePalette::beginFrame() {
+    _boneCount = 0;
+    _frames++;
+}
+
+// The returned pointer is only good until the next reserve().
+float* radomeBonePalette::reserve(int count, int& base) {
+    base = _boneCount;
+    _boneCount += count;
+    int rows = (_boneCount + BONES_PER_ROW - 1) / BONES_PER_ROW;
+    if ((int)_bones.size() < rows * BONE_PALETTE_WIDTH * 4)
+        _bones.resize(rows * BONE_PALETTE_WIDTH * 4);
+    return &_bones[base * 16];
+}
+
+void radomeBonePalette::endFrame() {
+    if (!_texture || !_boneCount)
+        return;
+
+    int rows = (_boneCount + BONES_PER_ROW - 1) / BONES_PER_ROW;
+    if (rows > _rows) {
+        int grown = _rows;
+        while (grown < rows)
+            grown *= 2;
+        allocateTexture(grown);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, _texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, BONE_PALETTE_WIDTH, rows, GL_RGBA, GL_FLOAT, &_bones[0]);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void radomeBonePalette::bind(ofShader& shader, int textureUnit) {
+    glActiveTexture(GL_TEXTURE0 + textureUnit);
+    glBindTexture(GL_TEXTURE_2D, _texture);
+    glActiveTexture(GL_TEXTURE0);
+    shader.setUniform1i("bones", textureUnit);
+    shader.setUniform2f("paletteSize", BONE_PALETTE_WIDTH, _rows);
+}
+
+void radomeBonePalette::unbind(int textureUnit) {
+    glActiveTexture(GL_TEXTURE0 + textureUnit);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+radomeSkeleton::radomeSkeleton()
+: _pScene(NULL)
+, _channelAnimation(-1)
+{
+}
+
+radomeSkeleton::~radomeSkeleton() {
+    clear();
+}
+
+void radomeSkeleton::clear() {
+    for (auto iter = _meshes.begin(); iter != _meshes.end(); ++iter) {
+        if (iter->skin.weightBuffer)
+            glDeleteBuffers(1, &iter->skin.weightBuffer);
+    }
+    _meshes.clear();
+    _nodes.clear();
+    _nodeIndex.clear();
+    _globals.clear();
+    _channels.clear();
+    _channelAnimation = -1;
+    _pScene = NULL;
+}
+
+void radomeSkeleton::addNode(const aiNode* pNode, int parent) {
+    Node node;
+    node.pNode = pNode;
+    node.parent = parent;
+    int index = _nodes.size();
+    _nodes.push_back(node);
+    _nodeIndex[pNode->mName.data] = index;
+    for (unsigned int ii = 0; ii < pNode->mNumChildren; ii++)
+        addNode(pNode->mChildren[ii], index);
+}
+
+bool radomeSkeleton::setup(const aiScene* pScene) {
+    clear();
+    if (!pScene || !pScene->mRootNode)
+        return false;
+    _pScene = pScene;
+
+    // Parents come before their children, so one forward pass poses the tree.
+    addNode(pScene->mRootNode, -1);
+    _globals.resize(_nodes.size());
+
+    for (unsigned int ii = 0; ii < pScene->mNumMeshes; ii++) {
+        const aiMesh* pMesh = pScene->mMeshes[ii];
+        if (!pMesh->HasBones())
+            continue;
+
+        SkinnedMesh skinned;
+        skinned.meshIndex = ii;
+        for (unsigned int bb = 0; bb < pMesh->mNumBones; bb++) {
+            auto iter = _nodeIndex.find(pMesh->mBones[bb]->mName.data);
+            Bone bone;
+            bone.node = iter != _nodeIndex.end() ? iter->second : -1;
+            bone.offset = pMesh->mBones[bb]->mOffsetMatrix;
+            skinned.bones.push_back(bone);
+        }
+        buildWeights(pMesh, skinned);
+        _meshes.push_back(skinned);
+    }
+    return isValid();
+}
+
+// Keeps the MAX_BONE_INFLUENCES strongest weights per vertex, renormalized,
+// as four bone indices and four weights.
+void radomeSkeleton::buildWeights(const aiMesh* pMesh, SkinnedMesh& skinned) {
+    const int stride = MAX_BONE_INFLUENCES * 2;
+    vector<float> attributes(pMesh->mNumVertices * stride, 0.0f);
+
+    for (unsigned int bb = 0; bb < pMesh->mNumBones; bb++) {
+        const aiBone* pBone = pMesh->mBones[bb];
+        for (unsigned int ww = 0; ww < pBone->mNumWeights; ww++) {
+            const aiVertexWeight& weight = pBone->mWeights[ww];
+            if (weight.mVertexId >= pMesh->mNumVertices)
+                continue;
+            float* pIndices = &attributes[weight.mVertexId * stride];
+            float* pWeights = pIndices + MAX_BONE_INFLUENCES;
+            int weakest = 0;
+            for (int ii = 1; ii < MAX_BONE_INFLUENCES; ii++) {
+                if (pWeights[ii] < pWeights[weakest])
+                    weakest = ii;
+            }
+            if (weight.mWeight > pWeights[weakest]) {
+                pIndices[weakest] = bb;
+                pWeights[weakest] = weight.mWeight;
+            }
+        }
+    }
+
+    for (unsigned int vv = 0; vv < pMesh->mNumVertices; vv++) {
+        float* pWeights = &attributes[vv * stride + MAX_BONE_INFLUENCES];
+        float total = 0;
+        for (int ii = 0; ii < MAX_BONE_INFLUENCES; ii++)
+            total += pWeights[ii];
+        for (int ii = 0; ii < MAX_BONE_INFLUENCES && total > 0; ii++)
+            pWeights[ii] /= total;
+    }
+
+    skinned.skin.weightBuffer = 0;
+    skinned.skin.boneBase = 0;
+    skinned.skin.boneCount = skinned.bones.size();
+    skinned.weights.swap(attributes);
+}
+
+void radomeSkeleton::upload() {
+    for (auto iter = _meshes.begin(); iter != _meshes.end(); ++iter) {
+        if (iter->skin.weightBuffer || iter->weights.empty())
+            continue;
+        glGenBuffers(1, &iter->skin.weightBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, iter->skin.weightBuffer);
+        glBufferData(GL_ARRAY_BUFFER, iter->weights.size() * sizeof(float), &iter->weights[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        vector<float>().swap(iter->weights);
+    }
+}
+
+size_t radomeSkeleton::getWeightBytes() const {
+    size_t bytes = 0;
+    for (auto iter = _meshes.begin(); iter != _meshes.end(); ++iter)
+        bytes += _pScene->mMeshes[iter->meshIndex]->mNumVertices * MAX_BONE_INFLUENCES * 2 * sizeof(float);
+    return bytes;
+}
+
+const radomeSkin* radomeSkeleton::getSkin(int meshIndex) const {
+    for (auto iter = _meshes.begin(); iter != _meshes.end(); ++iter) {
+        if (iter->meshIndex == meshIndex)
+            return &iter->skin;
+    }
+    return NULL;
+}
+
+const aiNodeAnim* radomeSkeleton::findChannel(const aiAnimation* pAnimation, const aiNode* pNode) {
+    for (unsigned int ii = 0; ii < pAnimation->mNumChannels; ii++) {
+        if (strcmp(pAnimation->mChannels[ii]->mNodeName.data, pNode->mName.data) == 0)
+            return pAnimation->mChannels[ii];
+    }
+    return NULL;
+}
+
+// Index of the key at or before ticks, clamped to the track.
+template <typename Key>
+static unsigned int findKey(const Key* pKeys, unsigned int count, double ticks) {
+    unsigned int key = 0;
+    while (key + 1 < count && pKeys[key + 1].mTime <= ticks)
+        key++;
+    return key;
+}
+
+template <typename Key>
+static float keyFactor(const Key* pKeys, unsigned int count, unsigned int key, double ticks) {
+    if (key + 1 >= count)
+        return 0;
+    double span = pKeys[key + 1].mTime - pKeys[key].mTime;
+    return span > 0 ? ofClamp((ticks - pKeys[key].mTime) / span, 0, 1) : 0;
+}
+
+static aiVector3D interpolateVector(const aiVectorKey* pKeys, unsigned int count, double ticks, const aiVector3D& fallback) {
+    if (!count)
+        return fallback;
+    unsigned int key = findKey(pKeys, count, ticks);
+    float f = keyFactor(pKeys, count, key, ticks);
+    if (f == 0)
+        return pKeys[key].mValue;
+    return pKeys[key].mValue + (pKeys[key + 1].mValue - pKeys[key].mValue) * f;
+}
+
+aiMatrix4x4 radomeSkeleton::interpolate(const aiNodeAnim* pChannel, double ticks) {
+    aiVector3D position = interpolateVector(pChannel->mPositionKeys, pChannel->mNumPositionKeys, ticks, aiVector3D(0, 0, 0));
+    aiVector3D scaling = interpolateVector(pChannel->mScalingKeys, pChannel->mNumScalingKeys, ticks, aiVector3D(1, 1, 1));
+
+    aiQuaternion rotation;
+    if (pChannel->mNumRotationKeys) {
+        unsigned int key = findKey(pChannel->mRotationKeys, pChannel->mNumRotationKeys, ticks);
+        float f = keyFactor(pChannel->mRotationKeys, pChannel->mNumRotationKeys, key, ticks);
+        rotation = pChannel->mRotationKeys[key].mValue;
+        if (f > 0) {
+            aiQuaternion::Interpolate(rotation, pChannel->mRotationKeys[key].mValue, pChannel->mRotationKeys[key + 1].mValue, f);
+            rotation.Normalize();
+        }
+    }
+
+    // translation * rotation * scaling
+    aiMatrix3x3 r = rotation.GetMatrix();
+    aiMatrix4x4 m;
+    m.a1 = r.a1 * scaling.x; m.a2 = r.a2 * scaling.y; m.a3 = r.a3 * scaling.z; m.a4 = position.x;
+    m.b1 = r.b1 * scaling.x; m.b2 = r.b2 * scaling.y; m.b3 = r.b3 * scaling.z; m.b4 = position.y;
+    m.c1 = r.c1 * scaling.x; m.c2 = r.c2 * scaling.y; m.c3 = r.c3 * scaling.z; m.c4 = position.z;
+    m.d1 = 0; m.d2 = 0; m.d3 = 0; m.d4 = 1;
+    return m;
+}
+
+// Writes m as four GL (column-major) columns.
+static void writeBone(float* pOut, const aiMatrix4x4& m) {
+    const float columns[16] = {
+        m.a1, m.b1, m.c1, m.d1,
+        m.a2, m.b2, m.c2, m.d2,
+        m.a3, m.b3, m.c3, m.d3,
+        m.a4, m.b4, m.c4, m.d4,
+    };
+    memcpy(pOut, columns, sizeof(columns));
+}
+
+void radomeSkeleton::pose(unsigned int animation, double ticks) {
+    if (!isValid() || animation >= _pScene->mNumAnimations)
+        return;
+
+    const aiAnimation* pAnimation = _pScene->mAnimations[animation];
+    if (_channelAnimation != (int)animation) {
+        _channels.resize(_nodes.size());
+        for (int ii = 0; ii < (int)_nodes.size(); ii++)
+            _channels[ii] = findChannel(pAnimation, _nodes[ii].pNode);
+        _channelAnimation = animation;
+    }
+
+    for (int ii = 0; ii < (int)_nodes.size(); ii++) {
+        aiMatrix4x4 local = _channels[ii] ? interpolate(_channels[ii], ticks) : _nodes[ii].pNode->mTransformation;
+        _globals[ii] = _nodes[ii].parent >= 0 ? _globals[_nodes[ii].parent] * local : local;
+    }
+}
+
+void radomeSkeleton::writeBones(radomeBonePalette& palette) {
+    if (!isValid())
+        return;
+
+    // Same bone transform as ofxAssimpModelLoader's CPU skinning: the bone
+    // node's full chain up to the root, times the bone's offset matrix.
+    for (auto iter = _meshes.begin(); iter != _meshes.end(); ++iter) {
+        float* pOut = palette.reserve(iter->bones.size(), iter->skin.boneBase);
+        for (int bb = 0; bb < (int)iter->bones.size(); bb++) {
+            const Bone& bone = iter->bones[bb];
+            aiMatrix4x4 m = bone.node >= 0 ? _globals[bone.node] * bone.offset : bone.offset;
+            writeBone(pOut + bb * 16, m);
+        }
+    }
+}
@@ -0,0 +1,133 @@
+//
+//  radomeSkinning.h
+//  radome
+//
+//  GPU skinning for Assimp models. A skeleton evaluates its node animation into
+//  bone matrices on the CPU (a few dozen matrices rather than every vertex),
+//  every skinned asset writes them into one palette texture that is uploaded
+//  once per frame, and the skinning shader blends the bind-pose vertices.
+//
+
+#ifndef __radome__radomeSkinning__
+#define __radome__radomeSkinning__
+
+#include "ofMain.h"
+#include "radomeGpuMemory.h"
+#include "aiScene.h"
+
+#include <map>
+using std::map;
+
+#define MAX_BONE_INFLUENCES 4
+// Clear of VIDEO_LAYER_TEXTURE_UNIT (1) and COLOR_LUT_TEXTURE_UNIT (2).
+#define BONE_PALETTE_TEXTURE_UNIT 3
+
+// Per-mesh state the render queue needs to draw a skinned mesh: where its
+// bone indices and weights live, and where its bones start in the palette.
+struct radomeSkin {
+    GLuint weightBuffer;
+    int boneBase;
+    int boneCount;
+};
+
+// CPU time spent posing animated assets, split by skinning path.
+struct radomeSkinningTimes {
+    unsigned int cpuPoses;
+    unsigned int gpuPoses;
+    unsigned long long cpuMicros;
+    unsigned long long gpuMicros;
+};
+
+// Every skinned asset's bone matrices for the frame, packed into one float
+// texture, four RGBA texels (matrix columns) per bone.
+class radomeBonePalette {
+public:
+    radomeBonePalette();
+    ~radomeBonePalette();
+
+    // Fails without float textures or vertex texture fetch; assets then keep
+    // skinning on the CPU.
+    bool allocate();
+    bool isAllocated() const { return _texture != 0; }
+
+    void beginFrame();
+    // Space for count bones (16 floats each); base is the first bone's index.
+    // GL thread only, like the rest of the palette: nothing here is locked.
+    float* reserve(int count, int& base);
+    // Uploads the bones written this frame, growing the texture if needed.
+    void endFrame();
+
+    unsigned int getFrameCount() const { return _frames; }
+    int getBoneCount() const { return _boneCount; }
+
+    // Sets the shader's bones sampler and paletteSize.
+    void bind(ofShader& shader, int textureUnit);
+    void unbind(int textureUnit);
+
+protected:
+    void allocateTexture(int rows);
+
+    GLuint _texture;
+    int _rows;
+    vector<float> _bones;
+    int _boneCount;
+    unsigned int _frames;
+    radomeGpuMemory::Handle _allocation;
+};
+
+class radomeSkeleton {
+public:
+    radomeSkeleton();
+    ~radomeSkeleton();
+
+    // Builds the node table and per-mesh bone weights; false when the scene
+    // has no skinned meshes. No GL, so it can run on the loader's thread;
+    // upload() then moves the weights into buffers.
+    bool setup(const aiScene* pScene);
+    void upload();
+    void clear();
+    bool isValid() const { return !_meshes.empty(); }
+
+    // Poses the hierarchy at ticks of the given animation: CPU only, so
+    // skeletons of different assets can be posed on job threads at once.
+    void pose(unsigned int animation, double ticks);
+    // Writes each skinned mesh's bones, as last posed, into the palette.
+    void writeBones(radomeBonePalette& palette);
+
+    // NULL for meshes without bones.
+    const radomeSkin* getSkin(int meshIndex) const;
+    size_t getWeightBytes() const;
+
+protected:
+    struct Node {
+        const aiNode* pNode;
+        int parent;
+    };
+    struct Bone {
+        int node;
+        aiMatrix4x4 offset;
+    };
+    struct SkinnedMesh {
+        int meshIndex;
+        vector<Bone> bones;
+        vector<float> weights;  // until uploaded
+        radomeSkin skin;
+    };
+
+    void addNode(const aiNode* pNode, int parent);
+    void buildWeights(const aiMesh* pMesh, SkinnedMesh& skinned);
+    const aiNodeAnim* findChannel(const aiAnimation* pAnimation, const aiNode* pNode);
+    aiMatrix4x4 interpolate(const aiNodeAnim* pChannel, double ticks);
+
+    const aiScene* _pScene;
+    vector<Node> _nodes;
+    map<string, int> _nodeIndex;
+    vector<SkinnedMesh> _meshes;
+    vector<aiMatrix4x4> _globals;
+
+    // Channel for each node, rebuilt when the animation changes.
+    int _channelAnimation;
+    vector<const aiNodeAnim*> _channels;
+};
+
+#endif /* defined(__radome__radomeSkinning__) */
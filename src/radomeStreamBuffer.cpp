@@ -0,0 +1,204 @@
+//
+//  radomeStreamBuffer.cpp
+//  radome
+//
+
+#include "radomeStreamBuffer.h"
+
+#define STREAM_ALIGNMENT 64
+#define FENCE_TIMEOUT_NS 1000000000ULL
+
+radomeStreamBuffer::radomeStreamBuffer()
+: _mode(StreamOrphaned)
+, _buffer(0)
+, _regionSize(0)
+, _region(0)
+, _offset(0)
+, _wanted(0)
+, _pMapped(NULL)
+, _inFrame(false)
+, _allocation(0)
+{
+    memset(&_stats, 0, sizeof(_stats));
+    for (int ii = 0; ii < STREAM_BUFFER_REGIONS; ii++)
+        _fences[ii] = 0;
+}
+
+radomeStreamBuffer::~radomeStreamBuffer() {
+    release();
+    if (_allocation)
+        radomeGpuMemory::get().release(_allocation);
+}
+
+const char* radomeStreamBuffer::getModeName() const {
+    switch (_mode) {
+        case StreamPersistent: return "persistent";
+        case StreamUnsynchronized: return "unsynchronized";
+        default: return "orphaned";
+    }
+}
+
+void radomeStreamBuffer::release() {
+    for (int ii = 0; ii < STREAM_BUFFER_REGIONS; ii++) {
+        if (_fences[ii]) {
+            glDeleteSync(_fences[ii]);
+            _fences[ii] = 0;
+        }
+    }
+    if (_buffer) {
+        if (_pMapped) {
+            glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            _pMapped = NULL;
+        }
+        glDeleteBuffers(1, &_buffer);
+        _buffer = 0;
+    }
+    _inFrame = false;
+}
+
+bool radomeStreamBuffer::allocate(size_t regionSize) {
+    release();
+    _regionSize = (regionSize + STREAM_ALIGNMENT - 1) & ~(size_t)(STREAM_ALIGNMENT - 1);
+    _region = 0;
+    _offset = 0;
+    size_t total = _regionSize * STREAM_BUFFER_REGIONS;
+
+    if (GLEW_ARB_sync && GLEW_ARB_buffer_storage)
+        _mode = StreamPersistent;
+    else if (GLEW_ARB_sync && GLEW_ARB_map_buffer_range)
+        _mode = StreamUnsynchronized;
+    else
+        _mode = StreamOrphaned;
+
+    glGenBuffers(1, &_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+    if (_mode == StreamPersistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_ARRAY_BUFFER, total, NULL, flags);
+        _pMapped = (char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, total, flags);
+        if (!_pMapped) {
+            ofLogWarning() << "stream buffer: persistent mapping failed, mapping per frame instead";
+            glDeleteBuffers(1, &_buffer);
+            glGenBuffers(1, &_buffer);
+            glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+            _mode = GLEW_ARB_map_buffer_range ? StreamUnsynchronized : StreamOrphaned;
+        }
+    }
+    if (_mode != StreamPersistent) {
+        glBufferData(GL_ARRAY_BUFFER, _mode == StreamOrphaned ? _regionSize : total, NULL, GL_STREAM_DRAW);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    _stats.regionSize = _regionSize;
+    size_t bytes = _mode == StreamOrphaned ? _regionSize : total;
+    if (_allocation)
+        radomeGpuMemory::get().resize(_allocation, bytes);
+    else
+        _allocation = radomeGpuMemory::get().track(this, "geometry stream", GpuModelGeometry, bytes);
+
+    ofLogNotice() << "stream buffer: " << STREAM_BUFFER_REGIONS << " x " << _regionSize / 1024 << " KB, " << getModeName();
+    return true;
+}
+
+// A fence that hasn't signaled means the CPU caught up with the GPU; that
+// wait is the stall being counted.
+void radomeStreamBuffer::waitForRegion(int region) {
+    if (!_fences[region])
+        return;
+    GLenum result = glClientWaitSync(_fences[region], 0, 0);
+    if (result == GL_TIMEOUT_EXPIRED) {
+        _stats.stalls++;
+        glClientWaitSync(_fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+    }
+    glDeleteSync(_fences[region]);
+    _fences[region] = 0;
+}
+
+void radomeStreamBuffer::beginFrame() {
+    if (!_buffer)
+        return;
+
+    // Everything that read the previous region was issued last frame.
+    if (_mode != StreamOrphaned && _offset > 0) {
+        if (_fences[_region])
+            glDeleteSync(_fences[_region]);
+        _fences[_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    if (_wanted > _regionSize) {
+        size_t grown = MAX(_wanted, _regionSize * 2);
+        ofLogNotice() << "stream buffer: growing region to " << grown / 1024 << " KB";
+        allocate(grown);
+    }
+    _wanted = 0;
+
+    _region = (_region + 1) % STREAM_BUFFER_REGIONS;
+    _offset = 0;
+    _stats.frames++;
+
+    if (_mode == StreamOrphaned) {
+        _staging.resize(_regionSize);
+    } else {
+        waitForRegion(_region);
+        if (_mode == StreamUnsynchronized) {
+            glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+            _pMapped = (char*)glMapBufferRange(GL_ARRAY_BUFFER, _region * _regionSize, _regionSize,
+                GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+    }
+    _inFrame = true;
+}
+
+void radomeStreamBuffer::endFrame() {
+    if (!_inFrame)
+        return;
+    _inFrame = false;
+    _stats.bytesLastFrame = _offset;
+
+    if (_mode == StreamUnsynchronized && _pMapped) {
+        glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        _pMapped = NULL;
+    } else if (_mode == StreamOrphaned && _offset > 0) {
+        glBindBuffer(GL_ARRAY_BUFFER, _buffer);
+        glBufferData(GL_ARRAY_BUFFER, _regionSize, NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, _offset, &_staging[0]);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+}
+
+void* radomeStreamBuffer::reserve(size_t bytes, size_t& offset) {
+    if (!_inFrame)
+        return NULL;
+
+    size_t aligned = (bytes + STREAM_ALIGNMENT - 1) & ~(size_t)(STREAM_ALIGNMENT - 1);
+    _wanted = MAX(_wanted, _offset + aligned);
+    if (_offset + aligned > _regionSize) {
+        _stats.overflows++;
+        return NULL;
+    }
+
+    char* p = NULL;
+    switch (_mode) {
+        case StreamPersistent:
+            p = _pMapped + _region * _regionSize + _offset;
+            offset = _region * _regionSize + _offset;
+            break;
+        case StreamUnsynchronized:
+            if (!_pMapped)
+                return NULL;
+            p = _pMapped + _offset;
+            offset = _region * _regionSize + _offset;
+            break;
+        default:
+            p = &_staging[_offset];
+            offset = _offset;
+            break;
+    }
+    _offset += aligned;
+    return p;
+}
@@ -0,0 +1,83 @@
+//
+//  radomeStreamBuffer.h
+//  radome
+//
+//  Ring of per-frame upload regions for geometry that changes every frame.
+//  Writers get a pointer straight into mapped GPU memory and never wait on
+//  the GPU unless the ring has wrapped onto a region it is still reading.
+//
+
+#ifndef __radome__radomeStreamBuffer__
+#define __radome__radomeStreamBuffer__
+
+#include "ofMain.h"
+#include "radomeGpuMemory.h"
+
+#define STREAM_BUFFER_REGIONS 3
+
+// Where one mesh's streamed vertex data lives this frame.
+struct radomeVertexStream {
+    GLuint buffer;
+    size_t positionOffset;
+    size_t normalOffset;
+    bool hasNormals;
+};
+
+enum radomeStreamMode {
+    StreamPersistent = 0,   // ARB_buffer_storage: mapped once, coherent
+    StreamUnsynchronized,   // ARB_map_buffer_range: mapped per frame without syncing
+    StreamOrphaned,         // neither, or no ARB_sync: staged and uploaded into a fresh store
+};
+
+struct radomeStreamStats {
+    unsigned int frames;
+    unsigned int stalls;        // frames that had to wait on a region's fence
+    unsigned int overflows;     // reservations that didn't fit and fell back
+    size_t bytesLastFrame;
+    size_t regionSize;
+};
+
+class radomeStreamBuffer {
+public:
+    radomeStreamBuffer();
+    ~radomeStreamBuffer();
+
+    // Size of one frame's region; the ring holds STREAM_BUFFER_REGIONS of them.
+    bool allocate(size_t regionSize);
+    bool isAllocated() const { return _buffer != 0; }
+
+    // Fences the region the previous frame wrote, then moves on to the next
+    // one, waiting only if the GPU hasn't finished reading it yet.
+    void beginFrame();
+    // Makes this frame's writes visible to the GPU; call before drawing.
+    void endFrame();
+
+    // Space in the current region, or NULL when it is full (the region grows
+    // at the start of the next frame).
+    void* reserve(size_t bytes, size_t& offset);
+
+    GLuint getBufferId() const { return _buffer; }
+    radomeStreamMode getMode() const { return _mode; }
+    const char* getModeName() const;
+    const radomeStreamStats& getStats() const { return _stats; }
+
+protected:
+    void release();
+    void waitForRegion(int region);
+
+    radomeStreamMode _mode;
+    GLuint _buffer;
+    size_t _regionSize;
+    int _region;
+    size_t _offset;
+    size_t _wanted;
+    char* _pMapped;       // whole ring when persistent, current region otherwise
+    vector<char> _staging;
+    GLsync _fences[STREAM_BUFFER_REGIONS];
+    bool _inFrame;
+
+    radomeStreamStats _stats;
+    radomeGpuMemory::Handle _allocation;
+};
+
+#endif /* defined(__radome__radomeStreamBuffer__) */
@@ -35,3 +35,17 @@ bool radomeSyphonClient::maybeBind() {
         return false;
     }
 }
+
+bool radomeSyphonClient::update() {
+    return isReady();
+}
+
+// The client's size is only known after it has been drawn once, so readiness
+// can't wait on it; a client with no server yet draws nothing.
+bool radomeSyphonClient::isReady() {
+    return isEnabled() && bSetup;
+}
+
+void radomeSyphonClient::drawFrame(float x, float y, float w, float h) {
+    draw(x, y, w, h);
+}
@@ -10,8 +10,9 @@
 #define __radome__radomeSyphonClient__
 
 #include "ofxSyphon.h"
+#include "radomeVideoSource.h"
 
-class radomeSyphonClient : public ofxSyphonClient {
+class radomeSyphonClient : public ofxSyphonClient, public radomeVideoSource {
 public:
     radomeSyphonClient();
     void initialize(string app, string server);
@@ -26,6 +27,14 @@ public:
     
     ofTexture& getTexture() { return mTex; }
     int getTextureId() { return mTex.getTextureData().textureID; }
+
+    // radomeVideoSource. Syphon doesn't say when a new frame arrived, so every
+    // frame counts as new.
+    bool update();
+    bool isReady();
+    float getWidth() { return ofxSyphonClient::getWidth(); }
+    float getHeight() { return ofxSyphonClient::getHeight(); }
+    void drawFrame(float x, float y, float w, float h);
     
 protected:
     bool bEnabled;
@@ -0,0 +1,513 @@
+//
+//  radomeTexturePipeline.cpp
+//  radome
+//
+
+#include "radomeTexturePipeline.h"
+#include "radomeBlockCompressor.h"
+
+#include <sys/stat.h>
+#include <stdint.h>
+#include <algorithm>
+
+#define TEXTURE_WORKER_THREADS 2
+#define TEXTURE_CACHE_DIRECTORY "texcache"
+#define TEXTURE_CACHE_VERSION 1
+// Enough for a few small textures or one large level a frame.
+#define UPLOAD_BYTES_PER_FRAME (2 * 1024 * 1024)
+#define MAX_ANISOTROPY 8.0
+#define IDLE_SLEEP_MS 10
+
+static const char textureCacheMagic[4] = { 'R', 'D', 'T', 'X' };
+
+struct textureCacheHeader {
+    char magic[4];
+    uint32_t version;
+    int64_t sourceSize;
+    int64_t sourceTime;
+    uint32_t format;
+    uint32_t levelCount;
+};
+
+struct textureCacheLevel {
+    uint32_t width;
+    uint32_t height;
+    uint32_t bytes;
+};
+
+class radomeTextureWorker : public ofThread {
+public:
+    radomeTextureWorker(radomeTexturePipeline* pPipeline) : _pPipeline(pPipeline) {}
+
+protected:
+    void threadedFunction() {
+        while (isThreadRunning()) {
+            radomeTexturePipeline::Job* pJob = _pPipeline->take();
+            if (!pJob) {
+                sleep(IDLE_SLEEP_MS);
+                continue;
+            }
+            bool fromCache = false;
+            bool prepared = _pPipeline->prepare(*pJob, fromCache);
+            _pPipeline->finish(pJob, prepared, fromCache);
+        }
+    }
+
+    radomeTexturePipeline* _pPipeline;
+};
+
+size_t radomeTextureImage::getBytes(int firstLevel) const {
+    size_t bytes = 0;
+    for (int ii = firstLevel; ii < (int)levels.size(); ii++)
+        bytes += levels[ii].data.size();
+    return bytes;
+}
+
+// 2x2 box filter; odd sizes lose their last row or column.
+static void halve(const vector<unsigned char>& src, int width, int height, vector<unsigned char>& dst) {
+    int w = MAX(1, width / 2), h = MAX(1, height / 2);
+    dst.resize((size_t)w * h * 4);
+    for (int y = 0; y < h; y++) {
+        int y0 = MIN(y * 2, height - 1), y1 = MIN(y * 2 + 1, height - 1);
+        for (int x = 0; x < w; x++) {
+            int x0 = MIN(x * 2, width - 1), x1 = MIN(x * 2 + 1, width - 1);
+            for (int cc = 0; cc < 4; cc++) {
+                int sum = src[((size_t)y0 * width + x0) * 4 + cc] + src[((size_t)y0 * width + x1) * 4 + cc]
+                        + src[((size_t)y1 * width + x0) * 4 + cc] + src[((size_t)y1 * width + x1) * 4 + cc];
+                dst[((size_t)y * w + x) * 4 + cc] = (sum + 2) / 4;
+            }
+        }
+    }
+}
+
+radomeTexturePipeline::radomeTexturePipeline()
+: _pUploading(NULL)
+, _compress(false)
+, _anisotropy(1)
+, _pixelBuffer(0)
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+radomeTexturePipeline::~radomeTexturePipeline() {
+    for (auto iter = _workers.begin(); iter != _workers.end(); ++iter) {
+        (*iter)->waitForThread(true);
+        delete *iter;
+    }
+    for (auto iter = _pending.begin(); iter != _pending.end(); ++iter)
+        deleteJob(*iter);
+    for (auto iter = _prepared.begin(); iter != _prepared.end(); ++iter)
+        deleteJob(*iter);
+    if (_pUploading)
+        deleteJob(_pUploading);
+    for (auto iter = _delivered.begin(); iter != _delivered.end(); ++iter) {
+        glDeleteTextures(1, &iter->texture);
+        delete iter->pImage;
+    }
+    if (_pixelBuffer)
+        glDeleteBuffers(1, &_pixelBuffer);
+}
+
+void radomeTexturePipeline::setup() {
+    _compress = GLEW_EXT_texture_compression_s3tc;
+    if (GLEW_EXT_texture_filter_anisotropic) {
+        GLfloat maxAnisotropy = 1;
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropy);
+        _anisotropy = MIN(maxAnisotropy, MAX_ANISOTROPY);
+    }
+    if (GLEW_ARB_pixel_buffer_object)
+        glGenBuffers(1, &_pixelBuffer);
+
+    ofDirectory::createDirectory(TEXTURE_CACHE_DIRECTORY, true, true);
+    _cacheDirectory = ofToDataPath(TEXTURE_CACHE_DIRECTORY, true) + "/";
+
+    for (int ii = 0; ii < TEXTURE_WORKER_THREADS; ii++) {
+        radomeTextureWorker* pWorker = new radomeTextureWorker(this);
+        pWorker->startThread(true, false);
+        _workers.push_back(pWorker);
+    }
+    ofLogNotice() << "texture pipeline: " << (_compress ? "S3TC" : "uncompressed RGBA")
+                  << ", " << _anisotropy << "x anisotropic, "
+                  << (_pixelBuffer ? "pixel buffer uploads" : "direct uploads");
+}
+
+void radomeTexturePipeline::request(const void* pOwner, int slot, const string& path) {
+    Job* pJob = new Job();
+    pJob->pOwner = pOwner;
+    pJob->slot = slot;
+    pJob->path = path;
+    pJob->pImage = NULL;
+    pJob->texture = 0;
+    pJob->nextLevel = -1;
+    pJob->canceled = false;
+
+    _mutex.lock();
+    _pending.push_back(pJob);
+    _stats.requested++;
+    _mutex.unlock();
+}
+
+void radomeTexturePipeline::cancel(const void* pOwner) {
+    _mutex.lock();
+    for (auto iter = _pending.begin(); iter != _pending.end(); ) {
+        if ((*iter)->pOwner == pOwner) {
+            deleteJob(*iter);
+            iter = _pending.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+    for (auto iter = _prepared.begin(); iter != _prepared.end(); ) {
+        if ((*iter)->pOwner == pOwner) {
+            deleteJob(*iter);
+            iter = _prepared.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+    for (auto iter = _running.begin(); iter != _running.end(); ++iter) {
+        if ((*iter)->pOwner == pOwner)
+            (*iter)->canceled = true;
+    }
+    _mutex.unlock();
+
+    if (_pUploading && _pUploading->pOwner == pOwner) {
+        deleteJob(_pUploading);
+        _pUploading = NULL;
+    }
+    for (auto iter = _delivered.begin(); iter != _delivered.end(); ) {
+        if (iter->pOwner == pOwner) {
+            glDeleteTextures(1, &iter->texture);
+            delete iter->pImage;
+            iter = _delivered.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+}
+
+radomeTexturePipeline::Job* radomeTexturePipeline::take() {
+    Job* pJob = NULL;
+    _mutex.lock();
+    if (!_pending.empty()) {
+        pJob = _pending.front();
+        _pending.pop_front();
+        _running.push_back(pJob);
+    }
+    _mutex.unlock();
+    return pJob;
+}
+
+void radomeTexturePipeline::finish(Job* pJob, bool prepared, bool fromCache) {
+    _mutex.lock();
+    _running.erase(std::find(_running.begin(), _running.end(), pJob));
+    if (pJob->canceled || !prepared) {
+        if (!prepared)
+            _stats.failed++;
+        deleteJob(pJob);
+    } else {
+        if (fromCache)
+            _stats.cacheHits++;
+        _prepared.push_back(pJob);
+    }
+    _mutex.unlock();
+}
+
+// Worker thread: no GL in here.
+bool radomeTexturePipeline::prepare(Job& job, bool& fromCache) {
+    string fullPath = ofToDataPath(job.path, true);
+    struct stat info;
+    if (stat(fullPath.c_str(), &info) != 0) {
+        ofLogWarning() << "texture pipeline: couldn't find " << job.path;
+        return false;
+    }
+
+    job.pImage = new radomeTextureImage();
+    string cachePath = getCachePath(fullPath);
+    if (readCache(cachePath, info.st_size, info.st_mtime, *job.pImage)) {
+        fromCache = true;
+        return true;
+    }
+    if (!decode(job.path, *job.pImage)) {
+        ofLogWarning() << "texture pipeline: couldn't decode " << job.path;
+        return false;
+    }
+    writeCache(cachePath, info.st_size, info.st_mtime, *job.pImage);
+    return true;
+}
+
+bool radomeTexturePipeline::decode(const string& path, radomeTextureImage& image) {
+    ofPixels pixels;
+    if (!ofLoadImage(pixels, path))
+        return false;
+
+    int width = pixels.getWidth(), height = pixels.getHeight();
+    int channels = pixels.getNumChannels();
+    const unsigned char* pSource = pixels.getPixels();
+    vector<unsigned char> rgba((size_t)width * height * 4);
+    bool alpha = false;
+    for (size_t ii = 0; ii < (size_t)width * height; ii++) {
+        const unsigned char* pIn = pSource + ii * channels;
+        unsigned char* pOut = &rgba[ii * 4];
+        if (channels >= 3) {
+            pOut[0] = pIn[0];
+            pOut[1] = pIn[1];
+            pOut[2] = pIn[2];
+        } else {
+            pOut[0] = pOut[1] = pOut[2] = pIn[0];
+        }
+        pOut[3] = channels == 4 ? pIn[3] : channels == 2 ? pIn[1] : 255;
+        alpha = alpha || pOut[3] < 255;
+    }
+
+    image.format = !_compress ? GL_RGBA8
+                 : alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    image.levels.clear();
+    vector<unsigned char> smaller;
+    while (true) {
+        image.levels.push_back(radomeTextureLevel());
+        radomeTextureLevel& level = image.levels.back();
+        level.width = width;
+        level.height = height;
+        if (image.isCompressed()) {
+            level.data.resize(radomeBlockCompressor::getCompressedSize(width, height, alpha));
+            radomeBlockCompressor::compress(&rgba[0], width, height, alpha, &level.data[0]);
+        } else {
+            level.data = rgba;
+        }
+        if (width == 1 && height == 1)
+            break;
+        halve(rgba, width, height, smaller);
+        rgba.swap(smaller);
+        width = MAX(1, width / 2);
+        height = MAX(1, height / 2);
+    }
+    return true;
+}
+
+// One file per source path, invalidated when the source's size or
+// modification time changes.
+string radomeTexturePipeline::getCachePath(const string& path) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t ii = 0; ii < path.size(); ii++) {
+        hash ^= (unsigned char)path[ii];
+        hash *= 1099511628211ULL;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.rdt", (unsigned long long)hash);
+    return _cacheDirectory + name;
+}
+
+bool radomeTexturePipeline::readCache(const string& cachePath, long long sourceSize, long long sourceTime,
+                                      radomeTextureImage& image) {
+    FILE* pFile = fopen(cachePath.c_str(), "rb");
+    if (!pFile)
+        return false;
+
+    textureCacheHeader header;
+    bool valid = fread(&header, sizeof(header), 1, pFile) == 1
+        && memcmp(header.magic, textureCacheMagic, sizeof(header.magic)) == 0
+        && header.version == TEXTURE_CACHE_VERSION
+        && header.sourceSize == sourceSize && header.sourceTime == sourceTime
+        && header.levelCount > 0
+        // Compressed entries are useless to a driver without S3TC.
+        && (_compress || header.format == GL_RGBA8);
+
+    image.format = header.format;
+    image.levels.clear();
+    for (uint32_t ii = 0; valid && ii < header.levelCount; ii++) {
+        textureCacheLevel stored;
+        if (fread(&stored, sizeof(stored), 1, pFile) != 1) {
+            valid = false;
+            break;
+        }
+        size_t expected = !image.isCompressed() ? (size_t)stored.width * stored.height * 4
+            : radomeBlockCompressor::getCompressedSize(stored.width, stored.height,
+                                                       header.format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT);
+        if (stored.bytes != expected) {
+            valid = false;
+            break;
+        }
+        image.levels.push_back(radomeTextureLevel());
+        radomeTextureLevel& level = image.levels.back();
+        level.width = stored.width;
+        level.height = stored.height;
+        level.data.resize(stored.bytes);
+        valid = fread(&level.data[0], stored.bytes, 1, pFile) == 1;
+    }
+    fclose(pFile);
+    if (!valid)
+        image.levels.clear();
+    return valid;
+}
+
+void radomeTexturePipeline::writeCache(const string& cachePath, long long sourceSize, long long sourceTime,
+                                       const radomeTextureImage& image) {
+    // Written aside (named after the image, so two workers on the same file
+    // don't collide) and renamed, so a reader never sees half a file.
+    string partialPath = cachePath + "." + ofToString((unsigned long)(size_t)&image) + ".part";
+    FILE* pFile = fopen(partialPath.c_str(), "wb");
+    if (!pFile) {
+        ofLogWarning() << "texture pipeline: couldn't write cache " << cachePath;
+        return;
+    }
+
+    textureCacheHeader header;
+    memcpy(header.magic, textureCacheMagic, sizeof(header.magic));
+    header.version = TEXTURE_CACHE_VERSION;
+    header.sourceSize = sourceSize;
+    header.sourceTime = sourceTime;
+    header.format = image.format;
+    header.levelCount = image.levels.size();
+    bool written = fwrite(&header, sizeof(header), 1, pFile) == 1;
+    for (auto iter = image.levels.begin(); written && iter != image.levels.end(); ++iter) {
+        textureCacheLevel stored;
+        stored.width = iter->width;
+        stored.height = iter->height;
+        stored.bytes = iter->data.size();
+        written = fwrite(&stored, sizeof(stored), 1, pFile) == 1
+               && fwrite(&iter->data[0], stored.bytes, 1, pFile) == 1;
+    }
+    fclose(pFile);
+    if (!written || rename(partialPath.c_str(), cachePath.c_str()) != 0) {
+        ofLogWarning() << "texture pipeline: couldn't write cache " << cachePath;
+        remove(partialPath.c_str());
+    }
+}
+
+GLuint radomeTexturePipeline::createTexture(const radomeTextureImage& image, int firstLevel) {
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, image.levels.size() - 1 - firstLevel);
+    if (_anisotropy > 1)
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, _anisotropy);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+// Expects the target texture bound to GL_TEXTURE_2D.
+void radomeTexturePipeline::uploadLevel(const radomeTextureImage& image, int index, int targetLevel) {
+    const radomeTextureLevel& level = image.levels[index];
+    const GLvoid* pData = &level.data[0];
+    if (_pixelBuffer) {
+        // Orphaning hands back fresh storage, so the copy never waits on the
+        // previous transfer and the driver DMAs this one while we carry on.
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, _pixelBuffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, level.data.size(), NULL, GL_STREAM_DRAW);
+        void* pMapped = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
+        if (pMapped) {
+            memcpy(pMapped, pData, level.data.size());
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            pData = NULL;  // offset into the bound buffer
+        } else {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+    }
+    if (image.isCompressed())
+        glCompressedTexImage2D(GL_TEXTURE_2D, targetLevel, image.format, level.width, level.height, 0,
+                               level.data.size(), pData);
+    else
+        glTexImage2D(GL_TEXTURE_2D, targetLevel, GL_RGBA8, level.width, level.height, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, pData);
+    if (_pixelBuffer)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+// Smallest levels first; a texture is only handed over once complete, so a
+// large one can take a few frames without anything drawing it half-loaded.
+void radomeTexturePipeline::update() {
+    size_t uploaded = 0;
+    while (uploaded < UPLOAD_BYTES_PER_FRAME) {
+        if (!_pUploading) {
+            _mutex.lock();
+            if (!_prepared.empty()) {
+                _pUploading = _prepared.front();
+                _prepared.pop_front();
+            }
+            _mutex.unlock();
+            if (!_pUploading)
+                break;
+            _pUploading->texture = createTexture(*_pUploading->pImage, 0);
+            _pUploading->nextLevel = _pUploading->pImage->levels.size() - 1;
+        }
+
+        Job& job = *_pUploading;
+        glBindTexture(GL_TEXTURE_2D, job.texture);
+        while (job.nextLevel >= 0 && uploaded < UPLOAD_BYTES_PER_FRAME) {
+            uploadLevel(*job.pImage, job.nextLevel, job.nextLevel);
+            uploaded += job.pImage->levels[job.nextLevel].data.size();
+            job.nextLevel--;
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+        if (job.nextLevel >= 0)
+            break;
+
+        radomeTextureResult result;
+        result.pOwner = job.pOwner;
+        result.slot = job.slot;
+        result.pImage = job.pImage;
+        result.texture = job.texture;
+        _delivered.push_back(result);
+
+        _mutex.lock();
+        _stats.delivered++;
+        _stats.uncompressedBytes += (size_t)job.pImage->levels[0].width * job.pImage->levels[0].height * 4;
+        _stats.uploadedBytes += job.pImage->getBytes();
+        _mutex.unlock();
+
+        delete _pUploading;
+        _pUploading = NULL;
+    }
+}
+
+void radomeTexturePipeline::collect(vector<radomeTextureResult>& delivered) {
+    delivered.insert(delivered.end(), _delivered.begin(), _delivered.end());
+    _delivered.clear();
+}
+
+GLuint radomeTexturePipeline::upload(const radomeTextureImage& image, int firstLevel) {
+    GLuint texture = createTexture(image, firstLevel);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    for (int level = image.levels.size() - 1; level >= firstLevel; level--)
+        uploadLevel(image, level, level - firstLevel);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+void radomeTexturePipeline::wrap(GLuint texture, const radomeTextureImage& image, int firstLevel, ofTexture& wrapper) {
+    const radomeTextureLevel& level = image.levels[firstLevel];
+    wrapper.setUseExternalTextureID(texture);
+    ofTextureData& data = wrapper.getTextureData();
+    data.textureTarget = GL_TEXTURE_2D;
+    data.glTypeInternal = image.format;
+    data.width = data.tex_w = level.width;
+    data.height = data.tex_h = level.height;
+    data.tex_t = data.tex_u = 1;
+    data.bFlipTexture = false;
+}
+
+int radomeTexturePipeline::getPendingCount() {
+    _mutex.lock();
+    int count = _pending.size() + _running.size() + _prepared.size() + (_pUploading ? 1 : 0);
+    _mutex.unlock();
+    return count;
+}
+
+radomeTextureStats radomeTexturePipeline::getStats() {
+    _mutex.lock();
+    radomeTextureStats stats = _stats;
+    _mutex.unlock();
+    return stats;
+}
+
+void radomeTexturePipeline::deleteJob(Job* pJob) {
+    if (pJob->texture)
+        glDeleteTextures(1, &pJob->texture);
+    delete pJob->pImage;
+    delete pJob;
+}
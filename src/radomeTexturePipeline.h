@@ -0,0 +1,127 @@
+//
+//  radomeTexturePipeline.h
+//  radome
+//
+//  Model textures off the main thread: worker threads decode the file, build
+//  its mip chain and block-compress it (or read all of that back from the
+//  on-disk cache), then the GL thread uploads a few levels per frame through
+//  a pixel buffer object. Finished textures are mipmapped GL_TEXTURE_2Ds,
+//  sampled with normalized texcoords.
+//
+
+#ifndef __radome__radomeTexturePipeline__
+#define __radome__radomeTexturePipeline__
+
+#include "ofMain.h"
+
+#include <deque>
+using std::deque;
+
+struct radomeTextureLevel {
+    int width;
+    int height;
+    vector<unsigned char> data;
+};
+
+// A decoded texture with its full mip chain, largest level first. Assets keep
+// it after upload so smaller sizes can be re-uploaded without decoding again.
+struct radomeTextureImage {
+    GLenum format;  // an S3TC internal format, or GL_RGBA8 without S3TC
+    vector<radomeTextureLevel> levels;
+
+    bool isCompressed() const { return format != GL_RGBA8; }
+    // Video memory for the chain from firstLevel down.
+    size_t getBytes(int firstLevel = 0) const;
+};
+
+struct radomeTextureResult {
+    const void* pOwner;
+    int slot;
+    radomeTextureImage* pImage;
+    GLuint texture;
+};
+
+struct radomeTextureStats {
+    int requested;
+    int cacheHits;
+    int delivered;
+    int failed;
+    // Full-size RGBA without mipmaps, as the loader would have kept them,
+    // against what was actually uploaded.
+    size_t uncompressedBytes;
+    size_t uploadedBytes;
+};
+
+class radomeTextureWorker;
+
+class radomeTexturePipeline {
+public:
+    radomeTexturePipeline();
+    ~radomeTexturePipeline();
+
+    // GL thread: checks for S3TC, anisotropic filtering and pixel buffers.
+    void setup();
+
+    // Loads path for (owner, slot); the result comes back through collect().
+    void request(const void* pOwner, int slot, const string& path);
+    // Drops everything queued, in flight or delivered for owner.
+    void cancel(const void* pOwner);
+
+    // GL thread, once per frame: uploads prepared images within the budget.
+    void update();
+    // Hands over every fully uploaded texture; the caller owns the image and
+    // the GL texture from then on.
+    void collect(vector<radomeTextureResult>& delivered);
+
+    // Uploads levels from firstLevel down right away, for re-sizing a texture
+    // whose image is already in memory.
+    GLuint upload(const radomeTextureImage& image, int firstLevel);
+    // Points texture at a pipeline texture so ofTexture::bind() works with it.
+    static void wrap(GLuint texture, const radomeTextureImage& image, int firstLevel, ofTexture& wrapper);
+
+    int getPendingCount();
+    radomeTextureStats getStats();
+
+protected:
+    friend class radomeTextureWorker;
+
+    struct Job {
+        const void* pOwner;
+        int slot;
+        string path;
+        radomeTextureImage* pImage;
+        GLuint texture;
+        int nextLevel;  // uploads go smallest level first
+        bool canceled;  // owner went away while a worker had it
+    };
+
+    // Worker side.
+    Job* take();
+    void finish(Job* pJob, bool prepared, bool fromCache);
+    bool prepare(Job& job, bool& fromCache);
+    bool decode(const string& path, radomeTextureImage& image);
+    bool readCache(const string& cachePath, long long sourceSize, long long sourceTime, radomeTextureImage& image);
+    void writeCache(const string& cachePath, long long sourceSize, long long sourceTime, const radomeTextureImage& image);
+    string getCachePath(const string& path);
+
+    // GL side.
+    GLuint createTexture(const radomeTextureImage& image, int firstLevel);
+    void uploadLevel(const radomeTextureImage& image, int level, int targetLevel);
+    void deleteJob(Job* pJob);
+
+    ofMutex _mutex;
+    vector<radomeTextureWorker*> _workers;
+    deque<Job*> _pending;
+    vector<Job*> _running;
+    deque<Job*> _prepared;
+    Job* _pUploading;
+    vector<radomeTextureResult> _delivered;
+    radomeTextureStats _stats;
+
+    bool _compress;
+    float _anisotropy;
+    GLuint _pixelBuffer;
+    string _cacheDirectory;
+};
+
+#endif /* defined(__radome__radomeTexturePipeline__) */
@@ -0,0 +1,458 @@
+//
+//  radomeVideoFileSource.cpp
+//  radome
+//
+
+#include "radomeVideoFileSource.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Three buffers, so a frame's copy never waits on the uploads of the two
+// before it.
+#define VIDEO_FILE_PBOS 3
+// Clips up to this size are read ahead whole and stay cached for every
+// loop; larger ones are streamed through a window of upcoming frames.
+#define VIDEO_FILE_CACHE_MB 1024
+#define VIDEO_FILE_PREFETCH_FRAMES 8
+// Copies are split into jobs of this many bytes.
+#define VIDEO_FILE_COPY_CHUNK (1024 * 1024)
+#define Y4M_MAX_HEADER 1024
+#define Y4M_MAX_FRAME_HEADER 256
+// Clock times land on frame boundaries at whole multiples of the frame
+// rate; rounding mustn't put them a frame early.
+#define FRAME_EPSILON 0.0001
+
+struct radomeFrameCopy {
+    unsigned char* pDest;
+    const unsigned char* pSource;
+    size_t bytes;
+};
+
+static void copyChunks(void* pData, int begin, int end) {
+    radomeFrameCopy* pCopy = (radomeFrameCopy*)pData;
+    size_t from = (size_t)begin * VIDEO_FILE_COPY_CHUNK;
+    size_t to = MIN(pCopy->bytes, (size_t)end * VIDEO_FILE_COPY_CHUNK);
+    if (from < to)
+        memcpy(pCopy->pDest + from, pCopy->pSource + from, to - from);
+}
+
+radomeVideoFileSource::radomeVideoFileSource()
+: _pData(NULL)
+, _size(0)
+, _streaming(false)
+, _pJobs(NULL)
+, _format(VideoFileRGB)
+, _width(0)
+, _height(0)
+, _chromaWidth(0)
+, _chromaHeight(0)
+, _fullRange(false)
+, _frameBytes(0)
+, _rateNumerator(30)
+, _rateDenominator(1)
+, _time(0)
+, _frame(-1)
+, _prefetched(-1)
+, _usePbos(false)
+, _pbo(0)
+, _pPixels(NULL)
+, _texturesCurrent(false)
+, _copyMicros(0)
+{
+    memset(_textures, 0, sizeof(_textures));
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+radomeVideoFileSource::~radomeVideoFileSource() {
+    release();
+    if (!_pbos.empty())
+        glDeleteBuffers(_pbos.size(), &_pbos[0]);
+}
+
+bool radomeVideoFileSource::canLoad(const string& path) {
+    string ext = ofToLower(ofFilePath::getFileExt(path));
+    return ext == "y4m" || ext == "rgb" || ext == "rgba" || ext == "bgra";
+}
+
+void radomeVideoFileSource::release() {
+    if (_pData) {
+        munmap(_pData, _size);
+        _pData = NULL;
+        _size = 0;
+    }
+    for (int ii = 0; ii < 3; ii++) {
+        if (_textures[ii])
+            glDeleteTextures(1, &_textures[ii]);
+        _textures[ii] = 0;
+    }
+    _offsets.clear();
+    _frame = -1;
+    _prefetched = -1;
+    _pPixels = NULL;
+}
+
+bool radomeVideoFileSource::load(const string& path) {
+    release();
+    _width = _height = 0;
+    _chromaWidth = _chromaHeight = 0;
+    _fullRange = false;
+    _rateNumerator = 30;
+    _rateDenominator = 1;
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        ofLogError() << "couldn't open video file " << path;
+        return false;
+    }
+    struct stat info;
+    void* pMapped = MAP_FAILED;
+    if (fstat(file, &info) == 0 && info.st_size > 0)
+        pMapped = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, file, 0);
+    close(file);
+    if (pMapped == MAP_FAILED) {
+        ofLogError() << "couldn't map video file " << path;
+        return false;
+    }
+    _pData = (unsigned char*)pMapped;
+    _size = info.st_size;
+    _path = path;
+
+    bool parsed = ofToLower(ofFilePath::getFileExt(path)) == "y4m" ? parseY4M() : parseRawName(path);
+    if (!parsed || _offsets.empty()) {
+        ofLogError() << "couldn't play video file " << path;
+        release();
+        return false;
+    }
+
+    // A clip that fits is cached whole, ready for every pass of the loop;
+    // the kernel reads a larger one ahead of playback and frees it behind.
+    _streaming = _size > (size_t)VIDEO_FILE_CACHE_MB * 1024 * 1024;
+    madvise(_pData, _size, _streaming ? MADV_SEQUENTIAL : MADV_WILLNEED);
+
+    _usePbos = GLEW_ARB_pixel_buffer_object;
+    if (_format == VideoFileYCbCr && !_shader.isLoaded()) {
+        _shader.setupShaderFromFile(GL_FRAGMENT_SHADER, "yuv.frag");
+        _shader.linkProgram();
+    }
+    ofLogNotice() << "video file " << path << ": " << _width << "x" << _height << ", "
+                  << _offsets.size() << " frames at " << ofToString(getFrameRate(), 2) << " fps"
+                  << (_streaming ? ", streamed" : ", cached");
+    return true;
+}
+
+// Y4M: a text header with the size, rate and chroma layout, then frames of
+// one luma plane and two chroma planes, each after a line of its own.
+bool radomeVideoFileSource::parseY4M() {
+    const char* pText = (const char*)_pData;
+    size_t limit = MIN(_size, (size_t)Y4M_MAX_HEADER);
+    const char* pEnd = (const char*)memchr(pText, '\n', limit);
+    if (!pEnd || limit < 10 || memcmp(pText, "YUV4MPEG2 ", 10) != 0)
+        return false;
+
+    string chroma = "420jpeg";
+    vector<string> tokens = ofSplitString(string(pText + 10, pEnd), " ", true, true);
+    for (int ii = 0; ii < (int)tokens.size(); ii++) {
+        const string& token = tokens[ii];
+        switch (token[0]) {
+        case 'W': _width = ofToInt(token.substr(1)); break;
+        case 'H': _height = ofToInt(token.substr(1)); break;
+        case 'F': sscanf(token.c_str() + 1, "%d:%d", &_rateNumerator, &_rateDenominator); break;
+        case 'C': chroma = token.substr(1); break;
+        case 'X': if (token == "XCOLORRANGE=FULL") _fullRange = true; break;
+        }
+    }
+    if (_width <= 0 || _height <= 0 || _rateNumerator <= 0 || _rateDenominator <= 0)
+        return false;
+
+    _format = VideoFileYCbCr;
+    if (chroma == "420jpeg" || chroma == "420paldv" || chroma == "420mpeg2" || chroma == "420") {
+        _chromaWidth = (_width + 1) / 2;
+        _chromaHeight = (_height + 1) / 2;
+    } else if (chroma == "422") {
+        _chromaWidth = (_width + 1) / 2;
+        _chromaHeight = _height;
+    } else if (chroma == "444") {
+        _chromaWidth = _width;
+        _chromaHeight = _height;
+    } else if (chroma == "mono") {
+        _chromaWidth = _chromaHeight = 0;
+    } else {
+        ofLogError() << "Y4M chroma layout C" << chroma << " isn't supported; only 8-bit 420, 422, 444 and mono are";
+        return false;
+    }
+    _frameBytes = (size_t)_width * _height + 2 * (size_t)_chromaWidth * _chromaHeight;
+
+    // Frame headers may carry parameters, so each one is found in turn.
+    size_t pos = pEnd + 1 - pText;
+    while (pos + 5 <= _size && memcmp(pText + pos, "FRAME", 5) == 0) {
+        const char* pLine = (const char*)memchr(pText + pos, '\n', MIN(_size - pos, (size_t)Y4M_MAX_FRAME_HEADER));
+        if (!pLine)
+            break;
+        size_t data = pLine + 1 - pText;
+        if (data + _frameBytes > _size)
+            break;
+        _offsets.push_back(data);
+        pos = data + _frameBytes;
+    }
+    return true;
+}
+
+// Raw frames carry no header: the size, and optionally the rate, come from
+// the name, e.g. "sky_4096x4096_29.97.rgb".
+bool radomeVideoFileSource::parseRawName(const string& path) {
+    string ext = ofToLower(ofFilePath::getFileExt(path));
+    _format = ext == "rgba" ? VideoFileRGBA : ext == "bgra" ? VideoFileBGRA : VideoFileRGB;
+
+    vector<string> parts = ofSplitString(ofFilePath::getBaseName(path), "_");
+    double fps = 30;
+    for (int ii = 0; ii < (int)parts.size(); ii++) {
+        int width, height;
+        char extra;
+        if (sscanf(parts[ii].c_str(), "%dx%d%c", &width, &height, &extra) != 2)
+            continue;
+        _width = width;
+        _height = height;
+        if (ii + 1 < (int)parts.size() && ofToFloat(parts[ii + 1]) > 0)
+            fps = ofToFloat(parts[ii + 1]);
+    }
+    if (_width <= 0 || _height <= 0) {
+        ofLogError() << "raw video files need their size in the name, like clip_1920x1080_30.rgb";
+        return false;
+    }
+    if (fps == floor(fps)) {
+        _rateNumerator = fps;
+        _rateDenominator = 1;
+    } else {
+        _rateNumerator = floor(fps * 1000 + 0.5);
+        _rateDenominator = 1000;
+    }
+
+    _frameBytes = (size_t)_width * _height * (_format == VideoFileRGB ? 3 : 4);
+    size_t frames = _size / _frameBytes;
+    for (size_t ii = 0; ii < frames; ii++)
+        _offsets.push_back(ii * _frameBytes);
+    return true;
+}
+
+int radomeVideoFileSource::getFrameAt(double time) const {
+    int count = _offsets.size();
+    long long frame = (long long)floor(time * _rateNumerator / _rateDenominator + FRAME_EPSILON) % count;
+    return frame < 0 ? frame + count : frame;
+}
+
+void radomeVideoFileSource::advise(int frame, int advice) {
+    static size_t pageSize = sysconf(_SC_PAGESIZE);
+    size_t begin = _offsets[frame] / pageSize * pageSize;
+    size_t end = MIN(_size, _offsets[frame] + _frameBytes);
+    madvise(_pData + begin, end - begin, advice);
+}
+
+// Keeps the next frames on their way in. Playback usually moves on a frame
+// at a time, so only the frames that have come into the window are asked
+// for; a jump asks for the whole window again.
+void radomeVideoFileSource::prefetch(int frame) {
+    int count = _offsets.size();
+    int window = MIN(VIDEO_FILE_PREFETCH_FRAMES, count - 1);
+    if (!_streaming || window <= 0)
+        return;
+    int moved = _prefetched < 0 ? count : (frame - _prefetched + count) % count;
+    if (!moved)
+        return;
+    int first = moved > window ? 1 : window - moved + 1;
+    for (int ii = first; ii <= window; ii++)
+        advise((frame + ii) % count, MADV_WILLNEED);
+    _prefetched = frame;
+}
+
+// The frame's one copy: from the mapping into the next buffer of the ring,
+// spread over the workers. With the frames read ahead it runs at memory
+// speed; a frame still on disk is faulted in by all of them at once.
+bool radomeVideoFileSource::readFrame(int frame) {
+    const unsigned char* pSource = _pData + _offsets[frame];
+    if (!_usePbos) {
+        _pPixels = pSource;
+        return true;
+    }
+
+    unsigned long long start = ofGetElapsedTimeMicros();
+    if (_pbos.empty()) {
+        _pbos.resize(VIDEO_FILE_PBOS);
+        glGenBuffers(_pbos.size(), &_pbos[0]);
+    }
+    int pbo = (_pbo + 1) % _pbos.size();
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, _pbos[pbo]);
+    // Orphaned first, so mapping doesn't wait for an upload still reading it.
+    glBufferData(GL_PIXEL_UNPACK_BUFFER_ARB, _frameBytes, NULL, GL_STREAM_DRAW);
+    unsigned char* pDest = (unsigned char*)glMapBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY);
+    if (pDest) {
+        radomeFrameCopy copy = { pDest, pSource, _frameBytes };
+        int chunks = (_frameBytes + VIDEO_FILE_COPY_CHUNK - 1) / VIDEO_FILE_COPY_CHUNK;
+        if (_pJobs) {
+            _pJobs->parallelFor(_copyJobs, copyChunks, &copy, 0, chunks);
+            _pJobs->wait(_copyJobs);
+        } else {
+            copyChunks(&copy, 0, chunks);
+        }
+    }
+    bool copied = pDest && glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER_ARB);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+    _copyMicros += ofGetElapsedTimeMicros() - start;
+    if (!copied)
+        return false;
+    _pbo = pbo;
+    return true;
+}
+
+bool radomeVideoFileSource::update() {
+    if (!_pData)
+        return false;
+    int frame = getFrameAt(_time);
+    prefetch(frame);
+    if (frame == _frame || !readFrame(frame))
+        return false;
+
+    if (_frame >= 0) {
+        int count = _offsets.size();
+        int advanced = (frame - _frame + count) % count;
+        if (advanced > 1)
+            _stats.skipped += advanced - 1;
+        // Streamed frames won't be back before the loop comes round.
+        if (_streaming)
+            advise(_frame, MADV_DONTNEED);
+    }
+    _frame = frame;
+    _texturesCurrent = false;
+    _stats.frames++;
+    return true;
+}
+
+void radomeVideoFileSource::getPixelFormat(GLenum& format, GLenum& type) const {
+    type = GL_UNSIGNED_BYTE;
+    if (_format == VideoFileRGB) {
+        format = GL_RGB;
+    } else if (_format == VideoFileRGBA) {
+        format = GL_RGBA;
+    } else {
+        format = GL_BGRA;
+        type = GL_UNSIGNED_INT_8_8_8_8_REV;
+    }
+}
+
+// Straight from the pixel buffer into the layer's slice, when the frame is
+// RGB and exactly the slice's size; anything else is drawn in.
+bool radomeVideoFileSource::uploadToSlice(GLuint texture, int slice, int width, int height) {
+    if (_frame < 0 || _format == VideoFileYCbCr || width != _width || height != _height)
+        return false;
+
+    GLenum format, type;
+    getPixelFormat(format, type);
+    if (_usePbos)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, _pbos[_pbo]);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glBindTexture(GL_TEXTURE_2D_ARRAY_EXT, texture);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY_EXT, 0, 0, 0, slice, _width, _height, 1, format, type,
+                    _usePbos ? NULL : _pPixels);
+    glBindTexture(GL_TEXTURE_2D_ARRAY_EXT, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (_usePbos)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+    return true;
+}
+
+// One texture for RGB, or one luminance texture per plane, so the chroma
+// planes are scaled up by the sampler when they're drawn.
+void radomeVideoFileSource::uploadTextures() {
+    bool planar = _format == VideoFileYCbCr;
+    int planes = planar && _chromaWidth ? 3 : 1;
+    int widths[3] = { _width, _chromaWidth, _chromaWidth };
+    int heights[3] = { _height, _chromaHeight, _chromaHeight };
+    size_t offsets[3] = { 0, (size_t)_width * _height, (size_t)_width * _height + (size_t)_chromaWidth * _chromaHeight };
+
+    GLenum format = GL_LUMINANCE, type = GL_UNSIGNED_BYTE;
+    if (!planar)
+        getPixelFormat(format, type);
+    const unsigned char* pBase = _usePbos ? NULL : _pPixels;
+    if (_usePbos)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, _pbos[_pbo]);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int ii = 0; ii < planes; ii++) {
+        if (!_textures[ii]) {
+            glGenTextures(1, &_textures[ii]);
+            glBindTexture(GL_TEXTURE_2D, _textures[ii]);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexImage2D(GL_TEXTURE_2D, 0, planar ? GL_LUMINANCE8 : GL_RGBA8, widths[ii], heights[ii], 0,
+                         planar ? GL_LUMINANCE : GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        }
+        glBindTexture(GL_TEXTURE_2D, _textures[ii]);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, widths[ii], heights[ii], format, type, pBase + offsets[ii]);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (_usePbos)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+}
+
+void radomeVideoFileSource::drawFrame(float x, float y, float w, float h) {
+    if (_frame < 0)
+        return;
+    bool planar = _format == VideoFileYCbCr;
+    if (planar && !_shader.isLoaded())
+        return;
+    if (!_texturesCurrent) {
+        uploadTextures();
+        _texturesCurrent = true;
+    }
+
+    if (planar) {
+        // Y4M doesn't say which matrix it was encoded with; HD and up is
+        // taken to be BT.709, anything smaller BT.601.
+        _shader.begin();
+        _shader.setUniform1i("yPlane", 0);
+        _shader.setUniform1i("cbPlane", 1);
+        _shader.setUniform1i("crPlane", 2);
+        _shader.setUniform1f("chroma", _chromaWidth ? 1 : 0);
+        _shader.setUniform1f("fullRange", _fullRange ? 1 : 0);
+        if (_height >= 720)
+            _shader.setUniform4f("coefficients", 1.5748, 0.187324, 0.468124, 1.8556);
+        else
+            _shader.setUniform4f("coefficients", 1.402, 0.344136, 0.714136, 1.772);
+        for (int ii = 2; ii >= 0; ii--) {
+            glActiveTexture(GL_TEXTURE0 + ii);
+            glBindTexture(GL_TEXTURE_2D, _textures[ii]);
+        }
+    } else {
+        glEnable(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, _textures[0]);
+    }
+
+    glBegin(GL_QUADS);
+    glTexCoord2f(0, 0); glVertex2f(x, y);
+    glTexCoord2f(1, 0); glVertex2f(x + w, y);
+    glTexCoord2f(1, 1); glVertex2f(x + w, y + h);
+    glTexCoord2f(0, 1); glVertex2f(x, y + h);
+    glEnd();
+
+    if (planar) {
+        for (int ii = 2; ii >= 0; ii--) {
+            glActiveTexture(GL_TEXTURE0 + ii);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+        _shader.end();
+    } else {
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glDisable(GL_TEXTURE_2D);
+    }
+}
+
+radomeVideoFileStats radomeVideoFileSource::getStats() {
+    radomeVideoFileStats stats = _stats;
+    stats.copyMicros = _stats.frames ? (float)_copyMicros / _stats.frames : 0;
+    memset(&_stats, 0, sizeof(_stats));
+    _copyMicros = 0;
+    return stats;
+}
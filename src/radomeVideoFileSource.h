@@ -0,0 +1,109 @@
+//
+//  radomeVideoFileSource.h
+//  radome
+//
+//  Plays an uncompressed clip from a memory-mapped file: Y4M, or raw frames
+//  named after their size ("sky_4096x4096_30.rgb"; .rgb, .rgba or .bgra,
+//  30 frames a second when the rate is left out). Nothing is decoded: a
+//  frame's bytes are copied from the mapping into a pixel buffer, on the job
+//  workers, and the GPU uploads them from there. Y4M planes are converted to
+//  RGB by a shader as the frame is drawn into its layer.
+//
+//  The frame shown follows the time handed to setTime(), so playback loops
+//  in step with the animation clock whatever the output frame rate. The
+//  kernel is told about the frames coming up ahead of time; clips too large
+//  to stay cached are read as a stream, and frames already shown are dropped
+//  from memory.
+//
+
+#ifndef __radome__radomeVideoFileSource__
+#define __radome__radomeVideoFileSource__
+
+#include "radomeVideoSource.h"
+#include "radomeJobSystem.h"
+
+enum radomeVideoFileFormat {
+    VideoFileRGB = 0,
+    VideoFileRGBA,
+    VideoFileBGRA,
+    VideoFileYCbCr,     // planar, 8 bits, from Y4M
+};
+
+struct radomeVideoFileStats {
+    unsigned int frames;        // uploaded
+    unsigned int skipped;       // passed over because the clock moved on more than a frame
+    float copyMicros;           // mean time to copy a frame out of the mapping
+};
+
+class radomeVideoFileSource : public radomeVideoSource {
+public:
+    radomeVideoFileSource();
+    ~radomeVideoFileSource();
+
+    // Whether the path names a file this source plays, going by its extension.
+    static bool canLoad(const string& path);
+
+    // Without a job system frames are copied on the calling thread.
+    void setJobSystem(radomeJobSystem* pJobs) { _pJobs = pJobs; }
+    bool load(const string& path);
+
+    int getFrameCount() const { return _offsets.size(); }
+    double getFrameRate() const { return (double)_rateNumerator / _rateDenominator; }
+
+    void setTime(double seconds) { _time = seconds; }
+    bool update();
+    bool isReady() { return _frame >= 0; }
+    float getWidth() { return _width; }
+    float getHeight() { return _height; }
+    void drawFrame(float x, float y, float w, float h);
+    bool uploadToSlice(GLuint texture, int slice, int width, int height);
+
+    // Since the last call.
+    radomeVideoFileStats getStats();
+
+protected:
+    bool parseY4M();
+    bool parseRawName(const string& path);
+    void release();
+    int getFrameAt(double time) const;
+    void advise(int frame, int advice);
+    void prefetch(int frame);
+    bool readFrame(int frame);
+    void uploadTextures();
+    void getPixelFormat(GLenum& format, GLenum& type) const;
+
+    string _path;
+    unsigned char* _pData;
+    size_t _size;
+    bool _streaming;            // too large to keep cached
+    radomeJobSystem* _pJobs;
+    radomeJobGroup _copyJobs;
+
+    int _format;
+    int _width;
+    int _height;
+    int _chromaWidth;           // 0 for monochrome Y4M
+    int _chromaHeight;
+    bool _fullRange;
+    size_t _frameBytes;
+    int _rateNumerator;
+    int _rateDenominator;
+    vector<size_t> _offsets;    // of each frame's pixels
+
+    double _time;
+    int _frame;                 // shown, -1 before the first
+    int _prefetched;            // the frame the read-ahead window last started from
+
+    bool _usePbos;
+    vector<GLuint> _pbos;
+    int _pbo;                   // holding the current frame
+    const unsigned char* _pPixels;  // the current frame in the mapping, without pixel buffers
+    GLuint _textures[3];        // RGB, or the Y, Cb and Cr planes
+    bool _texturesCurrent;
+    ofShader _shader;
+
+    radomeVideoFileStats _stats;
+    unsigned long long _copyMicros;
+};
+
+#endif /* defined(__radome__radomeVideoFileSource__) */
@@ -0,0 +1,40 @@
+//
+//  radomeVideoSource.h
+//  radome
+//
+//  Interface for anything that can feed a 2D layer of the compositor: Syphon
+//  clients, still images, shared memory rings, video files, and other frame
+//  providers.
+//
+
+#ifndef __radome__radomeVideoSource__
+#define __radome__radomeVideoSource__
+
+#include "ofMain.h"
+
+class radomeVideoSource {
+public:
+    virtual ~radomeVideoSource() {}
+
+    // The animation clock, in seconds, for the frame about to be composited.
+    // Sources that play clips show the frame for this time; live ones ignore it.
+    virtual void setTime(double seconds) {}
+
+    // Called once per frame before compositing; returns true when the source
+    // has a frame the layer stack hasn't copied yet.
+    virtual bool update() = 0;
+
+    virtual bool isReady() = 0;
+    virtual float getWidth() = 0;
+    virtual float getHeight() = 0;
+
+    // Draws the current frame to fill the given rectangle.
+    virtual void drawFrame(float x, float y, float w, float h) = 0;
+
+    // Sources with the frame's pixels at hand can upload them straight into
+    // a slice of the layer texture array, of the given size, instead of
+    // being drawn into it. False to be drawn.
+    virtual bool uploadToSlice(GLuint texture, int slice, int width, int height) { return false; }
+};
+
+#endif /* defined(__radome__radomeVideoSource__) */